@@ -0,0 +1,197 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncLogger.h"
+
+// Задержка вызова rawLog в опрашивающем потоке: синхронная запись в файл против асинхронного режима,
+// затем ограничение повторов и переполнение маленького кольца.
+// Самопроверка: асинхронное форматирование совпадает с snprintf, число строк сходится со счетчиками
+
+using namespace mb::log;
+
+constexpr int CALLS = 200000;
+static const char* LOG_PATH = "/tmp/mb_async_log_bench.log";
+
+static const char* STATUS[] = { "OK", "TIMEOUT", "CRC_ERROR", "EXCEPTION" };
+
+struct Latency {
+	double p50, p99, max;
+};
+
+static Latency measure(AsyncLogger& log) {
+	std::vector<double> ns(CALLS);
+	for (int i = 0; i < CALLS; i++) {
+		auto t = std::chrono::steady_clock::now();
+		log.rawLog("slave %d func %d addr %u: %s (%.3f ms)", i % 247 + 1, 3, i * 10u, STATUS[i & 3], i * 0.001);
+		ns[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t).count();
+	}
+	std::sort(ns.begin(), ns.end());
+	return Latency{ ns[CALLS / 2], ns[CALLS * 99 / 100], ns.back() };
+}
+
+static size_t countLines(const char* path) {
+	std::ifstream f(path);
+	std::string line;
+	size_t n = 0;
+	while (std::getline(f, line)) n++;
+	return n;
+}
+
+static void printLatency(const char* name, const Latency& l) {
+	std::cout << name << "p50 " << l.p50 << " ns, p99 " << l.p99 << " ns, max " << l.max / 1000 << " us" << std::endl;
+}
+
+// Результат фонового форматирования совпадает с snprintf для типичных преобразований
+static bool checkFormat() {
+	remove(LOG_PATH);
+	LogConfig config;
+	config.timestamps = false;
+	config.rate_window_ms = 0;
+	AsyncLogger log(config);
+	log.open(LOG_PATH);
+	log.setMode(LogMode::ASYNC);
+
+	std::vector<std::string> expected;
+	char buf[512];
+	const char* s = "строка";
+	long long big = -1234567890123ll;
+	size_t sz = 4096;
+	void* ptr = &sz;
+#define CHECK_FMT(...) snprintf(buf, sizeof(buf), __VA_ARGS__); expected.push_back(buf); log.rawLog(__VA_ARGS__)
+	CHECK_FMT("plain text 100%%");
+	CHECK_FMT("%d %i %u %x %X %o %c", -5, 42, 3000000000u, 0xBEEFu, 0xCAFEu, 8u, 'Z');
+	CHECK_FMT("%hhd %hd %ld %lld %zu %hhu %hu", -1, -2, -3l, big, sz, 255u, 65535u);
+	CHECK_FMT("[%8s] [%-8.3s] [%s]", s, "abcdef", "end");
+	CHECK_FMT("%.2f %10.4e %g %Lf", 3.14159, 12345.678, 0.0001, 2.5L);
+	CHECK_FMT("[%*d] [%-*d] [%.*f] [%*.*s]", 6, 42, 4, 7, 3, 1.0 / 3, 5, 2, "xyz");
+	CHECK_FMT("%p %05d %+d %#x", ptr, 42, 7, 255u);
+#undef CHECK_FMT
+	log.flush();
+
+	std::ifstream f(LOG_PATH);
+	std::string line;
+	size_t i = 0;
+	bool ok = true;
+	while (std::getline(f, line)) {
+		if (i >= expected.size() || line != expected[i]) {
+			std::cout << "format mismatch: '" << line << "' != '" << (i < expected.size() ? expected[i] : "") << "'" << std::endl;
+			ok = false;
+		}
+		i++;
+	}
+	return ok && i == expected.size();
+}
+
+// Одинаковое сообщение в цикле: выводится rate_burst, остальные учтены как отброшенные.
+// После паузы дольше окна о повторах без последующего сообщения фоновый поток сообщает отдельной строкой
+static bool checkRateLimit() {
+	remove(LOG_PATH);
+	LogConfig config;
+	config.rate_window_ms = 50;
+	AsyncLogger log(config);
+	log.open(LOG_PATH);
+	log.setMode(LogMode::ASYNC);
+	const int total = 100000;
+	auto t = std::chrono::steady_clock::now();
+	for (int i = 0; i < total; i++) log.rawLog("slave %d: %s", 17, "TIMEOUT");
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t).count() / total;
+	std::this_thread::sleep_for(std::chrono::milliseconds(config.rate_window_ms + 4 * config.flush_ms));
+	log.flush();
+
+	LogStats st = log.getStats();
+	std::ifstream f(LOG_PATH);
+	std::string line;
+	uint64_t messages = 0;
+	uint64_t reported = 0;
+	uint64_t notices = 0;
+	while (std::getline(f, line)) {
+		const size_t colon = line.rfind(": ");
+		if (line.find("[log]") != std::string::npos) {
+			++notices;
+			reported += std::stoull(line.substr(colon + 2));
+			continue;
+		}
+		++messages;
+		const size_t carried = line.find("отброшено: ");
+		if (carried != std::string::npos) reported += std::stoull(line.substr(carried + strlen("отброшено: ")));
+	}
+	std::cout << "repeated message: " << ns << " ns/call, written " << st.written << ", suppressed " << st.suppressed
+				 << ", reported " << reported << " (" << notices << " expiry notices)" << std::endl;
+	return st.written + st.suppressed == total && st.written >= 5 && messages == st.written && reported == st.suppressed && notices > 0;
+}
+
+// Кольцо 1 КБ и поток, пишущий без пауз: часть сообщений теряется, о потерях выводится строка
+static bool checkDrops() {
+	remove(LOG_PATH);
+	LogConfig config;
+	config.ring_size = 1024;
+	config.rate_window_ms = 0;
+	AsyncLogger log(config);
+	log.open(LOG_PATH);
+	log.setMode(LogMode::ASYNC);
+
+	const int total = 50000;
+	uint64_t drop_lines = 0;
+	std::thread writer([&]() {
+		for (int i = 0; i < total; i++) log.rawLog("frame %d from thread", i);
+	});
+	writer.join();
+	log.flush();
+
+	LogStats st = log.getStats();
+	std::ifstream f(LOG_PATH);
+	std::string line;
+	int last = -1;
+	bool ordered = true;
+	while (std::getline(f, line)) {
+		int n;
+		if (line.find("[log]") != std::string::npos) drop_lines++;
+		else if (sscanf(line.c_str() + 13, "frame %d", &n) == 1) {
+			ordered &= n > last;
+			last = n;
+		}
+	}
+	std::cout << "1 KB ring: written " << st.written << ", dropped " << st.dropped << ", drop notices " << drop_lines << std::endl;
+	return ordered && st.written + st.dropped == total && countLines(LOG_PATH) == st.written + drop_lines && (st.dropped == 0 || drop_lines > 0);
+}
+
+int main() {
+	std::cout << std::fixed << std::setprecision(1);
+
+	remove(LOG_PATH);
+	LogConfig config;
+	config.rate_window_ms = 0;
+	config.ring_size = 32 << 20;
+	AsyncLogger sync_log(config);
+	sync_log.open(LOG_PATH);
+	Latency sync = measure(sync_log);
+
+	remove(LOG_PATH);
+	AsyncLogger async_log(config);
+	async_log.open(LOG_PATH);
+	async_log.setMode(LogMode::ASYNC);
+	Latency async = measure(async_log);
+	async_log.flush();
+	LogStats st = async_log.getStats();
+
+	std::cout << CALLS << " calls, \"slave %d func %d addr %u: %s (%.3f ms)\"" << std::endl;
+	printLatency("sync:  ", sync);
+	printLatency("async: ", async);
+	std::cout << "async written " << st.written << ", dropped " << st.dropped << std::endl;
+
+	bool ok = st.written + st.dropped == CALLS && countLines(LOG_PATH) == st.written;
+	ok = checkFormat() && ok;
+	ok = checkRateLimit() && ok;
+	ok = checkDrops() && ok;
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	remove(LOG_PATH);
+	return ok ? 0 : 1;
+}
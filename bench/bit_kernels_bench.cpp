@@ -0,0 +1,182 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Map.h"
+#include "BitKernels.h"
+
+// Преобразование битов карты слов в массивы BIT и обратно на диапазонах по 2000 бит (максимум чтения катушек):
+// - прежний побитовый цикл Map::readWordBits/writeWordBits с ветвлением на каждом бите
+// - ядра scalar/sse2/avx2/bmi2, поддерживаемые процессором
+// Проверка: каждое ядро сверяется с эталонной побитовой версией на всех сдвигах 0-47 и длинах 0-300
+// и на случайных диапазонах, запись проверяет и соседние биты слов; методы Map сверяются с эталоном.
+// Запуск: bench_bit_kernels [seed]
+
+using namespace mb::data;
+
+constexpr size_t SPAN_BITS = 2000;
+constexpr size_t BUF_WORDS = 160;
+constexpr int SPANS = 200000;
+
+static double nowSec() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Прежняя реализация Map::readWordBits
+static void legacyRead(const WORD* mem, WORD bit_adr, WORD quantity, BIT* val) {
+	WORD word_adr = bit_adr / WORD_BIT_SIZE;
+	WORD bit_number = bit_adr % WORD_BIT_SIZE;
+	WORD word_val = mem[word_adr];
+	for (WORD i = 0; i < quantity; i++) {
+		if (bit_number == WORD_BIT_SIZE && i != 0) {
+			word_val = mem[++word_adr];
+			bit_number = 0;
+		}
+		val[i] = (word_val >> bit_number) & 1;
+		++bit_number;
+	}
+}
+
+// Прежняя реализация Map::writeWordBits
+static void legacyWrite(WORD* mem, WORD bit_adr, WORD quantity, const BIT* val) {
+	WORD word_adr = bit_adr / WORD_BIT_SIZE;
+	WORD bit_number = bit_adr % WORD_BIT_SIZE;
+	WORD word_val = mem[word_adr];
+	for (WORD i = 0; i < quantity; i++) {
+		if (bit_number == WORD_BIT_SIZE && i != 0) {
+			mem[word_adr] = word_val;
+			word_val = mem[++word_adr];
+			bit_number = 0;
+		}
+		if (val[i]) word_val |= (1 << bit_number);
+		else word_val &= ~(1 << bit_number);
+		++bit_number;
+	}
+	mem[word_adr] = word_val;
+}
+
+// Значения BIT: половина нулей, остальные - любое ненулевое значение (запись принимает его за 1)
+static void fillBits(std::mt19937& rng, std::vector<BIT>& bits) {
+	for (BIT& b : bits) b = rng() % 2 ? static_cast<BIT>(1 + rng() % 255) : 0;
+}
+
+static bool checkSpan(std::mt19937& rng, std::vector<WORD>& words, std::vector<BIT>& bits, size_t offset, size_t quantity) {
+	for (WORD& w : words) w = static_cast<WORD>(rng());
+	std::vector<BIT> got(quantity + 1, 0xEE), expect(quantity + 1, 0xEE);
+	unpackWordBits(words.data(), offset, quantity, got.data());
+	unpackWordBitsRef(words.data(), offset, quantity, expect.data());
+	if (got != expect) return false;		// Включая байт за концом массива
+
+	fillBits(rng, bits);
+	std::vector<WORD> ref = words;
+	packWordBits(words.data(), offset, quantity, bits.data());
+	packWordBitsRef(ref.data(), offset, quantity, bits.data());
+	return words == ref;					// Включая биты вне диапазона
+}
+
+static bool checkKernel(std::mt19937& rng) {
+	std::vector<WORD> words(BUF_WORDS);
+	std::vector<BIT> bits(BUF_WORDS * WORD_BIT_SIZE);
+	bool ok = true;
+	for (size_t offset = 0; offset < 48 && ok; offset++) {
+		for (size_t quantity = 0; quantity <= 300 && ok; quantity++) ok = checkSpan(rng, words, bits, offset, quantity);
+	}
+	for (int i = 0; i < 5000 && ok; i++) {
+		const size_t offset = rng() % 400;
+		const size_t quantity = rng() % (BUF_WORDS * WORD_BIT_SIZE - offset + 1);
+		ok = checkSpan(rng, words, bits, offset, quantity);
+	}
+	return ok;
+}
+
+// Методы Map на карте слов со стартовым адресом 7: writeBits (карта слов), write/readWordBits, write/readWordNBits
+static bool checkMap(std::mt19937& rng) {
+	const WORD start = 7, quantity = 140;
+	Map m;
+	if (!m.initNewMemory(start, quantity, MapType::WORD_MAP)) return false;
+	std::vector<WORD> ref(quantity, 0);
+	std::vector<BIT> bits(SPAN_BITS), got(SPAN_BITS);
+	bool ok = true;
+	for (int i = 0; i < 2000 && ok; i++) {
+		const WORD bit_adr = static_cast<WORD>(start * WORD_BIT_SIZE + rng() % (quantity * WORD_BIT_SIZE - SPAN_BITS));
+		const WORD n = static_cast<WORD>(1 + rng() % SPAN_BITS);
+		fillBits(rng, bits);
+		packWordBitsRef(ref.data(), bit_adr - start * WORD_BIT_SIZE, n, bits.data());
+		switch (i % 3) {
+			case 0: ok = m.writeBits(bit_adr, n, bits.data()); break;
+			case 1: ok = m.writeWordBits(bit_adr, n, bits.data()); break;
+			default: ok = m.writeWordNBits(bit_adr / WORD_BIT_SIZE, bit_adr % WORD_BIT_SIZE, n, bits.data()); break;
+		}
+		std::vector<WORD> mem(quantity);
+		ok = ok && m.readWords(start, quantity, mem.data()) && mem == ref;
+		ok = ok && (i % 2 ? m.readWordBits(bit_adr, n, got.data()) : m.readWordNBits(bit_adr / WORD_BIT_SIZE, bit_adr % WORD_BIT_SIZE, n, got.data()));
+		for (WORD k = 0; k < n && ok; k++) ok = got[k] == (bits[k] != 0);
+	}
+	// Границы: последний бит карты, выход за карту
+	const WORD last_bit = static_cast<WORD>((start + quantity) * WORD_BIT_SIZE - 1);
+	BIT one = 1;
+	ok = ok && m.writeBits(last_bit, 1, &one) && m.readWordBit(last_bit, &one) && one == 1;
+	ok = ok && !m.writeBits(last_bit, 2, bits.data()) && !m.readWordBits(last_bit, 2, got.data()) && !m.readWordBits(start * WORD_BIT_SIZE - 1, 1, got.data());
+	return ok;
+}
+
+template <typename Fn>
+static double spanNs(Fn fn) {
+	const double t = nowSec();
+	for (int i = 0; i < SPANS; i++) fn(i);
+	return (nowSec() - t) * 1e9 / SPANS;
+}
+
+int main(int argc, char* argv[]) {
+	const unsigned seed = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 1;
+	std::mt19937 rng(seed);
+	std::cout << std::fixed << std::setprecision(1);
+
+	std::vector<WORD> words(BUF_WORDS);
+	for (WORD& w : words) w = static_cast<WORD>(rng());
+	std::vector<BIT> bits(SPAN_BITS);
+	fillBits(rng, bits);
+	for (BIT& b : bits) b = b != 0;
+	volatile BIT sink = 0;
+
+	// Сдвиг начала меняется по кругу 0-15: диапазон чаще всего начинается не с границы слова
+	const double legacy_read = spanNs([&](int i) {
+		legacyRead(words.data(), static_cast<WORD>(i & 15), SPAN_BITS, bits.data());
+		sink = sink + bits[i % SPAN_BITS];
+	});
+	const double legacy_write = spanNs([&](int i) {
+		legacyWrite(words.data(), static_cast<WORD>(i & 15), SPAN_BITS, bits.data());
+		sink = sink + static_cast<BIT>(words[i % BUF_WORDS]);
+	});
+	std::cout << "legacy bit loop: unpack " << legacy_read << " ns, pack " << legacy_write << " ns per " << SPAN_BITS << " bits" << std::endl;
+
+	bool ok = true;
+	const BitKernel kernels[] = { BitKernel::SCALAR, BitKernel::SSE2, BitKernel::AVX2, BitKernel::BMI2 };
+	for (BitKernel k : kernels) {
+		if (!setBitKernel(k)) {
+			std::cout << std::setw(7) << bitKernelName(k) << ": not supported" << std::endl;
+			continue;
+		}
+		const double unpack = spanNs([&](int i) {
+			unpackWordBits(words.data(), static_cast<size_t>(i & 15), SPAN_BITS, bits.data());
+			sink = sink + bits[i % SPAN_BITS];
+		});
+		const double pack = spanNs([&](int i) {
+			packWordBits(words.data(), static_cast<size_t>(i & 15), SPAN_BITS, bits.data());
+			sink = sink + static_cast<BIT>(words[i % BUF_WORDS]);
+		});
+		const bool checked = checkKernel(rng);
+		ok = ok && checked;
+		std::cout << std::setw(7) << bitKernelName(k) << ": unpack " << unpack << " ns (" << SPAN_BITS / unpack << " Gbit/s, x" << legacy_read / unpack
+					 << "), pack " << pack << " ns (" << SPAN_BITS / pack << " Gbit/s, x" << legacy_write / pack << ")" << (checked ? "" : " MISMATCH") << std::endl;
+	}
+
+	setBitKernel(BitKernel::AUTO);
+	ok = checkMap(rng) && ok;
+	std::cout << "auto kernel: " << bitKernelName(getBitKernel()) << std::endl;
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
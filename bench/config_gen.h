@@ -0,0 +1,31 @@
+#ifndef MB_BENCH_CONFIG_GEN_H
+#define MB_BENCH_CONFIG_GEN_H
+
+#include <fstream>
+#include <string>
+
+// Генерация конфигурации тегов для бенчмарков: секции по 1000 тегов функций 3 и 1,
+// у каждой секции диапазон опроса на все ее адреса
+inline void generateConfig(const std::string& path, int tags) {
+	static const char* types[] = { "", "INT16", "UINT32, AB_CD", "FLOAT_2, CD_AB", "INT32", "float_1, dc_ba" };
+	const int tags_per_section = 1000;
+	std::ofstream out(path);
+	out << "; generated config\n";
+	int n = 0;
+	for (int section = 0; n < tags; section++) {
+		int slave = section / 4 % 247 + 1;
+		int func = section % 2 ? 1 : 3;
+		out << "[" << slave << ":" << func << "]\n";
+		for (int i = 0; i < tags_per_section && n < tags; i++, n++) {
+			out << "tag_" << n << " = " << i * 2;
+			if (func == 3) {
+				const char* t = types[n % 6];
+				if (*t) out << ", " << t;
+			}
+			out << "\n";
+		}
+		out << "[" << slave << ":" << func << " ranges]\n0-" << tags_per_section * 2 << ", 1000\n";
+	}
+}
+
+#endif // MB_BENCH_CONFIG_GEN_H
@@ -0,0 +1,92 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#include "ConfigParser.h"
+#include "ConfigImage.h"
+#include "ScanScheduler.h"
+#include "config_gen.h"
+
+// Время от запуска до первого цикла опроса на конфигурации 200k тегов:
+// разбор текста с нормализацией и компиляцией плана против открытия готового образа.
+// Первый цикл - все запросы плана, приведенные к ScanRequest.
+// Запуск: bench_config_image [количество тегов, по умолчанию 200000]
+
+using namespace mb::data;
+
+static double msSince(std::chrono::steady_clock::time_point t0) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static size_t firstCycle(const ConfigImage& image, std::vector<ScanRequest>& cycle) {
+	cycle.clear();
+	cycle.reserve(image.getPlanCount());
+	const ImagePollItem* plan = image.getPlan();
+	for (size_t i = 0; i < image.getPlanCount(); i++) {
+		cycle.push_back(ScanRequest{ plan[i].slave_id, plan[i].func, plan[i].start, plan[i].quantity, plan[i].scan_ms });
+	}
+	return cycle.size();
+}
+
+int main(int argc, char* argv[]) {
+	int tags = argc > 1 ? std::atoi(argv[1]) : 200000;
+	std::string text_path = "/tmp/mb_bench_config.ini";
+	std::string image_path = "/tmp/mb_bench_config.img";
+	generateConfig(text_path, tags);
+
+	std::vector<ScanRequest> cycle;
+	std::cout << std::fixed << std::setprecision(2);
+
+	// Текст: разбор, нормализация и план (компиляция во временный образ)
+	auto t0 = std::chrono::steady_clock::now();
+	ConfigFile file;
+	ConfigParser parser;
+	if (!file.open(text_path) || !parser.parse(file.text())) return 1;
+	if (!ConfigImage::compile(parser, file.text(), 1000, image_path)) return 1;
+	double text_ms = msSince(t0);
+	std::cout << "text parse + normalize + plan: " << std::setw(8) << text_ms << " ms" << std::endl;
+
+	for (bool verify : { true, false }) {
+		t0 = std::chrono::steady_clock::now();
+		ConfigImage image;
+		if (!image.open(image_path, verify)) {
+			std::cerr << image.getError() << std::endl;
+			return 1;
+		}
+		size_t requests = firstCycle(image, cycle);
+		double image_ms = msSince(t0);
+		std::cout << "image open" << (verify ? " + checksum" : "           ") << "  -> first poll: " << std::setw(8) << image_ms << " ms ("
+				  << image.getTagCount() << " tags, " << requests << " requests, " << image.getHeader().total_size / 1024 << " KiB)" << std::endl;
+	}
+
+	// Актуальность образа и контроль повреждения
+	ConfigImage image;
+	image.open(image_path);
+	std::cout << "source hash matches: " << (image.getHeader().source_hash == ConfigImage::hash(file.text().data(), file.text().size()) ? "yes" : "no") << std::endl;
+	image.close();
+	FILE* f = fopen(image_path.c_str(), "r+b");
+	fseek(f, -1, SEEK_END);
+	fputc('~', f);
+	fclose(f);
+	std::cout << "corrupted image: " << (image.open(image_path) ? "accepted" : image.getError()) << std::endl;
+
+	// Поврежденное смещение имени тега без проверки контрольной суммы
+	image.open(image_path, false);
+	const uint64_t tag_offset = image.getHeader().tag_offset;
+	image.close();
+	const uint32_t bad_offset = UINT32_MAX;
+	f = fopen(image_path.c_str(), "r+b");
+	fseek(f, static_cast<long>(tag_offset + offsetof(ImageTag, name_offset)), SEEK_SET);
+	fwrite(&bad_offset, sizeof(bad_offset), 1, f);
+	fclose(f);
+	std::cout << "corrupted tag, no checksum: " << (image.open(image_path, false) ? "accepted" : image.getError()) << std::endl;
+
+	std::remove(text_path.c_str());
+	std::remove(image_path.c_str());
+	return 0;
+}
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "ConfigParser.h"
+#include "config_gen.h"
+
+// Время загрузки сгенерированной конфигурации на 200k тегов:
+// построчный разбор через std::string (split/trim/toUpperCase/stoi, как в RegManager::parseReg)
+// и ConfigParser поверх mmap. Считаются выделения памяти.
+// Запуск: bench_config_parse [количество тегов, по умолчанию 200000]
+
+using namespace mb::data;
+
+static size_t g_allocs = 0;
+
+void* operator new(size_t size) {
+	++g_allocs;
+	void* p = std::malloc(size ? size : 1);
+	if (p == nullptr) throw std::bad_alloc();
+	return p;
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+/* Разбор через std::string, повторяет вспомогательные функции ModbusEnums */
+
+static std::vector<std::string> split(const std::string& s, char delimeter) {
+	std::vector<std::string> tokens;
+	std::string token;
+	std::istringstream ss(s);
+	while (std::getline(ss, token, delimeter)) tokens.push_back(token);
+	return tokens;
+}
+
+static std::string trim(const std::string& s) {
+	size_t first = s.find_first_not_of(" \t\r");
+	if (first == std::string::npos) return "";
+	size_t last = s.find_last_not_of(" \t\r");
+	return s.substr(first, last - first + 1);
+}
+
+static std::string toUpperCase(const std::string& s) {
+	std::string r = s;
+	for (char& c : r) c = toupper(c);
+	return r;
+}
+
+static bool isNumber(const std::string& s) {
+	if (s.empty()) return false;
+	for (char c : s) if (!isdigit(c)) return false;
+	return true;
+}
+
+struct LegacyTag {
+	std::string name;
+	int slave_id, func, address;
+	std::string type, order;
+	int precision;
+};
+
+static size_t legacyLoad(const std::string& path) {
+	std::vector<LegacyTag> tags;
+	std::ifstream in(path);
+	std::string line;
+	int slave = 0, func = 0;
+	bool ranges = false;
+	size_t count = 0;
+	while (std::getline(in, line)) {
+		line = trim(line.substr(0, line.find(';')));
+		if (line.empty()) continue;
+		if (line[0] == '[') {
+			std::vector<std::string> parts = split(line.substr(1, line.size() - 2), ':');
+			slave = std::stoi(parts[0]);
+			std::vector<std::string> f = split(parts[1], ' ');
+			func = std::stoi(f[0]);
+			ranges = f.size() > 1;
+			continue;
+		}
+		if (ranges) {
+			std::vector<std::string> t = split(split(line, ',')[0], '-');
+			count += std::stoi(trim(t[0])) <= std::stoi(trim(t[1]));
+			continue;
+		}
+		std::vector<std::string> kv = split(line, '=');
+		LegacyTag tag;
+		tag.name = trim(kv[0]);
+		tag.slave_id = slave;
+		tag.func = func;
+		tag.precision = 0;
+		for (std::string token : split(kv[1], ',')) {
+			token = toUpperCase(trim(token));
+			if (isNumber(token)) tag.address = std::stoi(token);
+			else if (token.compare(0, 5, "FLOAT") == 0) {
+				std::vector<std::string> ft = split(token, '_');
+				tag.type = ft[0];
+				if (ft.size() > 1 && isNumber(ft[1])) tag.precision = std::stoi(ft[1]);
+			}
+			else if (token.find('_') != std::string::npos) tag.order = token;
+			else tag.type = token;
+		}
+		tags.push_back(tag);
+	}
+	return tags.size() + count;
+}
+
+template <typename F>
+static double measure(F f, size_t& allocs, size_t& result) {
+	size_t a0 = g_allocs;
+	auto t0 = std::chrono::steady_clock::now();
+	result = f();
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	allocs = g_allocs - a0;
+	return ms;
+}
+
+int main(int argc, char* argv[]) {
+	int tags = argc > 1 ? std::atoi(argv[1]) : 200000;
+	std::string path = "/tmp/mb_bench_config.ini";
+	generateConfig(path, tags);
+
+	size_t allocs, result;
+	double ms = measure([&]() { return legacyLoad(path); }, allocs, result);
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "std::string parse:  " << std::setw(8) << ms << " ms, allocations " << allocs << ", records " << result << std::endl;
+
+	ConfigParser parser;
+	ms = measure([&]() -> size_t {
+		ConfigFile file;
+		if (!file.open(path) || !parser.parse(file.text())) return 0;
+		return parser.getTags().size() + parser.getRanges().size();
+	}, allocs, result);
+	std::cout << "ConfigParser mmap:  " << std::setw(8) << ms << " ms, allocations " << allocs << ", records " << result << std::endl;
+
+	// Проверка сообщений об ошибках
+	const char* bad = "[1:3]\nok = 1, FLOAT_2\nbad = 2, FLAOT\n";
+	if (!parser.parse(bad)) {
+		const ConfigError& e = parser.getError();
+		std::cout << "error example: line " << e.line << ", column " << e.column << ": " << e.message << std::endl;
+	}
+
+	std::remove(path.c_str());
+	return 0;
+}
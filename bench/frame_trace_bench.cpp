@@ -0,0 +1,117 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "FrameTrace.h"
+#include "ModbusFrame.h"
+
+// Стоимость записи кадра: двоичная трассировка в mmap-кольцо против текстовой строки журнала
+// в формате Readme (Tx:000056-01 05 ...), отформатированной и записанной в файл на каждый кадр.
+// Затем проверка кольца: после многократного переполнения читаются ровно последние кадры, по порядку.
+
+using namespace mb::modbus;
+
+constexpr int FRAMES = 2000000;
+
+static double nowSec() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Пара кадров опроса: запрос чтения 10 регистров и ответ
+static void makeFrames(BYTE* tx, size_t& tx_len, BYTE* rx, size_t& rx_len) {
+	WORD vals[10] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+	tx[0] = 1;
+	tx_len = rtuFinish(tx, RTU_HEADER_SIZE + pduReadRequest(tx + 1, 3, 100, 10));
+	rx[0] = 1;
+	rx_len = rtuFinish(rx, RTU_HEADER_SIZE + pduReadWordsResponse(rx + 1, 3, 10, vals));
+}
+
+// Текстовый журнал кадров в стиле rawLog: строка формируется и пишется на каждое событие
+static double textLog(const char* path, const BYTE* tx, size_t tx_len, const BYTE* rx, size_t rx_len) {
+	FILE* f = fopen(path, "w");
+	char line[MODBUS_MAX_ADU_LENGTH * 3 + 32];
+	double t = nowSec();
+	for (int i = 0; i < FRAMES; i++) {
+		const bool is_tx = (i & 1) == 0;
+		const BYTE* adu = is_tx ? tx : rx;
+		const size_t len = is_tx ? tx_len : rx_len;
+		char* p = line + sprintf(line, "%s:%06d-", is_tx ? "Tx" : "Rx", i % 1000000);
+		for (size_t k = 0; k < len; k++) p += sprintf(p, k ? " %02X" : "%02X", adu[k]);
+		*p++ = '\n';
+		fwrite(line, 1, p - line, f);
+		fflush(f);
+	}
+	double sec = nowSec() - t;
+	fclose(f);
+	return sec;
+}
+
+static double binaryTrace(const char* path, const BYTE* tx, size_t tx_len, const BYTE* rx, size_t rx_len) {
+	FrameTrace trace;
+	trace.open(path, 16 << 20);
+	// Первый проход по кольцу включает первое обращение к страницам файла, замеряется второй
+	double sec = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		double t = nowSec();
+		for (int i = 0; i < FRAMES; i++) {
+			if (i & 1) trace.write(0, TraceDir::RX, TraceKind::RTU, rx, rx_len, 0);
+			else trace.write(0, TraceDir::TX, TraceKind::RTU, tx, tx_len);
+		}
+		sec = nowSec() - t;
+	}
+	return sec;
+}
+
+// Кольцо 64 КБ, кадры разной длины с номером внутри: читаться должны последние кадры без пропусков
+static bool checkWrap(const char* path) {
+	FrameTrace trace;
+	if (!trace.open(path, 64 << 10)) return false;
+	BYTE frame[MODBUS_MAX_ADU_LENGTH] = {};
+	const uint32_t total = 100000;
+	for (uint32_t i = 0; i < total; i++) {
+		memcpy(frame, &i, sizeof(i));
+		trace.write(static_cast<uint16_t>(i & 3), TraceDir::TX, TraceKind::TCP, frame, 4 + (i * 37) % 250);
+	}
+
+	FrameTraceReader reader;
+	if (!reader.open(path)) return false;
+	TraceFrame f;
+	uint32_t expected = UINT32_MAX, count = 0;
+	while (reader.next(f)) {
+		uint32_t n;
+		memcpy(&n, f.data, sizeof(n));
+		if (expected != UINT32_MAX && n != expected) return false;
+		if (f.len != 4 + (n * 37) % 250 || f.line_id != (n & 3)) return false;
+		expected = n + 1;
+		++count;
+	}
+	std::cout << "wrap check: last " << count << " of " << total << " frames read back in order" << std::endl;
+	return expected == total && count > 100 && reader.getError().empty() && trace.getFrames() == total;
+}
+
+int main() {
+	BYTE tx[MODBUS_MAX_ADU_LENGTH], rx[MODBUS_MAX_ADU_LENGTH];
+	size_t tx_len, rx_len;
+	makeFrames(tx, tx_len, rx, rx_len);
+
+	const char* text_path = "/tmp/mb_frame_trace_bench.log";
+	const char* trace_path = "/tmp/mb_frame_trace_bench.trace";
+
+	double text = textLog(text_path, tx, tx_len, rx, rx_len);
+	double binary = binaryTrace(trace_path, tx, tx_len, rx, rx_len);
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << FRAMES << " frames (" << tx_len << "/" << rx_len << " bytes)" << std::endl;
+	std::cout << "text log line:    " << text * 1e9 / FRAMES << " ns/frame" << std::endl;
+	std::cout << "binary trace:     " << binary * 1e9 / FRAMES << " ns/frame (x" << text / binary << ")" << std::endl;
+
+	bool ok = checkWrap(trace_path);
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	remove(text_path);
+	remove(trace_path);
+	return ok ? 0 : 1;
+}
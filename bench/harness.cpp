@@ -0,0 +1,313 @@
+#include "harness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+
+// Запуск: bench_suite [--benchmark_filter=<regex>] [--benchmark_min_time=<сек>] [--benchmark_repetitions=<n>]
+//                     [--benchmark_out=<файл.json>] [--benchmark_compare=<прошлый.json>] [--benchmark_list_tests]
+
+namespace mb {
+namespace bench {
+
+static uint64_t clockNs(clockid_t clock) {
+	timespec ts;
+	clock_gettime(clock, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+/* State */
+
+void State::start() {
+	m_running = true;
+	m_real_start = clockNs(CLOCK_MONOTONIC);
+	m_cpu_start = clockNs(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void State::stop() {
+	if (!m_running) return;
+	m_running = false;
+	m_real_ns += clockNs(CLOCK_MONOTONIC) - m_real_start;
+	m_cpu_ns += clockNs(CLOCK_THREAD_CPUTIME_ID) - m_cpu_start;
+}
+
+void State::pauseTiming() { stop(); }
+
+void State::resumeTiming() { start(); }
+
+/* Регистрация */
+
+static std::vector<std::unique_ptr<Benchmark>>& registry() {
+	static std::vector<std::unique_ptr<Benchmark>> benchmarks;
+	return benchmarks;
+}
+
+Benchmark* registerBenchmark(const char* name, BenchFunc func) {
+	registry().emplace_back(new Benchmark(name, func));
+	return registry().back().get();
+}
+
+/* Прогон */
+
+struct Options {
+	std::string filter = ".*";
+	double min_time = 0.5;
+	int repetitions = 3;
+	std::string out;
+	std::string compare;
+	bool list = false;
+};
+
+struct Run {
+	std::string name;
+	int threads;
+	uint64_t iterations;
+	double real_ns;		// На итерацию
+	double cpu_ns;
+	double items_per_second;
+	double bytes_per_second;
+	std::string label;
+};
+
+// Все потоки стартуют одновременно, время прогона - по самому медленному потоку
+static Run runOnce(const Benchmark& b, int64_t arg, int threads, uint64_t iterations) {
+	std::vector<std::unique_ptr<State>> states;
+	for (int t = 0; t < threads; t++) states.emplace_back(new State(iterations, arg, t, threads));
+
+	if (threads == 1) b.func()(*states[0]);
+	else {
+		std::atomic<int> ready(0);
+		std::vector<std::thread> pool;
+		for (int t = 0; t < threads; t++) {
+			pool.emplace_back([&, t]() {
+				ready.fetch_add(1);
+				while (ready.load() < threads) std::this_thread::yield();
+				b.func()(*states[t]);
+			});
+		}
+		for (std::thread& th : pool) th.join();
+	}
+
+	Run r;
+	r.threads = threads;
+	r.iterations = iterations;
+	double real = 0, cpu = 0, items = 0, bytes = 0;
+	for (const auto& s : states) {
+		real = std::max(real, s->realNs());
+		cpu += s->cpuNs();
+		items += s->items();
+		bytes += s->bytes();
+	}
+	r.real_ns = real / iterations;
+	r.cpu_ns = cpu / iterations;
+	r.items_per_second = real > 0 ? items * 1e9 / real : 0;
+	r.bytes_per_second = real > 0 ? bytes * 1e9 / real : 0;
+	r.label = states[0]->label();
+	return r;
+}
+
+// Подбор числа итераций как в Google Benchmark: рост до min_time с запасом 40%, не больше чем в 10 раз за шаг
+static Run runCalibrated(const Benchmark& b, int64_t arg, int threads, double min_time) {
+	uint64_t iterations = 1;
+	for (;;) {
+		Run r = runOnce(b, arg, threads, iterations);
+		const double sec = r.real_ns * iterations / 1e9;
+		if (sec >= min_time || iterations >= 1000000000ull) return r;
+		double multiplier = sec > 0 ? min_time * 1.4 / sec : 10.0;
+		multiplier = std::min(10.0, std::max(multiplier, 1.0 + 1e-9));
+		iterations = std::max<uint64_t>(iterations + 1, static_cast<uint64_t>(iterations * multiplier));
+	}
+}
+
+static std::string runName(const Benchmark& b, int64_t arg, bool has_arg, int threads, bool has_threads) {
+	std::string name = b.name();
+	if (has_arg) name += "/" + std::to_string(arg);
+	if (has_threads) name += "/threads:" + std::to_string(threads);
+	return name;
+}
+
+static std::string jsonEscape(const std::string& s) {
+	std::string out;
+	for (char c : s) {
+		if (c == '"' || c == '\\') out += '\\';
+		if (static_cast<unsigned char>(c) < 0x20) continue;
+		out += c;
+	}
+	return out;
+}
+
+static void writeJson(const std::string& path, const char* exe, const Options& opt, const std::vector<Run>& runs) {
+	std::ofstream out(path);
+	out.precision(10);
+	char host[256] = "";
+	gethostname(host, sizeof(host) - 1);
+	time_t now = time(nullptr);
+	char date[64];
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+	out << "{\n  \"context\": {\n";
+	out << "    \"date\": \"" << date << "\",\n";
+	out << "    \"host_name\": \"" << jsonEscape(host) << "\",\n";
+	out << "    \"executable\": \"" << jsonEscape(exe) << "\",\n";
+	out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+	out << "    \"library_build_type\": \"release\",\n";
+#else
+	out << "    \"library_build_type\": \"debug\",\n";
+#endif
+	out << "    \"library_version\": \"" << LIBMB_MAJOR "." LIBMB_MINOR "." LIBMB_FIX << "\",\n";
+	out << "    \"min_time\": " << opt.min_time << ",\n";
+	out << "    \"repetitions\": " << opt.repetitions << "\n";
+	out << "  },\n  \"benchmarks\": [";
+	for (size_t i = 0; i < runs.size(); i++) {
+		const Run& r = runs[i];
+		out << (i ? ",\n" : "\n") << "    {\n";
+		out << "      \"name\": \"" << jsonEscape(r.name) << "\",\n";
+		out << "      \"run_name\": \"" << jsonEscape(r.name) << "\",\n";
+		out << "      \"run_type\": \"iteration\",\n";
+		out << "      \"threads\": " << r.threads << ",\n";
+		out << "      \"iterations\": " << r.iterations << ",\n";
+		out << "      \"real_time\": " << r.real_ns << ",\n";
+		out << "      \"cpu_time\": " << r.cpu_ns << ",\n";
+		out << "      \"time_unit\": \"ns\"";
+		if (r.items_per_second > 0) out << ",\n      \"items_per_second\": " << r.items_per_second;
+		if (r.bytes_per_second > 0) out << ",\n      \"bytes_per_second\": " << r.bytes_per_second;
+		if (!r.label.empty()) out << ",\n      \"label\": \"" << jsonEscape(r.label) << "\"";
+		out << "\n    }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+// Чтение real_time по имени из JSON, записанного writeJson (или Google Benchmark)
+static bool readJson(const std::string& path, std::unordered_map<std::string, double>& times) {
+	std::ifstream in(path);
+	if (!in) return false;
+	std::stringstream ss;
+	ss << in.rdbuf();
+	const std::string text = ss.str();
+
+	const std::string name_key = "\"name\": \"";
+	const std::string time_key = "\"real_time\": ";
+	size_t pos = 0;
+	while ((pos = text.find(name_key, pos)) != std::string::npos) {
+		pos += name_key.size();
+		size_t end = text.find('"', pos);
+		size_t t = text.find(time_key, end);
+		if (end == std::string::npos || t == std::string::npos) break;
+		times[text.substr(pos, end - pos)] = strtod(text.c_str() + t + time_key.size(), nullptr);
+		pos = end;
+	}
+	return true;
+}
+
+static void printRun(const Run& r) {
+	char line[256];
+	int n = snprintf(line, sizeof(line), "%-48s %12.1f ns %12.1f ns %12llu", r.name.c_str(), r.real_ns, r.cpu_ns,
+						  static_cast<unsigned long long>(r.iterations));
+	if (r.items_per_second > 0) n += snprintf(line + n, sizeof(line) - n, "  items/s=%.4gM", r.items_per_second / 1e6);
+	if (r.bytes_per_second > 0) n += snprintf(line + n, sizeof(line) - n, "  bytes/s=%.4gM", r.bytes_per_second / 1e6);
+	if (!r.label.empty()) snprintf(line + n, sizeof(line) - n, "  %s", r.label.c_str());
+	puts(line);
+	fflush(stdout);
+}
+
+static bool parseOptions(int argc, char* argv[], Options& opt) {
+	for (int i = 1; i < argc; i++) {
+		const char* a = argv[i];
+		const char* eq = strchr(a, '=');
+		const std::string key = eq ? std::string(a, eq - a) : std::string(a);
+		const char* val = eq ? eq + 1 : "";
+		if (key == "--benchmark_filter") opt.filter = val;
+		else if (key == "--benchmark_min_time") opt.min_time = std::max(0.001, atof(val));
+		else if (key == "--benchmark_repetitions") opt.repetitions = std::max(1, atoi(val));
+		else if (key == "--benchmark_out") opt.out = val;
+		else if (key == "--benchmark_compare") opt.compare = val;
+		else if (key == "--benchmark_list_tests") opt.list = true;
+		else {
+			std::cerr << a << ": unknown option" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+static int runAll(int argc, char* argv[]) {
+	Options opt;
+	if (!parseOptions(argc, argv, opt)) return 2;
+	std::regex filter;
+	try {
+		filter = std::regex(opt.filter);
+	}
+	catch (const std::regex_error&) {
+		std::cerr << opt.filter << ": bad filter" << std::endl;
+		return 2;
+	}
+
+	std::unordered_map<std::string, double> baseline;
+	if (!opt.compare.empty() && !readJson(opt.compare, baseline)) {
+		std::cerr << opt.compare << ": can't read" << std::endl;
+		return 1;
+	}
+
+#ifndef NDEBUG
+	std::cout << "*** debug build: timings are not representative, use -DCMAKE_BUILD_TYPE=Release ***" << std::endl;
+#endif
+	if (!opt.list) printf("%-48s %15s %15s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+
+	std::vector<Run> runs;
+	for (const auto& b : registry()) {
+		std::vector<int64_t> args = b->args();
+		std::vector<int> threads = b->threadCounts();
+		if (args.empty()) args.push_back(0);
+		if (threads.empty()) threads.push_back(1);
+
+		for (int64_t arg : args) {
+			for (int t : threads) {
+				const std::string name = runName(*b, arg, !b->args().empty(), t, !b->threadCounts().empty());
+				if (!std::regex_search(name, filter)) continue;
+				if (opt.list) {
+					puts(name.c_str());
+					continue;
+				}
+
+				std::vector<Run> reps;
+				for (int i = 0; i < opt.repetitions; i++) reps.push_back(runCalibrated(*b, arg, t, opt.min_time));
+				std::sort(reps.begin(), reps.end(), [](const Run& x, const Run& y) { return x.real_ns < y.real_ns; });
+				Run r = reps[reps.size() / 2];
+				r.name = name;
+				printRun(r);
+				runs.push_back(r);
+			}
+		}
+	}
+
+	if (!opt.out.empty()) writeJson(opt.out, argv[0], opt, runs);
+
+	if (!baseline.empty()) {
+		printf("\n%-48s %12s %12s %9s\n", "Comparison", "Old", "New", "Change");
+		for (const Run& r : runs) {
+			auto it = baseline.find(r.name);
+			if (it == baseline.end() || it->second <= 0) continue;
+			printf("%-48s %9.1f ns %9.1f ns %+8.1f%%\n", r.name.c_str(), it->second, r.real_ns, (r.real_ns / it->second - 1) * 100);
+		}
+	}
+	return 0;
+}
+
+} // bench
+} // mb
+
+int main(int argc, char* argv[]) {
+	return mb::bench::runAll(argc, argv);
+}
@@ -0,0 +1,114 @@
+#ifndef MB_BENCH_HARNESS_H
+#define MB_BENCH_HARNESS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Минимальная обвязка микробенчмарков в духе Google Benchmark (внешних зависимостей нет).
+// Бенчмарк - функция void(State&), измеряемый цикл - while (state.keepRunning()) { ... }.
+// Регистрация: MB_BENCHMARK(mapReadWord)->arg(1000)->threads(4);
+// Число итераций подбирается до --benchmark_min_time, прогон повторяется --benchmark_repetitions раз, в отчет идет медиана.
+// JSON (--benchmark_out) совместим по полям с Google Benchmark, поэтому файлы разных версий сравниваются
+// как собственным --benchmark_compare, так и compare.py из Google Benchmark
+
+namespace mb {
+namespace bench {
+
+class State {
+public:
+	State(uint64_t iterations, int64_t arg, int thread_index, int threads)
+		: m_left(iterations), m_iterations(iterations), m_arg(arg), m_thread_index(thread_index), m_threads(threads) {}
+
+	// Первый вызов запускает таймер, последний останавливает
+	bool keepRunning() {
+		if (m_left != 0) {
+			if (m_left-- == m_iterations) start();
+			return true;
+		}
+		stop();
+		return false;
+	}
+
+	// Подготовка данных внутри цикла без учета времени
+	void pauseTiming();
+	void resumeTiming();
+
+	int64_t arg() const { return m_arg; }
+	int threadIndex() const { return m_thread_index; }
+	int threads() const { return m_threads; }
+	uint64_t iterations() const { return m_iterations; }
+
+	// Обработано элементов/байт за весь цикл (для items_per_second/bytes_per_second)
+	void setItemsProcessed(uint64_t n) { m_items = n; }
+	void setBytesProcessed(uint64_t n) { m_bytes = n; }
+	void setLabel(const std::string& label) { m_label = label; }
+
+	double realNs() const { return m_real_ns; }
+	double cpuNs() const { return m_cpu_ns; }
+	uint64_t items() const { return m_items; }
+	uint64_t bytes() const { return m_bytes; }
+	const std::string& label() const { return m_label; }
+
+private:
+	void start();
+	void stop();
+
+	uint64_t m_left;
+	uint64_t m_iterations;
+	int64_t m_arg;
+	int m_thread_index;
+	int m_threads;
+
+	bool m_running = false;
+	uint64_t m_real_start = 0;
+	uint64_t m_cpu_start = 0;
+	double m_real_ns = 0;
+	double m_cpu_ns = 0;
+	uint64_t m_items = 0;
+	uint64_t m_bytes = 0;
+	std::string m_label;
+};
+
+using BenchFunc = void (*)(State&);
+
+class Benchmark {
+public:
+	Benchmark(const char* name, BenchFunc func) : m_name(name), m_func(func) {}
+
+	Benchmark* arg(int64_t a) { m_args.push_back(a); return this; }
+	Benchmark* threads(int n) { m_threads.push_back(n); return this; }
+
+	const std::string& name() const { return m_name; }
+	BenchFunc func() const { return m_func; }
+	const std::vector<int64_t>& args() const { return m_args; }
+	const std::vector<int>& threadCounts() const { return m_threads; }
+
+private:
+	std::string m_name;
+	BenchFunc m_func;
+	std::vector<int64_t> m_args;
+	std::vector<int> m_threads;
+};
+
+Benchmark* registerBenchmark(const char* name, BenchFunc func);
+
+// Значение, которое компилятор не может выбросить как неиспользуемое
+template <typename T>
+inline void doNotOptimize(const T& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void clobberMemory() {
+	asm volatile("" : : : "memory");
+}
+
+} // bench
+} // mb
+
+#define MB_BENCH_CONCAT2(a, b) a##b
+#define MB_BENCH_CONCAT(a, b) MB_BENCH_CONCAT2(a, b)
+#define MB_BENCHMARK(func) \
+	static mb::bench::Benchmark* MB_BENCH_CONCAT(mb_benchmark_, __LINE__) __attribute__((unused)) = mb::bench::registerBenchmark(#func, func)
+
+#endif // MB_BENCH_HARNESS_H
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <algorithm>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "ConfigParser.h"
+#include "PollConfig.h"
+#include "ScanScheduler.h"
+#include "WorkPool.h"
+#include "config_gen.h"
+
+// Горячая перезагрузка конфигурации на 200k тегов при работающем опросе.
+// Поток опроса каждую миллисекунду строит цикл по своему планировщику и подхватывает новые снимки.
+// Сравнивается полное построение снимка и перезагрузка с изменением одного тега и одного диапазона.
+// Запуск: bench_hot_reload [количество тегов, по умолчанию 200000]
+
+using namespace mb::data;
+
+constexpr uint32_t DEFAULT_SCAN_MS = 1000;
+
+static uint64_t nowMs() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double msSince(std::chrono::steady_clock::time_point t0) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void printDiff(const char* name, const ReloadDiff& d, double ms) {
+	std::cout << std::left << std::setw(16) << name << std::right << std::setw(9) << ms << " ms  tags +" << d.tags_added << " -" << d.tags_removed
+			  << " ~" << d.tags_changed << ", groups kept " << d.groups_kept << ", rebuilt " << d.groups_rebuilt << ", removed " << d.groups_removed << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+	int tags = argc > 1 ? std::atoi(argv[1]) : 200000;
+	std::string path = "/tmp/mb_bench_reload.ini";
+	generateConfig(path, tags);
+	std::ifstream in(path);
+	std::stringstream ss;
+	ss << in.rdbuf();
+	std::string text = ss.str();
+	std::remove(path.c_str());
+
+	std::cout << std::fixed << std::setprecision(2);
+	PollConfig config(DEFAULT_SCAN_MS);
+	ConfigParser parser;
+	parser.parse(text);
+	ReloadDiff diff;
+	auto t0 = std::chrono::steady_clock::now();
+	config.apply(parser, &diff);
+	printDiff("initial", diff, msSince(t0));
+
+	// Поток опроса
+	std::atomic<bool> running(true);
+	std::atomic<uint64_t> cycles(0), requests(0), max_gap_us(0), updates(0);
+	std::atomic<double> update_ms(0);
+	std::thread poller([&]() {
+		ScanScheduler scheduler;
+		std::vector<ScanRequest> cycle;
+		std::shared_ptr<const PollSnapshot> cur = config.snapshot();
+		PollConfig::updateScheduler(scheduler, nullptr, *cur, DEFAULT_SCAN_MS, nowMs());
+		scheduler.start(nowMs());
+		auto last = std::chrono::steady_clock::now();
+		while (running) {
+			std::shared_ptr<const PollSnapshot> next = config.snapshot();
+			if (next != cur) {
+				auto u0 = std::chrono::steady_clock::now();
+				updates += PollConfig::updateScheduler(scheduler, cur.get(), *next, DEFAULT_SCAN_MS, nowMs());
+				update_ms = msSince(u0);
+				cur = std::move(next);
+			}
+			cycle.clear();
+			requests += scheduler.buildCycle(nowMs(), cycle);
+			++cycles;
+
+			auto now = std::chrono::steady_clock::now();
+			uint64_t gap = std::chrono::duration_cast<std::chrono::microseconds>(now - last).count();
+			if (gap > max_gap_us) max_gap_us = gap;
+			last = now;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	// Изменение типа одного тега и периода одного диапазона
+	size_t pos = text.find("tag_12346 = ");
+	size_t eol = text.find('\n', pos);
+	text.replace(pos, eol - pos, "tag_12346 = 2, FLOAT_3, AB_CD");
+	pos = text.find("[4:3 ranges]\n0-2000, 1000");
+	text.replace(pos, 25, "[4:3 ranges]\n0-2000, 250");
+
+	t0 = std::chrono::steady_clock::now();
+	parser.parse(text);
+	double parse_ms = msSince(t0);
+	t0 = std::chrono::steady_clock::now();
+	config.apply(parser, &diff);
+	printDiff("one tag edited", diff, msSince(t0));
+	std::cout << "parse " << parse_ms << " ms (not included above)" << std::endl;
+
+	// Полная перестройка для сравнения
+	PollConfig fresh(DEFAULT_SCAN_MS);
+	t0 = std::chrono::steady_clock::now();
+	fresh.apply(parser, &diff);
+	printDiff("full rebuild", diff, msSince(t0));
+
+	// Полная перестройка с группами в пуле потоков (как при запуске): снимок должен совпасть
+	mb::work::WorkPool pool(std::max(4u, std::thread::hardware_concurrency()));
+	PollConfig pooled(DEFAULT_SCAN_MS);
+	pooled.setWorkPool(&pool);
+	t0 = std::chrono::steady_clock::now();
+	pooled.apply(parser, &diff);
+	printDiff("full, pool", diff, msSince(t0));
+	bool same = pooled.snapshot()->groups.size() == fresh.snapshot()->groups.size() && pooled.snapshot()->tag_count == fresh.snapshot()->tag_count;
+	for (const auto& pair : fresh.snapshot()->groups) {
+		auto it = pooled.snapshot()->groups.find(pair.first);
+		same = same && it != pooled.snapshot()->groups.end() && it->second->tags == pair.second->tags && it->second->plan.size() == pair.second->plan.size();
+	}
+	std::cout << "pool " << pool.getThreadCount() << " threads, steals " << pool.getSteals() << ", snapshot " << (same ? "equal" : "DIFFERS") << std::endl;
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	running = false;
+	poller.join();
+	std::cout << "poller: " << cycles << " cycles, " << requests << " requests, scheduler groups updated " << updates
+			  << " in " << update_ms.load() << " ms, max cycle gap " << max_gap_us / 1000.0 << " ms" << std::endl;
+	std::cout << "snapshot version " << config.snapshot()->version << ", tags " << config.snapshot()->tag_count << std::endl;
+	return 0;
+}
@@ -0,0 +1,167 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+#include "Map.h"
+#include "ModbusMaster.h"
+
+// Метаданные диапазонов карты (время, качество, номер обновления):
+// - цена updateWords против writeWords на ответ из 100 регистров и чтения с метаданными против обычного
+// - readToMap через транспорт, который по очереди отвечает данными, исключением и таймаутом:
+//   качество и код исключения попадают в диапазон ответа, соседние диапазоны не меняются
+
+using namespace mb;
+using namespace mb::data;
+using namespace mb::modbus;
+
+constexpr WORD START = 1000;
+constexpr WORD RANGES = 10;
+constexpr WORD RANGE_WORDS = 100;
+constexpr int OPS = 2000000;
+
+static double nowSec() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Транспорт без линии: ответ задается перед запросом
+class ScriptTransport : public Transport {
+public:
+	ScriptTransport() { m_name = "script"; }
+
+	bool open() override { return true; }
+	void close() override {}
+	bool isOpen() const override { return true; }
+
+	MbStatus transact(const BYTE, const size_t, const BYTE** resp_pdu, size_t* resp_len, const uint32_t) override {
+		const BYTE* req = txPdu();
+		*resp_pdu = m_rx;
+		if (next == MbStatus::EXCEPTION) {
+			m_rx[0] = req[0] | 0x80;
+			m_rx[1] = exception_code;
+			*resp_len = 2;
+			return MbStatus::EXCEPTION;
+		}
+		if (next != MbStatus::OK) return next;
+		const WORD start = getWordBE(req + 1);
+		const WORD quantity = getWordBE(req + 3);
+		if (req[0] == 1 || req[0] == 2) {
+			for (WORD i = 0; i < quantity; i++) m_bits[i] = (start + i + value) & 1;
+			*resp_len = pduReadBitsResponse(m_rx, req[0], quantity, m_bits);
+		}
+		else {
+			for (WORD i = 0; i < quantity; i++) m_words[i] = static_cast<WORD>(start + i + value);
+			*resp_len = pduReadWordsResponse(m_rx, req[0], quantity, m_words);
+		}
+		return MbStatus::OK;
+	}
+
+	bool send(const BYTE, const size_t) override { return true; }
+
+	MbStatus next = MbStatus::OK;
+	BYTE exception_code = 0;
+	WORD value = 0;
+
+protected:
+	size_t headerSize() const override { return 0; }
+
+private:
+	BIT m_bits[MODBUS_MAX_READ_BITS];
+	WORD m_words[MODBUS_MAX_READ_REGISTERS];
+};
+
+static bool checkPolling() {
+	ScriptTransport transport;
+	ModbusMaster master(&transport);
+	Map map;
+	bool ok = map.initNewMemory(START, RANGES * RANGE_WORDS, MapType::WORD_MAP);
+	for (WORD r = 0; r < RANGES; r++) ok = map.addMetaRange(START + r * RANGE_WORDS, RANGE_WORDS) && ok;
+	// Пересечение, выход за карту, пустой диапазон
+	ok = !map.addMetaRange(START + 50, 100) && !map.addMetaRange(START - 1, 2) && !map.addMetaRange(START, 0) && ok;
+	ok = map.getMetaRangeCount() == RANGES && ok;
+
+	MapMeta meta, other;
+	WORD w = 0;
+	ok = map.readUInt16(START, &w, &meta) && meta.quality == MapQuality::UNKNOWN && meta.timestamp_ns == 0 && ok;
+
+	transport.value = 7;
+	ok = master.readToMap(1, 3, START, RANGE_WORDS, map) == MbStatus::OK && ok;
+	ok = map.readUInt16(START + 5, &w, &meta) && w == START + 12 && meta.quality == MapQuality::GOOD && meta.sequence == 1 && meta.timestamp_ns > 0 && ok;
+	const uint64_t good_ts = meta.timestamp_ns;
+
+	transport.next = MbStatus::EXCEPTION;
+	transport.exception_code = 2;
+	ok = master.readToMap(1, 3, START, RANGE_WORDS, map) == MbStatus::EXCEPTION && ok;
+	ok = map.readUInt16(START + 5, &w, &meta) && w == START + 12 && ok;	// Значение прежнее
+	ok = meta.quality == MapQuality::EXCEPTION && meta.exception_code == 2 && meta.sequence == 2 && meta.timestamp_ns >= good_ts && ok;
+
+	transport.next = MbStatus::TIMEOUT;
+	ok = master.readToMap(1, 3, START + RANGE_WORDS, RANGE_WORDS, map) == MbStatus::TIMEOUT && ok;
+	ok = map.readMeta(START + RANGE_WORDS, &other) && other.quality == MapQuality::COMM_FAIL && other.sequence == 1 && ok;
+	ok = map.readMeta(START + 2 * RANGE_WORDS, &other) && other.quality == MapQuality::UNKNOWN && other.sequence == 0 && ok;
+
+	// Значение на границе диапазонов: метаданные более старого
+	transport.next = MbStatus::OK;
+	ok = master.readToMap(1, 3, START, RANGE_WORDS, map) == MbStatus::OK && ok;
+	float f = 0;
+	ok = map.readFloat32(START + RANGE_WORDS - 1, &f, &meta) && meta.quality == MapQuality::COMM_FAIL && ok;
+	ok = map.readFloat32(START + RANGE_WORDS - 2, &f, &meta) && meta.quality == MapQuality::GOOD && meta.sequence == 3 && ok;
+
+	// Карта битов
+	Map coils;
+	ok = coils.initNewMemory(0, 64, MapType::BIT_MAP) && coils.addMetaRange(0, 32) && coils.addMetaRange(32, 32) && ok;
+	BIT bits[64];
+	ok = master.readToMap(1, 1, 32, 32, coils) == MbStatus::OK && ok;
+	ok = coils.readBits(32, 32, bits, &meta) && meta.quality == MapQuality::GOOD && bits[0] == ((32 + 7) & 1) && ok;
+	ok = coils.readMeta(0, &meta) && meta.quality == MapQuality::UNKNOWN && ok;
+
+	// Без диапазонов update* работают как write*
+	Map plain;
+	WORD vals[4] = { 1, 2, 3, 4 };
+	ok = plain.initNewMemory(0, 4, MapType::WORD_MAP) && plain.updateWords(0, 4, vals) && plain.readUInt16(3, &w, &meta) && w == 4 && ok;
+	ok = meta.quality == MapQuality::UNKNOWN && plain.setQuality(0, 4, MapQuality::COMM_FAIL) && ok;
+	return ok;
+}
+
+int main() {
+	std::cout << std::fixed << std::setprecision(1);
+
+	Map map;
+	map.initNewMemory(START, RANGES * RANGE_WORDS, MapType::WORD_MAP);
+	for (WORD r = 0; r < RANGES; r++) map.addMetaRange(START + r * RANGE_WORDS, RANGE_WORDS);
+	WORD words[RANGE_WORDS];
+	for (WORD i = 0; i < RANGE_WORDS; i++) words[i] = i;
+
+	double t = nowSec();
+	for (int i = 0; i < OPS; i++) map.writeWords(static_cast<WORD>(START + (i % RANGES) * RANGE_WORDS), RANGE_WORDS, words);
+	const double write_ns = (nowSec() - t) * 1e9 / OPS;
+	t = nowSec();
+	for (int i = 0; i < OPS; i++) map.updateWords(static_cast<WORD>(START + (i % RANGES) * RANGE_WORDS), RANGE_WORDS, words);
+	const double update_ns = (nowSec() - t) * 1e9 / OPS;
+
+	float f = 0;
+	double sum = 0;
+	MapMeta meta;
+	t = nowSec();
+	for (int i = 0; i < OPS; i++) {
+		map.readFloat32(static_cast<WORD>(START + (i % 999)), &f);
+		if (std::isfinite(f)) sum += f;
+	}
+	const double read_ns = (nowSec() - t) * 1e9 / OPS;
+	t = nowSec();
+	for (int i = 0; i < OPS; i++) {
+		map.readFloat32(static_cast<WORD>(START + (i % 999)), &f, &meta);
+		if (std::isfinite(f)) sum += meta.sequence;
+	}
+	const double read_meta_ns = (nowSec() - t) * 1e9 / OPS;
+	volatile double sink = sum;
+	(void)sink;
+
+	std::cout << RANGES << " meta ranges, sizeof(MapMeta) " << sizeof(MapMeta) << ", sizeof(Map) " << sizeof(Map) << std::endl;
+	std::cout << "write " << RANGE_WORDS << " words: writeWords " << write_ns << " ns, updateWords " << update_ns << " ns" << std::endl;
+	std::cout << "readFloat32: " << read_ns << " ns, with meta " << read_meta_ns << " ns" << std::endl;
+
+	const bool ok = checkPolling();
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
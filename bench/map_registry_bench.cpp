@@ -0,0 +1,164 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "Arena.h"
+#include "MapRegistry.h"
+
+// Маршрутизация (slave_id, func, адрес) -> карта на 247 устройствах x 4 таблицы:
+// - MapRegistry::route: прямая таблица устройств и страничный индекс адресов
+// - std::map по ключу (устройство, таблица, начало карты) с upper_bound
+// - линейный поиск по всем картам устройства и таблицы
+// Все три способа обязаны давать одну и ту же карту для каждого адреса.
+// Запуск: bench_map_registry [диапазонов на таблицу, по умолчанию 16] [seed]
+
+using namespace mb::data;
+
+constexpr int SLAVES = 247;
+constexpr int LOOKUPS = 4000000;
+static const int FUNCS[4] = { 1, 2, 3, 4 };
+
+struct Probe {
+	int slave_id;
+	int func;
+	WORD adr;
+};
+
+struct MapInfo {
+	WORD start;
+	WORD end;
+	Map* map;
+};
+
+static double nowSec() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t keyOf(int slave_id, int func, WORD adr) {
+	return (static_cast<uint32_t>(slave_id) << 18) | (static_cast<uint32_t>(MapRegistry::tableOf(func)) << 16) | adr;
+}
+
+int main(int argc, char* argv[]) {
+	const int ranges_per_table = argc > 1 ? std::atoi(argv[1]) : 16;
+	const unsigned seed = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : 1;
+	std::mt19937 rng(seed);
+	std::cout << std::fixed << std::setprecision(1);
+
+	// Диапазоны опроса с перекрытиями и короткими разрывами - часть из них сливается в одну карту
+	mb::mem::Arena arena(1024 * 1024);
+	MapRegistry registry(&arena);
+	double t = nowSec();
+	for (int s = 1; s <= SLAVES; s++) {
+		for (int func : FUNCS) {
+			std::vector<Range> ranges;
+			uint32_t adr = rng() % 100;
+			for (int i = 0; i < ranges_per_table && adr < 60000; i++) {
+				const uint32_t len = 1 + rng() % 120;
+				ranges.emplace_back(static_cast<WORD>(adr), static_cast<WORD>(adr + len - 1), 100 * (1 + rng() % 10));
+				adr += len + rng() % 200;
+				if (rng() % 4 == 0) adr -= std::min<uint32_t>(adr, len / 2);	// Перекрытие с предыдущим
+			}
+			registry.addRanges(s, func, ranges, 2);
+		}
+	}
+	const double build_ms = (nowSec() - t) * 1000;
+
+	std::map<uint32_t, MapInfo> ordered;
+	std::vector<std::vector<MapInfo>> linear(256 * 4);
+	registry.forEachMap([&](int slave_id, int func, Map& m) {
+		const MapInfo info{ m.getStartAdr(), m.getEndAdr(), &m };
+		ordered[keyOf(slave_id, func, info.start)] = info;
+		linear[slave_id * 4 + MapRegistry::tableOf(func)].push_back(info);
+	});
+	std::cout << registry.getMapCount() << " maps from " << SLAVES * 4 * ranges_per_table << " ranges, build " << build_ms
+				 << " ms, arena " << arena.capacity() / 1024 << " KiB" << std::endl;
+
+	// Адреса с попаданием в карты и промахами, включая функции записи и неверные устройства
+	const int probe_funcs[8] = { 1, 2, 3, 4, 5, 6, 15, 16 };
+	const uint32_t max_adr = std::min(64000, ranges_per_table * 180 + 100);
+	std::vector<Probe> probes(1 << 16);
+	for (Probe& p : probes) p = { 1 + static_cast<int>(rng() % 250), probe_funcs[rng() % 8], static_cast<WORD>(rng() % max_adr) };
+
+	bool ok = true;
+	uint64_t hits = 0;
+	Map* volatile sink = nullptr;
+
+	t = nowSec();
+	for (int i = 0; i < LOOKUPS; i++) {
+		const Probe& p = probes[i & (probes.size() - 1)];
+		MapRoute r;
+		if (registry.route(p.slave_id, p.func, p.adr, r)) sink = r.map;
+	}
+	const double reg_ns = (nowSec() - t) * 1e9 / LOOKUPS;
+
+	t = nowSec();
+	for (int i = 0; i < LOOKUPS; i++) {
+		const Probe& p = probes[i & (probes.size() - 1)];
+		if (MapRegistry::tableOf(p.func) < 0 || p.slave_id > 255) continue;
+		auto it = ordered.upper_bound(keyOf(p.slave_id, p.func, p.adr));
+		if (it == ordered.begin()) continue;
+		--it;
+		if ((it->first >> 16) == (keyOf(p.slave_id, p.func, p.adr) >> 16) && p.adr <= it->second.end) sink = it->second.map;
+	}
+	const double map_ns = (nowSec() - t) * 1e9 / LOOKUPS;
+
+	t = nowSec();
+	for (int i = 0; i < LOOKUPS; i++) {
+		const Probe& p = probes[i & (probes.size() - 1)];
+		const int table = MapRegistry::tableOf(p.func);
+		if (table < 0 || p.slave_id > 255) continue;
+		for (const MapInfo& m : linear[p.slave_id * 4 + table]) {
+			if (p.adr >= m.start && p.adr <= m.end) {
+				sink = m.map;
+				break;
+			}
+		}
+	}
+	const double lin_ns = (nowSec() - t) * 1e9 / LOOKUPS;
+	(void)sink;
+
+	std::cout << "route: registry " << std::setprecision(2) << reg_ns << " ns, std::map " << map_ns << " ns, linear " << lin_ns << " ns" << std::endl;
+
+	// Сверка маршрутов с линейным поиском
+	for (const Probe& p : probes) {
+		const int table = MapRegistry::tableOf(p.func);
+		const MapInfo* expect = nullptr;
+		if (table >= 0 && p.slave_id <= 255) {
+			for (const MapInfo& m : linear[p.slave_id * 4 + table]) {
+				if (p.adr >= m.start && p.adr <= m.end) expect = &m;
+			}
+		}
+		MapRoute r;
+		const bool found = registry.route(p.slave_id, p.func, p.adr, r);
+		ok = ok && found == (expect != nullptr);
+		if (found && expect) {
+			ok = ok && r.map == expect->map && r.offset == p.adr - expect->start && r.available == expect->end - p.adr + 1;
+			++hits;
+		}
+	}
+
+	// Пакетная запись и чтение через несколько соседних карт
+	MapRegistry small;
+	ok = small.addMap(7, 3, 100, 10) && small.addMap(7, 3, 110, 5) && small.addMap(7, 3, 115, 20) && ok;
+	ok = !small.addMap(7, 16, 120, 2) && small.addMap(7, 4, 120, 2) && ok;	// Пересечение в таблице регистров хранения
+	ok = small.addMap(7, 1, 0, 100) && small.addMap(7, 15, 100, 40) && ok;
+	WORD in[35], out[35] = {};
+	for (WORD i = 0; i < 35; i++) in[i] = static_cast<WORD>(1000 + i);
+	ok = small.writeWords(7, 16, 100, 35, in) && small.readWords(7, 3, 100, 35, out) && ok;
+	for (WORD i = 0; i < 35; i++) ok = ok && out[i] == in[i];
+	ok = !small.readWords(7, 3, 130, 10, out) && !small.readWords(7, 3, 99, 2, out) && ok;
+	BIT bits_in[140], bits_out[140] = {};
+	for (int i = 0; i < 140; i++) bits_in[i] = static_cast<BIT>(i % 3 == 0);
+	ok = small.writeBits(7, 5, 0, 140, bits_in) && small.readBits(7, 1, 0, 140, bits_out) && ok;
+	for (int i = 0; i < 140; i++) ok = ok && bits_out[i] == bits_in[i];
+	ok = small.find(7, 3, 110, 5) && !small.find(7, 3, 110, 6) && !small.find(8, 3, 110) && ok;
+
+	std::cout << "probes " << probes.size() << ", hits " << hits << std::endl;
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
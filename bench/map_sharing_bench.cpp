@@ -0,0 +1,130 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Map.h"
+
+// Массив карт, каждую из которых пишет и читает свой поток (карты устройств, опрашиваемых разными линиями).
+// "Плотная" раскладка повторяет прежнюю Map: мьютекс рядом с указателями и границами, объекты подряд без выравнивания,
+// память карт из new WORD[] - соседние объекты и буферы делят кэш-линии, и запись мьютекса одним потоком
+// выбивает линию у соседнего. Раскладка Map: объект и мьютекс на своих линиях, память выровнена целыми линиями.
+// Ложное разделение проявляется только на нескольких ядрах, при одном процессоре обе раскладки равны.
+// Запуск: bench_map_sharing [потоков, по умолчанию max(4, количество ядер)]
+
+using namespace mb::data;
+
+constexpr WORD MAP_WORDS = 8;
+constexpr int OPS = 2000000;
+static_assert(OPS % MAP_WORDS == 0, "OPS must be a multiple of MAP_WORDS");
+
+/** @brief Прежняя раскладка Map */
+struct PackedMap {
+	WORD start_adr = 0;
+	WORD end_adr = MAP_WORDS - 1;
+	WORD quantity = MAP_WORDS;
+	MapType map_type = MapType::WORD_MAP;
+	MemMode mem_mode = default_mem_mode;
+	BIT* mem_8_ptr = nullptr;
+	WORD* mem_16_ptr = new WORD[MAP_WORDS]();
+	std::string name;
+	bool bind = false;
+	std::mutex mtx;
+
+	~PackedMap() { delete[] mem_16_ptr; }
+
+	// Вне строки, как методы Map в Map.cpp
+	__attribute__((noinline)) bool writeWord(const WORD adr, const WORD val) {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (adr < start_adr || adr > end_adr) return false;
+		mem_16_ptr[adr - start_adr] = val;
+		return true;
+	}
+
+	__attribute__((noinline)) bool readDWord(const WORD adr, DWORD* val) {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (adr < start_adr || end_adr < adr + 1) return false;
+		memcpy(val, mem_16_ptr + adr - start_adr, sizeof(DWORD));
+		return true;
+	}
+};
+
+template <typename M>
+static double run(std::vector<M>& maps, int threads) {
+	std::atomic<int> ready(0);
+	std::atomic<bool> go(false);
+	std::vector<std::thread> pool;
+	for (int t = 0; t < threads; t++) {
+		pool.emplace_back([&, t]() {
+			M& m = maps[t];
+			DWORD d = 0;
+			++ready;
+			while (!go) std::this_thread::yield();
+			for (int i = 0; i < OPS; i++) {
+				m.writeWord(static_cast<WORD>(i % MAP_WORDS), static_cast<WORD>(i));
+				m.readDWord(static_cast<WORD>(i % (MAP_WORDS - 1)), &d);
+			}
+		});
+	}
+	while (ready < threads) std::this_thread::yield();
+	auto t0 = std::chrono::steady_clock::now();
+	go = true;
+	for (std::thread& th : pool) th.join();
+	const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	return 2.0 * OPS * threads / sec / 1e6;
+}
+
+// Выравнивание и чтение DWORD/float с нечетного адреса
+static bool checkLayout(std::vector<Map>& maps) {
+	bool ok = sizeof(Map) % MAP_CACHE_LINE == 0;
+	for (Map& m : maps) ok = ok && reinterpret_cast<uintptr_t>(&m) % MAP_CACHE_LINE == 0;
+
+	Map m;
+	ok = m.initNewMemory(0, 9, MapType::WORD_MAP) && ok;
+	DWORD d = 0;
+	float f = 0;
+	ok = m.writeDWord(1, 0x12345678) && m.readDWord(1, &d) && d == 0x12345678 && ok;
+	ok = m.writeFloat32(3, 3.25f) && m.readFloat32(3, &f) && f == 3.25f && ok;
+	ok = m.writeUInt32(7, 0xCAFEBABE) && m.readUInt32(7, &d) && d == 0xCAFEBABE && ok;
+	ok = !m.readDWord(8, &d) && ok;	// Второе слово за границей карты
+	return ok;
+}
+
+int main(int argc, char* argv[]) {
+	const unsigned cores = std::thread::hardware_concurrency();
+	const int threads = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(std::max(4u, cores));
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << threads << " threads, " << cores << " cores, sizeof(PackedMap) " << sizeof(PackedMap) << ", sizeof(Map) " << sizeof(Map) << std::endl;
+
+	std::vector<PackedMap> packed(threads);
+	std::vector<Map> aligned(threads);
+	for (Map& m : aligned) m.initNewMemory(0, MAP_WORDS, MapType::WORD_MAP);
+
+	// Чередование, чтобы прогрев и частота процессора не давали преимущества одной раскладке
+	double packed_mops = 0, aligned_mops = 0;
+	for (int r = 0; r < 3; r++) {
+		packed_mops = std::max(packed_mops, run(packed, threads));
+		aligned_mops = std::max(aligned_mops, run(aligned, threads));
+	}
+	std::cout << "packed layout:  " << packed_mops << " Mops/s" << std::endl;
+	std::cout << "aligned layout: " << aligned_mops << " Mops/s (x" << std::setprecision(2) << aligned_mops / packed_mops << ")" << std::endl;
+
+	// Последняя запись по адресу adr - i = OPS - MAP_WORDS + adr
+	bool ok = checkLayout(aligned);
+	for (Map& m : aligned) {
+		for (WORD adr = 0; adr < MAP_WORDS; adr++) {
+			WORD v = 0;
+			m.readWord(adr, &v);
+			ok = ok && v == static_cast<WORD>(OPS - MAP_WORDS + adr);
+		}
+	}
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "Arena.h"
+#include "Pool.h"
+#include "AllocHook.h"
+#include "Map.h"
+#include "RequestCache.h"
+
+// Подсистема памяти установившегося режима:
+// - буферы кадров: new/delete против FramePool
+// - промежуточные данные цикла: std::vector на каждый цикл против арены с reset
+// - память карт: new[] против арены в куче и на huge pages (выделение и проход по всем картам)
+// - кэш запросов с постоянным вытеснением: после прогрева ни одного выделения (NoAllocScope)
+
+using namespace mb;
+using namespace mb::mem;
+using namespace mb::data;
+using namespace mb::modbus;
+
+constexpr int MAPS = 988;				// 4 линии x 247 устройств
+constexpr WORD MAP_WORDS = 1000;
+
+static uint64_t g_violations = 0;
+
+static void onAlloc(const char* scope, uint64_t allocations) {
+	if (g_violations++ == 0) std::cerr << scope << ": " << allocations << " allocations" << std::endl;
+}
+
+static double nowSec() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Транспорт без линии: отвечает на чтение значениями адресов (биты - младший бит адреса)
+class EchoTransport : public Transport {
+public:
+	EchoTransport() { m_name = "echo"; }
+
+	bool open() override { return true; }
+	void close() override {}
+	bool isOpen() const override { return true; }
+
+	MbStatus transact(const BYTE, const size_t, const BYTE** resp_pdu, size_t* resp_len, const uint32_t) override {
+		const BYTE* req = txPdu();
+		const WORD start = getWordBE(req + 1);
+		const WORD quantity = getWordBE(req + 3);
+		if (req[0] == 1 || req[0] == 2) {
+			for (WORD i = 0; i < quantity; i++) m_bits[i] = (start + i) & 1;
+			*resp_len = pduReadBitsResponse(m_rx, req[0], quantity, m_bits);
+		}
+		else {
+			for (WORD i = 0; i < quantity; i++) m_words[i] = start + i;
+			*resp_len = pduReadWordsResponse(m_rx, req[0], quantity, m_words);
+		}
+		*resp_pdu = m_rx;
+		return MbStatus::OK;
+	}
+
+	bool send(const BYTE, const size_t) override { return true; }
+
+protected:
+	size_t headerSize() const override { return 0; }
+
+private:
+	BIT m_bits[MODBUS_MAX_READ_BITS];
+	WORD m_words[MODBUS_MAX_READ_REGISTERS];
+};
+
+static bool frameBuffers() {
+	const int n = 5000000;
+	volatile BYTE sink = 0;
+	double t = nowSec();
+	for (int i = 0; i < n; i++) {
+		BYTE* frame = new BYTE[MODBUS_MAX_ADU_LENGTH];
+		frame[0] = static_cast<BYTE>(i);
+		sink = sink + frame[0];
+		delete[] frame;
+	}
+	const double heap_ns = (nowSec() - t) * 1e9 / n;
+
+	FramePool pool(16);
+	uint64_t allocs = threadAllocations();
+	t = nowSec();
+	for (int i = 0; i < n; i++) {
+		BYTE* frame = pool.acquireFrame();
+		frame[0] = static_cast<BYTE>(i);
+		sink = sink + frame[0];
+		pool.release(frame);
+	}
+	const double pool_ns = (nowSec() - t) * 1e9 / n;
+	allocs = threadAllocations() - allocs;
+	std::cout << "frame buffer: new/delete " << heap_ns << " ns, FramePool " << pool_ns << " ns, pool allocations " << allocs << std::endl;
+	return allocs == 0 && pool.getAvailable() == 16;
+}
+
+static bool cycleScratch() {
+	const int cycles = 20000;
+	const size_t values = 4000;
+	double sum_vec = 0, sum_arena = 0;
+
+	uint64_t allocs = threadAllocations();
+	double t = nowSec();
+	for (int c = 0; c < cycles; c++) {
+		std::vector<double> v(values);
+		for (size_t i = 0; i < values; i++) v[i] = static_cast<double>(i + c);
+		sum_vec += v[values - 1];
+	}
+	const double vec_us = (nowSec() - t) * 1e6 / cycles;
+	const uint64_t vec_allocs = threadAllocations() - allocs;
+
+	Arena arena;
+	arena.reserve(values * sizeof(double) * 2);
+	allocs = threadAllocations();
+	t = nowSec();
+	for (int c = 0; c < cycles; c++) {
+		NoAllocScope guard("arena cycle");
+		arena.reset();
+		double* v = arena.allocArray<double>(values);
+		for (size_t i = 0; i < values; i++) v[i] = static_cast<double>(i + c);
+		sum_arena += v[values - 1];
+	}
+	const double arena_us = (nowSec() - t) * 1e6 / cycles;
+	const uint64_t arena_allocs = threadAllocations() - allocs;
+	std::cout << "cycle scratch x" << values << ": vector " << vec_us << " us (" << vec_allocs << " allocations), arena "
+				 << arena_us << " us (" << arena_allocs << " allocations)" << std::endl;
+	return arena_allocs == 0 && sum_vec == sum_arena;
+}
+
+// Выделение памяти карт и проход чтением по всем картам
+static bool mapStorage(const char* name, Arena* arena) {
+	std::vector<std::unique_ptr<Map>> maps(MAPS);
+	double t = nowSec();
+	for (int i = 0; i < MAPS; i++) {
+		maps[i].reset(new Map());
+		if (arena) maps[i]->initArenaMemory(0, MAP_WORDS, MapType::WORD_MAP, *arena);
+		else maps[i]->initNewMemory(0, MAP_WORDS, MapType::WORD_MAP);
+		maps[i]->writeWord(MAP_WORDS - 1, static_cast<WORD>(i));
+	}
+	const double init_ms = (nowSec() - t) * 1000;
+
+	WORD words[MODBUS_MAX_READ_REGISTERS];
+	uint64_t sum = 0;
+	const int passes = 20;
+	t = nowSec();
+	for (int p = 0; p < passes; p++) {
+		for (int i = 0; i < MAPS; i++) {
+			for (WORD adr = 0; adr + 100 <= MAP_WORDS; adr += 100) {
+				maps[i]->readWords(adr, 100, words);
+				sum += words[99];
+			}
+		}
+	}
+	const double pass_us = (nowSec() - t) * 1e6 / passes;
+	std::cout << "map storage " << name << ": init " << maps.size() << " maps " << init_ms << " ms, read pass " << pass_us << " us";
+	if (arena) std::cout << ", arena " << arena->capacity() / 1024 << " KiB in " << arena->getBlockCount() << " blocks" << (arena->isHugePages() ? " (MAP_HUGETLB)" : "");
+	std::cout << std::endl;
+	return sum == static_cast<uint64_t>(passes) * MAPS * (MAPS - 1) / 2;
+}
+
+// Кэш на 64 записи, 256 ключей по кругу: каждый запрос - промах с вытеснением
+static bool cacheSteadyState() {
+	EchoTransport transport;
+	ModbusMaster master(&transport);
+	RequestCache cache(&master, 64);
+	WORD words[MODBUS_MAX_READ_REGISTERS];
+	BIT bits[MODBUS_MAX_READ_BITS];
+	bool ok = true;
+
+	const int keys = 256;
+	const int reads = 200000;
+	auto readOne = [&](int i) {
+		const int k = i % keys;
+		const Range r(static_cast<WORD>(k * 10), static_cast<WORD>(k * 10 + (k % 2 ? 99 : 1999 - 1)), 1000);
+		if (k % 2) {
+			ok = cache.readWords(1 + k % 4, 3, r, words) == MbStatus::OK && words[0] == r.start && words[99] == r.start + 99 && ok;
+		}
+		else {
+			ok = cache.readBits(1 + k % 4, 1, r, bits) == MbStatus::OK && bits[1] == ((r.start + 1) & 1) && bits[1998] == ((r.start + 1998) & 1) && ok;
+		}
+	};
+	for (int i = 0; i < keys * 2; i++) readOne(i);	// Прогрев: корзины индекса и все записи в работе
+
+	const uint64_t allocs = threadAllocations();
+	double t = nowSec();
+	{
+		NoAllocScope guard("request cache");
+		for (int i = 0; i < reads; i++) readOne(i);
+	}
+	const double ns = (nowSec() - t) * 1e9 / reads;
+	const RequestCacheStats s = cache.getStats();
+	std::cout << "request cache 64/" << keys << " keys: " << ns << " ns/read, evictions " << s.evictions
+				 << ", allocations after warm-up " << threadAllocations() - allocs << std::endl;
+	return ok && s.evictions >= static_cast<uint64_t>(reads);
+}
+
+int main() {
+	std::cout << std::fixed << std::setprecision(1);
+	setAllocFailHandler(onAlloc);
+
+	bool ok = frameBuffers();
+	ok = cycleScratch() && ok;
+	ok = mapStorage("new[]", nullptr) && ok;
+	{
+		Arena arena(1024 * 1024);
+		ok = mapStorage("arena", &arena) && ok;
+	}
+	{
+		Arena arena(2 * 1024 * 1024, ArenaBacking::HUGE_PAGES);
+		ok = mapStorage("huge pages", &arena) && ok;
+	}
+	ok = cacheSteadyState() && ok;
+
+	ok = ok && g_violations == 0;
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include <time.h>
+
+#include "Metrics.h"
+#include "ModbusMaster.h"
+
+// Стоимость события метрик: счетчик, транзакция целиком (запрос, результат, RTT, байты), ожидание мьютекса Map.
+// Затем то же из 8 потоков одновременно (шарды потоков не разделяют строки кэша) и сверка сведенных значений.
+// В конце - накладные расходы на транзакцию мастера поверх транспорта без задержки.
+
+using namespace mb;
+using namespace mb::modbus;
+using namespace mb::metrics;
+
+constexpr int EVENTS = 10000000;
+constexpr int THREADS = 8;
+constexpr int THREAD_EVENTS = 2000000;
+constexpr int MASTER_TRANSACTIONS = 1000000;
+
+static double nowSec() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Процессорное время потока: при числе ядер меньше числа потоков настенное время включает чужие кванты
+static double threadCpuSec() {
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Транспорт без задержки: отвечает на чтение регистров нулями, на каждый 16-й запрос - исключением 02
+class NullTransport : public Transport {
+public:
+	NullTransport() : m_n(0) { m_name = "null"; }
+
+	bool open() override { return true; }
+	void close() override {}
+	bool isOpen() const override { return true; }
+
+	MbStatus transact(const BYTE, const size_t, const BYTE** resp_pdu, size_t* resp_len, const uint32_t) override {
+		const BYTE* req = txPdu();
+		*resp_pdu = m_rx;
+		if ((++m_n & 15) == 0) {
+			*resp_len = pduException(m_rx, req[0], ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_ADDRESS);
+			return MbStatus::EXCEPTION;
+		}
+		*resp_len = pduReadWordsResponse(m_rx, req[0], getWordBE(req + 3), m_zero);
+		return MbStatus::OK;
+	}
+
+	bool send(const BYTE, const size_t) override { return true; }
+
+protected:
+	size_t headerSize() const override { return 0; }
+
+private:
+	uint64_t m_n;
+	WORD m_zero[MODBUS_MAX_READ_REGISTERS] = {};
+};
+
+static void transactions(Metrics& m, int n, int seed) {
+	for (int i = 0; i < n; i++) {
+		int slave = 1 + ((i + seed) & 31);
+		uint32_t rtt = 200 + ((i * 7919u) & 4095);
+		m.onTransaction(slave, 3, Counter::RESPONSES, rtt, 5, 2 + 2 * 10);
+	}
+}
+
+static double perEvent(double sec, uint64_t n) {
+	return sec * 1e9 / n;
+}
+
+// Лучший из трех прогонов
+static double masterRun(ModbusMaster& master) {
+	WORD vals[10];
+	double best = 1e9;
+	for (int run = 0; run < 3; run++) {
+		double t = nowSec();
+		for (int i = 0; i < MASTER_TRANSACTIONS; i++) master.readWords(1 + (i & 7), 3, 100, 10, vals);
+		best = std::min(best, nowSec() - t);
+	}
+	return best;
+}
+
+int main() {
+	bool ok = true;
+	std::cout << std::fixed << std::setprecision(1);
+
+	{
+		Metrics m;
+		double t = nowSec();
+		for (int i = 0; i < EVENTS; i++) m.add(1 + (i & 31), 3, Counter::REQUESTS);
+		std::cout << "counter add:              " << perEvent(nowSec() - t, EVENTS) << " ns/event" << std::endl;
+
+		Metrics m2;
+		t = nowSec();
+		transactions(m2, EVENTS, 0);
+		std::cout << "transaction (1 thread):   " << perEvent(nowSec() - t, EVENTS) << " ns/event" << std::endl;
+
+		Metrics m3;
+		t = nowSec();
+		for (int i = 0; i < EVENTS; i++) m3.recordMapLockWait(100 + (i & 1023));
+		std::cout << "map lock wait:            " << perEvent(nowSec() - t, EVENTS) << " ns/event" << std::endl;
+
+		MetricsSnapshot snap;
+		m.snapshot(snap);
+		uint64_t total = 0;
+		for (const SeriesStats& s : snap.series) total += s.get(Counter::REQUESTS);
+		if (total != static_cast<uint64_t>(EVENTS) || snap.series.size() != 32) ok = false;
+	}
+
+	{
+		Metrics m;
+		std::vector<std::thread> threads;
+		std::vector<double> ns(THREADS);
+		for (int k = 0; k < THREADS; k++) {
+			threads.emplace_back([&m, &ns, k]() {
+				double t = threadCpuSec();
+				transactions(m, THREAD_EVENTS, k);
+				ns[k] = perEvent(threadCpuSec() - t, THREAD_EVENTS);
+			});
+		}
+		double worst = 0;
+		for (int k = 0; k < THREADS; k++) {
+			threads[k].join();
+			worst = std::max(worst, ns[k]);
+		}
+		std::cout << "transaction (" << THREADS << " threads):  " << worst << " ns/event (worst thread, cpu time)" << std::endl;
+
+		// Завершившиеся потоки вернули шарды, новые потоки продолжают их счетчики
+		for (int k = 0; k < 100; k++) std::thread([&m]() { m.add(200, 16, Counter::TIMEOUTS); }).join();
+
+		MetricsSnapshot snap;
+		m.snapshot(snap);
+		uint64_t requests = 0, bytes_in = 0, rtt_count = 0, timeouts = 0;
+		for (const SeriesStats& s : snap.series) {
+			requests += s.get(Counter::REQUESTS);
+			bytes_in += s.get(Counter::BYTES_IN);
+			rtt_count += s.rtt_us.count;
+			timeouts += s.get(Counter::TIMEOUTS);
+		}
+		const uint64_t expected = static_cast<uint64_t>(THREADS) * THREAD_EVENTS;
+		if (requests != expected || rtt_count != expected || bytes_in != expected * 22 || timeouts != 100) ok = false;
+	}
+
+	{
+		NullTransport transport;
+		ModbusMaster plain(&transport);
+		double base = masterRun(plain);
+
+		Metrics m;
+		ModbusMaster counted(&transport);
+		counted.setMetrics(&m);
+		double with = masterRun(counted);
+
+		std::cout << "master readWords:         " << perEvent(base, MASTER_TRANSACTIONS) << " ns, with metrics " << perEvent(with, MASTER_TRANSACTIONS)
+				  << " ns (+" << perEvent(with - base, MASTER_TRANSACTIONS) << " ns)" << std::endl;
+
+		MetricsSnapshot snap;
+		m.snapshot(snap);
+		uint64_t requests = 0, exceptions = 0, by_code = 0;
+		for (const SeriesStats& s : snap.series) {
+			requests += s.get(Counter::REQUESTS);
+			exceptions += s.get(Counter::EXCEPTIONS);
+			by_code += s.exceptions[static_cast<int>(ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_ADDRESS)];
+		}
+		if (requests != 3 * MASTER_TRANSACTIONS || exceptions != 3 * MASTER_TRANSACTIONS / 16 || by_code != exceptions) ok = false;
+
+		std::string text;
+		m.writeText(text);
+		std::cout << std::endl << text;
+
+		std::string prom;
+		m.writePrometheus(prom);
+		std::cout << std::endl << prom.substr(0, prom.find("# TYPE mb_responses_total")) << "..." << std::endl;
+	}
+
+	std::cout << std::endl << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
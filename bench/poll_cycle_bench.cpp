@@ -0,0 +1,296 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <optional>
+
+#include "ConfigParser.h"
+#include "PollConfig.h"
+#include "ScanScheduler.h"
+#include "Map.h"
+#include "Arena.h"
+#include "AllocHook.h"
+#include "Simulator.h"
+#include "ModbusMaster.h"
+#include "TcpTransport.h"
+#include "TagHistory.h"
+
+// Сквозное время полного цикла опроса: N устройств x M диапазонов на симуляторе ведомых устройств.
+// Путь мастера целиком: сгенерированная конфигурация -> ConfigParser -> PollConfig (нормализация, план) ->
+// ScanScheduler::buildCycle -> кодирование запроса -> TCP -> разбор ответа -> запись в Map -> чтение тегов по типам -> история тегов.
+// RangeManager/RegManager в этом дереве не собираются, их роль выполняют PollConfig и ScanScheduler.
+// Выводятся процентили времени цикла, процессорное время потока опроса и выделения памяти на цикл.
+// После прогрева каждый цикл выполняется в NoAllocScope: выделение памяти в цикле - ошибка самопроверки.
+// Промежуточные данные цикла (значения тегов) берутся из арены потока опроса, память карт - из кучи (heap),
+// арены (arena) или арены на huge pages (huge).
+// Конфигурация и значения регистров определяются seed, повторный запуск с тем же seed опрашивает то же самое.
+// Запуск: bench_poll_cycle [устройств, 100] [диапазонов на устройство, 10] [циклов, 300] [seed, 1] [heap|arena|huge]
+
+using namespace mb;
+using namespace mb::data;
+using namespace mb::modbus;
+using namespace mb::mem;
+
+constexpr int UNITS_PER_ENDPOINT = 247;
+constexpr uint32_t SCAN_MS = 1000;
+
+static volatile double g_sink = 0;	// Результат чтения тегов, чтобы компилятор не выбросил декодирование
+static uint64_t g_violations = 0;
+
+static void onCycleAlloc(const char* scope, uint64_t allocations) {
+	if (g_violations++ == 0) std::cerr << scope << ": " << allocations << " allocations after warm-up" << std::endl;
+}
+
+static uint64_t threadCpuNs() {
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t monoNs() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+/** @brief Линия опроса: сервер симулятора, мастер и его рабочая конфигурация */
+struct Line {
+	std::string text;
+	ConfigParser parser;
+	std::unique_ptr<PollConfig> config;
+	std::shared_ptr<const PollSnapshot> snapshot;
+	ScanScheduler scheduler;
+	std::vector<std::unique_ptr<Map>> maps;	// По номеру устройства
+	std::unique_ptr<Arena> map_arena;			// Память карт в режимах arena и huge
+	Arena scratch;										// Данные одного цикла, сбрасывается в начале цикла
+	std::vector<WORD> spans;						// Адресное пространство устройства
+	std::unique_ptr<TcpTransport> transport;
+	std::unique_ptr<ModbusMaster> master;
+	TagHistory history;								// Значения тегов по порядку в снимке
+};
+
+// Конфигурация одной линии: диапазоны длиной 8-64 регистра с разрывами 0-16, теги через 2 регистра
+static std::string generateLine(int units, int ranges, std::mt19937_64& rng, std::vector<WORD>& spans) {
+	static const char* types[] = { "", "INT16", "UINT16", "INT32, CD_AB", "UINT32, AB_CD", "FLOAT, CD_AB", "FLOAT_2", "float, dc_ba" };
+	std::ostringstream tags, rng_text;
+	spans.assign(units + 1, 0);
+	for (int unit = 1; unit <= units; unit++) {
+		tags << "[" << unit << ":3]\n";
+		rng_text << "[" << unit << ":3 ranges]\n";
+		uint32_t adr = 0;
+		for (int r = 0; r < ranges; r++) {
+			const uint32_t len = 8 + 2 * (rng() % 29);
+			rng_text << adr << "-" << adr + len - 1 << "\n";
+			for (uint32_t a = adr; a < adr + len; a += 2) {
+				tags << "t" << unit << "_" << a << " = " << a;
+				const char* t = types[rng() % 8];
+				if (*t) tags << ", " << t;
+				tags << "\n";
+			}
+			adr += len + 2 * (rng() % 9);
+		}
+		spans[unit] = static_cast<WORD>(adr);
+	}
+	return tags.str() + rng_text.str();
+}
+
+static double decodeTag(Map& map, const PollTag& tag) {
+	switch (tag.data_type) {
+		case CfgDataType::INT16: { int16_t v = 0; map.readInt16(tag.address, &v); return v; }
+		case CfgDataType::INT32: { int32_t v = 0; map.readInt32(tag.address, &v); return v; }
+		case CfgDataType::UINT32: { uint32_t v = 0; map.readUInt32(tag.address, &v); return v; }
+		case CfgDataType::FLOAT: {
+			float v = 0;
+			if (tag.precision) map.readFloat16(tag.address, &v, tag.precision);
+			else map.readFloat32(tag.address, &v);
+			return v;
+		}
+		default: { uint16_t v = 0; map.readUInt16(tag.address, &v); return v; }
+	}
+}
+
+static uint64_t fnv1a(const std::string& s, uint64_t h) {
+	for (unsigned char c : s) h = (h ^ c) * 1099511628211ull;
+	return h;
+}
+
+static double percentile(std::vector<double>& v, double p) {
+	std::sort(v.begin(), v.end());
+	return v[std::min(v.size() - 1, static_cast<size_t>(p * v.size()))];
+}
+
+int main(int argc, char* argv[]) {
+	const int slaves = argc > 1 ? std::atoi(argv[1]) : 100;
+	const int ranges = argc > 2 ? std::atoi(argv[2]) : 10;
+	const int cycles = argc > 3 ? std::atoi(argv[3]) : 300;
+	const uint64_t seed = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1;
+	const std::string storage = argc > 5 ? argv[5] : "heap";
+	if (slaves < 1 || ranges < 1 || cycles < 1 || (storage != "heap" && storage != "arena" && storage != "huge")) {
+		std::cerr << "Usage: " << argv[0] << " [slaves] [ranges] [cycles] [seed] [heap|arena|huge]" << std::endl;
+		return 2;
+	}
+	setAllocFailHandler(onCycleAlloc);
+	std::cout << std::fixed << std::setprecision(1);
+
+	// Устройства раскладываются по линиям до 247 адресов
+	std::mt19937_64 rng(seed);
+	std::vector<std::unique_ptr<Line>> lines;
+	Simulator sim;
+	sim.setSeed(seed);
+	sim.setTick(3600000);	// Значения задаются один раз при старте и сверяются после опроса
+	uint64_t config_hash = 14695981039346656037ull;
+	size_t tag_count = 0;
+	for (int first = 0; first < slaves; first += UNITS_PER_ENDPOINT) {
+		const int units = std::min(UNITS_PER_ENDPOINT, slaves - first);
+		std::unique_ptr<Line> line(new Line);
+		line->text = generateLine(units, ranges, rng, line->spans);
+		config_hash = fnv1a(line->text, config_hash);
+		if (!line->parser.parse(line->text)) {
+			std::cerr << "Config error at line " << line->parser.getError().line << ": " << line->parser.getError().message << std::endl;
+			return 1;
+		}
+		line->config.reset(new PollConfig(SCAN_MS));
+		line->config->apply(line->parser);
+		line->snapshot = line->config->snapshot();
+		tag_count += line->snapshot->tag_count;
+		line->history.init(line->snapshot->tag_count);
+
+		const int ep = sim.addTcp("127.0.0.1", 0);
+		for (int unit = 1; unit <= units; unit++) {
+			SimLayout layout;
+			layout.input = 0;
+			layout.holding = line->spans[unit];
+			sim.addSlaves(ep, unit, unit, layout);
+		}
+		PatternSpec p;
+		p.endpoint = ep;
+		p.end = 0xFFFF;
+		p.kind = SimPattern::SINE;
+		p.min = -1000;
+		p.max = 1000;
+		p.period_ms = 1000;
+		sim.addPattern(p);
+
+		line->maps.resize(units + 1);
+		if (storage != "heap") line->map_arena.reset(new Arena(1024 * 1024, storage == "huge" ? ArenaBacking::HUGE_PAGES : ArenaBacking::HEAP));
+		for (int unit = 1; unit <= units; unit++) {
+			line->maps[unit].reset(new Map());
+			if (line->map_arena) line->maps[unit]->initArenaMemory(0, line->spans[unit], MapType::WORD_MAP, *line->map_arena);
+			else line->maps[unit]->initNewMemory(0, line->spans[unit], MapType::WORD_MAP);
+		}
+		lines.push_back(std::move(line));
+	}
+	if (!sim.start()) {
+		std::cerr << "Can't start simulator" << std::endl;
+		return 1;
+	}
+	for (size_t i = 0; i < lines.size(); i++) {
+		Line& line = *lines[i];
+		line.transport.reset(new TcpTransport("127.0.0.1", sim.getPort(static_cast<int>(i))));
+		line.master.reset(new ModbusMaster(line.transport.get()));
+		line.master->setTimeout(1000);
+		PollConfig::updateScheduler(line.scheduler, nullptr, *line.snapshot, SCAN_MS, 0);
+		line.scheduler.start(0);
+	}
+
+	std::cout << "poll cycle: " << slaves << " slaves x " << ranges << " ranges, " << tag_count << " tags, "
+				 << lines.size() << " endpoints, seed " << seed << ", config fnv " << std::hex << config_hash << std::dec << std::endl;
+	if (storage == "huge") std::cout << "map storage: " << (lines[0]->map_arena->isHugePages() ? "huge pages" : "transparent huge pages (MAP_HUGETLB unavailable)") << std::endl;
+	else std::cout << "map storage: " << storage << std::endl;
+
+	// Цикл: каждый период все диапазоны должны быть опрошены, линии опрашиваются по очереди одним потоком
+	std::vector<ScanRequest> reqs;
+	std::vector<double> cycle_us, cpu_us;
+	std::vector<uint64_t> allocs;
+	cycle_us.reserve(cycles);
+	cpu_us.reserve(cycles);
+	allocs.reserve(cycles);
+	uint64_t requests = 0, registers = 0, errors = 0;
+	double sink = 0;
+	const int warmup = std::min(10, cycles);
+	for (int c = 0; c < warmup + cycles; c++) {
+		const uint64_t now_ms = static_cast<uint64_t>(c) * SCAN_MS;
+		std::optional<NoAllocScope> guard;
+		if (c >= warmup) guard.emplace("poll cycle");
+		const uint64_t allocs0 = threadAllocations();
+		const uint64_t cpu0 = threadCpuNs();
+		const uint64_t t0 = monoNs();
+		uint64_t cycle_requests = 0, cycle_registers = 0;
+		for (std::unique_ptr<Line>& lp : lines) {
+			Line& line = *lp;
+			line.scratch.reset();
+			reqs.clear();
+			line.scheduler.buildCycle(now_ms, reqs);
+			for (const ScanRequest& r : reqs) {
+				if (line.master->readToMap(r.slave_id, static_cast<BYTE>(r.func), r.start, r.quantity, *line.maps[r.slave_id]) != MbStatus::OK) errors++;
+				cycle_registers += r.quantity;
+			}
+			cycle_requests += reqs.size();
+			double* values = line.scratch.allocArray<double>(line.snapshot->tag_count);
+			size_t n = 0;
+			for (const auto& pair : line.snapshot->groups) {
+				Map& map = *line.maps[pair.second->slave_id];
+				for (const PollTag& tag : pair.second->tags) values[n++] = decodeTag(map, tag);
+			}
+			if (line.history.append(0, n, now_ms, values) != n) errors++;
+			for (size_t i = 0; i < n; i++) {
+				if (std::isfinite(values[i])) sink += values[i];
+			}
+		}
+		const uint64_t t1 = monoNs();
+		const uint64_t cycle_allocs = threadAllocations() - allocs0;
+		guard.reset();
+		if (c < warmup) continue;
+		cycle_us.push_back((t1 - t0) / 1000.0);
+		cpu_us.push_back((threadCpuNs() - cpu0) / 1000.0);
+		allocs.push_back(cycle_allocs);
+		requests += cycle_requests;
+		registers += cycle_registers;
+	}
+	sim.stop();
+	g_sink = sink;
+
+	// Сверка карт мастера с картами симулятора по адресам диапазонов конфигурации
+	uint64_t mismatches = 0;
+	for (size_t i = 0; i < lines.size(); i++) {
+		Line& line = *lines[i];
+		for (const auto& pair : line.snapshot->groups) {
+			const PollGroup& g = *pair.second;
+			Map* remote = sim.getMap(static_cast<int>(i), g.slave_id, SlaveTable::HOLDING_REGISTERS);
+			for (const Range& r : g.ranges) {
+				for (uint32_t adr = r.start; adr <= r.end; adr++) {
+					WORD a = 0, b = 1;
+					line.maps[g.slave_id]->readWord(static_cast<WORD>(adr), &a);
+					if (remote) remote->readWord(static_cast<WORD>(adr), &b);
+					mismatches += a != b;
+				}
+			}
+		}
+	}
+
+	double cpu_total = 0;
+	for (double v : cpu_us) cpu_total += v;
+	uint64_t allocs_total = 0;
+	for (uint64_t v : allocs) allocs_total += v;
+	const double n = static_cast<double>(cycle_us.size());
+	std::cout << "requests/cycle " << requests / n << ", registers/cycle " << registers / n << std::endl;
+	std::cout << "cycle time us: p50 " << percentile(cycle_us, 0.5) << ", p90 " << percentile(cycle_us, 0.9)
+				 << ", p99 " << percentile(cycle_us, 0.99) << ", max " << cycle_us.back() << std::endl;
+	std::cout << "cpu/cycle us: " << cpu_total / n << " (p50 " << percentile(cpu_us, 0.5) << ")" << std::endl;
+	std::cout << "allocs/cycle: " << allocs_total / n << ", cycles with allocations after warm-up " << g_violations << std::endl;
+	size_t history_bytes = 0;
+	for (const std::unique_ptr<Line>& lp : lines) history_bytes += lp->history.getMemorySize();
+	std::cout << "tag history: " << history_bytes / (1024.0 * 1024.0) << " MiB" << std::endl;
+	std::cout << "errors " << errors << ", mismatched registers " << mismatches << std::endl;
+
+	const bool ok = errors == 0 && mismatches == 0 && requests > 0 && g_violations == 0;
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "RequestCache.h"
+
+// 64 потока приложения читают одни и те же диапазоны одного устройства.
+// Сравнивается прямое обращение к мастеру, совместное выполнение одинаковых запросов (scan_ms = 0)
+// и кэш результатов с максимальным возрастом 20 мс. Линия симулируется транспортом с задержкой ответа.
+
+using namespace mb;
+using namespace mb::modbus;
+
+constexpr int THREADS = 64;
+constexpr int REQUESTS_PER_THREAD = 100;
+constexpr int LINE_US = 2000;	// Время транзакции на линии
+
+// Транспорт-симулятор: отвечает на чтение регистров значениями адресов через LINE_US
+class SimTransport : public Transport {
+public:
+	SimTransport() { m_name = "sim"; }
+
+	bool open() override { return true; }
+	void close() override {}
+	bool isOpen() const override { return true; }
+
+	MbStatus transact(const BYTE slave_id, const size_t pdu_len, const BYTE** resp_pdu, size_t* resp_len, const uint32_t timeout_ms) override {
+		(void)slave_id; (void)pdu_len; (void)timeout_ms;
+		const BYTE* req = txPdu();
+		WORD start = getWordBE(req + 1);
+		WORD quantity = getWordBE(req + 3);
+		WORD vals[MODBUS_MAX_READ_REGISTERS];
+		for (WORD i = 0; i < quantity; i++) vals[i] = start + i;
+		std::this_thread::sleep_for(std::chrono::microseconds(LINE_US));
+		*resp_len = pduReadWordsResponse(m_rx, req[0], quantity, vals);
+		*resp_pdu = m_rx;
+		return MbStatus::OK;
+	}
+
+	bool send(const BYTE, const size_t) override { return true; }
+
+protected:
+	size_t headerSize() const override { return 0; }
+};
+
+struct Result {
+	double seconds;
+	uint64_t transactions;
+	double p50_us;
+	double p99_us;
+	int bad;
+};
+
+// cache = nullptr - прямое чтение через мастер
+static Result run(ModbusMaster& master, RequestCache* cache, uint32_t max_age_ms) {
+	const data::Range ranges[] = { data::Range(0, 49, max_age_ms), data::Range(100, 124, max_age_ms),
+											 data::Range(200, 299, max_age_ms), data::Range(1000, 1009, max_age_ms) };
+	uint64_t start_tr = master.getTransactions();
+	std::vector<std::vector<double>> latency(THREADS);
+	std::atomic<int> bad(0);
+	std::vector<std::thread> threads;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int t = 0; t < THREADS; t++) {
+		threads.emplace_back([&, t]() {
+			std::mt19937 rng(t);
+			WORD vals[MODBUS_MAX_READ_REGISTERS];
+			latency[t].reserve(REQUESTS_PER_THREAD);
+			for (int i = 0; i < REQUESTS_PER_THREAD; i++) {
+				const data::Range& r = ranges[rng() % 4];
+				auto t0 = std::chrono::steady_clock::now();
+				MbStatus status = cache ? cache->readWords(1, 3, r, vals) : master.readWords(1, 3, r.start, r.quantity(), vals);
+				latency[t].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+				if (status != MbStatus::OK || vals[0] != r.start || vals[r.quantity() - 1] != r.end) ++bad;
+				std::this_thread::sleep_for(std::chrono::microseconds(rng() % 1000));
+			}
+		});
+	}
+	for (std::thread& t : threads) t.join();
+
+	Result res;
+	res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	res.transactions = master.getTransactions() - start_tr;
+	std::vector<double> all;
+	for (auto& l : latency) all.insert(all.end(), l.begin(), l.end());
+	std::sort(all.begin(), all.end());
+	res.p50_us = all[all.size() / 2];
+	res.p99_us = all[all.size() * 99 / 100];
+	res.bad = bad;
+	return res;
+}
+
+static void print(const char* name, const Result& r) {
+	std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(2)
+			  << std::setw(8) << r.seconds << " s" << std::setw(10) << r.transactions
+			  << std::setprecision(0) << std::setw(12) << r.p50_us << std::setw(12) << r.p99_us
+			  << std::setw(6) << r.bad << std::endl;
+}
+
+int main() {
+	SimTransport transport;
+	ModbusMaster master(&transport);
+
+	std::cout << THREADS << " threads x " << REQUESTS_PER_THREAD << " reads, line " << LINE_US << " us/transaction" << std::endl;
+	std::cout << std::left << std::setw(28) << "mode" << std::right << std::setw(10) << "time" << std::setw(10) << "wire"
+			  << std::setw(12) << "p50, us" << std::setw(12) << "p99, us" << std::setw(6) << "bad" << std::endl;
+
+	print("direct master", run(master, nullptr, 0));
+
+	RequestCache single_flight(&master);
+	print("single-flight", run(master, &single_flight, 0));
+
+	RequestCache cache(&master);
+	print("single-flight + LRU 20 ms", run(master, &cache, 20));
+	RequestCacheStats s = cache.getStats();
+	std::cout << "cache: requests " << s.requests << ", hits " << s.hits << ", collapsed " << s.collapsed
+			  << ", transactions " << s.transactions << ", evictions " << s.evictions << std::endl;
+	return 0;
+}
@@ -0,0 +1,146 @@
+// Симуляция загрузки RTU линии при опросе диапазонов разных классов опроса.
+// "До"     - все диапазоны нормализуются вместе и опрашиваются каждый цикл с периодом самого быстрого класса
+// "После"  - планировщик ScanScheduler опрашивает диапазон только когда наступил его срок
+// Окно слияния проверяется на двух профилях устройства: при кратных периодах классов сроки соседних диапазонов
+// и так совпадают, при некратных досрочный опрос соседа экономит отдельные запросы
+
+#include "ScanScheduler.h"
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+using namespace mb::data;
+
+constexpr int BAUD = 19200;
+constexpr double CHAR_US = 11.0 * 1000000.0 / BAUD;	// 11 бит на символ (8E1)
+constexpr double TURNAROUND_US = 3000.0;				// Время реакции устройства
+constexpr uint64_t SIM_MS = 120000;						// Длительность симуляции
+constexpr int SLAVES = 6;
+
+struct Tag { int func; uint16_t start; uint16_t end; uint32_t scan_ms; };
+
+// Типовое устройство: аварии, измерения, уставки и счетчики энергии (примыкают к измерениям), диагностика
+static const std::vector<Tag> DEVICE = {
+	{ 1, 0, 15, 200 },
+	{ 3, 100, 109, 1000 },
+	{ 3, 110, 119, 5000 },
+	{ 3, 120, 149, 60000 },
+	{ 4, 0, 59, 5000 },
+};
+
+// Устройство с некратными периодами: токи, напряжения, мощности и температуры идут подряд
+static const std::vector<Tag> DEVICE_SKEWED = {
+	{ 1, 0, 15, 200 },
+	{ 3, 100, 109, 700 },
+	{ 3, 110, 119, 1100 },
+	{ 3, 120, 129, 1700 },
+	{ 3, 130, 139, 2300 },
+};
+
+static double transactionUs(int func, uint16_t quantity) {
+	int resp_bytes = (func == 1 || func == 2) ? 5 + (quantity + 7) / 8 : 5 + 2 * quantity;
+	return (8 + resp_bytes) * CHAR_US + 2 * 3.5 * CHAR_US + TURNAROUND_US;
+}
+
+struct SimResult {
+	uint64_t transactions = 0;
+	double busy_us = 0;
+	uint64_t max_alarm_gap_ms = 0;
+};
+
+static void trackAlarm(std::vector<uint64_t>& last, int slave_id, uint64_t now_ms, SimResult& r) {
+	if (last[slave_id]) r.max_alarm_gap_ms = std::max(r.max_alarm_gap_ms, now_ms - last[slave_id]);
+	last[slave_id] = now_ms;
+}
+
+static SimResult simulateFlat(const std::vector<Tag>& device) {
+	SimResult r;
+	std::vector<uint64_t> last_alarm(SLAVES + 1, 0);
+	std::vector<Range> ranges[SLAVES + 1][5];
+
+	for (int s = 1; s <= SLAVES; s++) {
+		for (const Tag& t : device) ranges[s][t.func].emplace_back(t.start, t.end);
+		for (int f = 1; f <= 4; f++) normalizeRangeList(ranges[s][f]);
+	}
+
+	uint64_t period = 200;
+	double now_us = 0;
+	while (now_us < SIM_MS * 1000.0) {
+		double cycle_start = now_us;
+		for (int s = 1; s <= SLAVES; s++) {
+			for (int f = 1; f <= 4; f++) {
+				for (const Range& range : ranges[s][f]) {
+					if (f == 1) trackAlarm(last_alarm, s, static_cast<uint64_t>(now_us / 1000), r);
+					double tx = transactionUs(f, range.quantity());
+					now_us += tx;
+					r.busy_us += tx;
+					++r.transactions;
+				}
+			}
+		}
+		now_us = std::max(now_us, cycle_start + period * 1000.0);
+	}
+	return r;
+}
+
+static SimResult simulateScheduler(const std::vector<Tag>& device, double merge_window) {
+	SimResult r;
+	std::vector<uint64_t> last_alarm(SLAVES + 1, 0);
+	ScanScheduler scheduler;
+	scheduler.setMergeWindow(merge_window);
+
+	for (int s = 1; s <= SLAVES; s++) {
+		for (const Tag& t : device) scheduler.addRange(s, t.func, Range(t.start, t.end, t.scan_ms), 1000);
+	}
+	scheduler.start(0);
+
+	// Очередь ожидающих запросов, после каждой транзакции в нее добавляются наступившие сроки
+	// и более быстрые классы опроса обгоняют медленные
+	std::vector<ScanRequest> pending;
+	double now_us = 0;
+	while (now_us < SIM_MS * 1000.0) {
+		if (scheduler.buildCycle(static_cast<uint64_t>(now_us / 1000), pending)) {
+			std::stable_sort(pending.begin(), pending.end(), [](const ScanRequest& a, const ScanRequest& b) {
+				return a.scan_ms < b.scan_ms;
+			});
+		}
+		if (pending.empty()) {
+			now_us = std::max(now_us, static_cast<double>(scheduler.nextDeadline()) * 1000.0);
+			continue;
+		}
+		ScanRequest req = pending.front();
+		pending.erase(pending.begin());
+		if (req.func == 1) trackAlarm(last_alarm, req.slave_id, static_cast<uint64_t>(now_us / 1000), r);
+		double tx = transactionUs(req.func, req.quantity);
+		now_us += tx;
+		r.busy_us += tx;
+		++r.transactions;
+	}
+	return r;
+}
+
+static void print(const char* name, const SimResult& r) {
+	double seconds = SIM_MS / 1000.0;
+	printf("%-28s %10llu %10.1f %9.1f%% %12llu\n", name,
+		static_cast<unsigned long long>(r.transactions),
+		r.transactions / seconds,
+		100.0 * r.busy_us / (SIM_MS * 1000.0),
+		static_cast<unsigned long long>(r.max_alarm_gap_ms));
+}
+
+static void run(const char* title, const std::vector<Tag>& device) {
+	printf("\n%s\n", title);
+	printf("%-28s %10s %10s %10s %12s\n", "mode", "requests", "req/s", "bus", "alarm gap ms");
+	print("flat (every cycle)", simulateFlat(device));
+	print("scheduler, merge window 0", simulateScheduler(device, 0.0));
+	print("scheduler, merge 0.25", simulateScheduler(device, 0.25));
+}
+
+int main(void) {
+	printf("RTU %d baud, %d slaves, %llu s simulated\n", BAUD, SLAVES, static_cast<unsigned long long>(SIM_MS / 1000));
+	run("harmonic periods (200/1000/5000/60000 ms)", DEVICE);
+	run("skewed periods (200/700/1100/1700/2300 ms)", DEVICE_SKEWED);
+	return 0;
+}
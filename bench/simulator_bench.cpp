@@ -0,0 +1,243 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Simulator.h"
+#include "ModbusMaster.h"
+#include "TcpTransport.h"
+#include "RtuTransport.h"
+
+// Пропускная способность симулятора и проверка его моделей:
+// - 4 сервера TCP x 247 устройств, клиенты ModbusMaster опрашивают по 100 регистров (запрос-ответ)
+// - одно соединение с конвейером из 64 запросов: предел самого симулятора без ожидания клиента
+// - задержка ответа (фиксированная и нормальная), доли исключений и неответов
+// - шаблоны значений (const, counter) и линия RTU на псевдотерминале
+
+using namespace mb;
+using namespace mb::modbus;
+
+constexpr double RUN_SEC = 1.5;
+constexpr WORD CONST_VALUE = 1234;
+
+static double nowSec() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static PatternSpec constPattern(int endpoint) {
+	PatternSpec p;
+	p.endpoint = endpoint;
+	p.start = 0;
+	p.end = 99;
+	p.kind = SimPattern::CONST;
+	p.min = p.max = CONST_VALUE;
+	return p;
+}
+
+// Клиенты запрос-ответ, по clients_per_ep на сервер
+static bool requestResponse(Simulator& sim, int clients_per_ep) {
+	std::atomic<uint64_t> ok(0), bad(0);
+	std::vector<std::thread> threads;
+	const double start = nowSec();
+	for (size_t ep = 0; ep < sim.getEndpointCount(); ep++) {
+		for (int c = 0; c < clients_per_ep; c++) {
+			threads.emplace_back([&, ep, c]() {
+				TcpTransport tcp("127.0.0.1", sim.getPort(static_cast<int>(ep)));
+				ModbusMaster master(&tcp);
+				master.setTimeout(1000);
+				WORD vals[100];
+				int slave = 1 + c;
+				while (nowSec() - start < RUN_SEC) {
+					if (master.readWords(slave, 3, 0, 100, vals) == MbStatus::OK && vals[0] == CONST_VALUE && vals[99] == CONST_VALUE) ++ok;
+					else ++bad;
+					slave = slave % 247 + 1;
+				}
+			});
+		}
+	}
+	for (std::thread& t : threads) t.join();
+	const double sec = nowSec() - start;
+	std::cout << "request/response, " << threads.size() << " clients: " << static_cast<uint64_t>(ok / sec) << " req/s, bad " << bad << std::endl;
+	return ok > 0 && bad == 0;
+}
+
+// Конвейер: 64 запроса подряд, затем 64 ответа
+static bool pipelined(Simulator& sim) {
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in adr = {};
+	adr.sin_family = AF_INET;
+	adr.sin_port = htons(sim.getPort(0));
+	inet_pton(AF_INET, "127.0.0.1", &adr.sin_addr);
+	if (::connect(fd, reinterpret_cast<sockaddr*>(&adr), sizeof(adr)) != 0) return false;
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	const int depth = 64;
+	const size_t resp_len = TCP_HEADER_SIZE + 2 + 2 * 10;
+	std::vector<BYTE> batch(depth * 12);
+	std::vector<BYTE> resp(depth * resp_len);
+	uint64_t done = 0, bad = 0;
+	WORD tid = 0;
+	const double start = nowSec();
+	while (nowSec() - start < RUN_SEC) {
+		for (int i = 0; i < depth; i++) {
+			BYTE* adu = batch.data() + i * 12;
+			mbapEncode(adu, tid++, static_cast<BYTE>(1 + i % 247), pduReadRequest(adu + TCP_HEADER_SIZE, 3, 0, 10));
+		}
+		if (::send(fd, batch.data(), batch.size(), 0) != static_cast<ssize_t>(batch.size())) break;
+		size_t have = 0;
+		while (have < resp.size()) {
+			ssize_t n = ::recv(fd, resp.data() + have, resp.size() - have, 0);
+			if (n <= 0) break;
+			have += n;
+		}
+		for (int i = 0; i < depth; i++) bad += getWordBE(resp.data() + i * resp_len + TCP_HEADER_SIZE + 2) != CONST_VALUE;
+		done += depth;
+	}
+	::close(fd);
+	const double sec = nowSec() - start;
+	std::cout << "pipelined x" << depth << ", 1 connection: " << static_cast<uint64_t>(done / sec) << " req/s, bad " << bad << std::endl;
+	return done > 0 && bad == 0;
+}
+
+// Медиана времени ответа при заданной задержке
+static bool latency(const LatencyModel& model, double expect_ms, const char* name) {
+	Simulator sim;
+	int ep = sim.addTcp("127.0.0.1", 0);
+	sim.addSlaves(ep, 1, 1, SimLayout());
+	sim.setLatency(ep, model);
+	sim.start();
+
+	TcpTransport tcp("127.0.0.1", sim.getPort(ep));
+	ModbusMaster master(&tcp);
+	master.setTimeout(1000);
+	std::vector<double> ms;
+	WORD vals[10];
+	for (int i = 0; i < 100; i++) {
+		double t = nowSec();
+		if (master.readWords(1, 3, 0, 10, vals) != MbStatus::OK) return false;
+		ms.push_back((nowSec() - t) * 1000);
+	}
+	std::sort(ms.begin(), ms.end());
+	const double median = ms[ms.size() / 2];
+	std::cout << "latency " << name << ": median " << median << " ms, p99 " << ms[98] << " ms" << std::endl;
+	return median >= expect_ms * 0.9 && median < expect_ms + 2;
+}
+
+// Доли исключений и неответов близки к заданным
+static bool faults() {
+	Simulator sim;
+	int ep = sim.addTcp("127.0.0.1", 0);
+	sim.addSlaves(ep, 1, 10, SimLayout());
+	FaultModel f;
+	f.exception_rate = 0.1;
+	f.exception = ModbusExceptionCode::EXCEPTION_SLAVE_OR_SERVER_BUSY;
+	f.no_response_rate = 0.05;
+	sim.setFaults(ep, f);
+	sim.start();
+
+	TcpTransport tcp("127.0.0.1", sim.getPort(ep));
+	ModbusMaster master(&tcp);
+	master.setTimeout(20);
+	const int total = 1000;
+	int exceptions = 0, timeouts = 0;
+	WORD vals[10];
+	for (int i = 0; i < total; i++) {
+		MbStatus s = master.readWords(1 + i % 10, 3, 0, 10, vals);
+		if (s == MbStatus::EXCEPTION && master.getLastException() == ModbusExceptionCode::EXCEPTION_SLAVE_OR_SERVER_BUSY) exceptions++;
+		else if (s == MbStatus::TIMEOUT) timeouts++;
+	}
+	std::cout << "faults: exceptions " << exceptions * 100.0 / total << "% (10%), no response " << timeouts * 100.0 / total << "% (5%)" << std::endl;
+	return exceptions > total * 0.06 && exceptions < total * 0.14 && timeouts > total * 0.025 && timeouts < total * 0.08;
+}
+
+// Шаблон counter на псевдотерминале RTU: значение растет со временем, линия отвечает с задержкой
+static bool rtuPattern() {
+	Simulator sim;
+	int ep = sim.addPty();
+	if (ep < 0) return false;
+	SimLayout layout;
+	layout.discrete = 16;
+	sim.addSlaves(ep, 1, 5, layout);
+	LatencyModel l;
+	l.kind = SimLatency::FIXED;
+	l.a_ms = 3;
+	sim.setLatency(ep, l);
+	PatternSpec p;
+	p.endpoint = ep;
+	p.first_slave = 1;
+	p.last_slave = 5;
+	p.start = 0;
+	p.end = 9;
+	p.kind = SimPattern::COUNTER;
+	p.min = 100;
+	p.max = 1000;
+	p.period_ms = 100;
+	sim.addPattern(p);
+	p.table = SlaveTable::DISCRETE_INPUTS;
+	p.end = 15;
+	p.kind = SimPattern::CONST;
+	p.min = p.max = 1;
+	sim.addPattern(p);
+	sim.setTick(10);
+	sim.start();
+
+	RtuTransport rtu(sim.getEndpointName(ep));
+	if (!rtu.open()) return false;
+	ModbusMaster master(&rtu);
+	master.setTimeout(200);
+	WORD first = 0, last = 0;
+	BIT bits[16];
+	bool ok = true;
+	for (int i = 0; i < 20 && ok; i++) {
+		WORD v;
+		ok = master.readWords(1 + i % 5, 3, 5, 1, &v) == MbStatus::OK && master.readBits(1 + i % 5, 2, 0, 16, bits) == MbStatus::OK;
+		ok = ok && std::count(bits, bits + 16, 1) == 16;
+		if (i == 0) first = v;
+		last = v;
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+	std::cout << "rtu " << sim.getEndpointName(ep) << ": counter " << first << " -> " << last << std::endl;
+	return ok && first >= 100 && last > first;
+}
+
+int main() {
+	std::cout << std::fixed << std::setprecision(2);
+
+	Simulator sim;
+	for (int i = 0; i < 4; i++) {
+		int ep = sim.addTcp("127.0.0.1", 0);
+		sim.addSlaves(ep, 1, 247, SimLayout());
+		sim.addPattern(constPattern(ep));
+	}
+	sim.start();
+	std::cout << "simulator: " << sim.getEndpointCount() << " endpoints, " << sim.getSlaveCount() << " slaves" << std::endl;
+
+	bool ok = requestResponse(sim, 4);
+	ok = pipelined(sim) && ok;
+	sim.stop();
+
+	LatencyModel fixed;
+	fixed.kind = SimLatency::FIXED;
+	fixed.a_ms = 5;
+	ok = latency(fixed, 5, "fixed 5 ms") && ok;
+	LatencyModel normal;
+	normal.kind = SimLatency::NORMAL;
+	normal.a_ms = 3;
+	normal.b_ms = 0.5;
+	ok = latency(normal, 3, "normal 3/0.5 ms") && ok;
+	ok = faults() && ok;
+	ok = rtuPattern() && ok;
+
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "MapRegistry.h"
+#include "WorkPool.h"
+
+// Запуск опроса: 247 устройств x 4 функции x 1000 диапазонов (перемешаны, с перекрытиями и разными классами опроса)
+// - прежний путь: вложенные unordered_map slave_id -> func -> диапазоны (как RangeManager), нормализация
+//   с повторным поиском пары на каждой итерации, затем MapRegistry::addRanges по одной паре
+// - MapRegistry::addBuckets: нормализация групп и выделение памяти карт в пуле из 1 потока и из всех процессоров
+// Проверка: нормализованные диапазоны и списки карт всех путей совпадают.
+// Запуск: bench_startup [диапазонов на функцию, по умолчанию 1000] [max_gap] [seed]
+
+using namespace mb::data;
+
+constexpr int SLAVES = 247;
+static const int FUNCS[4] = { 1, 2, 3, 4 };
+static const uint32_t SCAN_MS[3] = { 0, 100, 1000 };
+
+using RangeTable = std::unordered_map<int, std::unordered_map<int, std::vector<Range>>>;
+
+struct MapInfo {
+	int slave_id;
+	int func;
+	WORD start;
+	WORD quantity;
+
+	bool operator==(const MapInfo& o) const { return slave_id == o.slave_id && func == o.func && start == o.start && quantity == o.quantity; }
+	bool operator<(const MapInfo& o) const {
+		if (slave_id != o.slave_id) return slave_id < o.slave_id;
+		if (func != o.func) return func < o.func;
+		return start < o.start;
+	}
+};
+
+static bool rangeLess(const Range& a, const Range& b) {
+	if (a.start != b.start) return a.start < b.start;
+	if (a.end != b.end) return a.end < b.end;
+	return a.scan_ms < b.scan_ms;
+}
+
+static double nowSec() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::vector<RangeBucket> makeBuckets(std::mt19937& rng, int per_func) {
+	std::vector<RangeBucket> buckets;
+	for (int s = 1; s <= SLAVES; s++) {
+		for (int func : FUNCS) {
+			RangeBucket b{ s, func, {} };
+			uint32_t adr = rng() % 100;
+			for (int i = 0; i < per_func && adr < 65000; i++) {
+				const uint32_t len = 1 + rng() % 40;
+				b.ranges.emplace_back(static_cast<uint16_t>(adr), static_cast<uint16_t>(std::min<uint32_t>(adr + len - 1, 65535)), SCAN_MS[rng() % 3]);
+				// Следующий диапазон перекрывает текущий, примыкает к нему или отстоит на разрыв
+				adr += rng() % 4 == 0 ? len / 2 : len + rng() % 24;
+			}
+			std::shuffle(b.ranges.begin(), b.ranges.end(), rng);
+			buckets.push_back(std::move(b));
+		}
+	}
+	return buckets;
+}
+
+static std::vector<MapInfo> mapsOf(const MapRegistry& registry) {
+	std::vector<MapInfo> maps;
+	registry.forEachMap([&maps](int slave_id, int func, const Map& m) { maps.push_back(MapInfo{ slave_id, func, m.getStartAdr(), m.getQuantity() }); });
+	std::sort(maps.begin(), maps.end());
+	return maps;
+}
+
+// Прежний путь: нормализация каждой пары через m_ranges[slave_id][func], карты по одной паре
+static double legacyStartup(const std::vector<RangeBucket>& buckets, WORD max_gap, RangeTable& table, MapRegistry& registry) {
+	const double t = nowSec();
+	for (const RangeBucket& b : buckets) {
+		for (const Range& r : b.ranges) table[b.slave_id][b.func].push_back(r);
+	}
+	for (const auto& pair : table) {
+		for (const auto& inner : pair.second) normalizeRangeList(table[pair.first][inner.first]);
+	}
+	for (const auto& pair : table) {
+		for (const auto& inner : pair.second) registry.addRanges(pair.first, inner.first, inner.second, max_gap);
+	}
+	return nowSec() - t;
+}
+
+static double bucketStartup(std::vector<RangeBucket> buckets, WORD max_gap, mb::work::WorkPool* pool, MapRegistry& registry, std::vector<RangeBucket>& normalized) {
+	const double t = nowSec();
+	registry.addBuckets(buckets, max_gap, pool);
+	const double elapsed = nowSec() - t;
+	normalized = std::move(buckets);
+	return elapsed;
+}
+
+int main(int argc, char* argv[]) {
+	const int per_func = argc > 1 ? std::atoi(argv[1]) : 1000;
+	const WORD max_gap = argc > 2 ? static_cast<WORD>(std::atoi(argv[2])) : 0;
+	const unsigned seed = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : 1;
+	std::mt19937 rng(seed);
+	std::cout << std::fixed << std::setprecision(1);
+
+	const std::vector<RangeBucket> buckets = makeBuckets(rng, per_func);
+	size_t total = 0;
+	for (const RangeBucket& b : buckets) total += b.ranges.size();
+	std::cout << SLAVES << " slaves x " << 4 << " funcs, " << total << " ranges, max gap " << max_gap << std::endl;
+
+	RangeTable table;
+	MapRegistry legacy;
+	const double t_legacy = legacyStartup(buckets, max_gap, table, legacy);
+	const std::vector<MapInfo> expected = mapsOf(legacy);
+	std::cout << "legacy (nested maps, addRanges): " << t_legacy * 1e3 << " ms, maps " << expected.size() << std::endl;
+
+	bool ok = !expected.empty();
+	// На одном процессоре пул из 4 потоков проверяет перехват работы, но не ускоряет запуск
+	const unsigned hw = std::max(4u, std::thread::hardware_concurrency());
+	for (unsigned threads : { 1u, hw }) {
+		mb::work::WorkPool pool(threads);
+		MapRegistry registry;
+		std::vector<RangeBucket> normalized;
+		const double t = bucketStartup(buckets, max_gap, &pool, registry, normalized);
+		const std::vector<MapInfo> maps = mapsOf(registry);
+		bool same = maps == expected;
+		for (RangeBucket& b : normalized) {
+			std::vector<Range> ref = table[b.slave_id][b.func];
+			std::vector<Range> got = b.ranges;
+			std::sort(ref.begin(), ref.end(), rangeLess);
+			std::sort(got.begin(), got.end(), rangeLess);
+			same = same && ref.size() == got.size() &&
+				std::equal(ref.begin(), ref.end(), got.begin(), [](const Range& x, const Range& y) { return x.start == y.start && x.end == y.end && x.scan_ms == y.scan_ms; });
+		}
+		// Повторная загрузка тех же групп не создает карт: все отрезки пересекаются с существующими
+		same = same && registry.addBuckets(normalized, max_gap, &pool) == 0 && registry.getMapCount() == expected.size();
+		ok = ok && same;
+		std::cout << "addBuckets, " << pool.getThreadCount() << " threads: " << t * 1e3 << " ms (x" << std::setprecision(2) << t_legacy / t << std::setprecision(1)
+					 << "), steals " << pool.getSteals() << ", maps " << maps.size() << (same ? "" : " DIFFERS") << std::endl;
+	}
+
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
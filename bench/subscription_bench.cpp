@@ -0,0 +1,216 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Map.h"
+#include "SubscriptionHub.h"
+
+// Подписки на изменения карты против опроса карты потребителем (как потоки сигнализации и HMI сейчас):
+// - цена updateWords ответа из 100 регистров без наблюдателя и с 1/4/16 подписчиками на всю карту
+// - поиск изменений потребителем: readWords всей карты и сравнение с копией против poll подписки
+// - потоки: опрос пишет ответы с меняющимися значениями, подписчики COALESCE и DROP читают события,
+//   выводятся счетчики и задержка от записи ответа до выдачи
+// Проверка: события совпадают с изменениями (слова, тег DWORD из двух ответов, биты обеих карт),
+// переполнение DROP/COALESCE, после остановки потоков копия подписчика COALESCE совпадает с картой.
+// Запуск: bench_subscription [seed]
+
+using namespace mb::data;
+
+constexpr WORD START = 1000;
+constexpr WORD WORDS = 1000;
+constexpr WORD RESPONSE = 100;
+constexpr int OPS = 200000;
+
+static double nowSec() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Ответ: change слов из RESPONSE меняют значение
+static void makeResponse(std::mt19937& rng, std::vector<WORD>& words, int change) {
+	for (int i = 0; i < change; i++) words[rng() % RESPONSE] ^= static_cast<WORD>(1 + rng() % 0xFFFF);
+}
+
+static double updateNs(Map& map, std::mt19937& rng, SubscriptionHub* hub, std::vector<SubscriberId>& subs) {
+	// Ответы по каждому диапазону отличаются от прошлого ответа того же диапазона на 2 слова
+	std::vector<std::vector<WORD>> ranges(WORDS / RESPONSE);
+	for (size_t r = 0; r < ranges.size(); r++) {
+		ranges[r].resize(RESPONSE);
+		map.readWords(static_cast<WORD>(START + r * RESPONSE), RESPONSE, ranges[r].data());
+	}
+	std::vector<ChangeEvent> events(4096);
+	double total = 0;
+	for (int i = 0; i < OPS; i++) {
+		std::vector<WORD>& words = ranges[i % ranges.size()];
+		makeResponse(rng, words, 2);
+		const WORD adr = static_cast<WORD>(START + (i % ranges.size()) * RESPONSE);
+		const double t = nowSec();
+		map.updateWords(adr, RESPONSE, words.data());
+		total += nowSec() - t;
+		if (hub && i % 16 == 15) {
+			for (SubscriberId id : subs) hub->poll(id, events.data(), events.size());
+		}
+	}
+	return total * 1e9 / OPS;
+}
+
+static bool checkEvents() {
+	SubscriptionHub hub;
+	Map words, coils, packed;
+	bool ok = words.initNewMemory(0, 100, MapType::WORD_MAP) && coils.initNewMemory(0, 64, MapType::BIT_MAP) && packed.initNewMemory(0, 8, MapType::WORD_MAP);
+	const SubscriberId a = hub.addSubscriber(64), b = hub.addSubscriber(16, OverflowPolicy::DROP);
+	ok = ok && hub.watchRange(a, words, 20, 10) && hub.watchTag(a, words, 7, 49, 2) && hub.watchRange(a, coils, 0, 64) && hub.watchTag(a, coils, 8, 5, 1);
+	ok = ok && hub.watchRange(a, packed, 1, 2) && hub.watchRange(b, words, 0, 100);
+	ok = ok && !hub.watchRange(a, words, 95, 10) && !hub.watchTag(a, coils, 9, 0, 2) && !hub.watchRange(7, words, 0, 1);
+	Map other;
+	SubscriptionHub second;
+	ok = ok && other.initNewMemory(0, 4, MapType::WORD_MAP) && second.addSubscriber() == 0 && !second.watchRange(0, words, 0, 1);
+
+	ChangeEvent ev[128];
+	WORD w[30] = {};
+	w[5] = 1;			// Адрес 25
+	w[29] = 0x1111;	// Адрес 49: первое слово тега
+	ok = ok && words.updateWords(20, 30, w, 123) && hub.poll(a, ev, 128) == 2;
+	ok = ok && ev[0].address == 25 && ev[0].value[0] == 1 && ev[0].tag == INVALID_TAG_HANDLE && ev[0].timestamp_ns == 123 && ev[0].map == &words;
+	ok = ok && ev[1].tag == 7 && ev[1].count == 2 && ev[1].value[0] == 0x1111 && ev[1].value[1] == 0;
+	// Второе слово тега - другим ответом: событие с обоими словами; то же значение - без события
+	WORD w2[2] = { 0x2222, 0 };
+	ok = ok && words.updateWords(50, 2, w2) && hub.poll(a, ev, 128) == 1 && ev[0].tag == 7 && ev[0].value[0] == 0x1111 && ev[0].value[1] == 0x2222;
+	ok = ok && words.updateWords(50, 2, w2) && hub.poll(a, ev, 128) == 0;
+
+	BIT bits[64] = {};
+	bits[5] = 7;
+	bits[63] = 1;
+	ok = ok && coils.updateBits(0, 64, bits) && hub.poll(a, ev, 128) == 3;
+	ok = ok && ev[0].map == &coils && ev[0].address == 5 && ev[1].address == 63 && ev[2].tag == 8 && ev[2].value[0] == 1;
+	// Биты в карте слов - события по словам
+	BIT one = 1;
+	ok = ok && packed.updateBits(2 * WORD_BIT_SIZE + 3, 1, &one) && hub.poll(a, ev, 128) == 1 && ev[0].map == &packed && ev[0].address == 2 && ev[0].value[0] == 8;
+
+	// Подписчик b (DROP, кольцо 16) видел все изменения words: 2 + 1 слово, остальное не менялось
+	ok = ok && hub.poll(b, ev, 128) == 3;
+	for (WORD i = 0; i < 100; i++) w[i % 30] = static_cast<WORD>(i + 100);
+	ok = ok && words.updateWords(0, 30, w) && hub.poll(b, ev, 128) == 16 && hub.poll(a, ev, 128) == 10;
+	SubscriberStats sb = hub.getStats(b);
+	ok = ok && sb.published == 19 && sb.dropped == 14 && sb.delivered == 19 && sb.max_pending == 16 && sb.pending == 0;
+
+	// COALESCE: 100 изменений 10 адресов в кольце на 64 - последние значения выдаются после кольца
+	for (int k = 1; k <= 10; k++) {
+		for (WORD i = 0; i < 10; i++) w[i] = static_cast<WORD>(k * 100 + i);
+		ok = words.updateWords(20, 10, w) && ok;
+	}
+	size_t n = hub.poll(a, ev, 70);
+	ok = ok && n == 70 && ev[63].value[0] == 703 && ev[64].coalesced == 1 && ev[64].address == 20 && ev[64].value[0] == 1000;
+	n = hub.poll(a, ev, 70);
+	ok = ok && n == 4 && ev[3].address == 29 && ev[3].value[0] == 1009 && hub.poll(a, ev, 70) == 0;
+	const SubscriberStats sa = hub.getStats(a);
+	ok = ok && sa.coalesced == 36 && sa.dropped == 0;
+
+	hub.clear();
+	return ok && words.getObserver() == nullptr && coils.getObserver() == nullptr;
+}
+
+int main(int argc, char* argv[]) {
+	const unsigned seed = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 1;
+	std::mt19937 rng(seed);
+	std::cout << std::fixed << std::setprecision(1);
+
+	Map map;
+	map.initNewMemory(START, WORDS, MapType::WORD_MAP);
+	std::vector<SubscriberId> subs;
+	std::cout << "updateWords " << RESPONSE << " words, 2 changed: no observer " << updateNs(map, rng, nullptr, subs) << " ns";
+	for (int count : { 1, 4, 16 }) {
+		SubscriptionHub hub;
+		subs.clear();
+		for (int i = 0; i < count; i++) {
+			subs.push_back(hub.addSubscriber(4096));
+			hub.watchRange(subs.back(), map, START, WORDS);
+		}
+		std::cout << ", " << count << " subscribers " << updateNs(map, rng, &hub, subs) << " ns";
+	}
+	std::cout << std::endl;
+
+	// Поиск изменений: сравнение всей карты с копией против poll подписки, изменения - 2 слова на ответ
+	{
+		SubscriptionHub hub;
+		const SubscriberId id = hub.addSubscriber(4096);
+		hub.watchRange(id, map, START, WORDS);
+		std::vector<WORD> copy(WORDS), now(WORDS), words(RESPONSE);
+		std::vector<ChangeEvent> events(4096);
+		map.readWords(START, WORDS, copy.data());
+		hub.poll(id, events.data(), events.size());
+		double scan = 0, poll = 0;
+		size_t found_scan = 0, found_poll = 0;
+		for (int i = 0; i < OPS / 10; i++) {
+			const WORD adr = static_cast<WORD>(START + (i % 10) * RESPONSE);
+			map.readWords(adr, RESPONSE, words.data());
+			makeResponse(rng, words, 2);
+			map.updateWords(adr, RESPONSE, words.data());
+			double t = nowSec();
+			map.readWords(START, WORDS, now.data());
+			for (WORD k = 0; k < WORDS; k++) {
+				if (now[k] != copy[k]) {
+					copy[k] = now[k];
+					found_scan++;
+				}
+			}
+			scan += nowSec() - t;
+			t = nowSec();
+			found_poll += hub.poll(id, events.data(), events.size());
+			poll += nowSec() - t;
+		}
+		std::cout << "find changes in " << WORDS << " words: scan " << scan * 1e9 / (OPS / 10) << " ns, poll " << poll * 1e9 / (OPS / 10)
+					 << " ns (changes " << found_scan << "/" << found_poll << ")" << std::endl;
+	}
+
+	// Потоки: опрос и два подписчика с маленькими кольцами
+	bool ok = checkEvents();
+	{
+		SubscriptionHub hub;
+		const SubscriberId hmi = hub.addSubscriber(256), alarm = hub.addSubscriber(256, OverflowPolicy::DROP);
+		ok = hub.watchRange(hmi, map, START, WORDS) && hub.watchRange(alarm, map, START, WORDS) && ok;
+		std::vector<WORD> mirror(WORDS);
+		map.readWords(START, WORDS, mirror.data());
+		std::atomic<bool> done(false);
+		std::thread consumer([&]() {
+			std::vector<ChangeEvent> events(128);
+			for (;;) {
+				const bool last = done.load(std::memory_order_acquire);
+				size_t n;
+				while ((n = hub.poll(hmi, events.data(), events.size())) > 0) {
+					for (size_t i = 0; i < n; i++) mirror[events[i].address - START] = events[i].value[0];
+				}
+				hub.poll(alarm, events.data(), events.size());
+				if (last) break;
+				std::this_thread::yield();
+			}
+		});
+		std::vector<WORD> words(RESPONSE);
+		uint64_t changes = 0;
+		for (int i = 0; i < OPS; i++) {
+			const WORD adr = static_cast<WORD>(START + (i % 10) * RESPONSE);
+			map.readWords(adr, RESPONSE, words.data());
+			std::vector<WORD> before = words;
+			makeResponse(rng, words, 1 + i % 8);
+			for (WORD k = 0; k < RESPONSE; k++) changes += before[k] != words[k];
+			map.updateWords(adr, RESPONSE, words.data());
+		}
+		done.store(true, std::memory_order_release);
+		consumer.join();
+		std::vector<WORD> final(WORDS);
+		map.readWords(START, WORDS, final.data());
+		const SubscriberStats h = hub.getStats(hmi), a = hub.getStats(alarm);
+		const bool same = final == mirror;
+		ok = ok && same && a.published + a.dropped == changes && h.published + h.coalesced == changes && h.pending == 0;
+		std::cout << "threads: " << changes << " changes" << std::endl;
+		std::cout << "  coalesce: published " << h.published << ", coalesced " << h.coalesced << ", delivered " << h.delivered << ", max pending " << h.max_pending
+					 << ", lag avg " << h.avg_lag_ns / 1000.0 << " us, max " << h.max_lag_ns / 1000.0 << " us, mirror " << (same ? "equal" : "DIFFERS") << std::endl;
+		std::cout << "  drop:     published " << a.published << ", dropped " << a.dropped << ", max pending " << a.max_pending
+					 << ", lag avg " << a.avg_lag_ns / 1000.0 << " us, max " << a.max_lag_ns / 1000.0 << " us" << std::endl;
+	}
+
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
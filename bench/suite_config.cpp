@@ -0,0 +1,59 @@
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "harness.h"
+#include "ConfigParser.h"
+#include "TagIndex.h"
+#include "config_gen.h"
+
+// Загрузка тегов: разбор строк "имя = адрес, тип_точность, порядок" (то, что делает RegManager::addReg при чтении
+// конфигурации) и построение индекса тегов по имени и адресу, как RegManager::indexReg
+
+using namespace mb::data;
+using mb::bench::State;
+
+static std::string configText(int tags) {
+	const std::string path = "/tmp/mb_bench_suite_" + std::to_string(tags) + ".ini";
+	generateConfig(path, tags);
+	std::ifstream in(path);
+	std::stringstream ss;
+	ss << in.rdbuf();
+	remove(path.c_str());
+	return ss.str();
+}
+
+static void tagParse(State& state) {
+	const std::string text = configText(static_cast<int>(state.arg()));
+	ConfigParser parser;
+	while (state.keepRunning()) {
+		parser.clear();
+		parser.parse(text);
+		mb::bench::doNotOptimize(parser.getTags().data());
+	}
+	state.setItemsProcessed(state.iterations() * parser.getTags().size());
+	state.setBytesProcessed(state.iterations() * text.size());
+}
+MB_BENCHMARK(tagParse)->arg(10000)->arg(100000);
+
+// Добавление всех тегов и первый поиск (досортировка индекса адресов)
+static void tagIndexBuild(State& state) {
+	const std::string text = configText(static_cast<int>(state.arg()));
+	ConfigParser parser;
+	parser.parse(text);
+	const std::vector<ConfigTag>& tags = parser.getTags();
+	std::vector<TagHandle> found;
+	while (state.keepRunning()) {
+		TagIndex index;
+		for (size_t i = 0; i < tags.size(); i++) {
+			const ConfigTag& t = tags[i];
+			const bool dword = t.data_type != CfgDataType::NONE && t.data_type != CfgDataType::INT16 && t.data_type != CfgDataType::UINT16;
+			index.add(t.name, t.slave_id, t.func, t.address, dword ? 2 : 1, static_cast<TagHandle>(i));
+		}
+		found.clear();
+		index.findByAddress(tags[0].slave_id, tags[0].func, tags[0].address, found);
+		mb::bench::doNotOptimize(found.data());
+	}
+	state.setItemsProcessed(state.iterations() * tags.size());
+}
+MB_BENCHMARK(tagIndexBuild)->arg(10000)->arg(100000);
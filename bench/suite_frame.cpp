@@ -0,0 +1,113 @@
+#include <vector>
+
+#include "harness.h"
+#include "ModbusFrame.h"
+
+// Кодирование запросов и разбор ответов RTU/TCP (регистры и биты), CRC16, упаковка битов
+
+using namespace mb::modbus;
+using mb::bench::State;
+
+static void rtuEncodeReadRequest(State& state) {
+	BYTE adu[MODBUS_MAX_ADU_LENGTH];
+	WORD adr = 0;
+	while (state.keepRunning()) {
+		adu[0] = 17;
+		size_t len = rtuFinish(adu, RTU_HEADER_SIZE + pduReadRequest(adu + RTU_HEADER_SIZE, 3, adr++, 125));
+		mb::bench::doNotOptimize(len);
+	}
+	state.setItemsProcessed(state.iterations());
+}
+MB_BENCHMARK(rtuEncodeReadRequest);
+
+static void rtuDecodeReadWords(State& state) {
+	const WORD n = static_cast<WORD>(state.arg());
+	std::vector<WORD> src(n), dst(n);
+	for (WORD i = 0; i < n; i++) src[i] = static_cast<WORD>(i * 31 + 7);
+	BYTE adu[MODBUS_MAX_ADU_LENGTH];
+	adu[0] = 17;
+	const size_t len = rtuFinish(adu, RTU_HEADER_SIZE + pduReadWordsResponse(adu + RTU_HEADER_SIZE, 3, n, src.data()));
+	bool ok = true;
+	while (state.keepRunning()) {
+		ok &= rtuCheck(adu, len) && pduParseWords(adu + RTU_HEADER_SIZE, len - RTU_HEADER_SIZE - RTU_CRC_SIZE, 3, n, dst.data());
+		mb::bench::doNotOptimize(dst[0]);
+	}
+	if (!ok) state.setLabel("DECODE FAILED");
+	state.setItemsProcessed(state.iterations() * n);
+	state.setBytesProcessed(state.iterations() * len);
+}
+MB_BENCHMARK(rtuDecodeReadWords)->arg(10)->arg(125);
+
+static void tcpEncodeReadRequest(State& state) {
+	BYTE adu[MODBUS_MAX_ADU_LENGTH];
+	WORD tid = 0;
+	while (state.keepRunning()) {
+		size_t pdu_len = pduReadRequest(adu + TCP_HEADER_SIZE, 4, tid, 60);
+		mbapEncode(adu, tid++, 1, pdu_len);
+		mb::bench::doNotOptimize(adu[0]);
+	}
+	state.setItemsProcessed(state.iterations());
+}
+MB_BENCHMARK(tcpEncodeReadRequest);
+
+static void tcpDecodeReadWords(State& state) {
+	const WORD n = static_cast<WORD>(state.arg());
+	std::vector<WORD> src(n, 0xABCD), dst(n);
+	BYTE adu[MODBUS_MAX_ADU_LENGTH];
+	const size_t pdu_len = pduReadWordsResponse(adu + TCP_HEADER_SIZE, 4, n, src.data());
+	mbapEncode(adu, 1, 1, pdu_len);
+	const size_t len = TCP_HEADER_SIZE + pdu_len;
+	bool ok = true;
+	while (state.keepRunning()) {
+		MbapHeader h;
+		ok &= mbapDecode(adu, len, h) && pduParseWords(adu + TCP_HEADER_SIZE, pdu_len, 4, n, dst.data());
+		mb::bench::doNotOptimize(dst[0]);
+	}
+	if (!ok) state.setLabel("DECODE FAILED");
+	state.setItemsProcessed(state.iterations() * n);
+	state.setBytesProcessed(state.iterations() * len);
+}
+MB_BENCHMARK(tcpDecodeReadWords)->arg(10)->arg(125);
+
+static void rtuDecodeReadBits(State& state) {
+	const WORD n = static_cast<WORD>(state.arg());
+	std::vector<BIT> src(n), dst(n);
+	for (WORD i = 0; i < n; i++) src[i] = i % 3 == 0;
+	BYTE adu[MODBUS_MAX_ADU_LENGTH];
+	adu[0] = 17;
+	const size_t len = rtuFinish(adu, RTU_HEADER_SIZE + pduReadBitsResponse(adu + RTU_HEADER_SIZE, 1, n, src.data()));
+	bool ok = true;
+	while (state.keepRunning()) {
+		ok &= rtuCheck(adu, len) && pduParseBits(adu + RTU_HEADER_SIZE, len - RTU_HEADER_SIZE - RTU_CRC_SIZE, 1, n, dst.data());
+		mb::bench::doNotOptimize(dst[0]);
+	}
+	if (!ok) state.setLabel("DECODE FAILED");
+	state.setItemsProcessed(state.iterations() * n);
+}
+MB_BENCHMARK(rtuDecodeReadBits)->arg(16)->arg(2000);
+
+static void crc16Frame(State& state) {
+	const size_t n = static_cast<size_t>(state.arg());
+	std::vector<BYTE> buf(n);
+	for (size_t i = 0; i < n; i++) buf[i] = static_cast<BYTE>(i * 13);
+	while (state.keepRunning()) {
+		WORD crc = crc16(buf.data(), n);
+		mb::bench::doNotOptimize(crc);
+	}
+	state.setBytesProcessed(state.iterations() * n);
+}
+MB_BENCHMARK(crc16Frame)->arg(8)->arg(256);
+
+static void packUnpackBits(State& state) {
+	const WORD n = static_cast<WORD>(state.arg());
+	std::vector<BIT> bits(n);
+	std::vector<BYTE> packed((n + 7) / 8);
+	for (WORD i = 0; i < n; i++) bits[i] = i % 5 == 0;
+	while (state.keepRunning()) {
+		packBits(bits.data(), n, packed.data());
+		unpackBits(packed.data(), n, bits.data());
+		mb::bench::doNotOptimize(bits[0]);
+	}
+	state.setItemsProcessed(state.iterations() * n);
+}
+MB_BENCHMARK(packUnpackBits)->arg(16)->arg(2000);
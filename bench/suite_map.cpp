@@ -0,0 +1,196 @@
+#include <random>
+#include <vector>
+
+#include "harness.h"
+#include "Map.h"
+
+// Типизированное чтение/запись Map одним и несколькими потоками (одна общая карта на 10000 регистров,
+// адреса - псевдослучайные с фиксированным зерном), блочное чтение/запись как при разборе ответа опроса,
+// чтение/запись битов в BIT_MAP и битов слов в WORD_MAP
+
+using namespace mb::data;
+using mb::bench::State;
+
+constexpr WORD MAP_SIZE = 10000;
+constexpr size_t PROBES = 4096;
+
+static Map& wordMap() {
+	static Map* map = []() {
+		Map* m = new Map();
+		m->initNewMemory(0, MAP_SIZE, MapType::WORD_MAP);
+		for (WORD a = 0; a < MAP_SIZE; a++) m->writeWord(a, static_cast<WORD>(a * 7));
+		return m;
+	}();
+	return *map;
+}
+
+static Map& bitMap() {
+	static Map* map = []() {
+		Map* m = new Map();
+		m->initNewMemory(0, MAP_SIZE, MapType::BIT_MAP);
+		for (WORD a = 0; a < MAP_SIZE; a++) m->writeBit(a, a % 3 == 0);
+		return m;
+	}();
+	return *map;
+}
+
+// Адреса DWORD-значений (четные, с запасом под второе слово)
+static const std::vector<WORD>& probes() {
+	static const std::vector<WORD> adr = []() {
+		std::mt19937 rng(42);
+		std::vector<WORD> v(PROBES);
+		for (WORD& a : v) a = static_cast<WORD>(rng() % (MAP_SIZE / 2 - 1) * 2);
+		return v;
+	}();
+	return adr;
+}
+
+static void mapReadWord(State& state) {
+	Map& map = wordMap();
+	const std::vector<WORD>& adr = probes();
+	size_t i = state.threadIndex() * 997;
+	WORD val;
+	while (state.keepRunning()) {
+		map.readWord(adr[i++ & (PROBES - 1)], &val);
+		mb::bench::doNotOptimize(val);
+	}
+	state.setItemsProcessed(state.iterations());
+}
+MB_BENCHMARK(mapReadWord)->threads(1)->threads(4);
+
+static void mapWriteWord(State& state) {
+	Map& map = wordMap();
+	const std::vector<WORD>& adr = probes();
+	size_t i = state.threadIndex() * 997;
+	while (state.keepRunning()) {
+		map.writeWord(adr[i & (PROBES - 1)], static_cast<WORD>(i));
+		i++;
+	}
+	state.setItemsProcessed(state.iterations());
+}
+MB_BENCHMARK(mapWriteWord)->threads(1)->threads(4);
+
+static void mapReadFloat32(State& state) {
+	Map& map = wordMap();
+	const std::vector<WORD>& adr = probes();
+	size_t i = state.threadIndex() * 997;
+	float val;
+	while (state.keepRunning()) {
+		map.readFloat32(adr[i++ & (PROBES - 1)], &val);
+		mb::bench::doNotOptimize(val);
+	}
+	state.setItemsProcessed(state.iterations());
+}
+MB_BENCHMARK(mapReadFloat32)->threads(1)->threads(4);
+
+static void mapWriteFloat32(State& state) {
+	Map& map = wordMap();
+	const std::vector<WORD>& adr = probes();
+	size_t i = state.threadIndex() * 997;
+	while (state.keepRunning()) {
+		map.writeFloat32(adr[i & (PROBES - 1)], static_cast<float>(i) * 0.5f);
+		i++;
+	}
+	state.setItemsProcessed(state.iterations());
+}
+MB_BENCHMARK(mapWriteFloat32)->threads(1)->threads(4);
+
+static void mapReadInt32(State& state) {
+	Map& map = wordMap();
+	const std::vector<WORD>& adr = probes();
+	size_t i = 0;
+	int32_t val;
+	while (state.keepRunning()) {
+		map.readInt32(adr[i++ & (PROBES - 1)], &val);
+		mb::bench::doNotOptimize(val);
+	}
+	state.setItemsProcessed(state.iterations());
+}
+MB_BENCHMARK(mapReadInt32);
+
+// Блок регистров одного ответа опроса
+static void mapReadWords(State& state) {
+	Map& map = wordMap();
+	const WORD n = static_cast<WORD>(state.arg());
+	std::vector<WORD> vals(n);
+	WORD adr = 0;
+	while (state.keepRunning()) {
+		map.readWords(adr, n, vals.data());
+		mb::bench::doNotOptimize(vals[0]);
+		adr = static_cast<WORD>((adr + n) % (MAP_SIZE - n));
+	}
+	state.setItemsProcessed(state.iterations() * n);
+	state.setBytesProcessed(state.iterations() * n * sizeof(WORD));
+}
+MB_BENCHMARK(mapReadWords)->arg(10)->arg(125);
+
+static void mapWriteWords(State& state) {
+	Map& map = wordMap();
+	const WORD n = static_cast<WORD>(state.arg());
+	std::vector<WORD> vals(n, 0x1234);
+	WORD adr = 0;
+	while (state.keepRunning()) {
+		map.writeWords(adr, n, vals.data());
+		adr = static_cast<WORD>((adr + n) % (MAP_SIZE - n));
+	}
+	state.setItemsProcessed(state.iterations() * n);
+	state.setBytesProcessed(state.iterations() * n * sizeof(WORD));
+}
+MB_BENCHMARK(mapWriteWords)->arg(10)->arg(125);
+
+static void mapReadBits(State& state) {
+	Map& map = bitMap();
+	const WORD n = static_cast<WORD>(state.arg());
+	std::vector<BIT> vals(n);
+	WORD adr = 0;
+	while (state.keepRunning()) {
+		map.readBits(adr, n, vals.data());
+		mb::bench::doNotOptimize(vals[0]);
+		adr = static_cast<WORD>((adr + 13) % (MAP_SIZE - n));
+	}
+	state.setItemsProcessed(state.iterations() * n);
+}
+MB_BENCHMARK(mapReadBits)->arg(16)->arg(2000);
+
+static void mapWriteBits(State& state) {
+	Map& map = bitMap();
+	const WORD n = static_cast<WORD>(state.arg());
+	std::vector<BIT> vals(n);
+	for (WORD i = 0; i < n; i++) vals[i] = i % 5 == 0;
+	WORD adr = 0;
+	while (state.keepRunning()) {
+		map.writeBits(adr, n, vals.data());
+		adr = static_cast<WORD>((adr + 13) % (MAP_SIZE - n));
+	}
+	state.setItemsProcessed(state.iterations() * n);
+}
+MB_BENCHMARK(mapWriteBits)->arg(16)->arg(2000);
+
+// Биты слов WORD_MAP (адрес бита = адрес слова * 16 + номер бита)
+static void mapReadWordBits(State& state) {
+	Map& map = wordMap();
+	const WORD n = static_cast<WORD>(state.arg());
+	std::vector<BIT> vals(n);
+	WORD adr = 0;
+	while (state.keepRunning()) {
+		map.readWordBits(adr, n, vals.data());
+		mb::bench::doNotOptimize(vals[0]);
+		adr = static_cast<WORD>((adr + 16 * 7 + 3) % 32768);
+	}
+	state.setItemsProcessed(state.iterations() * n);
+}
+MB_BENCHMARK(mapReadWordBits)->arg(16)->arg(256);
+
+static void mapWriteWordBits(State& state) {
+	Map& map = wordMap();
+	const WORD n = static_cast<WORD>(state.arg());
+	std::vector<BIT> vals(n);
+	for (WORD i = 0; i < n; i++) vals[i] = i & 1;
+	WORD adr = 0;
+	while (state.keepRunning()) {
+		map.writeWordBits(adr, n, vals.data());
+		adr = static_cast<WORD>((adr + 16 * 7 + 3) % 32768);
+	}
+	state.setItemsProcessed(state.iterations() * n);
+}
+MB_BENCHMARK(mapWriteWordBits)->arg(16)->arg(256);
@@ -0,0 +1,57 @@
+#include <random>
+#include <vector>
+
+#include "harness.h"
+#include "Range.h"
+
+// Нормализация диапазонов всех устройств и функций, как RangeManager::normalizeRanges (ядро - normalizeRangeList):
+// списки по 100 диапазонов тегов длиной 1-20 регистров в адресах 0-9999, четыре класса опроса, порядок случайный
+
+using namespace mb::data;
+using mb::bench::State;
+
+constexpr size_t RANGES_PER_LIST = 100;
+
+static std::vector<std::vector<Range>> makeRanges(size_t count) {
+	static const uint32_t scan_ms[] = { 0, 200, 1000, 5000 };
+	std::mt19937 rng(42);
+	std::vector<std::vector<Range>> lists((count + RANGES_PER_LIST - 1) / RANGES_PER_LIST);
+	for (size_t i = 0; i < count; i++) {
+		uint16_t start = static_cast<uint16_t>(rng() % 10000);
+		uint16_t len = static_cast<uint16_t>(rng() % 20);
+		lists[i / RANGES_PER_LIST].emplace_back(start, static_cast<uint16_t>(start + len), scan_ms[rng() % 4]);
+	}
+	return lists;
+}
+
+static size_t totalSize(const std::vector<std::vector<Range>>& lists) {
+	size_t n = 0;
+	for (const std::vector<Range>& l : lists) n += l.size();
+	return n;
+}
+
+static void normalizeRanges(State& state) {
+	const std::vector<std::vector<Range>> source = makeRanges(static_cast<size_t>(state.arg()));
+	std::vector<std::vector<Range>> lists;
+	while (state.keepRunning()) {
+		state.pauseTiming();
+		lists = source;
+		state.resumeTiming();
+		for (std::vector<Range>& l : lists) normalizeRangeList(l);
+	}
+	state.setItemsProcessed(state.iterations() * totalSize(source));
+	state.setLabel(std::to_string(totalSize(lists)) + " ranges after merge");
+}
+MB_BENCHMARK(normalizeRanges)->arg(10000)->arg(100000);
+
+// Повторная нормализация уже нормализованных списков (горячая перезагрузка без изменений)
+static void normalizeRangesSorted(State& state) {
+	std::vector<std::vector<Range>> lists = makeRanges(static_cast<size_t>(state.arg()));
+	for (std::vector<Range>& l : lists) normalizeRangeList(l);
+	while (state.keepRunning()) {
+		for (std::vector<Range>& l : lists) normalizeRangeList(l);
+		mb::bench::doNotOptimize(lists.data());
+	}
+	state.setItemsProcessed(state.iterations() * totalSize(lists));
+}
+MB_BENCHMARK(normalizeRangesSorted)->arg(10000)->arg(100000);
@@ -0,0 +1,185 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "TagHistory.h"
+
+// История 50k тегов: опрос раз в секунду с дрожанием времени 0-3 мс, значения четырех видов -
+// постоянные (состояния), счетчики, плавные float32 (синус) и шум float32.
+// Выводятся память на тег, байт на значение, глубина истории, время append, запроса интервала и прореживания.
+// Проверка: у каждого 97-го тега запросы сверяются с записанными значениями (побитно) и прореживанием по ним.
+// Запуск: bench_tag_history [тегов, 50000] [циклов опроса, 1000] [байт в блоке, 256] [блоков на тег, 4]
+
+using namespace mb::data;
+
+constexpr uint64_t PERIOD_MS = 1000;
+constexpr size_t CHECK_STEP = 97;
+constexpr int QUERIES = 20000;
+
+static double nowSec() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double tagValue(size_t tag, uint64_t cycle, std::mt19937& rng) {
+	switch (tag % 4) {
+		case 0: return static_cast<double>((tag / 4) % 3);
+		case 1: return static_cast<double>(tag * 10 + cycle * (tag % 7));
+		case 2: return static_cast<float>(220.0 + 5.0 * std::sin((cycle + tag) * 0.01));
+		default: return static_cast<float>(50.0 + (rng() % 10000) / 1000.0);
+	}
+}
+
+static bool sameBits(double a, double b) {
+	return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// Запрос всей истории - хвост записанных значений, прореживание - по ним же
+static bool checkTag(const TagHistory& history, TagHandle handle, const std::vector<TagSample>& written, std::mt19937& rng) {
+	std::vector<TagSample> got;
+	const size_t n = history.query(handle, 0, UINT64_MAX, got);
+	bool ok = n == got.size() && n == history.getSampleCount(handle) && n > 0 && n <= written.size();
+	const size_t skip = written.size() - n;
+	for (size_t i = 0; i < n && ok; i++) ok = got[i].ts == written[skip + i].ts && sameBits(got[i].value, written[skip + i].value);
+
+	TagSample last;
+	ok = ok && history.last(handle, &last) && last.ts == written.back().ts && sameBits(last.value, written.back().value);
+
+	// Случайный интервал и случайный шаг прореживания
+	const uint64_t first = written[skip].ts, end = written.back().ts;
+	const uint64_t from = first + rng() % (end - first + 1);
+	const uint64_t to = from + rng() % (end - from + 1);
+	got.clear();
+	const size_t m = history.query(handle, from, to, got);
+	size_t expect = 0;
+	for (size_t i = skip; i < written.size(); i++) expect += written[i].ts >= from && written[i].ts <= to;
+	ok = ok && m == expect;
+
+	const uint64_t bucket = 1 + rng() % 120000;
+	std::vector<TagBucket> buckets;
+	const size_t b = history.queryBuckets(handle, from, to, bucket, buckets);
+	ok = ok && b == (to - from) / bucket + 1;
+	for (size_t k = 0; k < b && ok; k++) {
+		const TagBucket& t = buckets[k];
+		uint32_t count = 0;
+		double mn = 0, mx = 0, sum = 0;
+		for (size_t i = skip; i < written.size(); i++) {
+			if (written[i].ts < t.start || written[i].ts >= t.start + bucket || written[i].ts > to) continue;
+			const double v = written[i].value;
+			mn = count ? std::min(mn, v) : v;
+			mx = count ? std::max(mx, v) : v;
+			sum += v;
+			count++;
+		}
+		const double avg = count ? sum / count : 0;
+		ok = t.start == from + k * bucket && t.count == count && t.min == mn && t.max == mx && std::fabs(t.avg - avg) <= 1e-9 * std::max(1.0, std::fabs(avg));
+	}
+	return ok;
+}
+
+// Граничные случаи на маленькой истории
+static bool checkEdges() {
+	TagHistory h;
+	bool ok = !h.init(0) && !h.init(1, 30) && !h.init(1, 256, 1) && h.init(2, 32, 2);
+	TagSample s;
+	std::vector<TagSample> out;
+	ok = ok && !h.last(0, &s) && h.query(0, 0, UINT64_MAX, out) == 0 && !h.append(2, 0, 1.0);
+	ok = ok && h.append(0, 1000, 1.5) && !h.append(0, 999, 1.0) && h.append(0, 1000, NAN) && h.append(0, 1000 + (1ull << 40), -0.0);
+	ok = ok && h.query(0, 0, UINT64_MAX, out) == 3 && std::isnan(out[1].value) && std::signbit(out[2].value) && out[2].ts == 1000 + (1ull << 40);
+	std::vector<TagBucket> b;
+	ok = ok && h.queryBuckets(0, 1000, 1000, 1, b) == 1 && b[0].count == 1 && b[0].avg == 1.5;
+	ok = ok && h.queryBuckets(0, 0, UINT64_MAX, 1, b) == 0 && h.queryBuckets(0, 10, 5, 1, b) == 0;
+	// Переполнение кольца: остаются последние значения
+	for (int i = 0; i < 1000; i++) ok = h.append(1, i * 10, i * 0.25) && ok;
+	out.clear();
+	const size_t n = h.query(1, 0, UINT64_MAX, out);
+	ok = ok && n > 0 && n < 1000 && out.back().ts == 9990 && out.back().value == 999 * 0.25 && out.front().value == (1000 - n) * 0.25;
+	h.clear();
+	return ok && h.getSampleCount(1) == 0 && !h.last(1, &s);
+}
+
+int main(int argc, char* argv[]) {
+	const size_t tags = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50000;
+	const uint64_t cycles = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000;
+	const size_t block_bytes = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 256;
+	const size_t blocks = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 4;
+	TagHistory history;
+	if (cycles < 2 || !history.init(tags, block_bytes, blocks)) {
+		std::cerr << "Usage: " << argv[0] << " [tags] [cycles] [block bytes] [blocks per tag]" << std::endl;
+		return 2;
+	}
+	std::cout << std::fixed << std::setprecision(1);
+
+	// Заполнение как после декодирования цикла опроса: все теги за цикл, время цикла с дрожанием
+	std::mt19937 rng(1);
+	std::vector<std::vector<TagSample>> written((tags + CHECK_STEP - 1) / CHECK_STEP);
+	// Первая половина циклов - append по одному тегу, вторая - массивом значений цикла
+	std::vector<double> values(tags);
+	bool ok = true;
+	double single_s = 0, batch_s = 0;
+	for (uint64_t c = 0; c < cycles; c++) {
+		const uint64_t ts = 1700000000000ull + c * PERIOD_MS + rng() % 4;
+		for (size_t tag = 0; tag < tags; tag++) {
+			values[tag] = tagValue(tag, c, rng);
+			if (tag % CHECK_STEP == 0) written[tag / CHECK_STEP].push_back(TagSample{ ts, values[tag] });
+		}
+		const double t0 = nowSec();
+		if (c < cycles / 2) {
+			for (size_t tag = 0; tag < tags; tag++) ok = history.append(static_cast<TagHandle>(tag), ts, values[tag]) && ok;
+			single_s += nowSec() - t0;
+		}
+		else {
+			ok = history.append(0, tags, ts, values.data()) == tags && ok;
+			batch_s += nowSec() - t0;
+		}
+	}
+	const double single_ns = single_s * 1e9 / (cycles / 2 * tags);
+	const double batch_ns = batch_s * 1e9 / ((cycles - cycles / 2) * tags);
+
+	size_t samples = 0;
+	for (size_t tag = 0; tag < tags; tag++) samples += history.getSampleCount(static_cast<TagHandle>(tag));
+	const double per_tag = static_cast<double>(history.getMemorySize()) / tags;
+	std::cout << tags << " tags, " << cycles << " cycles, blocks " << blocks << " x " << block_bytes << " bytes" << std::endl;
+	std::cout << "memory " << history.getMemorySize() / (1024.0 * 1024.0) << " MiB, " << per_tag << " bytes/tag, "
+				 << std::setprecision(2) << history.getMemorySize() / static_cast<double>(samples) << " bytes/sample (raw 16), "
+				 << std::setprecision(1) << static_cast<double>(samples) / tags << " samples/tag retained" << std::endl;
+	std::cout << "append ns/tag: single " << single_ns << ", cycle array " << batch_ns << std::endl;
+
+	// Запросы по случайным тегам: последние 60 с, вся история, прореживание всей истории до 10 интервалов
+	const uint64_t end = 1700000000000ull + (cycles - 1) * PERIOD_MS + 3;
+	std::vector<TagSample> out;
+	std::vector<TagBucket> buckets;
+	out.reserve(1 << 16);
+	buckets.reserve(1 << 10);
+	size_t total = 0;
+	double t = nowSec();
+	for (int i = 0; i < QUERIES; i++) {
+		out.clear();
+		total += history.query(static_cast<TagHandle>(rng() % tags), end - 60 * PERIOD_MS, end, out);
+	}
+	const double recent_us = (nowSec() - t) * 1e6 / QUERIES;
+	t = nowSec();
+	for (int i = 0; i < QUERIES; i++) {
+		out.clear();
+		total += history.query(static_cast<TagHandle>(rng() % tags), 0, end, out);
+	}
+	const double full_us = (nowSec() - t) * 1e6 / QUERIES;
+	t = nowSec();
+	for (int i = 0; i < QUERIES; i++) {
+		buckets.clear();
+		const uint64_t from = end - cycles * PERIOD_MS;
+		total += history.queryBuckets(static_cast<TagHandle>(rng() % tags), from, end, (end - from) / 10 + 1, buckets);
+	}
+	const double buckets_us = (nowSec() - t) * 1e6 / QUERIES;
+	volatile size_t sink = total;
+	(void)sink;
+	std::cout << "query us: last 60 s " << std::setprecision(2) << recent_us << ", full history " << full_us << ", 10 buckets " << buckets_us << std::endl;
+
+	for (size_t k = 0; k < written.size() && ok; k++) ok = checkTag(history, static_cast<TagHandle>(k * CHECK_STEP), written[k], rng);
+	ok = checkEdges() && ok;
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <forward_list>
+#include <random>
+#include <chrono>
+
+#include "TagIndex.h"
+
+// Поиск тега по имени и по адресу на 50k тегах: линейный проход по forward_list (как в RegManager)
+// против TagIndex. Теги - 10 устройств x 2 функции, часть тегов DWORD.
+// Запуск: bench_tag_index [количество тегов, по умолчанию 50000]
+
+using namespace mb::data;
+
+struct Tag {
+	std::string name;
+	int slave_id;
+	int func;
+	int address;
+	int width;
+};
+
+constexpr int LOOKUPS = 200000;
+
+template <typename F>
+static double nsPerOp(F f, int ops) {
+	auto t0 = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / ops;
+}
+
+int main(int argc, char* argv[]) {
+	int count = argc > 1 ? std::atoi(argv[1]) : 50000;
+	const int groups = 20;
+	const int per_group = (count + groups - 1) / groups;
+
+	std::forward_list<Tag> list;
+	std::vector<const Tag*> handles;
+	TagIndex index;
+	// Добавление в обратном порядке адресов, как emplace_front в RegManager
+	for (int n = count - 1; n >= 0; n--) {
+		int group = n / per_group;
+		int i = n % per_group;
+		list.push_front(Tag{ "plant.area" + std::to_string(group) + ".tag_" + std::to_string(n), group / 2 + 1, group % 2 ? 4 : 3, i * 2, n % 3 == 0 ? 2 : 1 });
+		const Tag& t = list.front();
+		index.add(t.name, t.slave_id, t.func, static_cast<uint16_t>(t.address), static_cast<uint8_t>(t.width), static_cast<TagHandle>(handles.size()));
+		handles.push_back(&t);
+	}
+
+	std::mt19937 rng(1);
+	std::vector<const Tag*> probes;
+	for (int i = 0; i < LOOKUPS; i++) probes.push_back(handles[rng() % handles.size()]);
+	const int linear_ops = LOOKUPS / 100;
+
+	size_t hits = 0;
+	double linear_name = nsPerOp([&]() {
+		for (int i = 0; i < linear_ops; i++) {
+			for (const Tag& t : list) {
+				if (t.name == probes[i]->name) {
+					++hits;
+					break;
+				}
+			}
+		}
+	}, linear_ops);
+	double index_name = nsPerOp([&]() {
+		for (int i = 0; i < LOOKUPS; i++) hits += handles[index.findByName(probes[i]->name)] == probes[i];
+	}, LOOKUPS);
+
+	std::vector<TagHandle> found;
+	double linear_adr = nsPerOp([&]() {
+		for (int i = 0; i < linear_ops; i++) {
+			const Tag* p = probes[i];
+			for (const Tag& t : list) {
+				if (t.slave_id == p->slave_id && t.func == p->func && t.address <= p->address && t.address + t.width > p->address) ++hits;
+			}
+		}
+	}, linear_ops);
+	double index_adr = nsPerOp([&]() {
+		for (int i = 0; i < LOOKUPS; i++) {
+			const Tag* p = probes[i];
+			found.clear();
+			hits += index.findByAddress(p->slave_id, p->func, static_cast<uint16_t>(p->address), found);
+		}
+	}, LOOKUPS);
+
+	// Проверка: DWORD находится и по второму адресу, несуществующее имя не находится
+	bool ok = index.findByName("no.such.tag") == INVALID_TAG_HANDLE;
+	for (const Tag* t : handles) {
+		if (t->width != 2) continue;
+		found.clear();
+		index.findByAddress(t->slave_id, t->func, static_cast<uint16_t>(t->address + 1), found);
+		ok = ok && found.size() == 1 && handles[found[0]] == t;
+		break;
+	}
+
+	std::cout << count << " tags, hits " << hits << ", self-check " << (ok ? "ok" : "FAILED") << std::endl;
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "by name:    linear " << std::setw(12) << linear_name << " ns, index " << std::setw(8) << index_name << " ns" << std::endl;
+	std::cout << "by address: linear " << std::setw(12) << linear_adr << " ns, index " << std::setw(8) << index_adr << " ns" << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Simulator.h"
+#include "ModbusMaster.h"
+#include "ModbusFrame.h"
+#include "RtuTcpTransport.h"
+#include "TcpTransport.h"
+#include "UdpTransport.h"
+
+// Транспорты RTU поверх TCP и Modbus UDP против симулятора на loopback:
+// - запрос-ответ ModbusMaster через Modbus TCP, RTU поверх TCP и UDP: запросов в секунду
+// - RTU поверх TCP: ошибка CRC, молчание отсутствующего устройства, опоздавший ответ не мешает следующему запросу
+// - UDP: 16 шлюзов x 16 устройств, опрос всех устройств по одному запросу (transact) против пакета
+//   transactBatch (sendmmsg/recvmmsg): время опроса и системных вызовов на устройство
+// - UDP: неответы и опоздавшие ответы в пакете - таймауты только у них, данные остальных верны
+// Проверка: каждое устройство отдает свои значения (номер шлюза и устройства), ошибки распознаются.
+// Запуск: bench_transports [опросов всех устройств, по умолчанию 200]
+
+using namespace mb;
+using namespace mb::modbus;
+
+constexpr int GATEWAYS = 16;
+constexpr int SLAVES = 16;
+constexpr WORD WORDS = 10;
+constexpr double RUN_SEC = 1.0;
+
+static double nowSec() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static WORD valueOf(int endpoint, int slave, WORD adr) {
+	return static_cast<WORD>(endpoint * 1000 + slave * 10 + adr);
+}
+
+// Значения регистров хранения [0, WORDS) - номер точки и устройства
+static void fillSlaves(Simulator& sim, int endpoint, int slaves) {
+	sim.addSlaves(endpoint, 1, slaves, SimLayout());
+	for (int s = 1; s <= slaves; s++) {
+		WORD vals[WORDS];
+		for (WORD a = 0; a < WORDS; a++) vals[a] = valueOf(endpoint, s, a);
+		sim.getMap(endpoint, s, SlaveTable::HOLDING_REGISTERS)->writeWords(0, WORDS, vals);
+	}
+}
+
+static bool checkWords(int endpoint, int slave, const WORD* vals) {
+	for (WORD a = 0; a < WORDS; a++) {
+		if (vals[a] != valueOf(endpoint, slave, a)) return false;
+	}
+	return true;
+}
+
+// Запрос-ответ через один транспорт в течение RUN_SEC
+static bool requestRate(Transport& transport, int endpoint, const char* name) {
+	ModbusMaster master(&transport);
+	master.setTimeout(1000);
+	WORD vals[WORDS];
+	uint64_t ok = 0, bad = 0;
+	const double start = nowSec();
+	for (int i = 0; nowSec() - start < RUN_SEC; i++) {
+		const int slave = 1 + i % SLAVES;
+		if (master.readWords(slave, 3, 0, WORDS, vals) == MbStatus::OK && checkWords(endpoint, slave, vals)) ++ok;
+		else ++bad;
+	}
+	std::cout << std::left << std::setw(14) << name << std::right << static_cast<uint64_t>(ok / (nowSec() - start)) << " req/s, bad " << bad << std::endl;
+	return ok > 0 && bad == 0;
+}
+
+// RTU поверх TCP: CRC, отсутствующее устройство, опоздавший ответ
+static bool rtuTcpErrors() {
+	Simulator sim;
+	const int ep = sim.addRtuTcp("127.0.0.1", 0);
+	fillSlaves(sim, ep, 2);
+	FaultModel f;
+	f.corrupt_rate = 1;
+	const int bad_ep = sim.addRtuTcp("127.0.0.1", 0);
+	fillSlaves(sim, bad_ep, 1);
+	sim.setFaults(bad_ep, f);
+	LatencyModel slow;
+	slow.kind = SimLatency::FIXED;
+	slow.a_ms = 30;
+	const int slow_ep = sim.addRtuTcp("127.0.0.1", 0);
+	fillSlaves(sim, slow_ep, 1);
+	sim.setLatency(slow_ep, slow);
+	if (!sim.start()) return false;
+
+	WORD vals[WORDS];
+	RtuTcpTransport rtu("127.0.0.1", sim.getPort(ep));
+	ModbusMaster master(&rtu);
+	master.setTimeout(20);
+	const MbStatus missing = master.readWords(9, 3, 0, WORDS, vals);
+	bool ok = missing == MbStatus::TIMEOUT && master.readWords(2, 3, 0, WORDS, vals) == MbStatus::OK && checkWords(ep, 2, vals);
+
+	RtuTcpTransport bad("127.0.0.1", sim.getPort(bad_ep));
+	ModbusMaster bad_master(&bad);
+	bad_master.setTimeout(200);
+	const MbStatus crc = bad_master.readWords(1, 3, 0, WORDS, vals);
+	ok = ok && crc == MbStatus::CRC_ERROR;
+
+	// Ответ приходит после таймаута и остается в соединении: следующий запрос его отбрасывает
+	RtuTcpTransport late("127.0.0.1", sim.getPort(slow_ep));
+	ModbusMaster late_master(&late);
+	late_master.setTimeout(10);
+	const MbStatus first = late_master.readWords(1, 3, 0, WORDS, vals);
+	std::this_thread::sleep_for(std::chrono::milliseconds(40));
+	late_master.setTimeout(200);
+	const MbStatus second = late_master.readWords(1, 3, 0, 2, vals);
+	ok = ok && first == MbStatus::TIMEOUT && second == MbStatus::OK && vals[0] == valueOf(slow_ep, 1, 0) && vals[1] == valueOf(slow_ep, 1, 1);
+
+	std::cout << "rtu+tcp errors: missing slave " << mbStatusToString(missing) << ", corrupt " << mbStatusToString(crc) << ", late response "
+				 << mbStatusToString(first) << " then " << mbStatusToString(second) << std::endl;
+	return ok;
+}
+
+// Опрос всех устройств всех шлюзов пакетами, проверка ответов. Возвращает количество верных ответов
+static size_t pollBatch(UdpTransport& udp, const std::vector<sockaddr_in>& peers, std::vector<UdpRequest>& reqs, uint32_t timeout_ms, size_t& wrong) {
+	const size_t total = peers.size() * SLAVES;
+	size_t good = 0;
+	for (size_t first = 0; first < total; first += udp.getBatchSize()) {
+		const size_t n = std::min(udp.getBatchSize(), total - first);
+		for (size_t i = 0; i < n; i++) {
+			const size_t dev = first + i;
+			reqs[i].peer = peers[dev / SLAVES];
+			reqs[i].slave_id = static_cast<BYTE>(1 + dev % SLAVES);
+			reqs[i].pdu_len = pduReadRequest(udp.batchPdu(i), 3, 0, WORDS);
+		}
+		udp.transactBatch(reqs.data(), n, timeout_ms);
+		for (size_t i = 0; i < n; i++) {
+			const size_t dev = first + i;
+			WORD vals[WORDS];
+			if (reqs[i].status != MbStatus::OK) continue;
+			if (pduParseWords(reqs[i].resp_pdu, reqs[i].resp_len, 3, WORDS, vals) && checkWords(static_cast<int>(dev / SLAVES), static_cast<int>(1 + dev % SLAVES), vals)) good++;
+			else wrong++;
+		}
+	}
+	return good;
+}
+
+static bool udpBatch(int cycles) {
+	Simulator sim;
+	std::vector<sockaddr_in> peers(GATEWAYS);
+	for (int g = 0; g < GATEWAYS; g++) {
+		const int ep = sim.addUdp("127.0.0.1", 0);
+		fillSlaves(sim, ep, SLAVES);
+		UdpTransport::resolve("127.0.0.1", sim.getPort(ep), peers[g]);
+	}
+	if (!sim.start()) return false;
+	const size_t devices = GATEWAYS * SLAVES;
+
+	// По одному запросу: транспорт на шлюз, как TCP
+	std::vector<std::unique_ptr<UdpTransport>> lines;
+	uint64_t one_calls = 0;
+	size_t one_good = 0;
+	for (int g = 0; g < GATEWAYS; g++) lines.emplace_back(new UdpTransport("127.0.0.1", sim.getPort(g)));
+	double t = nowSec();
+	for (int c = 0; c < cycles; c++) {
+		for (int g = 0; g < GATEWAYS; g++) {
+			ModbusMaster master(lines[g].get());
+			master.setTimeout(200);
+			for (int s = 1; s <= SLAVES; s++) {
+				WORD vals[WORDS];
+				one_good += master.readWords(s, 3, 0, WORDS, vals) == MbStatus::OK && checkWords(g, s, vals);
+			}
+		}
+	}
+	const double one_sec = nowSec() - t;
+	for (auto& line : lines) one_calls += line->getSyscalls();
+
+	// Пакеты: все устройства одним сокетом
+	UdpTransport udp("127.0.0.1", 0, devices);
+	std::vector<UdpRequest> reqs(devices);
+	size_t batch_good = 0, wrong = 0;
+	t = nowSec();
+	for (int c = 0; c < cycles; c++) batch_good += pollBatch(udp, peers, reqs, 200, wrong);
+	const double batch_sec = nowSec() - t;
+
+	const double polls = static_cast<double>(cycles) * devices;
+	std::cout << "udp " << GATEWAYS << " gateways x " << SLAVES << " slaves, " << cycles << " cycles:" << std::endl;
+	std::cout << "  transact:      " << one_sec * 1e6 / polls << " us/device, " << std::setprecision(3) << one_calls / polls << std::setprecision(1) << " syscalls/device, ok " << one_good << std::endl;
+	std::cout << "  transactBatch: " << batch_sec * 1e6 / polls << " us/device, " << std::setprecision(3) << udp.getSyscalls() / polls << std::setprecision(1) << " syscalls/device, ok " << batch_good
+				 << " (x" << std::setprecision(2) << one_sec / batch_sec << std::setprecision(1) << ")" << std::endl;
+	return one_good == polls && batch_good == polls && wrong == 0;
+}
+
+// Пакет с неответами на одном шлюзе и опоздавшими ответами на другом
+static bool udpFaults() {
+	Simulator sim;
+	std::vector<sockaddr_in> peers(4);
+	for (int g = 0; g < 4; g++) {
+		const int ep = sim.addUdp("127.0.0.1", 0);
+		fillSlaves(sim, ep, SLAVES);
+		UdpTransport::resolve("127.0.0.1", sim.getPort(ep), peers[g]);
+	}
+	FaultModel f;
+	f.no_response_rate = 0.25;
+	sim.setFaults(1, f);
+	LatencyModel slow;
+	slow.kind = SimLatency::FIXED;
+	slow.a_ms = 30;
+	sim.setLatency(2, slow);
+	if (!sim.start()) return false;
+
+	UdpTransport udp("127.0.0.1", 0, 4 * SLAVES);
+	std::vector<UdpRequest> reqs(4 * SLAVES);
+	size_t wrong = 0, good = 0, lost = 0, late = 0;
+	for (int c = 0; c < 20; c++) {
+		good += pollBatch(udp, peers, reqs, 10, wrong);
+		for (int i = 0; i < 4 * SLAVES; i++) {
+			if (reqs[i].status != MbStatus::TIMEOUT) continue;
+			if (i / SLAVES == 1) lost++;
+			else if (i / SLAVES == 2) late++;
+			else wrong++;	// Исправные шлюзы обязаны ответить
+		}
+	}
+	std::cout << "udp faults, 20 batches: ok " << good << ", no response " << lost << " (25% of 320), late " << late << " (320), wrong " << wrong << std::endl;
+	return wrong == 0 && late == 20 * SLAVES && lost > 40 && lost < 130 && good == 20 * 2 * SLAVES + (20 * SLAVES - lost);
+}
+
+int main(int argc, char* argv[]) {
+	const int cycles = argc > 1 ? std::atoi(argv[1]) : 200;
+	std::cout << std::fixed << std::setprecision(1);
+
+	Simulator sim;
+	const int tcp_ep = sim.addTcp("127.0.0.1", 0);
+	const int rtu_ep = sim.addRtuTcp("127.0.0.1", 0);
+	const int udp_ep = sim.addUdp("127.0.0.1", 0);
+	for (int ep : { tcp_ep, rtu_ep, udp_ep }) fillSlaves(sim, ep, SLAVES);
+	bool ok = sim.start();
+
+	TcpTransport tcp("127.0.0.1", sim.getPort(tcp_ep));
+	RtuTcpTransport rtu("127.0.0.1", sim.getPort(rtu_ep));
+	UdpTransport udp("127.0.0.1", sim.getPort(udp_ep));
+	ok = requestRate(tcp, tcp_ep, "tcp") && ok;
+	ok = requestRate(rtu, rtu_ep, "rtu+tcp") && ok;
+	ok = requestRate(udp, udp_ep, "udp") && ok;
+	sim.stop();
+
+	ok = rtuTcpErrors() && ok;
+	ok = udpBatch(cycles) && ok;
+	ok = udpFaults() && ok;
+
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Map.h"
+#include "WordKernels.h"
+
+// Чтение блока счетчика электроэнергии: 60 значений float32 подряд (120 регистров)
+// - 60 вызовов readFloat32: 60 захватов мьютекса и 60 проверок границ
+// - один вызов readFloat32Array для каждой реализации перестановки и каждого порядка регистров
+// Проверка: массивы совпадают с одиночными чтениями и записями во всех порядках, на четных и нечетных адресах,
+// раскладка 1.0f по регистрам соответствует AB CD / CD AB / BA DC / DC BA.
+// Запуск: bench_typed_array [seed]
+
+using namespace mb::data;
+
+constexpr WORD START = 1000;
+constexpr WORD WORDS = 400;
+constexpr WORD METER_VALUES = 60;
+constexpr int BLOCKS = 200000;
+
+static const MemMode MODES[] = { MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE, MemMode::BIG_ENDIAN_MODE, MemMode::LITTLE_ENDIAN_MODE, MemMode::BIG_ENDIAN_BYTE_SWAP_MODE };
+static const char* MODE_NAMES[] = { "CD_AB", "AB_CD", "DC_BA", "BA_DC" };
+
+static double nowSec() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename Fn>
+static double blockNs(Fn fn) {
+	const double t = nowSec();
+	for (int i = 0; i < BLOCKS; i++) fn(i);
+	return (nowSec() - t) * 1e9 / BLOCKS;
+}
+
+// Регистры 1.0f (0x3F80 0000) в каждом порядке
+static bool checkLayout() {
+	const WORD expect[4][2] = { { 0x0000, 0x3F80 }, { 0x3F80, 0x0000 }, { 0x0000, 0x803F }, { 0x803F, 0x0000 } };
+	Map m;
+	if (!m.initNewMemory(0, 8, MapType::WORD_MAP)) return false;
+	bool ok = true;
+	for (int k = 0; k < 4; k++) {
+		const float one[2] = { 1.0f, 1.0f };
+		WORD words[4] = {};
+		float back[2] = {}, single = 0;
+		ok = ok && m.writeFloat32Array(1, 2, one, MODES[k]) && m.readWords(1, 4, words);
+		ok = ok && words[0] == expect[k][0] && words[1] == expect[k][1] && words[2] == expect[k][0] && words[3] == expect[k][1];
+		ok = ok && m.readFloat32Array(1, 2, back, MODES[k]) && back[0] == 1.0f && back[1] == 1.0f;
+		ok = ok && m.readFloat32(3, &single, MODES[k]) && single == 1.0f;
+	}
+	return ok;
+}
+
+// Массивы против одиночных методов на случайных словах, всех длинах до 130 и сдвигах
+static bool checkArrays(std::mt19937& rng) {
+	Map m;
+	if (!m.initNewMemory(START, WORDS, MapType::WORD_MAP)) return false;
+	std::vector<WORD> words(WORDS);
+	bool ok = true;
+	for (int k = 0; k < 4 && ok; k++) {
+		const MemMode mode = MODES[k];
+		for (WORD count = 1; count <= 130 && ok; count++) {
+			for (WORD& w : words) w = static_cast<WORD>(rng());
+			m.writeWords(START, WORDS, words.data());
+			const WORD adr = static_cast<WORD>(START + rng() % (WORDS - 2 * count + 1));
+
+			std::vector<uint32_t> u(count);
+			std::vector<int32_t> s(count);
+			std::vector<float> f(count), f16(count);
+			ok = m.readUInt32Array(adr, count, u.data(), mode) && m.readInt32Array(adr, count, s.data(), mode)
+				 && m.readFloat32Array(adr, count, f.data(), mode) && m.readFloat16Array(adr, count, f16.data(), 2, mode);
+			for (WORD i = 0; i < count && ok; i++) {
+				uint32_t u1 = 0;
+				int32_t s1 = 0;
+				float f1 = 0, h1 = 0;
+				ok = m.readUInt32(adr + 2 * i, &u1, mode) && m.readInt32(adr + 2 * i, &s1, mode) && m.readFloat32(adr + 2 * i, &f1, mode)
+					 && m.readFloat16(adr + i, &h1, 2, mode);
+				ok = ok && u1 == u[i] && s1 == s[i] && memcmp(&f1, &f[i], sizeof(float)) == 0 && h1 == f16[i];
+			}
+
+			// Запись массива и чтение одиночными методами, соседние слова не меняются
+			for (uint32_t& v : u) v = rng();
+			ok = ok && m.writeUInt32Array(adr, count, u.data(), mode);
+			for (WORD i = 0; i < count && ok; i++) {
+				uint32_t u1 = 0;
+				ok = m.readUInt32(adr + 2 * i, &u1, mode) && u1 == u[i];
+			}
+			WORD before = 0, after = 0;
+			if (adr > START) ok = ok && m.readWord(adr - 1, &before) && before == words[adr - 1 - START];
+			if (adr + 2 * count < START + WORDS) ok = ok && m.readWord(adr + 2 * count, &after) && after == words[adr + 2 * count - START];
+
+			for (WORD i = 0; i < count; i++) f16[i] = static_cast<float>(static_cast<int16_t>(rng())) / 100;
+			ok = ok && m.writeFloat16Array(adr, count, f16.data(), 2, mode);
+			for (WORD i = 0; i < count && ok; i++) {
+				float h1 = 0;
+				float expect = 0;
+				Map one;
+				ok = one.initNewMemory(0, 1, MapType::WORD_MAP) && one.writeFloat16(0, f16[i], 2, mode) && one.readFloat16(0, &expect, 2, mode);
+				ok = ok && m.readFloat16(adr + i, &h1, 2, mode) && h1 == expect;
+			}
+		}
+	}
+	// Границы: последнее значение карты и выход за карту
+	float f2[2];
+	ok = ok && m.readFloat32Array(START + WORDS - 4, 2, f2) && !m.readFloat32Array(START + WORDS - 3, 2, f2)
+		 && !m.readFloat32Array(START - 1, 1, f2) && !m.readFloat32Array(START, 0, f2);
+	return ok;
+}
+
+int main(int argc, char* argv[]) {
+	const unsigned seed = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 1;
+	std::mt19937 rng(seed);
+	std::cout << std::fixed << std::setprecision(1);
+
+	Map m;
+	m.initNewMemory(START, WORDS, MapType::WORD_MAP);
+	std::vector<float> values(WORDS / 2);
+	for (size_t i = 0; i < values.size(); i++) values[i] = static_cast<float>(i) * 0.5f + 220.0f;
+	m.writeFloat32Array(START, static_cast<WORD>(values.size()), values.data());
+
+	float out[METER_VALUES];
+	volatile float sink = 0;
+	const double single_ns = blockNs([&](int i) {
+		const WORD adr = static_cast<WORD>(START + 2 * (i % 16));
+		for (WORD k = 0; k < METER_VALUES; k++) m.readFloat32(adr + 2 * k, &out[k]);
+		sink = sink + out[i % METER_VALUES];
+	});
+	std::cout << METER_VALUES << " x readFloat32: " << single_ns << " ns per block" << std::endl;
+
+	bool ok = true;
+	const WordKernel kernels[] = { WordKernel::SCALAR, WordKernel::SSSE3, WordKernel::AVX2 };
+	for (WordKernel k : kernels) {
+		if (!setWordKernel(k)) {
+			std::cout << std::setw(7) << wordKernelName(k) << ": not supported" << std::endl;
+			continue;
+		}
+		std::cout << std::setw(7) << wordKernelName(k) << ":";
+		for (int mode = 0; mode < 4; mode++) {
+			const double ns = blockNs([&](int i) {
+				m.readFloat32Array(static_cast<WORD>(START + 2 * (i % 16)), METER_VALUES, out, MODES[mode]);
+				sink = sink + out[i % METER_VALUES];
+			});
+			std::cout << " " << MODE_NAMES[mode] << " " << ns << " ns (x" << single_ns / ns << ")";
+		}
+		const bool checked = checkLayout() && checkArrays(rng);
+		ok = ok && checked;
+		std::cout << (checked ? "" : " MISMATCH") << std::endl;
+	}
+
+	setWordKernel(WordKernel::AUTO);
+	std::cout << "auto kernel: " << wordKernelName(getWordKernel()) << std::endl;
+	std::cout << "self-check: " << (ok ? "ok" : "FAIL") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "Gateway.h"
+#include "RtuTransport.h"
+#include "TcpTransport.h"
+#include "SlaveHandler.h"
+#include "ModbusFrame.h"
+
+// Шлюз Modbus TCP -> RTU поверх псевдотерминала.
+// Поток-симулятор отвечает на запросы RTU за устройство 1 с задержкой линии,
+// несколько клиентов TCP одновременно опрашивают одни и те же регистры через шлюз.
+// Запуск: use_gateway [количество клиентов, по умолчанию 8] [файл трассировки кадров линии RTU]
+
+using namespace mb;
+using namespace mb::modbus;
+
+constexpr int SIM_SLAVE = 1;
+constexpr int DEAD_SLAVE = 9;
+constexpr WORD REGS = 100;
+constexpr int LINE_DELAY_MS = 5;		// Время передачи запроса и ответа на 19200
+constexpr int READS_PER_CLIENT = 200;
+
+// Симулятор устройства RTU на ведущей стороне псевдотерминала
+static void simulate(int fd, SlaveHandler* handler, std::atomic<bool>* running) {
+	BYTE rx[MODBUS_MAX_ADU_LENGTH];
+	BYTE tx[MODBUS_MAX_ADU_LENGTH];
+	size_t have = 0;
+
+	while (*running) {
+		pollfd pfd = { fd, POLLIN, 0 };
+		// Пауза на линии - начало нового кадра
+		if (::poll(&pfd, 1, 20) <= 0) {
+			have = 0;
+			continue;
+		}
+		ssize_t n = ::read(fd, rx + have, sizeof(rx) - have);
+		if (n <= 0) continue;
+		have += n;
+
+		size_t need = rtuRequestLength(rx, have);
+		if (need == 0 || have < need) continue;
+		if (need > sizeof(rx) || !rtuCheck(rx, need)) {
+			have = 0;
+			continue;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(LINE_DELAY_MS));
+		size_t pdu_len = handler->handle(rx[0], rx + RTU_HEADER_SIZE, need - RTU_HEADER_SIZE - RTU_CRC_SIZE, tx + RTU_HEADER_SIZE);
+		have = 0;
+		if (pdu_len == 0) continue;
+		tx[0] = rx[0];
+		size_t len = rtuFinish(tx, RTU_HEADER_SIZE + pdu_len);
+		if (::write(fd, tx, len) != static_cast<ssize_t>(len)) std::cerr << "Simulator write error" << std::endl;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	int clients = argc > 1 ? std::atoi(argv[1]) : 8;
+	if (clients < 1) clients = 1;
+
+	// Карта регистров устройства: регистр i = 1000 + i
+	data::Map holding(0, REGS);
+	holding.initNewMemory(data::MapType::WORD_MAP);
+	for (WORD i = 0; i < REGS; i++) holding.writeWord(i, 1000 + i);
+	SlaveHandler handler;
+	handler.setMap(SIM_SLAVE, SlaveTable::HOLDING_REGISTERS, &holding);
+
+	int pty = posix_openpt(O_RDWR | O_NOCTTY);
+	if (pty < 0 || grantpt(pty) != 0 || unlockpt(pty) != 0) {
+		std::cerr << "Can't open pty" << std::endl;
+		return 1;
+	}
+	std::atomic<bool> running(true);
+	std::thread sim(simulate, pty, &handler, &running);
+
+	HealthConfig config;
+	config.initial_timeout_ms = 100;
+	SlaveHealth health(config);
+	RtuTransport rtu(ptsname(pty));
+	if (!rtu.open()) {
+		std::cerr << "Can't open " << ptsname(pty) << std::endl;
+		return 1;
+	}
+	FrameTrace trace;
+	if (argc > 2 && trace.open(argv[2], 4 << 20)) rtu.setTrace(&trace, 1);	// Просмотр: mb_trace print <файл>
+	ModbusMaster rtu_master(&rtu, &health);
+
+	Gateway gateway(&rtu_master);
+	gateway.addCacheRange(SIM_SLAVE, 3, 0, REGS - 1, 200);
+	if (!gateway.start("127.0.0.1", 0)) {
+		std::cerr << "Can't start gateway" << std::endl;
+		return 1;
+	}
+	gateway.startPoller();
+	std::cout << "Gateway: 127.0.0.1:" << gateway.getPort() << " -> " << rtu.getName() << std::endl;
+
+	// Клиенты опрашивают один и тот же диапазон и проверяют значения
+	std::atomic<int> bad(0);
+	std::vector<std::thread> threads;
+	auto start = std::chrono::steady_clock::now();
+	for (int c = 0; c < clients; c++) {
+		threads.emplace_back([&gateway, &bad, c]() {
+			TcpTransport tcp("127.0.0.1", gateway.getPort());
+			ModbusMaster master(&tcp);
+			master.setTimeout(2000);
+			if (!tcp.open()) {
+				++bad;
+				return;
+			}
+			WORD vals[REGS];
+			for (int i = 0; i < READS_PER_CLIENT; i++) {
+				WORD start_adr = (c * 7 + i) % 50;
+				if (master.readWords(SIM_SLAVE, 3, start_adr, 50, vals) != MbStatus::OK) {
+					++bad;
+					continue;
+				}
+				for (WORD j = 0; j < 50; j++) {
+					if (vals[j] != 1000 + start_adr + j) {
+						++bad;
+						break;
+					}
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			}
+		});
+	}
+	for (std::thread& t : threads) t.join();
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	GatewayStats stats = gateway.getStats();
+	std::cout << "Clients: " << clients << ", reads: " << clients * READS_PER_CLIENT << ", bad: " << bad << ", " << elapsed << " s" << std::endl;
+	std::cout << "TCP requests: " << stats.tcp_requests << ", cache hits: " << stats.cache_hits << ", collapsed: " << stats.collapsed
+			  << ", serial reads: " << stats.serial_reads << std::endl;
+
+	// Запись проходит на линию и сбрасывает кэш, следующее чтение видит новое значение
+	TcpTransport tcp("127.0.0.1", gateway.getPort());
+	ModbusMaster client(&tcp);
+	client.setTimeout(2000);
+	tcp.open();
+	WORD val = 0;
+	MbStatus status = client.writeWord(SIM_SLAVE, 10, 4242);
+	if (status == MbStatus::OK) status = client.readWords(SIM_SLAVE, 3, 10, 1, &val);
+	std::cout << "Write through gateway: " << mbStatusToString(status) << ", read back " << val << std::endl;
+	if (val != 4242) ++bad;
+
+	// Неотвечающее устройство - исключение GATEWAY_TARGET
+	status = client.readWords(DEAD_SLAVE, 3, 0, 10, &val);
+	std::cout << "Dead slave: " << mbStatusToString(status) << ", exception " << static_cast<int>(client.getLastException()) << std::endl;
+	if (status != MbStatus::EXCEPTION || client.getLastException() != ModbusExceptionCode::EXCEPTION_GATEWAY_TARGET) ++bad;
+
+	tcp.close();
+	gateway.stop();
+	running = false;
+	sim.join();
+	rtu.close();
+	::close(pty);
+
+	return bad == 0 ? 0 : 1;
+}
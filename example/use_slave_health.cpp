@@ -0,0 +1,101 @@
+#include <iostream>
+#include <random>
+#include <cstdlib>
+
+#include "SlaveHealth.h"
+
+// Симуляция RTU линии из 5 устройств: устройство 3 не отвечает (или теряет заданную долю запросов),
+// устройство 4 теряет 10% запросов. Сравнивается опрос с фиксированным таймаутом и адаптивный опрос.
+// Запуск: use_health [доля потерь устройства 3, по умолчанию 1.0]
+
+using namespace mb::modbus;
+
+constexpr int SLAVES = 5;
+constexpr double FIXED_TIMEOUT_MS = 500.0;
+constexpr uint64_t SIM_MS = 10 * 60 * 1000;
+
+// Симулируемое устройство, теряющее заданную долю запросов
+struct SimSlave {
+	double drop;			// Доля запросов без ответа 0..1
+	double rtt_ms;			// Среднее время ответа
+	double jitter_ms;
+
+	// Возвращает время ответа или отрицательное значение, если ответа не будет
+	double answer(std::mt19937& rng) const {
+		std::uniform_real_distribution<double> u(0.0, 1.0);
+		if (u(rng) < drop) return -1;
+		std::normal_distribution<double> n(rtt_ms, jitter_ms);
+		return std::max(1.0, n(rng));
+	}
+};
+
+struct Result {
+	uint64_t polls[SLAVES + 1] = {};
+	uint64_t answers[SLAVES + 1] = {};
+	uint64_t cycles = 0;
+};
+
+static Result simulate(const SimSlave* slaves, SlaveHealth* health) {
+	Result r;
+	std::mt19937 rng(12345);
+	double now = 0;
+
+	while (now < SIM_MS) {
+		for (int id = 1; id <= SLAVES; id++) {
+			if (health && !health->shouldPoll(id, static_cast<uint64_t>(now))) continue;
+			double timeout = health ? health->timeoutMs(id) : FIXED_TIMEOUT_MS;
+			double rtt = slaves[id].answer(rng);
+			++r.polls[id];
+			if (rtt >= 0 && rtt <= timeout) {
+				++r.answers[id];
+				now += rtt;
+				if (health) health->onResponse(id, static_cast<uint32_t>(rtt * 1000), static_cast<uint64_t>(now));
+			}
+			else {
+				now += timeout;
+				if (health) health->onTimeout(id, static_cast<uint64_t>(now));
+			}
+			now += 2.0; // Пауза между запросами на линии
+		}
+		++r.cycles;
+	}
+	return r;
+}
+
+static void print(const char* name, const Result& r) {
+	std::cout << name << ": cycles " << r.cycles << ", average cycle " << static_cast<double>(SIM_MS) / r.cycles << " ms" << std::endl;
+	for (int id = 1; id <= SLAVES; id++) {
+		std::cout << "  slave " << id << " polls " << r.polls[id] << ", answers " << r.answers[id]
+					 << ", answers/min " << r.answers[id] * 60000.0 / SIM_MS << std::endl;
+	}
+}
+
+int main(int argc, char** argv) {
+	double drop = argc > 1 ? atof(argv[1]) : 1.0;
+
+	SimSlave slaves[SLAVES + 1] = {
+		{ 0, 0, 0 },
+		{ 0.0, 12.0, 2.0 },
+		{ 0.0, 15.0, 3.0 },
+		{ drop, 20.0, 3.0 },
+		{ 0.1, 18.0, 4.0 },
+		{ 0.0, 25.0, 5.0 },
+	};
+
+	std::cout << "Slave 3 drop ratio " << drop << ", simulated " << SIM_MS / 1000 << " s" << std::endl;
+
+	print("Fixed timeout 500 ms", simulate(slaves, nullptr));
+
+	SlaveHealth health;
+	print("Adaptive", simulate(slaves, &health));
+
+	for (int id = 1; id <= SLAVES; id++) {
+		SlaveStats st;
+		health.getStats(id, st);
+		const char* state = st.state == SlaveState::ONLINE ? "ONLINE" : st.state == SlaveState::SUSPECT ? "SUSPECT" : "OFFLINE";
+		std::cout << "  slave " << id << " " << state << ", timeout " << st.timeout_ms << " ms, p50 " << st.p50_us
+					 << " us, p99 " << st.p99_us << " us, timeouts " << st.timeouts << ", errors " << st.errors << ", skipped " << st.skipped << ", last seen " << st.last_seen_ms << " ms" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,212 @@
+#include "ConfigImage.h"
+#include "Range.h"
+#include "ScanScheduler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace mb {
+namespace data {
+
+static_assert(sizeof(ImageTag) == 16, "ImageTag layout changed, increase CONFIG_IMAGE_VERSION");
+static_assert(sizeof(ImageRange) == 12, "ImageRange layout changed, increase CONFIG_IMAGE_VERSION");
+static_assert(sizeof(ImagePollItem) == 12, "ImagePollItem layout changed, increase CONFIG_IMAGE_VERSION");
+
+constexpr uint32_t IMAGE_ENDIAN = 0x01020304;
+
+static size_t align8(size_t v) { return (v + 7) & ~static_cast<size_t>(7); }
+
+uint64_t ConfigImage::hash(const void* data, size_t size) {
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	uint64_t h = 0xCBF29CE484222325ULL ^ size;
+	// По 8 байт за шаг, хвост дополняется нулями
+	while (size >= 8) {
+		uint64_t w;
+		memcpy(&w, p, 8);
+		h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+		h ^= h >> 32;
+		p += 8;
+		size -= 8;
+	}
+	if (size > 0) {
+		uint64_t w = 0;
+		memcpy(&w, p, size);
+		h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+		h ^= h >> 32;
+	}
+	return h;
+}
+
+bool ConfigImage::compile(const ConfigParser& parser, std::string_view source, uint32_t default_scan_ms, const std::string& path) {
+	const std::vector<ConfigTag>& cfg_tags = parser.getTags();
+
+	// Каталог тегов
+	std::vector<ImageTag> tags;
+	tags.reserve(cfg_tags.size());
+	size_t names_size = 0;
+	for (const ConfigTag& t : cfg_tags) names_size += t.name.size();
+	if (names_size > UINT32_MAX) return false;
+	std::string names;
+	names.reserve(names_size);
+
+	for (const ConfigTag& t : cfg_tags) {
+		if (t.name.size() > UINT16_MAX) return false;
+		ImageTag tag = {};
+		tag.name_offset = static_cast<uint32_t>(names.size());
+		tag.name_len = static_cast<uint16_t>(t.name.size());
+		tag.slave_id = static_cast<uint8_t>(t.slave_id);
+		tag.func = static_cast<uint8_t>(t.func);
+		tag.address = t.address;
+		tag.data_type = t.data_type;
+		tag.order = t.order;
+		tag.precision = t.precision;
+		tags.push_back(tag);
+		names.append(t.name);
+	}
+	std::stable_sort(tags.begin(), tags.end(), [](const ImageTag& a, const ImageTag& b) {
+		if (a.slave_id != b.slave_id) return a.slave_id < b.slave_id;
+		if (a.func != b.func) return a.func < b.func;
+		return a.address < b.address;
+	});
+
+	// Нормализация диапазонов по (slave_id, func), период по умолчанию подставляется до слияния
+	std::map<int, std::vector<Range>> grouped;
+	for (const ConfigRange& r : parser.getRanges()) {
+		grouped[(r.slave_id << 8) | r.func].emplace_back(r.start, r.end, r.scan_ms ? r.scan_ms : default_scan_ms);
+	}
+	std::vector<ImageRange> ranges;
+	std::vector<ImagePollItem> plan;
+	for (auto& pair : grouped) {
+		normalizeRangeList(pair.second);
+		const uint8_t slave_id = static_cast<uint8_t>(pair.first >> 8);
+		const uint8_t func = static_cast<uint8_t>(pair.first & 0xFF);
+		const uint32_t max_q = ScanScheduler::maxQuantity(func);
+		for (const Range& r : pair.second) {
+			ImageRange range = {};
+			range.slave_id = slave_id;
+			range.func = func;
+			range.start = r.start;
+			range.end = r.end;
+			range.scan_ms = r.scan_ms;
+			ranges.push_back(range);
+
+			if (func < 1 || func > 4) continue;
+			splitRange(r.start, r.end, max_q, [&](uint16_t start, uint16_t quantity) {
+				ImagePollItem item = {};
+				item.slave_id = slave_id;
+				item.func = func;
+				item.start = start;
+				item.quantity = quantity;
+				item.scan_ms = r.scan_ms;
+				plan.push_back(item);
+			});
+		}
+	}
+	std::stable_sort(plan.begin(), plan.end(), [](const ImagePollItem& a, const ImagePollItem& b) { return a.scan_ms < b.scan_ms; });
+
+	// Раскладка секций
+	ImageHeader header = {};
+	memcpy(header.magic, CONFIG_IMAGE_MAGIC, 4);
+	header.version = CONFIG_IMAGE_VERSION;
+	header.header_size = sizeof(ImageHeader);
+	header.endian = IMAGE_ENDIAN;
+	header.default_scan_ms = default_scan_ms;
+	header.source_hash = hash(source.data(), source.size());
+	header.tag_count = static_cast<uint32_t>(tags.size());
+	header.range_count = static_cast<uint32_t>(ranges.size());
+	header.plan_count = static_cast<uint32_t>(plan.size());
+	header.names_size = static_cast<uint32_t>(names.size());
+
+	size_t pos = align8(sizeof(ImageHeader));
+	header.tag_offset = pos;
+	pos = align8(pos + tags.size() * sizeof(ImageTag));
+	header.range_offset = pos;
+	pos = align8(pos + ranges.size() * sizeof(ImageRange));
+	header.plan_offset = pos;
+	pos = align8(pos + plan.size() * sizeof(ImagePollItem));
+	header.names_offset = pos;
+	pos += names.size();
+	header.total_size = pos;
+
+	std::vector<char> image(pos, 0);
+	if (!tags.empty()) memcpy(image.data() + header.tag_offset, tags.data(), tags.size() * sizeof(ImageTag));
+	if (!ranges.empty()) memcpy(image.data() + header.range_offset, ranges.data(), ranges.size() * sizeof(ImageRange));
+	if (!plan.empty()) memcpy(image.data() + header.plan_offset, plan.data(), plan.size() * sizeof(ImagePollItem));
+	if (!names.empty()) memcpy(image.data() + header.names_offset, names.data(), names.size());
+	header.checksum = hash(image.data() + sizeof(ImageHeader), image.size() - sizeof(ImageHeader));
+	memcpy(image.data(), &header, sizeof(ImageHeader));
+
+	// Запись во временный файл и атомарная замена, чтобы работающий процесс не увидел половину образа
+	std::string tmp_path = path + ".tmp";
+	FILE* f = fopen(tmp_path.c_str(), "wb");
+	if (f == nullptr) return false;
+	bool result = fwrite(image.data(), 1, image.size(), f) == image.size();
+	result = fclose(f) == 0 && result;
+	if (result) result = rename(tmp_path.c_str(), path.c_str()) == 0;
+	if (!result) remove(tmp_path.c_str());
+	return result;
+}
+
+bool ConfigImage::fail(const char* error) {
+	m_error = error;
+	close();
+	return false;
+}
+
+bool ConfigImage::open(const std::string& path, bool verify) {
+	close();
+	m_error = "";
+	if (!m_file.open(path)) return fail("can't open image");
+
+	std::string_view data = m_file.text();
+	m_data = data.data();
+	m_size = data.size();
+	if (m_size < sizeof(ImageHeader)) return fail("image too small");
+
+	const ImageHeader& h = getHeader();
+	if (memcmp(h.magic, CONFIG_IMAGE_MAGIC, 4) != 0) return fail("bad magic");
+	if (h.version != CONFIG_IMAGE_VERSION || h.header_size != sizeof(ImageHeader)) return fail("unsupported version");
+	if (h.endian != IMAGE_ENDIAN) return fail("foreign byte order");
+	if (h.total_size != m_size) return fail("size mismatch");
+
+	auto fits = [this](uint64_t offset, uint64_t bytes) { return offset % 8 == 0 && offset >= sizeof(ImageHeader) && offset <= m_size && bytes <= m_size - offset; };
+	if (!fits(h.tag_offset, static_cast<uint64_t>(h.tag_count) * sizeof(ImageTag)) ||
+		 !fits(h.range_offset, static_cast<uint64_t>(h.range_count) * sizeof(ImageRange)) ||
+		 !fits(h.plan_offset, static_cast<uint64_t>(h.plan_count) * sizeof(ImagePollItem)) ||
+		 !fits(h.names_offset, h.names_size)) {
+		return fail("section out of bounds");
+	}
+
+	if (verify && hash(m_data + sizeof(ImageHeader), m_size - sizeof(ImageHeader)) != h.checksum) return fail("checksum mismatch");
+
+	// Записи проверяются и без контрольной суммы: getTagName и план опроса используют их без проверок
+	const ImageTag* tags = getTags();
+	for (uint32_t i = 0; i < h.tag_count; i++) {
+		if (static_cast<uint64_t>(tags[i].name_offset) + tags[i].name_len > h.names_size) return fail("tag name out of bounds");
+	}
+	const ImageRange* ranges = getRanges();
+	for (uint32_t i = 0; i < h.range_count; i++) {
+		if (ranges[i].start > ranges[i].end) return fail("bad range");
+	}
+	const ImagePollItem* plan = getPlan();
+	for (uint32_t i = 0; i < h.plan_count; i++) {
+		const ImagePollItem& item = plan[i];
+		if (item.func < 1 || item.func > 4 || item.quantity == 0 || item.quantity > ScanScheduler::maxQuantity(item.func) ||
+			 static_cast<uint32_t>(item.start) + item.quantity - 1 > UINT16_MAX) {
+			return fail("bad poll item");
+		}
+	}
+	return true;
+}
+
+void ConfigImage::close() {
+	m_file.close();
+	m_data = nullptr;
+	m_size = 0;
+}
+
+} // data
+} // mb
@@ -0,0 +1,118 @@
+#ifndef MB_CONFIG_IMAGE_H
+#define MB_CONFIG_IMAGE_H
+
+#include "ConfigParser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace mb {
+namespace data {
+
+#define CONFIG_IMAGE_MAGIC "MBCI"
+#define CONFIG_IMAGE_VERSION 1
+
+/** @brief Заголовок образа конфигурации. Все смещения - от начала файла, секции выровнены на 8 байт */
+struct ImageHeader {
+	char magic[4];				// CONFIG_IMAGE_MAGIC
+	uint16_t version;			// CONFIG_IMAGE_VERSION
+	uint16_t header_size;
+	uint32_t endian;			// 0x01020304 в порядке байт компилятора образа
+	uint32_t default_scan_ms;
+	uint64_t checksum;		// Хеш всего, что после заголовка
+	uint64_t source_hash;	// Хеш исходного текста (проверка актуальности образа)
+	uint64_t total_size;
+	uint64_t tag_offset;
+	uint64_t range_offset;
+	uint64_t plan_offset;
+	uint64_t names_offset;
+	uint32_t tag_count;
+	uint32_t range_count;
+	uint32_t plan_count;
+	uint32_t names_size;
+};
+
+/** @brief Тег каталога, отсортирован по (slave_id, func, address) */
+struct ImageTag {
+	uint32_t name_offset;	// Смещение имени в секции имен
+	uint16_t name_len;
+	uint8_t slave_id;
+	uint8_t func;
+	uint16_t address;
+	CfgDataType data_type;
+	CfgDataOrder order;
+	uint8_t precision;
+	uint8_t reserved[3];
+};
+
+/** @brief Нормализованный диапазон опроса */
+struct ImageRange {
+	uint8_t slave_id;
+	uint8_t func;
+	uint16_t start;
+	uint16_t end;
+	uint16_t reserved;
+	uint32_t scan_ms;			// Период опроса, 0 в тексте заменен периодом по умолчанию
+};
+
+/** @brief Запрос плана опроса: диапазон, разбитый по ограничению количества чтения, по возрастанию периода */
+struct ImagePollItem {
+	uint8_t slave_id;
+	uint8_t func;
+	uint16_t start;
+	uint16_t quantity;
+	uint16_t reserved;
+	uint32_t scan_ms;
+};
+
+/** @brief Предварительно скомпилированный двоичный образ конфигурации.
+	compile разбирает, нормализует и раскладывает конфигурацию один раз, open отображает образ в память (mmap)
+	и проверяет версию, размеры секций, границы записей и контрольную сумму. Записи используются прямо из отображения, без разбора */
+class ConfigImage {
+public:
+	ConfigImage() : m_data(nullptr), m_size(0), m_error("") {}
+	~ConfigImage() { close(); }
+
+	ConfigImage(const ConfigImage&) = delete;
+	ConfigImage& operator=(const ConfigImage&) = delete;
+
+	// Компиляция разобранной конфигурации source в файл path (запись через временный файл и rename)
+	static bool compile(const ConfigParser& parser, std::string_view source, uint32_t default_scan_ms, const std::string& path);
+	static uint64_t hash(const void* data, size_t size);
+
+	// verify = false - без проверки контрольной суммы, заголовок, границы секций и записи (имена тегов, план) проверяются всегда
+	bool open(const std::string& path, bool verify = true);
+	void close();
+	bool isOpen() const { return m_data != nullptr; }
+	const char* getError() const { return m_error; }
+
+	const ImageHeader& getHeader() const { return *reinterpret_cast<const ImageHeader*>(m_data); }
+
+	const ImageTag* getTags() const { return section<ImageTag>(getHeader().tag_offset); }
+	size_t getTagCount() const { return getHeader().tag_count; }
+	std::string_view getTagName(const ImageTag& tag) const { return std::string_view(section<char>(getHeader().names_offset) + tag.name_offset, tag.name_len); }
+
+	const ImageRange* getRanges() const { return section<ImageRange>(getHeader().range_offset); }
+	size_t getRangeCount() const { return getHeader().range_count; }
+
+	const ImagePollItem* getPlan() const { return section<ImagePollItem>(getHeader().plan_offset); }
+	size_t getPlanCount() const { return getHeader().plan_count; }
+
+private:
+	template <typename T>
+	const T* section(uint64_t offset) const { return reinterpret_cast<const T*>(m_data + offset); }
+
+	bool fail(const char* error);
+
+	ConfigFile m_file;
+	const char* m_data;
+	size_t m_size;
+	const char* m_error;
+};
+
+} // data
+} // mb
+
+#endif // MB_CONFIG_IMAGE_H
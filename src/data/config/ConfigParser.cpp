@@ -0,0 +1,384 @@
+#include "ConfigParser.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mb {
+namespace data {
+
+const char* cfgDataTypeToString(CfgDataType type) {
+	switch (type) {
+		case CfgDataType::NONE: return "NONE";
+		case CfgDataType::INT16: return "INT16";
+		case CfgDataType::UINT16: return "UINT16";
+		case CfgDataType::INT32: return "INT32";
+		case CfgDataType::UINT32: return "UINT32";
+		case CfgDataType::FLOAT: return "FLOAT";
+	}
+	return "NONE";
+}
+
+const char* cfgDataOrderToString(CfgDataOrder order) {
+	switch (order) {
+		case CfgDataOrder::NONE: return "NONE";
+		case CfgDataOrder::AB_CD: return "AB_CD";
+		case CfgDataOrder::CD_AB: return "CD_AB";
+		case CfgDataOrder::BA_DC: return "BA_DC";
+		case CfgDataOrder::DC_BA: return "DC_BA";
+	}
+	return "NONE";
+}
+
+/* ConfigFile */
+
+bool ConfigFile::open(const std::string& path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+	m_size = static_cast<size_t>(st.st_size);
+	if (m_size == 0) {
+		::close(fd);
+		m_data = "";
+		return true;
+	}
+
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED) {
+		m_size = 0;
+		return false;
+	}
+	madvise(data, m_size, MADV_SEQUENTIAL);
+	m_data = static_cast<const char*>(data);
+	m_mapped = true;
+	return true;
+}
+
+void ConfigFile::assign(std::string_view text) {
+	close();
+	m_data = text.data();
+	m_size = text.size();
+}
+
+void ConfigFile::close() {
+	if (m_mapped) munmap(const_cast<char*>(m_data), m_size);
+	m_data = nullptr;
+	m_size = 0;
+	m_mapped = false;
+}
+
+/* Ключевые слова */
+
+// Ключевое слово: тип данных или порядок
+struct Keyword {
+	const char* str;
+	uint8_t len;
+	bool is_order;
+	uint8_t value;
+};
+
+static constexpr Keyword keywords[] = {
+	{ "INT16", 5, false, static_cast<uint8_t>(CfgDataType::INT16) },
+	{ "UINT16", 6, false, static_cast<uint8_t>(CfgDataType::UINT16) },
+	{ "INT32", 5, false, static_cast<uint8_t>(CfgDataType::INT32) },
+	{ "UINT32", 6, false, static_cast<uint8_t>(CfgDataType::UINT32) },
+	{ "FLOAT", 5, false, static_cast<uint8_t>(CfgDataType::FLOAT) },
+	{ "AB_CD", 5, true, static_cast<uint8_t>(CfgDataOrder::AB_CD) },
+	{ "CD_AB", 5, true, static_cast<uint8_t>(CfgDataOrder::CD_AB) },
+	{ "BA_DC", 5, true, static_cast<uint8_t>(CfgDataOrder::BA_DC) },
+	{ "DC_BA", 5, true, static_cast<uint8_t>(CfgDataOrder::DC_BA) },
+};
+
+constexpr size_t KEYWORD_COUNT = sizeof(keywords) / sizeof(keywords[0]);
+constexpr size_t KEYWORD_MAX_LEN = 6;
+constexpr unsigned KEYWORD_SLOTS = 16;
+
+// Хеш по первому, предпоследнему символу и длине, без коллизий на наборе keywords
+constexpr unsigned keywordHash(const char* s, size_t len) {
+	return (static_cast<unsigned>(s[0]) * 3 + static_cast<unsigned>(s[len - 2]) * 2 + static_cast<unsigned>(len)) & (KEYWORD_SLOTS - 1);
+}
+
+struct KeywordTable {
+	int8_t slot[KEYWORD_SLOTS];
+	constexpr KeywordTable() : slot() {
+		for (unsigned i = 0; i < KEYWORD_SLOTS; i++) slot[i] = -1;
+		for (size_t k = 0; k < KEYWORD_COUNT; k++) slot[keywordHash(keywords[k].str, keywords[k].len)] = static_cast<int8_t>(k);
+	}
+};
+
+constexpr bool keywordHashIsPerfect() {
+	for (size_t a = 0; a < KEYWORD_COUNT; a++) {
+		for (size_t b = a + 1; b < KEYWORD_COUNT; b++) {
+			if (keywordHash(keywords[a].str, keywords[a].len) == keywordHash(keywords[b].str, keywords[b].len)) return false;
+		}
+	}
+	return true;
+}
+
+static_assert(keywordHashIsPerfect(), "Keyword hash has collisions, change keywordHash");
+
+static constexpr KeywordTable keyword_table;
+
+// Поиск ключевого слова без учета регистра, nullptr - не найдено
+static const Keyword* findKeyword(std::string_view token) {
+	if (token.size() < 2 || token.size() > KEYWORD_MAX_LEN) return nullptr;
+	char upper[KEYWORD_MAX_LEN];
+	for (size_t i = 0; i < token.size(); i++) {
+		char c = token[i];
+		upper[i] = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+	}
+	int8_t k = keyword_table.slot[keywordHash(upper, token.size())];
+	if (k < 0 || keywords[k].len != token.size() || memcmp(keywords[k].str, upper, token.size()) != 0) return nullptr;
+	return &keywords[k];
+}
+
+/* Разбор */
+
+static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static std::string_view trimView(std::string_view s) {
+	while (!s.empty() && isSpace(s.front())) s.remove_prefix(1);
+	while (!s.empty() && isSpace(s.back())) s.remove_suffix(1);
+	return s;
+}
+
+// Очередной токен до delimeter (без пробелов по краям), rest - остаток после разделителя
+static std::string_view nextToken(std::string_view& rest, char delimeter) {
+	size_t pos = rest.find(delimeter);
+	std::string_view token = rest.substr(0, pos);
+	rest = pos == std::string_view::npos ? std::string_view() : rest.substr(pos + 1);
+	return trimView(token);
+}
+
+static bool parseNumber(std::string_view s, uint32_t& val) {
+	if (s.empty()) return false;
+	auto res = std::from_chars(s.data(), s.data() + s.size(), val);
+	return res.ec == std::errc() && res.ptr == s.data() + s.size();
+}
+
+static bool isBitFunc(int func) { return func == 1 || func == 2 || func == 5 || func == 15; }
+
+static bool isValidFunc(int func) { return (func >= 1 && func <= 6) || func == 15 || func == 16; }
+
+static uint64_t hashMix(uint64_t h, uint64_t v) {
+	h = (h ^ v) * 0x9E3779B97F4A7C15ULL;
+	return h ^ (h >> 32);
+}
+
+// Имя - по 8 байт, хвост дополняется нулями
+static uint64_t hashName(uint64_t h, std::string_view name) {
+	const char* p = name.data();
+	size_t size = name.size();
+	for (; size >= 8; p += 8, size -= 8) {
+		uint64_t w;
+		memcpy(&w, p, 8);
+		h = hashMix(h, w);
+	}
+	uint64_t w = 0;
+	memcpy(&w, p, size);
+	return hashMix(h, w ^ (static_cast<uint64_t>(name.size()) << 56));
+}
+
+void ConfigParser::clear() {
+	m_tags.clear();
+	m_ranges.clear();
+	m_group_hashes.clear();
+	m_group_hash = SIZE_MAX;
+	m_error = ConfigError();
+	m_line = 0;
+	m_slave_id = -1;
+	m_func = -1;
+	m_is_ranges = false;
+}
+
+bool ConfigParser::fail(const char* pos, const char* line_start, const char* message) {
+	m_error.line = m_line;
+	m_error.column = static_cast<uint32_t>(pos - line_start) + 1;
+	m_error.message = message;
+	return false;
+}
+
+uint64_t& ConfigParser::groupHash() {
+	// Запись группы ищется при первом теге или диапазоне секции, пустые секции групп не создают.
+	// Групп немного (не больше секций), поэтому поиск линейный
+	if (m_group_hash == SIZE_MAX) {
+		const int key = (m_slave_id << 8) | m_func;
+		for (m_group_hash = 0; m_group_hash < m_group_hashes.size() && m_group_hashes[m_group_hash].key != key; m_group_hash++) {}
+		if (m_group_hash == m_group_hashes.size()) m_group_hashes.push_back(ConfigGroupHash{ key, 0 });
+	}
+	return m_group_hashes[m_group_hash].hash;
+}
+
+bool ConfigParser::findGroupHash(const int key, uint64_t& hash) const {
+	auto it = std::lower_bound(m_group_hashes.begin(), m_group_hashes.end(), key, [](const ConfigGroupHash& g, int k) { return g.key < k; });
+	if (it == m_group_hashes.end() || it->key != key) return false;
+	hash = it->hash;
+	return true;
+}
+
+bool ConfigParser::parse(std::string_view text) {
+	clear();
+	// Строк не меньше, чем тегов, поэтому векторы не перераспределяются во время разбора
+	m_tags.reserve(std::count(text.begin(), text.end(), '\n') + 1);
+
+	const char* p = text.data();
+	const char* end = p + text.size();
+	while (p < end) {
+		const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (eol == nullptr) eol = end;
+		++m_line;
+
+		std::string_view line(p, eol - p);
+		size_t comment = line.find_first_of(";#");
+		if (comment != std::string_view::npos) line = line.substr(0, comment);
+		line = trimView(line);
+
+		if (!line.empty()) {
+			bool result;
+			if (line.front() == '[') result = parseSection(line, p);
+			else if (m_slave_id < 0) result = fail(line.data(), p, "definition outside of section");
+			else if (m_is_ranges) result = parseRange(line, p);
+			else result = parseTag(line, p);
+			if (!result) return false;
+		}
+		p = eol + 1;
+	}
+	std::sort(m_group_hashes.begin(), m_group_hashes.end(), [](const ConfigGroupHash& a, const ConfigGroupHash& b) { return a.key < b.key; });
+	return true;
+}
+
+bool ConfigParser::parseSection(std::string_view line, const char* line_start) {
+	if (line.back() != ']') return fail(line.data() + line.size() - 1, line_start, "expected ']'");
+	std::string_view rest = line.substr(1, line.size() - 2);
+
+	std::string_view slave_str = nextToken(rest, ':');
+	uint32_t slave_id;
+	if (!parseNumber(slave_str, slave_id) || slave_id > 247) return fail(slave_str.data(), line_start, "bad slave id");
+
+	rest = trimView(rest);
+	size_t pos = rest.find_first_of(" \t");
+	std::string_view func_str = rest.substr(0, pos);
+	uint32_t func;
+	if (!parseNumber(func_str, func) || !isValidFunc(func)) return fail(func_str.empty() ? line.data() + line.size() - 1 : func_str.data(), line_start, "bad function");
+
+	std::string_view kind = pos == std::string_view::npos ? std::string_view() : trimView(rest.substr(pos));
+	m_is_ranges = false;
+	if (!kind.empty()) {
+		static constexpr char RANGES[] = "ranges";
+		bool is_ranges = kind.size() == sizeof(RANGES) - 1;
+		for (size_t i = 0; is_ranges && i < kind.size(); i++) is_ranges = (kind[i] | 0x20) == RANGES[i];
+		if (!is_ranges) return fail(kind.data(), line_start, "unknown section kind");
+		m_is_ranges = true;
+	}
+
+	m_slave_id = static_cast<int>(slave_id);
+	m_func = static_cast<int>(func);
+	m_group_hash = SIZE_MAX;
+	return true;
+}
+
+bool ConfigParser::parseTag(std::string_view line, const char* line_start) {
+	size_t eq = line.find('=');
+	if (eq == std::string_view::npos) return fail(line.data() + line.size(), line_start, "expected '='");
+
+	ConfigTag tag;
+	tag.name = trimView(line.substr(0, eq));
+	if (tag.name.empty()) return fail(line.data(), line_start, "empty tag name");
+	tag.slave_id = m_slave_id;
+	tag.func = m_func;
+	tag.data_type = CfgDataType::NONE;
+	tag.order = CfgDataOrder::NONE;
+	tag.precision = 0;
+	tag.line = m_line;
+
+	std::string_view rest = line.substr(eq + 1);
+	std::string_view token = nextToken(rest, ',');
+	uint32_t address;
+	if (!parseNumber(token, address)) return fail(token.data(), line_start, "bad address");
+	if (address > 0xFFFF) return fail(token.data(), line_start, "address out of range");
+	tag.address = static_cast<uint16_t>(address);
+
+	while (!rest.empty()) {
+		token = nextToken(rest, ',');
+		if (token.empty()) return fail(token.data(), line_start, "empty parameter");
+		if (isBitFunc(m_func)) return fail(token.data(), line_start, "parameter for bit function");
+
+		// Точность FLOAT_N отделяется последним '_' с числом после него
+		std::string_view word = token;
+		uint32_t precision = 0;
+		bool has_precision = false;
+		size_t us = token.rfind('_');
+		if (us != std::string_view::npos && parseNumber(token.substr(us + 1), precision)) {
+			word = token.substr(0, us);
+			has_precision = true;
+		}
+
+		const Keyword* kw = findKeyword(word);
+		if (kw == nullptr) return fail(token.data(), line_start, "unknown keyword");
+		if (kw->is_order) {
+			if (has_precision) return fail(token.data(), line_start, "unknown keyword");
+			tag.order = static_cast<CfgDataOrder>(kw->value);
+		}
+		else {
+			tag.data_type = static_cast<CfgDataType>(kw->value);
+			if (has_precision) {
+				if (tag.data_type != CfgDataType::FLOAT) return fail(token.data() + us + 1, line_start, "precision for non-float type");
+				if (precision > 9) return fail(token.data() + us + 1, line_start, "precision out of range");
+				tag.precision = static_cast<uint8_t>(precision);
+			}
+		}
+	}
+
+	// Теги и диапазоны отличаются старшим байтом, чтобы перенос строки между секциями менял хеш
+	uint64_t& h = groupHash();
+	h = hashMix(hashName(h, tag.name), (1ULL << 56) | (static_cast<uint64_t>(tag.address) << 24) | (static_cast<uint64_t>(tag.data_type) << 16) |
+					(static_cast<uint64_t>(tag.order) << 8) | tag.precision);
+	m_tags.push_back(tag);
+	return true;
+}
+
+bool ConfigParser::parseRange(std::string_view line, const char* line_start) {
+	std::string_view rest = line;
+	std::string_view span = nextToken(rest, ',');
+	std::string_view end_str = span;
+	std::string_view start_str = nextToken(end_str, '-');
+	if (end_str.empty()) end_str = start_str;
+	else end_str = trimView(end_str);
+
+	uint32_t start, end;
+	if (!parseNumber(start_str, start) || start > 0xFFFF) return fail(start_str.data(), line_start, "bad range start");
+	if (!parseNumber(end_str, end) || end > 0xFFFF) return fail(end_str.empty() ? line.data() + line.size() : end_str.data(), line_start, "bad range end");
+	if (start > end) std::swap(start, end);
+
+	uint32_t scan_ms = 0;
+	if (!rest.empty()) {
+		std::string_view scan_str = nextToken(rest, ',');
+		if (!parseNumber(scan_str, scan_ms)) return fail(scan_str.data(), line_start, "bad scan period");
+		if (!rest.empty()) return fail(rest.data() - 1, line_start, "unexpected parameter");
+	}
+
+	ConfigRange range;
+	range.slave_id = m_slave_id;
+	range.func = m_func;
+	range.start = static_cast<uint16_t>(start);
+	range.end = static_cast<uint16_t>(end);
+	range.scan_ms = scan_ms;
+	uint64_t& h = groupHash();
+	h = hashMix(hashMix(h, (2ULL << 56) | (static_cast<uint64_t>(range.start) << 16) | range.end), range.scan_ms);
+	m_ranges.push_back(range);
+	return true;
+}
+
+} // data
+} // mb
@@ -0,0 +1,143 @@
+#ifndef MB_CONFIG_PARSER_H
+#define MB_CONFIG_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mb {
+namespace data {
+
+/** @brief Тип данных регистра в конфигурации */
+enum class CfgDataType : uint8_t {
+	NONE,
+	INT16,
+	UINT16,
+	INT32,
+	UINT32,
+	FLOAT,
+};
+
+/** @brief Порядок слов/байт DWORD в конфигурации */
+enum class CfgDataOrder : uint8_t {
+	NONE,
+	AB_CD,
+	CD_AB,
+	BA_DC,
+	DC_BA,
+};
+
+const char* cfgDataTypeToString(CfgDataType type);
+const char* cfgDataOrderToString(CfgDataOrder order);
+
+/** @brief Описание тега (регистра) из конфигурации. name указывает в текст конфигурации */
+struct ConfigTag {
+	std::string_view name;
+	int slave_id;
+	int func;
+	uint16_t address;
+	CfgDataType data_type;
+	CfgDataOrder order;
+	uint8_t precision;
+	uint32_t line;
+};
+
+/** @brief Диапазон опроса из конфигурации */
+struct ConfigRange {
+	int slave_id;
+	int func;
+	uint16_t start;
+	uint16_t end;
+	uint32_t scan_ms;		// 0 - класс опроса по умолчанию
+};
+
+/** @brief Хеш описания пары slave_id/func: ее теги и диапазоны в порядке текста */
+struct ConfigGroupHash {
+	int key;					// slave_id << 8 | func
+	uint64_t hash;
+};
+
+/** @brief Ошибка разбора, line и column считаются с 1 */
+struct ConfigError {
+	uint32_t line = 0;
+	uint32_t column = 0;
+	const char* message = "";
+};
+
+/** @brief Файл конфигурации, отображенный в память (mmap) только для чтения.
+	Теги ConfigParser ссылаются на текст файла, поэтому файл должен быть открыт, пока они используются */
+class ConfigFile {
+public:
+	ConfigFile() : m_data(nullptr), m_size(0), m_mapped(false) {}
+	~ConfigFile() { close(); }
+
+	ConfigFile(const ConfigFile&) = delete;
+	ConfigFile& operator=(const ConfigFile&) = delete;
+
+	bool open(const std::string& path);
+	// Текст в памяти вызывающего кода, без копирования
+	void assign(std::string_view text);
+	void close();
+
+	std::string_view text() const { return std::string_view(m_data, m_size); }
+
+private:
+	const char* m_data;
+	size_t m_size;
+	bool m_mapped;
+};
+
+/** @brief Разбор определений тегов и диапазонов без выделения памяти на токены.
+	Формат:
+		; комментарий (также #)
+		[1:3]							; секция тегов: устройство 1, функция 3
+		temp = 100, FLOAT_2, CD_AB	; имя = адрес[, тип[_точность]][, порядок]
+		alarm = 101
+		[1:3 ranges]				; секция диапазонов опроса устройства 1 функции 3
+		0-99, 1000					; начало-конец[, период опроса мс]
+	Ключевые слова не зависят от регистра и распознаются совершенной хеш-функцией.
+	Числа разбираются std::from_chars прямо из текста. Память выделяется только под векторы результатов.
+	Попутно для каждой пары slave_id/func считается хеш ее тегов и диапазонов в порядке текста (getGroupHashes):
+	по нему перезагрузка находит неизменившиеся группы без сравнения тегов.
+	Разбор останавливается на первой ошибке, ее позиция доступна через getError */
+class ConfigParser {
+public:
+	ConfigParser() {}
+	~ConfigParser() {}
+
+	bool parse(std::string_view text);
+	void clear();
+
+	const std::vector<ConfigTag>& getTags() const { return m_tags; }
+	const std::vector<ConfigRange>& getRanges() const { return m_ranges; }
+	// Хеши групп с тегами или диапазонами, по возрастанию key
+	const std::vector<ConfigGroupHash>& getGroupHashes() const { return m_group_hashes; }
+	// Хеш группы, false - в конфигурации нет группы key
+	bool findGroupHash(const int key, uint64_t& hash) const;
+	const ConfigError& getError() const { return m_error; }
+
+private:
+	bool parseSection(std::string_view line, const char* line_start);
+	bool parseTag(std::string_view line, const char* line_start);
+	bool parseRange(std::string_view line, const char* line_start);
+	bool fail(const char* pos, const char* line_start, const char* message);
+	uint64_t& groupHash();
+
+	std::vector<ConfigTag> m_tags;
+	std::vector<ConfigRange> m_ranges;
+	std::vector<ConfigGroupHash> m_group_hashes;
+	ConfigError m_error;
+
+	uint32_t m_line = 0;
+	int m_slave_id = -1;
+	int m_func = -1;
+	bool m_is_ranges = false;
+	size_t m_group_hash = SIZE_MAX;		// Номер хеша группы текущей секции в m_group_hashes
+};
+
+} // data
+} // mb
+
+#endif // MB_CONFIG_PARSER_H
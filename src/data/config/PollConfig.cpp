@@ -0,0 +1,169 @@
+#include "PollConfig.h"
+#include "WorkPool.h"
+
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+namespace mb {
+namespace data {
+
+// Подсчет изменений тегов по именам внутри перестроенной группы
+static void diffTags(const PollGroup* prev, const PollGroup& cur, ReloadDiff& diff) {
+	if (prev == nullptr) {
+		diff.tags_added += cur.tags.size();
+		return;
+	}
+	std::unordered_map<std::string_view, const PollTag*> old_tags;
+	old_tags.reserve(prev->tags.size());
+	for (const PollTag& t : prev->tags) old_tags.emplace(t.name, &t);
+
+	for (const PollTag& t : cur.tags) {
+		auto it = old_tags.find(t.name);
+		if (it == old_tags.end()) {
+			++diff.tags_added;
+			continue;
+		}
+		if (!(*it->second == t)) ++diff.tags_changed;
+		old_tags.erase(it);
+	}
+	diff.tags_removed += old_tags.size();
+}
+
+PollConfig::PollConfig(uint32_t default_scan_ms) : m_default_scan_ms(default_scan_ms), m_pool(nullptr) {}
+
+std::shared_ptr<const PollSnapshot> PollConfig::snapshot() const {
+	return std::atomic_load(&m_snapshot);
+}
+
+std::shared_ptr<PollGroup> PollConfig::buildGroup(int key, uint64_t hash, std::vector<const ConfigTag*>& tags, std::vector<Range>& ranges) const {
+	std::shared_ptr<PollGroup> g = std::make_shared<PollGroup>();
+	g->slave_id = key >> 8;
+	g->func = key & 0xFF;
+	g->hash = hash;
+
+	g->tags.reserve(tags.size());
+	for (const ConfigTag* t : tags) g->tags.push_back(PollTag{ std::string(t->name), t->address, t->data_type, t->order, t->precision });
+	g->ranges = std::move(ranges);
+	normalizeRangeList(g->ranges);
+
+	if (g->func >= 1 && g->func <= 4) {
+		const uint32_t max_q = ScanScheduler::maxQuantity(g->func);
+		for (const Range& r : g->ranges) {
+			splitRange(r.start, r.end, max_q, [&](uint16_t start, uint16_t quantity) {
+				g->plan.push_back(ScanRequest{ g->slave_id, g->func, start, quantity, r.scan_ms });
+			});
+		}
+	}
+	return g;
+}
+
+bool PollConfig::apply(const ConfigParser& parser, ReloadDiff* diff) {
+	std::lock_guard<std::mutex> lock(m_apply_mtx);
+	std::shared_ptr<const PollSnapshot> prev = snapshot();
+	ReloadDiff d;
+
+	std::shared_ptr<PollSnapshot> next = std::make_shared<PollSnapshot>();
+	next->version = prev ? prev->version + 1 : 1;
+	next->tag_count = 0;
+
+	// Группы с тем же хешем описания (теги и диапазоны в порядке конфигурации) переходят в новый снимок тем же
+	// указателем, остальные перестраиваются. Перестановка строк считается изменением и только перестраивает группу
+	struct Source {
+		uint64_t hash;
+		std::shared_ptr<const PollGroup> old;
+		std::vector<const ConfigTag*> tags;
+		std::vector<Range> ranges;
+		std::shared_ptr<PollGroup> group;
+	};
+	std::map<int, Source> sources;
+	for (const ConfigGroupHash& g : parser.getGroupHashes()) {
+		std::shared_ptr<const PollGroup> old;
+		if (prev) {
+			auto it = prev->groups.find(g.key);
+			if (it != prev->groups.end()) old = it->second;
+		}
+
+		if (old && old->hash == g.hash) {
+			next->tag_count += old->tags.size();
+			next->groups.emplace(g.key, std::move(old));
+			++d.groups_kept;
+		}
+		else sources[g.key] = Source{ g.hash, std::move(old), {}, {}, nullptr };
+	}
+
+	// Описания собираются только для перестраиваемых групп. Строки секции идут подряд, поэтому группа ищется при смене ключа
+	if (!sources.empty()) {
+		int last_key = -1;
+		Source* s = nullptr;
+		auto sourceOf = [&](int key) {
+			if (key != last_key) {
+				auto it = sources.find(key);
+				s = it == sources.end() ? nullptr : &it->second;
+				last_key = key;
+			}
+			return s;
+		};
+		for (const ConfigTag& t : parser.getTags()) {
+			if (Source* src = sourceOf((t.slave_id << 8) | t.func)) src->tags.push_back(&t);
+		}
+		for (const ConfigRange& r : parser.getRanges()) {
+			if (Source* src = sourceOf((r.slave_id << 8) | r.func)) src->ranges.emplace_back(r.start, r.end, r.scan_ms ? r.scan_ms : m_default_scan_ms);
+		}
+	}
+	std::vector<std::pair<int, Source*>> rebuild;
+	rebuild.reserve(sources.size());
+	for (auto& pair : sources) rebuild.emplace_back(pair.first, &pair.second);
+
+	// Группы независимы: нормализация и разбиение идут параллельно, сборка снимка - в потоке apply
+	auto build = [this, &rebuild](size_t i) {
+		Source& s = *rebuild[i].second;
+		s.group = buildGroup(rebuild[i].first, s.hash, s.tags, s.ranges);
+	};
+	if (m_pool) m_pool->parallelFor(rebuild.size(), build);
+	else for (size_t i = 0; i < rebuild.size(); i++) build(i);
+
+	for (auto& pair : sources) {
+		Source& s = pair.second;
+		diffTags(s.old.get(), *s.group, d);
+		next->tag_count += s.group->tags.size();
+		next->groups.emplace(pair.first, std::move(s.group));
+		++d.groups_rebuilt;
+	}
+
+	if (prev) {
+		for (const auto& pair : prev->groups) {
+			uint64_t hash;
+			if (parser.findGroupHash(pair.first, hash)) continue;
+			++d.groups_removed;
+			d.tags_removed += pair.second->tags.size();
+		}
+	}
+
+	std::atomic_store(&m_snapshot, std::shared_ptr<const PollSnapshot>(std::move(next)));
+	if (diff) *diff = d;
+	return true;
+}
+
+size_t PollConfig::updateScheduler(ScanScheduler& scheduler, const PollSnapshot* prev, const PollSnapshot& cur, uint32_t default_ms, uint64_t now_ms) {
+	// Изменения всех групп применяются к планировщику одной пакетной заменой
+	std::vector<ScanGroup> groups;
+	for (const auto& pair : cur.groups) {
+		if (prev) {
+			auto it = prev->groups.find(pair.first);
+			if (it != prev->groups.end() && it->second == pair.second) continue;
+		}
+		groups.push_back(ScanGroup{ pair.second->slave_id, pair.second->func, &pair.second->ranges });
+	}
+	if (prev) {
+		for (const auto& pair : prev->groups) {
+			if (cur.groups.count(pair.first)) continue;
+			groups.push_back(ScanGroup{ pair.second->slave_id, pair.second->func, nullptr });
+		}
+	}
+	if (!groups.empty()) scheduler.replaceGroups(groups, default_ms, now_ms);
+	return groups.size();
+}
+
+} // data
+} // mb
@@ -0,0 +1,96 @@
+#ifndef MB_POLL_CONFIG_H
+#define MB_POLL_CONFIG_H
+
+#include "ConfigParser.h"
+#include "Range.h"
+#include "ScanScheduler.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mb {
+namespace work {
+class WorkPool;
+}
+
+namespace data {
+
+/** @brief Тег рабочей конфигурации (имя хранится в снимке, а не в тексте файла) */
+struct PollTag {
+	std::string name;
+	uint16_t address;
+	CfgDataType data_type;
+	CfgDataOrder order;
+	uint8_t precision;
+
+	bool operator==(const PollTag& o) const {
+		return address == o.address && data_type == o.data_type && order == o.order && precision == o.precision && name == o.name;
+	}
+};
+
+/** @brief Теги, диапазоны и план опроса одной пары slave_id/func. После построения не изменяется */
+struct PollGroup {
+	int slave_id;
+	int func;
+	uint64_t hash;									// Хеш описания группы (ConfigParser::getGroupHashes)
+	std::vector<PollTag> tags;					// В порядке конфигурации
+	std::vector<Range> ranges;					// Нормализованные диапазоны
+	std::vector<ScanRequest> plan;			// Запросы с разбиением по протокольному лимиту
+};
+
+/** @brief Неизменяемый снимок конфигурации опроса. Группы, не затронутые изменением, разделяются с предыдущим снимком */
+struct PollSnapshot {
+	uint64_t version;
+	size_t tag_count;
+	std::map<int, std::shared_ptr<const PollGroup>> groups;	// (slave_id << 8 | func) -> группа
+};
+
+/** @brief Результат сравнения новой конфигурации с рабочей */
+struct ReloadDiff {
+	size_t tags_added = 0;
+	size_t tags_removed = 0;
+	size_t tags_changed = 0;			// Изменены адрес, тип, порядок или точность
+	size_t groups_kept = 0;				// Группы, перенесенные в новый снимок без перестроения
+	size_t groups_rebuilt = 0;
+	size_t groups_removed = 0;
+};
+
+/** @brief Рабочая конфигурация опроса с горячей перезагрузкой (RCU).
+	apply сравнивает новую конфигурацию с текущим снимком по хешам групп slave_id/func, посчитанным при разборе,
+	и перестраивает (нормализует
+	и разбивает на запросы) только изменившиеся группы и атомарно публикует новый снимок. С пулом потоков (setWorkPool)
+	группы перестраиваются параллельно: при запуске перестраиваются все группы всех устройств.
+	Поток опроса берет снимок через snapshot() и держит его, пока он нужен: старый снимок освобождается,
+	когда его отпустит последний читатель. Чтение снимка не блокирует публикацию и наоборот */
+class PollConfig {
+public:
+	PollConfig(uint32_t default_scan_ms);
+	~PollConfig() {}
+
+	// Построение и публикация нового снимка, diff - необязательная статистика изменений
+	bool apply(const ConfigParser& parser, ReloadDiff* diff = nullptr);
+
+	std::shared_ptr<const PollSnapshot> snapshot() const;
+	// Пул для перестроения групп в apply, nullptr - в потоке apply. Пул должен жить дольше PollConfig
+	void setWorkPool(work::WorkPool* pool) { m_pool = pool; }
+
+	// Перенос изменений снимка cur относительно prev (nullptr - пустая конфигурация) в планировщик потока опроса.
+	// Заменяются только диапазоны изменившихся групп, расписание остальных сохраняется. Возвращает количество групп
+	static size_t updateScheduler(ScanScheduler& scheduler, const PollSnapshot* prev, const PollSnapshot& cur, uint32_t default_ms, uint64_t now_ms);
+
+private:
+	std::shared_ptr<PollGroup> buildGroup(int key, uint64_t hash, std::vector<const ConfigTag*>& tags, std::vector<Range>& ranges) const;
+
+	uint32_t m_default_scan_ms;
+	work::WorkPool* m_pool;
+	std::shared_ptr<const PollSnapshot> m_snapshot;	// Доступ только через std::atomic_load/atomic_store
+	std::mutex m_apply_mtx;									// Публикации выполняются по одной
+};
+
+} // data
+} // mb
+
+#endif // MB_POLL_CONFIG_H
@@ -0,0 +1,309 @@
+#include "BitKernels.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MB_BIT_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace mb {
+namespace data {
+
+#define MB_ALWAYS_INLINE inline __attribute__((always_inline))
+
+void unpackWordBitsRef(const uint16_t* words, size_t bit_offset, size_t quantity, uint8_t* bits) {
+	for (size_t i = 0; i < quantity; i++) {
+		const size_t n = bit_offset + i;
+		bits[i] = (words[n / 16] >> (n % 16)) & 1;
+	}
+}
+
+void packWordBitsRef(uint16_t* words, size_t bit_offset, size_t quantity, const uint8_t* bits) {
+	for (size_t i = 0; i < quantity; i++) {
+		const size_t n = bit_offset + i;
+		const uint16_t mask = static_cast<uint16_t>(1u << (n % 16));
+		if (bits[i]) words[n / 16] |= mask;
+		else words[n / 16] &= ~mask;
+	}
+}
+
+/* Обход диапазона кусками по 32 бита. Кусок со сдвигом внутри слова занимает три слова, без сдвига - два,
+   поэтому окно никогда не выходит за последнее слово диапазона. Ops::unpack32 раскладывает 32 бита в 32 байта,
+   Ops::pack32 собирает 32 байта в 32 бита. Шаблоны встраиваются в функции с атрибутом target,
+   поэтому векторные операции компилируются без общих флагов -m */
+
+template <typename Ops>
+static MB_ALWAYS_INLINE void unpackSpan(const uint16_t* words, size_t bit_offset, size_t quantity, uint8_t* bits) {
+	words += bit_offset / 16;
+	const size_t shift = bit_offset % 16;
+	size_t done = 0;
+	for (; done + 32 <= quantity; done += 32) {
+		const size_t p = shift + done;
+		const size_t w = p / 16;
+		uint64_t win = words[w] | static_cast<uint64_t>(words[w + 1]) << 16;
+		if (p % 16) win |= static_cast<uint64_t>(words[w + 2]) << 32;
+		Ops::unpack32(static_cast<uint32_t>(win >> (p % 16)), bits + done);
+	}
+	unpackWordBitsRef(words, shift + done, quantity - done, bits + done);
+}
+
+template <typename Ops>
+static MB_ALWAYS_INLINE void packSpan(uint16_t* words, size_t bit_offset, size_t quantity, const uint8_t* bits) {
+	words += bit_offset / 16;
+	const size_t shift = bit_offset % 16;
+	size_t done = 0;
+	for (; done + 32 <= quantity; done += 32) {
+		const size_t p = shift + done;
+		const size_t w = p / 16;
+		const size_t s = p % 16;
+		uint64_t win = words[w] | static_cast<uint64_t>(words[w + 1]) << 16;
+		if (s) win |= static_cast<uint64_t>(words[w + 2]) << 32;
+		win = (win & ~(0xFFFFFFFFull << s)) | static_cast<uint64_t>(Ops::pack32(bits + done)) << s;
+		words[w] = static_cast<uint16_t>(win);
+		words[w + 1] = static_cast<uint16_t>(win >> 16);
+		if (s) words[w + 2] = static_cast<uint16_t>(win >> 32);
+	}
+	packWordBitsRef(words, shift + done, quantity - done, bits + done);
+}
+
+// Байты 64-битного числа в порядке памяти: младший байт - первый
+static MB_ALWAYS_INLINE uint64_t loadBytes64(const uint8_t* p) {
+	uint64_t x;
+	memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	x = __builtin_bswap64(x);
+#endif
+	return x;
+}
+
+static MB_ALWAYS_INLINE void storeBytes64(uint8_t* p, uint64_t x) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	x = __builtin_bswap64(x);
+#endif
+	memcpy(p, &x, sizeof(x));
+}
+
+constexpr uint64_t LSB_BYTES = 0x0101010101010101ull;
+constexpr uint64_t LOW7_BYTES = 0x7F7F7F7F7F7F7F7Full;
+
+// Ненулевые байты -> старший бит байта установлен
+static MB_ALWAYS_INLINE uint64_t nonZeroHighBits(uint64_t x) {
+	return (((x & LOW7_BYTES) + LOW7_BYTES) | x) & ~LOW7_BYTES;
+}
+
+struct ScalarOps {
+	// Бит i байта b -> байт i. Бит 7 отдельно: иначе при умножении он складывается с битом 0 и дает перенос
+	static MB_ALWAYS_INLINE uint64_t spread8(uint32_t b) {
+		return (((b & 0x7F) * 0x0002040810204081ull) & LSB_BYTES) | static_cast<uint64_t>(b >> 7) << 56;
+	}
+
+	// Младший бит байта i -> бит i результата
+	static MB_ALWAYS_INLINE uint32_t gather8(uint64_t x) {
+		return static_cast<uint32_t>((x * 0x0102040810204080ull) >> 56);
+	}
+
+	static MB_ALWAYS_INLINE void unpack32(uint32_t v, uint8_t* out) {
+		for (int k = 0; k < 4; k++) storeBytes64(out + 8 * k, spread8((v >> (8 * k)) & 0xFF));
+	}
+
+	static MB_ALWAYS_INLINE uint32_t pack32(const uint8_t* in) {
+		uint32_t v = 0;
+		for (int k = 0; k < 4; k++) v |= gather8(nonZeroHighBits(loadBytes64(in + 8 * k)) >> 7) << (8 * k);
+		return v;
+	}
+};
+
+static void unpackScalar(const uint16_t* words, size_t bit_offset, size_t quantity, uint8_t* bits) {
+	unpackSpan<ScalarOps>(words, bit_offset, quantity, bits);
+}
+
+static void packScalar(uint16_t* words, size_t bit_offset, size_t quantity, const uint8_t* bits) {
+	packSpan<ScalarOps>(words, bit_offset, quantity, bits);
+}
+
+#ifdef MB_BIT_KERNELS_X86
+
+#define MB_TARGET(isa) __attribute__((target(isa)))
+
+struct Sse2Ops {
+	static MB_TARGET("sse2") inline void unpack16(uint32_t v, uint8_t* out) {
+		const __m128i mask = _mm_set1_epi64x(0x8040201008040201ll);
+		const __m128i x = _mm_set_epi64x(static_cast<long long>(((v >> 8) & 0xFF) * LSB_BYTES), static_cast<long long>((v & 0xFF) * LSB_BYTES));
+		const __m128i r = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(x, mask), mask), _mm_set1_epi8(1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), r);
+	}
+
+	static MB_TARGET("sse2") inline void unpack32(uint32_t v, uint8_t* out) {
+		unpack16(v, out);
+		unpack16(v >> 16, out + 16);
+	}
+
+	static MB_TARGET("sse2") inline uint32_t pack32(const uint8_t* in) {
+		const __m128i zero = _mm_setzero_si128();
+		const uint32_t lo = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), zero));
+		const uint32_t hi = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16)), zero));
+		return ~(lo | hi << 16);
+	}
+};
+
+struct Avx2Ops {
+	static MB_TARGET("avx2") inline void unpack32(uint32_t v, uint8_t* out) {
+		// Байт k числа размножается на байты 8k..8k+7, затем каждый байт проверяется своим битом
+		const __m256i index = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+											   2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+		const __m256i mask = _mm256_set1_epi64x(0x8040201008040201ll);
+		const __m256i x = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(v)), index);
+		const __m256i r = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(x, mask), mask), _mm256_set1_epi8(1));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), r);
+	}
+
+	static MB_TARGET("avx2") inline uint32_t pack32(const uint8_t* in) {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+		return ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_setzero_si256())));
+	}
+};
+
+struct Bmi2Ops {
+	static MB_TARGET("bmi2") inline void unpack32(uint32_t v, uint8_t* out) {
+		for (int k = 0; k < 4; k++) storeBytes64(out + 8 * k, _pdep_u64((v >> (8 * k)) & 0xFF, LSB_BYTES));
+	}
+
+	static MB_TARGET("bmi2") inline uint32_t pack32(const uint8_t* in) {
+		uint32_t v = 0;
+		for (int k = 0; k < 4; k++) v |= static_cast<uint32_t>(_pext_u64(nonZeroHighBits(loadBytes64(in + 8 * k)), ~LOW7_BYTES)) << (8 * k);
+		return v;
+	}
+};
+
+static MB_TARGET("sse2") void unpackSse2(const uint16_t* words, size_t bit_offset, size_t quantity, uint8_t* bits) {
+	unpackSpan<Sse2Ops>(words, bit_offset, quantity, bits);
+}
+
+static MB_TARGET("sse2") void packSse2(uint16_t* words, size_t bit_offset, size_t quantity, const uint8_t* bits) {
+	packSpan<Sse2Ops>(words, bit_offset, quantity, bits);
+}
+
+static MB_TARGET("avx2") void unpackAvx2(const uint16_t* words, size_t bit_offset, size_t quantity, uint8_t* bits) {
+	unpackSpan<Avx2Ops>(words, bit_offset, quantity, bits);
+}
+
+static MB_TARGET("avx2") void packAvx2(uint16_t* words, size_t bit_offset, size_t quantity, const uint8_t* bits) {
+	packSpan<Avx2Ops>(words, bit_offset, quantity, bits);
+}
+
+static MB_TARGET("bmi2") void unpackBmi2(const uint16_t* words, size_t bit_offset, size_t quantity, uint8_t* bits) {
+	unpackSpan<Bmi2Ops>(words, bit_offset, quantity, bits);
+}
+
+static MB_TARGET("bmi2") void packBmi2(uint16_t* words, size_t bit_offset, size_t quantity, const uint8_t* bits) {
+	packSpan<Bmi2Ops>(words, bit_offset, quantity, bits);
+}
+
+#endif // MB_BIT_KERNELS_X86
+
+using UnpackFn = void (*)(const uint16_t*, size_t, size_t, uint8_t*);
+using PackFn = void (*)(uint16_t*, size_t, size_t, const uint8_t*);
+
+static void unpackFirst(const uint16_t* words, size_t bit_offset, size_t quantity, uint8_t* bits);
+static void packFirst(uint16_t* words, size_t bit_offset, size_t quantity, const uint8_t* bits);
+
+// Начальные значения - константная инициализация: выбор реализации при первом вызове, в том числе из статических конструкторов
+static std::atomic<UnpackFn> g_unpack(unpackFirst);
+static std::atomic<PackFn> g_pack(packFirst);
+static std::atomic<BitKernel> g_kernel(BitKernel::AUTO);
+
+bool isBitKernelSupported(BitKernel kernel) {
+#ifdef MB_BIT_KERNELS_X86
+	__builtin_cpu_init();	// Вызов возможен из статических конструкторов, до инициализации libgcc
+#endif
+	switch (kernel) {
+		case BitKernel::AUTO:
+		case BitKernel::SCALAR:
+			return true;
+#ifdef MB_BIT_KERNELS_X86
+		case BitKernel::SSE2:
+			return __builtin_cpu_supports("sse2");
+		case BitKernel::AVX2:
+			return __builtin_cpu_supports("avx2");
+		case BitKernel::BMI2:
+			return __builtin_cpu_supports("bmi2");
+#endif
+		default:
+			return false;
+	}
+}
+
+const char* bitKernelName(BitKernel kernel) {
+	switch (kernel) {
+		case BitKernel::AUTO: return "auto";
+		case BitKernel::SCALAR: return "scalar";
+		case BitKernel::SSE2: return "sse2";
+		case BitKernel::AVX2: return "avx2";
+		case BitKernel::BMI2: return "bmi2";
+	}
+	return "unknown";
+}
+
+bool setBitKernel(BitKernel kernel) {
+	if (!isBitKernelSupported(kernel)) return false;
+	// AVX2 обрабатывает 32 бита одной операцией; PDEP/PEXT на AMD до Zen 3 микрокодовые, поэтому BMI2 только по явному выбору
+	if (kernel == BitKernel::AUTO) {
+		const BitKernel order[] = { BitKernel::AVX2, BitKernel::SSE2 };
+		kernel = BitKernel::SCALAR;
+		for (BitKernel k : order) {
+			if (isBitKernelSupported(k)) {
+				kernel = k;
+				break;
+			}
+		}
+	}
+
+	UnpackFn unpack = unpackScalar;
+	PackFn pack = packScalar;
+#ifdef MB_BIT_KERNELS_X86
+	if (kernel == BitKernel::SSE2) {
+		unpack = unpackSse2;
+		pack = packSse2;
+	}
+	else if (kernel == BitKernel::AVX2) {
+		unpack = unpackAvx2;
+		pack = packAvx2;
+	}
+	else if (kernel == BitKernel::BMI2) {
+		unpack = unpackBmi2;
+		pack = packBmi2;
+	}
+#endif
+	g_unpack.store(unpack, std::memory_order_relaxed);
+	g_pack.store(pack, std::memory_order_relaxed);
+	g_kernel.store(kernel, std::memory_order_relaxed);
+	return true;
+}
+
+BitKernel getBitKernel() {
+	if (g_kernel.load(std::memory_order_relaxed) == BitKernel::AUTO) setBitKernel(BitKernel::AUTO);
+	return g_kernel.load(std::memory_order_relaxed);
+}
+
+static void unpackFirst(const uint16_t* words, size_t bit_offset, size_t quantity, uint8_t* bits) {
+	getBitKernel();
+	g_unpack.load(std::memory_order_relaxed)(words, bit_offset, quantity, bits);
+}
+
+static void packFirst(uint16_t* words, size_t bit_offset, size_t quantity, const uint8_t* bits) {
+	getBitKernel();
+	g_pack.load(std::memory_order_relaxed)(words, bit_offset, quantity, bits);
+}
+
+void unpackWordBits(const uint16_t* words, size_t bit_offset, size_t quantity, uint8_t* bits) {
+	g_unpack.load(std::memory_order_relaxed)(words, bit_offset, quantity, bits);
+}
+
+void packWordBits(uint16_t* words, size_t bit_offset, size_t quantity, const uint8_t* bits) {
+	g_pack.load(std::memory_order_relaxed)(words, bit_offset, quantity, bits);
+}
+
+} // data
+} // mb
@@ -0,0 +1,42 @@
+#ifndef MB_BIT_KERNELS_H
+#define MB_BIT_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mb {
+namespace data {
+
+/** @brief Реализация преобразования между битами слов и массивами BIT (один бит на байт) */
+enum class BitKernel {
+	AUTO,		// Лучшая из поддерживаемых процессором
+	SCALAR,		// 64-битная арифметика, 8 бит за операцию
+	SSE2,		// 16 бит за операцию
+	AVX2,		// 32 бита за операцию
+	BMI2,		// PDEP/PEXT
+};
+
+/** @brief Пакетные преобразования битов карты слов.
+	Биты нумеруются от младшего бита первого слова: бит n - бит (n % 16) слова words[n / 16], как в Map::readWordBits.
+	Обработка идет кусками по 32 бита, хвост - по одному биту. Реализация выбирается один раз по возможностям процессора,
+	сборка не требует флагов -m: векторные и BMI2 функции компилируются с атрибутом target */
+
+// Распаковка quantity битов начиная с бита bit_offset в массив bits (значения 0/1)
+void unpackWordBits(const uint16_t* words, size_t bit_offset, size_t quantity, uint8_t* bits);
+// Упаковка массива bits (любое ненулевое значение - 1) в биты слов начиная с бита bit_offset, остальные биты слов не меняются
+void packWordBits(uint16_t* words, size_t bit_offset, size_t quantity, const uint8_t* bits);
+
+// Эталонные побитовые версии
+void unpackWordBitsRef(const uint16_t* words, size_t bit_offset, size_t quantity, uint8_t* bits);
+void packWordBitsRef(uint16_t* words, size_t bit_offset, size_t quantity, const uint8_t* bits);
+
+// Выбор реализации (бенчмарки и проверки), false - не поддерживается процессором или сборкой
+bool setBitKernel(BitKernel kernel);
+BitKernel getBitKernel();
+bool isBitKernelSupported(BitKernel kernel);
+const char* bitKernelName(BitKernel kernel);
+
+} // data
+} // mb
+
+#endif // MB_BIT_KERNELS_H
@@ -1,19 +1,76 @@
 #include "Map.h"
+#include "Arena.h"
+#include "BitKernels.h"
+#include "WordKernels.h"
+#include <cstring>
 
 #include <new> // для std::bad_alloc
 #include <math.h>
+#include <atomic>
+#include <chrono>
 
 namespace mb {
 namespace data {
 
+static std::atomic<Map::LockWaitHook> g_lock_wait_hook(nullptr);
+
+// Пара регистров в 32-битное значение с порядком mode и обратно. Через memcpy: смещение слова может быть не кратно 4
+template <typename T>
+static inline void loadPair(const WORD* words, T* val, MemMode mode) {
+	static_assert(sizeof(T) == sizeof(DWORD), "32-bit value expected");
+	const DWORD v = orderDWord(words[0] | static_cast<DWORD>(words[1]) << 16, mode);
+	memcpy(val, &v, sizeof(v));
+}
+
+template <typename T>
+static inline void storePair(WORD* words, const T* val, MemMode mode) {
+	static_assert(sizeof(T) == sizeof(DWORD), "32-bit value expected");
+	DWORD v;
+	memcpy(&v, val, sizeof(v));
+	v = orderDWord(v, mode);
+	words[0] = static_cast<WORD>(v);
+	words[1] = static_cast<WORD>(v >> 16);
+}
+
+void Map::setLockWaitHook(LockWaitHook hook) {
+	g_lock_wait_hook.store(hook);
+}
+
+#ifdef MB_MAP_LOCK_METRICS
+// Захват мьютекса с учетом ожидания. Свободный мьютекс берется через try_lock без замера времени
+class TimedLock {
+public:
+	explicit TimedLock(std::mutex& mtx) : m_mtx(mtx) {
+		if (m_mtx.try_lock()) return;
+		auto start = std::chrono::steady_clock::now();
+		m_mtx.lock();
+		Map::LockWaitHook hook = g_lock_wait_hook.load(std::memory_order_relaxed);
+		if (hook) hook(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+	~TimedLock() { m_mtx.unlock(); }
+
+	TimedLock(const TimedLock&) = delete;
+	TimedLock& operator=(const TimedLock&) = delete;
+
+private:
+	std::mutex& m_mtx;
+};
+#define MAP_LOCK() TimedLock lock(m_mtx)
+#else
+#define MAP_LOCK() std::lock_guard<std::mutex> lock(m_mtx)
+#endif
+
 bool Map::bindMap(MapType map_type, WORD start_adr, WORD quantity, void* data_ptr) {
-	if (data_ptr == nullptr) {
+	if (data_ptr == nullptr || quantity == 0) {
 		return false;
 	}
 
+	clearMemory();
+
 	m_map_type = map_type; // Устанавливаем тип карты
 	m_start_adr = start_adr; // Устанавливаем стартовый адрес
 	m_quantity = quantity; // Устанавливаем количество
+	m_end_adr = start_adr + quantity - 1;
 
 	// Если карта битов BIT_MAP
 	if (m_map_type == MapType::BIT_MAP) m_mem_8_ptr = static_cast<BIT*>(data_ptr);
@@ -25,9 +82,27 @@ bool Map::bindMap(MapType map_type, WORD start_adr, WORD quantity, void* data_pt
 	return true;
 }
 
+// Размер памяти карты целыми кэш-линиями: буферы соседних карт не делят линию
+static size_t storageBytes(WORD quantity, MapType map_type) {
+	const size_t bytes = map_type == MapType::BIT_MAP ? quantity * sizeof(BIT) : quantity * sizeof(WORD);
+	return (bytes + MAP_CACHE_LINE - 1) / MAP_CACHE_LINE * MAP_CACHE_LINE;
+}
+
+// Память, выровненная по кэш-линии и заполненная нулями
+static void* allocStorage(size_t bytes) {
+	void* p = ::operator new(bytes, std::align_val_t(MAP_CACHE_LINE), std::nothrow);
+	if (p != nullptr) memset(p, 0, bytes);
+	return p;
+}
+
+static void freeStorage(void* p) {
+	::operator delete(p, std::align_val_t(MAP_CACHE_LINE));
+}
+
 bool Map::initNewMemory(WORD start_adr, WORD quantity, MapType map_type, MemMode mem_mode) {
 	m_start_adr = start_adr;
 	m_quantity = quantity;
+	m_end_adr = start_adr + quantity - 1;
 	return initNewMemory(map_type, mem_mode);
 }
 
@@ -45,16 +120,14 @@ bool Map::initNewMemory(MapType map_type, MemMode mem_mode) {
 
 	// Если карта битов BIT_MAP
 	if (m_map_type == MapType::BIT_MAP) {
-		// Выделяем память и заполняем нулями с помощью () на конце
-		m_mem_8_ptr = new (std::nothrow) BIT[m_quantity];
+		m_mem_8_ptr = static_cast<BIT*>(allocStorage(storageBytes(m_quantity, m_map_type)));
 		if (m_mem_8_ptr == nullptr) {
 			result = false;
 		}
 	}
 	// Если карта слов WORD_MAP
 	else {
-		// Выделяем память и заполняем нулями с помощью () на конце
-		m_mem_16_ptr = new (std::nothrow) WORD[m_quantity]();
+		m_mem_16_ptr = static_cast<WORD*>(allocStorage(storageBytes(m_quantity, m_map_type)));
 		if (m_mem_16_ptr == nullptr) {
 			result = false;
 		}
@@ -66,13 +139,31 @@ bool Map::initNewMemory() {
 	return initNewMemory(MapType::WORD_MAP, MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 }
 
+bool Map::initArenaMemory(WORD start_adr, WORD quantity, MapType map_type, mem::Arena& arena, MemMode mode) {
+	if (quantity == 0) return false;
+	const size_t bytes = storageBytes(quantity, map_type);
+	void* data = arena.allocate(bytes, MAP_CACHE_LINE);
+	if (data == nullptr) return false;
+	memset(data, 0, bytes);
+	if (!bindMap(map_type, start_adr, quantity, data)) return false;
+	m_mem_mode = mode;
+	return true;
+}
+
 void Map::clearMemory() {
+	// Внешнюю память пользователя не освобождаем
+	if (m_bind) {
+		m_mem_16_ptr = nullptr;
+		m_mem_8_ptr = nullptr;
+		m_bind = false;
+		return;
+	}
 	if (m_mem_16_ptr != nullptr) {
-		delete[] m_mem_16_ptr;
+		freeStorage(m_mem_16_ptr);
 		m_mem_16_ptr = nullptr;
 	}
 	if (m_mem_8_ptr != nullptr) {
-		delete[] m_mem_8_ptr;
+		freeStorage(m_mem_8_ptr);
 		m_mem_8_ptr = nullptr;
 	}
 }
@@ -135,7 +226,7 @@ bool Map::printWordMapBits(WORD width) {
 // }
 
 bool Map::readWord(const WORD adr, WORD * const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr || val == nullptr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -144,16 +235,15 @@ bool Map::readWord(const WORD adr, WORD * const val, MemMode mode) {
 }
 
 bool Map::readDWord(WORD adr, DWORD *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || val == nullptr || m_end_adr < adr + 1 || m_map_type == MapType::BIT_MAP) return false;
-	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
-	*val = *(reinterpret_cast<DWORD*>(m_mem_16_ptr + offset));
+	loadPair(m_mem_16_ptr + offset, val, mode);
 	return true;
 }
 
 bool Map::readWords(const WORD adr, const WORD quantity, WORD *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || val == nullptr || quantity == 0 || m_end_adr < adr + quantity - 1 || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -164,7 +254,7 @@ bool Map::readWords(const WORD adr, const WORD quantity, WORD *const val, MemMod
 }
 
 bool Map::writeWord(const WORD adr, const WORD val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || adr > m_end_adr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -173,16 +263,15 @@ bool Map::writeWord(const WORD adr, const WORD val, MemMode mode) {
 }
 
 bool Map::writeDWord(const WORD adr, const DWORD val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr + 1 || m_map_type == MapType::BIT_MAP) return false;
-	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
-	*(reinterpret_cast<DWORD*>(m_mem_16_ptr + offset)) = val;
+	storePair(m_mem_16_ptr + offset, &val, mode);
 	return true;
 }
 
 bool Map::writeWords(const WORD adr, const WORD quantity, WORD *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || val == nullptr || quantity == 0 || m_end_adr < adr + quantity - 1 || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -193,7 +282,7 @@ bool Map::writeWords(const WORD adr, const WORD quantity, WORD *const val, MemMo
 }
 
 bool Map::readWordNBit(const WORD word_adr, const WORD bit_number, BIT *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	
 	if (val == nullptr || bit_number >= WORD_BIT_SIZE || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
@@ -207,36 +296,19 @@ bool Map::readWordNBit(const WORD word_adr, const WORD bit_number, BIT *const va
 }
 
 bool Map::readWordNBits(const WORD word_adr, const WORD bit_number, const WORD quantity, BIT *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (val == nullptr || bit_number >= WORD_BIT_SIZE || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 
-	WORD offset = word_adr - m_start_adr;
-	WORD word_val = *(m_mem_16_ptr + offset);
-	WORD t_bit_number = bit_number;
-	WORD t_word_counter = 0;
-
-	WORD end_word_adr = word_adr + ((bit_number + quantity - 1) / WORD_BIT_SIZE);
-	bool new_word = false;
-
+	const uint32_t end_word_adr = word_adr + (bit_number + quantity - 1) / WORD_BIT_SIZE;
 	if (word_adr < m_start_adr || end_word_adr > m_end_adr) return false;
 
-	for (WORD i = 0; i < quantity; i++) {
-		new_word = t_bit_number == WORD_BIT_SIZE;
-		if (new_word && i != 0) {
-			++t_word_counter;
-			offset = word_adr - m_start_adr + t_word_counter;
-			word_val = *(m_mem_16_ptr + offset);
-			t_bit_number = 0;
-		}
-		*(val + i) = helperReadWordBit(word_val, t_bit_number); 		// Получаем установленный бит по номеру
-		++t_bit_number;
-	}
+	unpackWordBits(m_mem_16_ptr, static_cast<size_t>(word_adr - m_start_adr) * WORD_BIT_SIZE + bit_number, quantity, val);
 	return true;
 }
 
 bool Map::writeWordNBit(const WORD word_adr, const WORD bit_number, const BIT val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	
 	if (bit_number >= WORD_BIT_SIZE || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
@@ -250,38 +322,19 @@ bool Map::writeWordNBit(const WORD word_adr, const WORD bit_number, const BIT va
 }
 
 bool Map::writeWordNBits(const WORD word_adr, const WORD bit_number, const WORD quantity, BIT *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (val == nullptr || bit_number >= WORD_BIT_SIZE || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 
-	WORD offset = word_adr - m_start_adr;
-	WORD word_val = *(m_mem_16_ptr + offset);
-	WORD t_bit_number = bit_number;
-	WORD t_word_counter = 0;
-
-	WORD end_word_adr = word_adr + ((bit_number + quantity - 1) / WORD_BIT_SIZE);
-	bool new_word = false;
-
+	const uint32_t end_word_adr = word_adr + (bit_number + quantity - 1) / WORD_BIT_SIZE;
 	if (word_adr < m_start_adr || end_word_adr > m_end_adr) return false;
 
-	for (WORD i = 0; i < quantity; i++) {
-		new_word = t_bit_number % WORD_BIT_SIZE == 0;
-		if (new_word && i != 0) {
-			*(m_mem_16_ptr + offset) = word_val;
-			++t_word_counter;
-			offset = word_adr - m_start_adr + t_word_counter; // Получаем сдвиг в памяти
-			word_val = *(m_mem_16_ptr + offset); 	// Получаем значение слова из памяти
-			t_bit_number = 0;
-		}
-		word_val = helperWriteWordBit(word_val,t_bit_number,*(val + i));
-		++t_bit_number;
-	}
-	*(m_mem_16_ptr + offset) = word_val;
+	packWordBits(m_mem_16_ptr, static_cast<size_t>(word_adr - m_start_adr) * WORD_BIT_SIZE + bit_number, quantity, val);
 	return true;
 }
 
 bool Map::readWordBit(const WORD bit_adr, BIT* val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	
 	if (val == nullptr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
@@ -299,37 +352,21 @@ bool Map::readWordBit(const WORD bit_adr, BIT* val, MemMode mode) {
 }
 
 bool Map::readWordBits(const WORD bit_adr, const WORD quantity, BIT *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (val == nullptr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 
-	WORD word_adr = bit_adr / WORD_BIT_SIZE;		// Адрес слова соответствующий адресу бита
-	WORD bit_number = bit_adr % WORD_BIT_SIZE;	 	// Номер бита в слове
-	WORD offset = word_adr - m_start_adr;
-	WORD word_val = *(m_mem_16_ptr + offset);
-
 	// Проверяем входит ли в диапазоны
-	WORD end_word_adr = (bit_adr + quantity - 1) / WORD_BIT_SIZE;
-	bool new_word = false;
-
+	const WORD word_adr = bit_adr / WORD_BIT_SIZE;		// Адрес слова соответствующий адресу бита
+	const uint32_t end_word_adr = (bit_adr + quantity - 1) / WORD_BIT_SIZE;
 	if (word_adr < m_start_adr || end_word_adr > m_end_adr) return false;
 
-	for (WORD i = 0; i < quantity; i++) {
-		new_word = bit_number == WORD_BIT_SIZE;
-		if (new_word && i != 0) {
-			++word_adr;
-			offset = word_adr - m_start_adr;		 	// Получаем сдвиг в памяти
-			word_val = *(m_mem_16_ptr + offset); 		// Получаем значение слова из памяти
-			bit_number = 0;
-		}
-		*(val + i) = helperReadWordBit(word_val, bit_number); 		// Получаем установленный бит по номеру
-		++bit_number;
-	}
+	unpackWordBits(m_mem_16_ptr, bit_adr - static_cast<size_t>(m_start_adr) * WORD_BIT_SIZE, quantity, val);
 	return true;
 }
 
 bool Map::writeWordBit(const WORD bit_adr, const BIT val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	
 	if (m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
@@ -347,39 +384,21 @@ bool Map::writeWordBit(const WORD bit_adr, const BIT val, MemMode mode) {
 }
 
 bool Map::writeWordBits(const WORD bit_adr, const WORD quantity, BIT *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (val == nullptr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 
-	WORD word_adr = bit_adr / WORD_BIT_SIZE;		// Адрес слова соответствующий адресу бита
-	WORD bit_number = bit_adr % WORD_BIT_SIZE;	 	// Номер бита в слове
-	WORD offset = word_adr - m_start_adr;
-	WORD word_val = *(m_mem_16_ptr + offset);
-
 	// Проверяем входит ли в диапазоны
-	WORD end_word_adr = (bit_adr + quantity - 1) / WORD_BIT_SIZE;
-	bool new_word = false;
-
+	const WORD word_adr = bit_adr / WORD_BIT_SIZE;		// Адрес слова соответствующий адресу бита
+	const uint32_t end_word_adr = (bit_adr + quantity - 1) / WORD_BIT_SIZE;
 	if (word_adr < m_start_adr || end_word_adr > m_end_adr) return false;
 
-	for (WORD i = 0; i < quantity; i++) {
-		new_word = bit_number == WORD_BIT_SIZE;
-		if (new_word && i != 0) {
-			*(m_mem_16_ptr + offset) = word_val; 	// Запись в память нового регистра
-			++word_adr; 							// Инкременитруем слово
-			offset = word_adr - m_start_adr;		// Получаем сдвиг в памяти
-			word_val = *(m_mem_16_ptr + offset); 	// Получаем значение слова из памяти
-			bit_number = 0;							// Меняем позицию бита на ноль
-		}
-		word_val = helperWriteWordBit(word_val,bit_number,*(val + i));
-		++bit_number;
-	}
-	*(m_mem_16_ptr + offset) = word_val;
+	packWordBits(m_mem_16_ptr, bit_adr - static_cast<size_t>(m_start_adr) * WORD_BIT_SIZE, quantity, val);
 	return true;
 }
 
 bool Map::readBit(const WORD adr, BIT *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (val == nullptr || (adr < m_start_adr || adr > m_end_adr) || m_map_type == MapType::WORD_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	
@@ -390,7 +409,7 @@ bool Map::readBit(const WORD adr, BIT *const val, MemMode mode) {
 }
 
 bool Map::readBits(const WORD adr, const WORD quantity, BIT *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (val == nullptr || quantity == 0 || (adr < m_start_adr || m_end_adr < adr + quantity - 1) || m_map_type == MapType::WORD_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -402,7 +421,7 @@ bool Map::readBits(const WORD adr, const WORD quantity, BIT *const val, MemMode
 }
 
 bool Map::writeBit(const WORD adr, BIT val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if ((adr < m_start_adr || adr > m_end_adr) && m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 
@@ -434,7 +453,7 @@ bool Map::writeBit(const WORD adr, BIT val, MemMode mode) {
 
 
 bool Map::writeBits(const WORD adr, const WORD quantity, BIT *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (val == nullptr || quantity == 0 || (adr < m_start_adr || m_end_adr < adr + quantity - 1) && m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	// Если битовая карта BIT
@@ -446,36 +465,20 @@ bool Map::writeBits(const WORD adr, const WORD quantity, BIT *const val, MemMode
 			*(m_mem_8_ptr + offset + i) = cur_val;
 		}
 	}
-	// Если битовая карта WORD
+	// Если карта слов WORD, адрес - номер бита в глобальной нумерации (слово adr / 16, бит adr % 16), как в writeWordBits
 	else {
-		WORD word_adr;
-		WORD offset;
-		WORD word_val;
-		WORD bit_number = 0;
-
-		// Проверяем входит ли в диапазоны
-		word_adr = adr / WORD_BIT_SIZE; // Получаем адрес слова
-		WORD end_word_adr = (adr + quantity - 1) / WORD_BIT_SIZE;
-
+		const WORD word_adr = adr / WORD_BIT_SIZE;
+		const uint32_t end_word_adr = (adr + quantity - 1) / WORD_BIT_SIZE;
 		if (word_adr < m_start_adr || end_word_adr > m_end_adr) return false;
 
-		for (WORD i = 0; i < quantity; i++) {
-			if (bit_number > WORD_BIT_SIZE - 1 || i == 0) {
-				word_adr = adr / WORD_BIT_SIZE; 			// Получаем адрес слова
-				bit_number = adr % WORD_BIT_SIZE;	 	// Получаем номер бита
-				offset = word_adr - m_start_adr;		 	// Получаем сдвиг в памяти
-				*(m_mem_16_ptr + offset) = word_val; // Получаем значение слова из памяти
-			}
-			*val = (word_val >> bit_number) & 1; 		// Получаем установленный бит по номеру
-			++bit_number;
-		}
+		packWordBits(m_mem_16_ptr, adr - static_cast<size_t>(m_start_adr) * WORD_BIT_SIZE, quantity, val);
 	}
 	
 	return true;
 }
 
 bool Map::readUInt8(const WORD adr, uint8_t *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr || val == nullptr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -484,7 +487,7 @@ bool Map::readUInt8(const WORD adr, uint8_t *const val, MemMode mode) {
 }
 
 bool Map::readUInt16(const WORD adr, uint16_t * const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr || val == nullptr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -493,16 +496,15 @@ bool Map::readUInt16(const WORD adr, uint16_t * const val, MemMode mode) {
 }
 
 bool Map::readUInt32(const WORD adr, uint32_t *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || val == nullptr || m_end_adr < adr + 1 || m_map_type == MapType::BIT_MAP) return false;
-	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
-	*val = *(reinterpret_cast<DWORD*>(m_mem_16_ptr + offset));
+	loadPair(m_mem_16_ptr + offset, val, mode);
 	return true;
 }
 
 bool Map::readInt8(const WORD adr, int8_t *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr || val == nullptr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -511,7 +513,7 @@ bool Map::readInt8(const WORD adr, int8_t *const val, MemMode mode) {
 }
 
 bool Map::readInt16(const WORD adr, int16_t * const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr || val == nullptr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -520,16 +522,15 @@ bool Map::readInt16(const WORD adr, int16_t * const val, MemMode mode) {
 }
 
 bool Map::readInt32(const WORD adr, int32_t *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || val == nullptr || m_end_adr < adr + 1 || m_map_type == MapType::BIT_MAP) return false;
-	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
-	*val = *(reinterpret_cast<DWORD*>(m_mem_16_ptr + offset));
+	loadPair(m_mem_16_ptr + offset, val, mode);
 	return true;
 }
 
 bool Map::readFloat16(const WORD adr, float *const val, uint8_t precision, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr || val == nullptr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -538,16 +539,15 @@ bool Map::readFloat16(const WORD adr, float *const val, uint8_t precision, MemMo
 }
 
 bool Map::readFloat32(const WORD adr, float *const val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || val == nullptr || m_end_adr < adr + 1 || m_map_type == MapType::BIT_MAP) return false;
-	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
-	*val = *(reinterpret_cast<float*>(m_mem_16_ptr + offset));
+	loadPair(m_mem_16_ptr + offset, val, mode);
 	return true;
 }
 
 bool Map::writeUInt8(const WORD adr, const uint8_t val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -556,7 +556,7 @@ bool Map::writeUInt8(const WORD adr, const uint8_t val, MemMode mode) {
 }
 
 bool Map::writeUInt16(const WORD adr, const uint16_t val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -565,16 +565,15 @@ bool Map::writeUInt16(const WORD adr, const uint16_t val, MemMode mode) {
 }
 
 bool Map::writeUInt32(const WORD adr, const uint32_t val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr  || m_end_adr < adr + 1 || m_map_type == MapType::BIT_MAP) return false;
-	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
-	*(reinterpret_cast<DWORD*>(m_mem_16_ptr + offset)) = val; 
+	storePair(m_mem_16_ptr + offset, &val, mode);
 	return true;
 }
 
 bool Map::writeInt8(const WORD adr, const int8_t val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -583,7 +582,7 @@ bool Map::writeInt8(const WORD adr, const int8_t val, MemMode mode) {
 }
 
 bool Map::writeInt16(const WORD adr, const int16_t val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -592,16 +591,15 @@ bool Map::writeInt16(const WORD adr, const int16_t val, MemMode mode) {
 }
 
 bool Map::writeInt32(const WORD adr, const int32_t val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr + 1 || m_map_type == MapType::BIT_MAP) return false;
-	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
-	*(reinterpret_cast<DWORD*>(m_mem_16_ptr + offset)) = val; 
+	storePair(m_mem_16_ptr + offset, &val, mode);
 	return true;
 }
 
 bool Map::writeFloat16(const WORD adr, const float val, uint8_t precision, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr || m_map_type == MapType::BIT_MAP) return false;
 	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
@@ -610,14 +608,270 @@ bool Map::writeFloat16(const WORD adr, const float val, uint8_t precision, MemMo
 }
 
 bool Map::writeFloat32(const WORD adr, const float val, MemMode mode) {
-	std::lock_guard<std::mutex> lock(m_mtx);
+	MAP_LOCK();
 	if (adr < m_start_adr || m_end_adr < adr + 1 || m_map_type == MapType::BIT_MAP) return false;
-	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
 	WORD offset = adr - m_start_adr;
-	*(reinterpret_cast<float*>(m_mem_16_ptr + offset)) = val; 
+	storePair(m_mem_16_ptr + offset, &val, mode);
 	return true;
 }
 
 
+
+bool Map::readUInt32Array(const WORD adr, const WORD count, uint32_t *const vals, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || vals == nullptr || count == 0 || m_end_adr < adr + 2 * count - 1 || m_map_type == MapType::BIT_MAP) return false;
+	wordsToDWords(m_mem_16_ptr + (adr - m_start_adr), count, vals, mode);
+	return true;
+}
+
+bool Map::readInt32Array(const WORD adr, const WORD count, int32_t *const vals, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || vals == nullptr || count == 0 || m_end_adr < adr + 2 * count - 1 || m_map_type == MapType::BIT_MAP) return false;
+	wordsToDWords(m_mem_16_ptr + (adr - m_start_adr), count, vals, mode);
+	return true;
+}
+
+bool Map::readFloat32Array(const WORD adr, const WORD count, float *const vals, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || vals == nullptr || count == 0 || m_end_adr < adr + 2 * count - 1 || m_map_type == MapType::BIT_MAP) return false;
+	wordsToDWords(m_mem_16_ptr + (adr - m_start_adr), count, vals, mode);
+	return true;
+}
+
+bool Map::readFloat16Array(const WORD adr, const WORD count, float *const vals, uint8_t precision, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || vals == nullptr || count == 0 || m_end_adr < adr + count - 1 || m_map_type == MapType::BIT_MAP) return false;
+	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
+	const WORD* words = m_mem_16_ptr + (adr - m_start_adr);
+	const double divider = pow(10, precision);
+	for (WORD i = 0; i < count; i++) vals[i] = static_cast<int16_t>(words[i]) / divider;
+	return true;
+}
+
+bool Map::writeUInt32Array(const WORD adr, const WORD count, const uint32_t *const vals, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || vals == nullptr || count == 0 || m_end_adr < adr + 2 * count - 1 || m_map_type == MapType::BIT_MAP) return false;
+	dwordsToWords(vals, count, m_mem_16_ptr + (adr - m_start_adr), mode);
+	return true;
+}
+
+bool Map::writeInt32Array(const WORD adr, const WORD count, const int32_t *const vals, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || vals == nullptr || count == 0 || m_end_adr < adr + 2 * count - 1 || m_map_type == MapType::BIT_MAP) return false;
+	dwordsToWords(vals, count, m_mem_16_ptr + (adr - m_start_adr), mode);
+	return true;
+}
+
+bool Map::writeFloat32Array(const WORD adr, const WORD count, const float *const vals, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || vals == nullptr || count == 0 || m_end_adr < adr + 2 * count - 1 || m_map_type == MapType::BIT_MAP) return false;
+	dwordsToWords(vals, count, m_mem_16_ptr + (adr - m_start_adr), mode);
+	return true;
+}
+
+bool Map::writeFloat16Array(const WORD adr, const WORD count, const float *const vals, uint8_t precision, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || vals == nullptr || count == 0 || m_end_adr < adr + count - 1 || m_map_type == MapType::BIT_MAP) return false;
+	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
+	WORD* words = m_mem_16_ptr + (adr - m_start_adr);
+	const float multiplier = powf(10, precision);
+	for (WORD i = 0; i < count; i++) words[i] = static_cast<int16_t>(vals[i] * multiplier);
+	return true;
+}
+
+static uint64_t metaNowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Map::addMetaRange(const WORD start_adr, const WORD quantity) {
+	MAP_LOCK();
+	const uint32_t end_adr = start_adr + quantity - 1;
+	if (quantity == 0 || start_adr < m_start_adr || end_adr > m_end_adr) return false;
+	auto pos = std::lower_bound(m_meta.begin(), m_meta.end(), start_adr, [](const MetaRange& r, WORD adr) { return r.start < adr; });
+	if (pos != m_meta.end() && pos->start <= end_adr) return false;
+	if (pos != m_meta.begin() && (pos - 1)->end >= start_adr) return false;
+	m_meta.insert(pos, MetaRange{ start_adr, static_cast<WORD>(end_adr), MapMeta() });
+	return true;
+}
+
+void Map::clearMetaRanges() {
+	MAP_LOCK();
+	m_meta.clear();
+}
+
+// Вызывается под блокировкой карты
+void Map::stampMeta(const WORD adr, const uint32_t quantity, const MapQuality quality, const uint8_t exception_code, uint64_t timestamp_ns) {
+	if (m_meta.empty() || quantity == 0) return;
+	if (timestamp_ns == 0) timestamp_ns = metaNowNs();
+	const uint32_t last = adr + quantity - 1;
+	auto it = std::upper_bound(m_meta.begin(), m_meta.end(), adr, [](WORD a, const MetaRange& r) { return a < r.start; });
+	if (it != m_meta.begin() && (it - 1)->end >= adr) --it;
+	for (; it != m_meta.end() && it->start <= last; ++it) {
+		it->meta.timestamp_ns = timestamp_ns;
+		it->meta.quality = quality;
+		it->meta.exception_code = exception_code;
+		++it->meta.sequence;
+	}
+}
+
+// Вызывается под блокировкой карты. Самый старый диапазон, пересекающий [adr, adr + quantity - 1], без диапазонов - UNKNOWN
+void Map::collectMeta(const WORD adr, const uint32_t quantity, MapMeta *const meta) const {
+	if (meta == nullptr) return;
+	*meta = MapMeta();
+	const uint32_t last = adr + quantity - 1;
+	auto it = std::upper_bound(m_meta.begin(), m_meta.end(), adr, [](WORD a, const MetaRange& r) { return a < r.start; });
+	if (it != m_meta.begin() && (it - 1)->end >= adr) --it;
+	bool found = false;
+	for (; it != m_meta.end() && it->start <= last; ++it) {
+		if (!found || it->meta.timestamp_ns < meta->timestamp_ns) *meta = it->meta;
+		found = true;
+	}
+}
+
+bool Map::updateWords(const WORD adr, const WORD quantity, WORD *const val, uint64_t timestamp_ns) {
+	if (timestamp_ns == 0 && (!m_meta.empty() || m_observer)) timestamp_ns = metaNowNs();	// Время берется до блокировки
+	MAP_LOCK();
+	if (adr < m_start_adr || val == nullptr || quantity == 0 || m_end_adr < adr + quantity - 1 || m_map_type == MapType::BIT_MAP) return false;
+	if (m_observer) m_observer->onWords(adr, quantity, m_mem_16_ptr + (adr - m_start_adr), val, timestamp_ns);
+	memcpy(m_mem_16_ptr + (adr - m_start_adr), val, quantity * sizeof(WORD));
+	stampMeta(adr, quantity, MapQuality::GOOD, 0, timestamp_ns);
+	return true;
+}
+
+bool Map::updateBits(const WORD adr, const WORD quantity, BIT *const val, uint64_t timestamp_ns) {
+	if (timestamp_ns == 0 && (!m_meta.empty() || m_observer)) timestamp_ns = metaNowNs();
+	MAP_LOCK();
+	if (val == nullptr || quantity == 0) return false;
+	if (m_map_type == MapType::BIT_MAP) {
+		if (adr < m_start_adr || m_end_adr < adr + quantity - 1) return false;
+		BIT* bits = m_mem_8_ptr + (adr - m_start_adr);
+		if (m_observer) m_observer->onBits(adr, quantity, bits, val, timestamp_ns);
+		for (WORD i = 0; i < quantity; i++) bits[i] = val[i] != 0;
+		stampMeta(adr, quantity, MapQuality::GOOD, 0, timestamp_ns);
+	}
+	// Карта слов: адрес бита в глобальной нумерации, как у writeBits, метаданные - по адресам слов
+	else {
+		const WORD word_adr = adr / WORD_BIT_SIZE;
+		const uint32_t end_word_adr = (adr + quantity - 1) / WORD_BIT_SIZE;
+		if (word_adr < m_start_adr || end_word_adr > m_end_adr) return false;
+		const size_t bit_offset = adr - static_cast<size_t>(m_start_adr) * WORD_BIT_SIZE;
+		if (m_observer == nullptr) packWordBits(m_mem_16_ptr, bit_offset, quantity, val);
+		// Наблюдателю - прежние и новые слова, частями по OBSERVE_WORDS слов
+		else {
+			constexpr size_t OBSERVE_WORDS = 128;
+			WORD old_words[OBSERVE_WORDS + 1];
+			for (size_t done = 0; done < quantity;) {
+				const size_t first = bit_offset + done;
+				const size_t n = std::min<size_t>(quantity - done, OBSERVE_WORDS * WORD_BIT_SIZE - first % WORD_BIT_SIZE);
+				const size_t w0 = first / WORD_BIT_SIZE, w1 = (first + n - 1) / WORD_BIT_SIZE;
+				memcpy(old_words, m_mem_16_ptr + w0, (w1 - w0 + 1) * sizeof(WORD));
+				packWordBits(m_mem_16_ptr, first, n, val + done);
+				m_observer->onWords(static_cast<WORD>(m_start_adr + w0), static_cast<WORD>(w1 - w0 + 1), old_words, m_mem_16_ptr + w0, timestamp_ns);
+				done += n;
+			}
+		}
+		stampMeta(word_adr, end_word_adr - word_adr + 1, MapQuality::GOOD, 0, timestamp_ns);
+	}
+	return true;
+}
+
+bool Map::setQuality(const WORD adr, const WORD quantity, const MapQuality quality, const uint8_t exception_code, uint64_t timestamp_ns) {
+	if (m_meta.empty()) return true;
+	if (timestamp_ns == 0) timestamp_ns = metaNowNs();
+	MAP_LOCK();
+	if (adr < m_start_adr || quantity == 0 || m_end_adr < adr + quantity - 1) return false;
+	stampMeta(adr, quantity, quality, exception_code, timestamp_ns);
+	return true;
+}
+
+void Map::setObserver(MapObserver* observer) {
+	MAP_LOCK();
+	m_observer = observer;
+}
+
+bool Map::readMeta(const WORD adr, MapMeta *const meta) {
+	MAP_LOCK();
+	if (meta == nullptr || adr < m_start_adr || adr > m_end_adr) return false;
+	collectMeta(adr, 1, meta);
+	return true;
+}
+
+bool Map::readWords(const WORD adr, const WORD quantity, WORD *const val, MapMeta *const meta, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || val == nullptr || quantity == 0 || m_end_adr < adr + quantity - 1 || m_map_type == MapType::BIT_MAP) return false;
+	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
+	memcpy(val, m_mem_16_ptr + (adr - m_start_adr), quantity * sizeof(WORD));
+	collectMeta(adr, quantity, meta);
+	return true;
+}
+
+bool Map::readBits(const WORD adr, const WORD quantity, BIT *const val, MapMeta *const meta, MemMode mode) {
+	MAP_LOCK();
+	if (val == nullptr || quantity == 0 || (adr < m_start_adr || m_end_adr < adr + quantity - 1) || m_map_type == MapType::WORD_MAP) return false;
+	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
+	memcpy(val, m_mem_8_ptr + (adr - m_start_adr), quantity);
+	collectMeta(adr, quantity, meta);
+	return true;
+}
+
+bool Map::readUInt16(const WORD adr, uint16_t *const val, MapMeta *const meta, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || m_end_adr < adr || val == nullptr || m_map_type == MapType::BIT_MAP) return false;
+	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
+	*val = m_mem_16_ptr[adr - m_start_adr];
+	collectMeta(adr, 1, meta);
+	return true;
+}
+
+bool Map::readInt16(const WORD adr, int16_t *const val, MapMeta *const meta, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || m_end_adr < adr || val == nullptr || m_map_type == MapType::BIT_MAP) return false;
+	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
+	*val = static_cast<int16_t>(m_mem_16_ptr[adr - m_start_adr]);
+	collectMeta(adr, 1, meta);
+	return true;
+}
+
+bool Map::readUInt32(const WORD adr, uint32_t *const val, MapMeta *const meta, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || val == nullptr || m_end_adr < adr + 1 || m_map_type == MapType::BIT_MAP) return false;
+	loadPair(m_mem_16_ptr + (adr - m_start_adr), val, mode);
+	collectMeta(adr, 2, meta);
+	return true;
+}
+
+bool Map::readInt32(const WORD adr, int32_t *const val, MapMeta *const meta, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || val == nullptr || m_end_adr < adr + 1 || m_map_type == MapType::BIT_MAP) return false;
+	loadPair(m_mem_16_ptr + (adr - m_start_adr), val, mode);
+	collectMeta(adr, 2, meta);
+	return true;
+}
+
+bool Map::readFloat16(const WORD adr, float *const val, MapMeta *const meta, uint8_t precision, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || m_end_adr < adr || val == nullptr || m_map_type == MapType::BIT_MAP) return false;
+	if (mode == MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE);
+	*val = static_cast<int16_t>(m_mem_16_ptr[adr - m_start_adr]) / pow(10, precision);
+	collectMeta(adr, 1, meta);
+	return true;
+}
+
+bool Map::readFloat32(const WORD adr, float *const val, MapMeta *const meta, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || val == nullptr || m_end_adr < adr + 1 || m_map_type == MapType::BIT_MAP) return false;
+	loadPair(m_mem_16_ptr + (adr - m_start_adr), val, mode);
+	collectMeta(adr, 2, meta);
+	return true;
+}
+
+bool Map::readFloat32Array(const WORD adr, const WORD count, float *const vals, MapMeta *const meta, MemMode mode) {
+	MAP_LOCK();
+	if (adr < m_start_adr || vals == nullptr || count == 0 || m_end_adr < adr + 2 * count - 1 || m_map_type == MapType::BIT_MAP) return false;
+	wordsToDWords(m_mem_16_ptr + (adr - m_start_adr), count, vals, mode);
+	collectMeta(adr, 2 * count, meta);
+	return true;
+}
+
 } // data
 } // mb
\ No newline at end of file
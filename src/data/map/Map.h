@@ -10,6 +10,10 @@
 #include <mutex>
 
 namespace mb {
+namespace mem {
+class Arena;
+}
+
 namespace data {
 
 #define WORD_BIT_SIZE 16
@@ -37,9 +41,42 @@ enum class MemMode {
 
 constexpr MemMode default_mem_mode = MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE;
 
+// Размер кэш-линии: выравнивание объекта Map, его мьютекса и памяти карты
+constexpr size_t MAP_CACHE_LINE = 64;
+
+/** @brief Качество значений диапазона карты */
+enum class MapQuality : uint8_t {
+	UNKNOWN,		// Диапазон еще не обновлялся
+	GOOD,
+	COMM_FAIL,		// Нет ответа, ошибка CRC, неверный ответ, устройство исключено из опроса
+	EXCEPTION,		// Устройство ответило исключением, код в exception_code
+};
+
+/** @brief Метаданные диапазона карты: время последнего обновления (steady_clock, нс), качество и номер обновления */
+struct MapMeta {
+	uint64_t timestamp_ns = 0;
+	uint32_t sequence = 0;
+	MapQuality quality = MapQuality::UNKNOWN;
+	uint8_t exception_code = 0;
+};
+
+/** @brief Наблюдатель записи ответов устройства в карту (updateWords/updateBits), например подписки на изменения.
+	Вызывается под блокировкой карты: old_val - значения до записи, new_val - записываемые (для битов любое ненулевое значение - 1).
+	Запись битов в карту слов передается в onWords по затронутым словам. Обработчик должен быть коротким и не обращаться к карте */
+class MapObserver {
+public:
+	virtual ~MapObserver() {}
+	virtual void onWords(const WORD adr, const WORD quantity, const WORD* old_val, const WORD* new_val, const uint64_t timestamp_ns) = 0;
+	virtual void onBits(const WORD adr, const WORD quantity, const BIT* old_val, const BIT* new_val, const uint64_t timestamp_ns) = 0;
+};
+
 /** @brief Класс отвечает за создание(привязки) карты памяти последовательных адресов.
 	Карта памяти может быть в виде битов (BIT) или слов (WORD) и имеет начальный адрес и количество регистров (слов или битов)
 	Предоставляет функции чтение и записи в карту памяти 
+	Раскладка рассчитана на массивы карт, с которыми работают разные потоки: объект выровнен по кэш-линии,
+	редко изменяемые поля (границы, указатели) отделены от мьютекса, который занимает свою линию,
+	собственная память карты выделяется целыми выровненными линиями. DWORD и float читаются через memcpy,
+	поэтому адрес может быть любым словом карты
 */
 
 // Пример. Карта памяти, начальный адрес 231, количество регистров 8
@@ -54,16 +91,29 @@ constexpr MemMode default_mem_mode = MemMode::LITTLE_ENDIAN_BYTE_SWAP_MODE;
 // (243) | 5401
 // (245) | 19084
 
-class Map {
+class alignas(MAP_CACHE_LINE) Map {
 public:
-	Map() : m_mem_16_ptr(nullptr), m_mem_8_ptr(nullptr) {}
+	Map() : m_start_adr(0),
+			  m_end_adr(0),
+			  m_quantity(0),
+			  m_map_type(MapType::WORD_MAP),
+			  m_mem_mode(default_mem_mode),
+			  m_mem_8_ptr(nullptr),
+			  m_mem_16_ptr(nullptr),
+			  m_bind(false) {}
 	Map(WORD start_adr, WORD quantity) : m_start_adr(start_adr), 
 													 m_quantity(quantity),
+													 m_map_type(MapType::WORD_MAP),
+													 m_mem_mode(default_mem_mode),
+													 m_mem_8_ptr(nullptr),
 													 m_mem_16_ptr(nullptr),
-													 m_mem_8_ptr(nullptr) {
+													 m_bind(false) {
 		m_end_adr = m_start_adr + quantity - 1;
 	}
-	~Map() {}
+	~Map() { clearMemory(); }
+
+	Map(const Map&) = delete;
+	Map& operator=(const Map&) = delete;
 
 	bool bindMap(MapType map_type, WORD start_adr, WORD quantity, void *data_ptr); // Привязка карты памяти к внешнему указателю на память (например на структуру пользователя)
 																										  // В этом случае чтение и запись в пользовательскую память необходимо будет производить
@@ -72,8 +122,15 @@ public:
 	bool initNewMemory(WORD start_adr, WORD quantity, MapType map_type, MemMode mode = default_mem_mode); 		  // Инициализация новой памяти
 	bool initNewMemory(MapType map_type, MemMode mode = default_mem_mode); 		  
 	bool initNewMemory(); 														  
+	// Инициализация памяти из арены (например, на huge pages), память освобождается вместе с ареной
+	bool initArenaMemory(WORD start_adr, WORD quantity, MapType map_type, mem::Arena& arena, MemMode mode = default_mem_mode);
 	
-	void clearMemory();												// Очистка выделенной памяти
+	void clearMemory();												// Очистка выделенной памяти (привязанная внешняя память только отвязывается)
+
+	WORD getStartAdr() const { return m_start_adr; }
+	WORD getEndAdr() const { return m_end_adr; }
+	WORD getQuantity() const { return m_quantity; }
+	MapType getMapType() const { return m_map_type; }
 
 	void setMapType(MapType map_type);							// Установка типа карты WORD или BIT
 
@@ -124,6 +181,36 @@ public:
 	// Запись массива битов
 	bool writeBits(const WORD adr, const WORD quantity, BIT *const val, MemMode mode = default_mem_mode);
 
+	/* Метаданные диапазонов. Хранятся на опрашиваемый диапазон, а не на слово (24 байта на диапазон).
+	   Диапазоны задаются до начала работы потоков, не пересекаются и лежат внутри карты. Адреса для карты битов - адреса битов.
+	   Без диапазонов update* работают как write*, а чтения с метаданными возвращают UNKNOWN */
+	bool addMetaRange(const WORD start_adr, const WORD quantity);
+	void clearMetaRanges();
+	size_t getMetaRangeCount() const { return m_meta.size(); }
+
+	// Запись ответа устройства: значения и метаданные всех диапазонов, пересекающих запись, под одной блокировкой.
+	// timestamp_ns = 0 - текущее время steady_clock
+	bool updateWords(const WORD adr, const WORD quantity, WORD *const val, uint64_t timestamp_ns = 0);
+	bool updateBits(const WORD adr, const WORD quantity, BIT *const val, uint64_t timestamp_ns = 0);
+	// Ошибка опроса: значения не меняются, качество и время диапазонов обновляются
+	bool setQuality(const WORD adr, const WORD quantity, const MapQuality quality, const uint8_t exception_code = 0, uint64_t timestamp_ns = 0);
+	// Метаданные диапазона, содержащего адрес
+	bool readMeta(const WORD adr, MapMeta *const meta);
+	// Наблюдатель update*, задается до начала работы потоков, nullptr - отключить
+	void setObserver(MapObserver* observer);
+	MapObserver* getObserver() const { return m_observer; }
+
+	// Чтения вместе с метаданными. Если значение захватывает несколько диапазонов, возвращаются метаданные самого старого
+	bool readWords(const WORD adr, const WORD quantity, WORD *const val, MapMeta *const meta, MemMode mode = default_mem_mode);
+	bool readBits(const WORD adr, const WORD quantity, BIT *const val, MapMeta *const meta, MemMode mode = default_mem_mode);
+	bool readUInt16(const WORD adr, uint16_t *const val, MapMeta *const meta, MemMode mode = default_mem_mode);
+	bool readInt16(const WORD adr, int16_t *const val, MapMeta *const meta, MemMode mode = default_mem_mode);
+	bool readUInt32(const WORD adr, uint32_t *const val, MapMeta *const meta, MemMode mode = default_mem_mode);
+	bool readInt32(const WORD adr, int32_t *const val, MapMeta *const meta, MemMode mode = default_mem_mode);
+	bool readFloat16(const WORD adr, float *const val, MapMeta *const meta, uint8_t precision = 1, MemMode mode = default_mem_mode);
+	bool readFloat32(const WORD adr, float *const val, MapMeta *const meta, MemMode mode = default_mem_mode);
+	bool readFloat32Array(const WORD adr, const WORD count, float *const vals, MapMeta *const meta, MemMode mode = default_mem_mode);
+
 	/* Чтение|Запись и интерпретирование в нужное представление int signed|int unsigned|float */
 	bool readUInt8(const WORD adr, uint8_t *const val, MemMode mode = default_mem_mode);
 	bool readUInt16(const WORD adr, uint16_t *const val, MemMode mode = default_mem_mode);
@@ -143,6 +230,24 @@ public:
 	bool writeFloat16(const WORD adr, const float val, uint8_t precision = 1, MemMode mode = default_mem_mode);
 	bool writeFloat32(const WORD adr, const float val, MemMode mode = default_mem_mode);
 
+	/* Массивы значений: count значений начиная с adr за одну блокировку и одну проверку границ.
+	   32-битные значения занимают 2 * count слов, порядок регистров и байтов задает mode (см. orderDWord в WordKernels.h),
+	   по умолчанию младшее слово первым, как у одиночных readUInt32/readFloat32.
+	   Float16 - int16 с precision знаками после запятой, как readFloat16 */
+	bool readUInt32Array(const WORD adr, const WORD count, uint32_t *const vals, MemMode mode = default_mem_mode);
+	bool readInt32Array(const WORD adr, const WORD count, int32_t *const vals, MemMode mode = default_mem_mode);
+	bool readFloat32Array(const WORD adr, const WORD count, float *const vals, MemMode mode = default_mem_mode);
+	bool readFloat16Array(const WORD adr, const WORD count, float *const vals, uint8_t precision = 1, MemMode mode = default_mem_mode);
+
+	bool writeUInt32Array(const WORD adr, const WORD count, const uint32_t *const vals, MemMode mode = default_mem_mode);
+	bool writeInt32Array(const WORD adr, const WORD count, const int32_t *const vals, MemMode mode = default_mem_mode);
+	bool writeFloat32Array(const WORD adr, const WORD count, const float *const vals, MemMode mode = default_mem_mode);
+	bool writeFloat16Array(const WORD adr, const WORD count, const float *const vals, uint8_t precision = 1, MemMode mode = default_mem_mode);
+
+	// Обработчик времени ожидания мьютекса карт (нс). Вызывается только в сборке с MB_MAP_LOCK_METRICS и только когда мьютекс был занят
+	using LockWaitHook = void (*)(uint64_t wait_ns);
+	static void setLockWaitHook(LockWaitHook hook);
+
 	bool printBitMap(WORD width); // Вывод карты битов в консоль
 	bool printWordMap(WORD width); // Вывод карты слов в консоль
 	bool printWordMapBits(WORD width); // Вывод карты слов в консоль в битовом представлении
@@ -174,13 +279,24 @@ private:
 	BIT* m_mem_8_ptr;   	// Указатель BIT на начало области карты памяти 
 	WORD* m_mem_16_ptr; 	// Указатель WORD на начало области карты памяти
 
-	std::string m_name; 	// Наименование карты памяти
-
 	bool m_bind; 			// Привязана ли карта памяти к внешнему указателю на память или нет (например на структуру пользователя)
 								// В этом случае чтение и запись в пользовательскую память необходимо будет производить только через картку памяти Map, т.к. здесь есть mutex
 								// только через картку памяти Map, если хотим безопасную работу с данными за счет mutex
 
-	std::mutex m_mtx;		// Мьютекс для разделения доступа при запросах разными потоками
+	std::string m_name; 	// Наименование карты памяти
+
+	struct MetaRange {
+		WORD start;
+		WORD end;
+		MapMeta meta;
+	};
+	std::vector<MetaRange> m_meta;	// Метаданные диапазонов по возрастанию адреса
+	MapObserver* m_observer = nullptr;
+
+	void stampMeta(const WORD adr, const uint32_t quantity, const MapQuality quality, const uint8_t exception_code, uint64_t timestamp_ns);
+	void collectMeta(const WORD adr, const uint32_t quantity, MapMeta *const meta) const;
+
+	alignas(MAP_CACHE_LINE) std::mutex m_mtx;		// Мьютекс для разделения доступа при запросах разными потоками, на отдельной кэш-линии
 };
 
 } // data
@@ -0,0 +1,209 @@
+#include "WordKernels.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MB_WORD_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace mb {
+namespace data {
+
+/* Перестановки в памяти: пара регистров - 4 байта [B0 B1 B2 B3] (B0 - младший байт первого регистра),
+   значение - 4 байта в порядке хоста. Для little endian хоста перестановка - выбор байтов по таблице,
+   векторные версии применяют ее к 4 (SSSE3) или 8 (AVX2) значениям за раз. Хвост и big endian хост - скалярно */
+
+static void wordsToDWordsScalar(const uint16_t* words, size_t count, void* dwords, MemMode mode) {
+	uint8_t* out = static_cast<uint8_t*>(dwords);
+	for (size_t i = 0; i < count; i++) {
+		const uint32_t v = orderDWord(words[2 * i] | static_cast<uint32_t>(words[2 * i + 1]) << 16, mode);
+		memcpy(out + 4 * i, &v, sizeof(v));
+	}
+}
+
+static void dwordsToWordsScalar(const void* dwords, size_t count, uint16_t* words, MemMode mode) {
+	const uint8_t* in = static_cast<const uint8_t*>(dwords);
+	for (size_t i = 0; i < count; i++) {
+		uint32_t v;
+		memcpy(&v, in + 4 * i, sizeof(v));
+		v = orderDWord(v, mode);
+		words[2 * i] = static_cast<uint16_t>(v);
+		words[2 * i + 1] = static_cast<uint16_t>(v >> 16);
+	}
+}
+
+#if defined(MB_WORD_KERNELS_X86) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+#define MB_TARGET(isa) __attribute__((target(isa)))
+
+// Номера байтов пары для каждого байта значения, nullptr - без перестановки
+static const uint8_t* shuffleOf(MemMode mode) {
+	static const uint8_t rotate[4] = { 2, 3, 0, 1 };
+	static const uint8_t swap_halves[4] = { 1, 0, 3, 2 };
+	static const uint8_t swap_all[4] = { 3, 2, 1, 0 };
+	switch (mode) {
+		case MemMode::BIG_ENDIAN_MODE: return rotate;
+		case MemMode::LITTLE_ENDIAN_MODE: return swap_halves;
+		case MemMode::BIG_ENDIAN_BYTE_SWAP_MODE: return swap_all;
+		default: return nullptr;
+	}
+}
+
+static __m128i shuffleMask(const uint8_t* order) {
+	alignas(16) uint8_t mask[16];
+	for (int i = 0; i < 16; i++) mask[i] = static_cast<uint8_t>((i & ~3) + order[i & 3]);
+	return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+}
+
+// Перестановка обратна сама себе: одна функция для обоих направлений
+static MB_TARGET("ssse3") void shuffleSsse3(const void* src, size_t count, void* dst, MemMode mode) {
+	const uint8_t* order = shuffleOf(mode);
+	const uint8_t* in = static_cast<const uint8_t*>(src);
+	uint8_t* out = static_cast<uint8_t*>(dst);
+	if (order == nullptr) {
+		memmove(out, in, count * 4);
+		return;
+	}
+	const __m128i mask = shuffleMask(order);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i), _mm_shuffle_epi8(v, mask));
+	}
+	for (; i < count; i++) {
+		for (int b = 0; b < 4; b++) out[4 * i + b] = in[4 * i + order[b]];
+	}
+}
+
+static MB_TARGET("avx2") void shuffleAvx2(const void* src, size_t count, void* dst, MemMode mode) {
+	const uint8_t* order = shuffleOf(mode);
+	const uint8_t* in = static_cast<const uint8_t*>(src);
+	uint8_t* out = static_cast<uint8_t*>(dst);
+	if (order == nullptr) {
+		memmove(out, in, count * 4);
+		return;
+	}
+	// pshufb работает внутри 128-битных половин, значения не пересекают границу половин
+	const __m256i mask = _mm256_broadcastsi128_si256(shuffleMask(order));
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 4 * i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * i), _mm256_shuffle_epi8(v, mask));
+	}
+	for (; i < count; i++) {
+		for (int b = 0; b < 4; b++) out[4 * i + b] = in[4 * i + order[b]];
+	}
+}
+
+static void wordsToDWordsSsse3(const uint16_t* words, size_t count, void* dwords, MemMode mode) {
+	shuffleSsse3(words, count, dwords, mode);
+}
+
+static void dwordsToWordsSsse3(const void* dwords, size_t count, uint16_t* words, MemMode mode) {
+	shuffleSsse3(dwords, count, words, mode);
+}
+
+static void wordsToDWordsAvx2(const uint16_t* words, size_t count, void* dwords, MemMode mode) {
+	shuffleAvx2(words, count, dwords, mode);
+}
+
+static void dwordsToWordsAvx2(const void* dwords, size_t count, uint16_t* words, MemMode mode) {
+	shuffleAvx2(dwords, count, words, mode);
+}
+
+#define MB_WORD_KERNELS_SIMD
+
+#endif
+
+using ToDWordsFn = void (*)(const uint16_t*, size_t, void*, MemMode);
+using ToWordsFn = void (*)(const void*, size_t, uint16_t*, MemMode);
+
+static void toDWordsFirst(const uint16_t* words, size_t count, void* dwords, MemMode mode);
+static void toWordsFirst(const void* dwords, size_t count, uint16_t* words, MemMode mode);
+
+// Константная инициализация: выбор реализации при первом вызове
+static std::atomic<ToDWordsFn> g_to_dwords(toDWordsFirst);
+static std::atomic<ToWordsFn> g_to_words(toWordsFirst);
+static std::atomic<WordKernel> g_kernel(WordKernel::AUTO);
+
+bool isWordKernelSupported(WordKernel kernel) {
+	switch (kernel) {
+		case WordKernel::AUTO:
+		case WordKernel::SCALAR:
+			return true;
+#ifdef MB_WORD_KERNELS_SIMD
+		case WordKernel::SSSE3:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("ssse3");
+		case WordKernel::AVX2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return false;
+	}
+}
+
+const char* wordKernelName(WordKernel kernel) {
+	switch (kernel) {
+		case WordKernel::AUTO: return "auto";
+		case WordKernel::SCALAR: return "scalar";
+		case WordKernel::SSSE3: return "ssse3";
+		case WordKernel::AVX2: return "avx2";
+	}
+	return "unknown";
+}
+
+bool setWordKernel(WordKernel kernel) {
+	if (!isWordKernelSupported(kernel)) return false;
+	if (kernel == WordKernel::AUTO) {
+		if (isWordKernelSupported(WordKernel::AVX2)) kernel = WordKernel::AVX2;
+		else if (isWordKernelSupported(WordKernel::SSSE3)) kernel = WordKernel::SSSE3;
+		else kernel = WordKernel::SCALAR;
+	}
+
+	ToDWordsFn to_dwords = wordsToDWordsScalar;
+	ToWordsFn to_words = dwordsToWordsScalar;
+#ifdef MB_WORD_KERNELS_SIMD
+	if (kernel == WordKernel::SSSE3) {
+		to_dwords = wordsToDWordsSsse3;
+		to_words = dwordsToWordsSsse3;
+	}
+	else if (kernel == WordKernel::AVX2) {
+		to_dwords = wordsToDWordsAvx2;
+		to_words = dwordsToWordsAvx2;
+	}
+#endif
+	g_to_dwords.store(to_dwords, std::memory_order_relaxed);
+	g_to_words.store(to_words, std::memory_order_relaxed);
+	g_kernel.store(kernel, std::memory_order_relaxed);
+	return true;
+}
+
+WordKernel getWordKernel() {
+	if (g_kernel.load(std::memory_order_relaxed) == WordKernel::AUTO) setWordKernel(WordKernel::AUTO);
+	return g_kernel.load(std::memory_order_relaxed);
+}
+
+static void toDWordsFirst(const uint16_t* words, size_t count, void* dwords, MemMode mode) {
+	getWordKernel();
+	g_to_dwords.load(std::memory_order_relaxed)(words, count, dwords, mode);
+}
+
+static void toWordsFirst(const void* dwords, size_t count, uint16_t* words, MemMode mode) {
+	getWordKernel();
+	g_to_words.load(std::memory_order_relaxed)(dwords, count, words, mode);
+}
+
+void wordsToDWords(const uint16_t* words, size_t count, void* dwords, MemMode mode) {
+	g_to_dwords.load(std::memory_order_relaxed)(words, count, dwords, mode);
+}
+
+void dwordsToWords(const void* dwords, size_t count, uint16_t* words, MemMode mode) {
+	g_to_words.load(std::memory_order_relaxed)(dwords, count, words, mode);
+}
+
+} // data
+} // mb
@@ -0,0 +1,48 @@
+#ifndef MB_WORD_KERNELS_H
+#define MB_WORD_KERNELS_H
+
+#include "Map.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mb {
+namespace data {
+
+/** @brief Реализация перестановки слов и байтов 32-битных значений */
+enum class WordKernel {
+	AUTO,		// Лучшая из поддерживаемых процессором
+	SCALAR,
+	SSSE3,		// 4 значения за операцию (pshufb)
+	AVX2,		// 8 значений за операцию
+};
+
+/** @brief Порядок регистров 32-битного значения по MemMode. Значение с байтами A B C D (A - старший):
+	BIG_ENDIAN_MODE - регистры AB, CD; LITTLE_ENDIAN_MODE - DC, BA; BIG_ENDIAN_BYTE_SWAP_MODE - BA, DC;
+	LITTLE_ENDIAN_BYTE_SWAP_MODE и EMPTY - CD, AB (младшее слово первым, как хранят readUInt32/readFloat32).
+	Перестановка обратна сама себе, поэтому одна функция переводит и пару регистров в значение, и значение в пару */
+inline uint32_t orderDWord(uint32_t x, MemMode mode) {
+	// x - пара регистров как число: первый регистр в младших 16 битах
+	switch (mode) {
+		case MemMode::BIG_ENDIAN_MODE: return x << 16 | x >> 16;
+		case MemMode::LITTLE_ENDIAN_MODE: return (x & 0x00FF00FFu) << 8 | ((x >> 8) & 0x00FF00FFu);
+		case MemMode::BIG_ENDIAN_BYTE_SWAP_MODE: return __builtin_bswap32(x);
+		default: return x;
+	}
+}
+
+// count значений из 2 * count слов (words[0] - первый регистр) в массив 32-битных значений (float, int32_t, uint32_t)
+void wordsToDWords(const uint16_t* words, size_t count, void* dwords, MemMode mode);
+// count 32-битных значений в 2 * count слов
+void dwordsToWords(const void* dwords, size_t count, uint16_t* words, MemMode mode);
+
+// Выбор реализации (бенчмарки и проверки), false - не поддерживается процессором или сборкой
+bool setWordKernel(WordKernel kernel);
+WordKernel getWordKernel();
+bool isWordKernelSupported(WordKernel kernel);
+const char* wordKernelName(WordKernel kernel);
+
+} // data
+} // mb
+
+#endif // MB_WORD_KERNELS_H
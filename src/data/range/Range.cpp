@@ -0,0 +1,30 @@
+#include "Range.h"
+
+namespace mb {
+namespace data {
+
+void normalizeRangeList(std::vector<Range>& ranges) {
+	if (ranges.empty()) return;
+
+	std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { 
+		if (a.scan_ms != b.scan_ms) return a.scan_ms < b.scan_ms;
+		if (a.start == b.start) return a.end < b.end;
+		return a.start < b.start;
+	});
+
+	std::vector<Range> result;
+	result.reserve(ranges.size());
+	result.push_back(ranges.front());
+
+	for (size_t i = 1; i < ranges.size(); i++) {
+		Range& last = result.back();
+		const Range& cur = ranges[i];
+		if (last.scan_ms == cur.scan_ms && last.overlaps(cur.start, cur.end)) last.merge(cur.start, cur.end);
+		else result.push_back(cur);
+	}
+
+	ranges = std::move(result);
+}
+
+} // data
+} // mb
@@ -0,0 +1,54 @@
+#ifndef MB_RANGE_H
+#define MB_RANGE_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+namespace mb {
+namespace data {
+
+/** @brief Диапазон последовательных адресов [start-end] с классом опроса */
+struct Range {
+    uint16_t start;
+    uint16_t end;
+    uint32_t scan_ms; // Период опроса диапазона в мс, 0 - класс опроса по умолчанию
+
+    Range() : start(0), end(0), scan_ms(0) {}
+    Range(uint16_t s, uint16_t e) : start(s), end(e), scan_ms(0) {}
+    Range(uint16_t s, uint16_t e, uint32_t ms) : start(s), end(e), scan_ms(ms) {}
+
+    bool overlaps(const uint16_t& o_start, const uint16_t& o_end) const { 
+        int diff_start = 0;
+        if (start != 0) diff_start = 1;
+        return start - diff_start <= o_end && end + 1 >= o_start; 
+    }
+    
+    void merge(const uint16_t& o_start, const uint16_t& o_end) {
+    	start = std::min(start, o_start);
+    	end = std::max(end, o_end);
+    }
+
+    uint16_t quantity() const { return end - start + 1; }
+};
+
+// Сортировка и слияние пересекающихся (соседних) диапазонов одного класса опроса.
+// Диапазоны разных классов не сливаются, иначе медленные регистры опрашивались бы с частотой быстрых
+void normalizeRangeList(std::vector<Range>& ranges);
+
+// Разбиение [start-end] на запросы не длиннее max_q (протокольный лимит): fn(start, quantity) для каждого.
+// Возвращает количество запросов
+template <typename Fn>
+size_t splitRange(uint32_t start, uint32_t end, uint32_t max_q, Fn&& fn) {
+    size_t count = 0;
+    for (uint32_t adr = start; adr <= end; adr += max_q, count++) {
+        fn(static_cast<uint16_t>(adr), static_cast<uint16_t>(std::min<uint32_t>(max_q, end - adr + 1)));
+    }
+    return count;
+}
+
+} // data
+} // mb
+
+#endif // MB_RANGE_H
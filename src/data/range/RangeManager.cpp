@@ -1,5 +1,7 @@
 #include "RangeManager.h"
 #include "Logger.h"
+#include "ScanScheduler.h"
+#include "WorkPool.h"
 
 namespace mb {
 namespace data {
@@ -29,6 +31,17 @@ void RangeManager::addRange(const int slave_id, const FuncNumber func, int start
 	addRange(slave_id, func, range);    
 }
 
+void RangeManager::addRange(const int slave_id, const FuncNumber func, int start, int end, uint32_t scan_ms) {
+	Range range(std::min(start, end), std::max(start, end), scan_ms);
+	addRange(slave_id, func, range);
+}
+
+void RangeManager::addRanges(const std::vector<ConfigRange>& ranges) {
+	for (const ConfigRange& r : ranges) {
+		addRange(r.slave_id, static_cast<FuncNumber>(r.func), r.start, r.end, r.scan_ms);
+	}
+}
+
 bool RangeManager::addRange(const int slave_id, const FuncNumber func, std::string& range_str) {
 	bool result = false;
 	bool is_find = false;
@@ -70,44 +83,37 @@ bool RangeManager::addRange(const int slave_id, const FuncNumber func, std::stri
 }
 
 void RangeManager::normalizeRanges() {
-	for (const auto& pair : m_ranges) {
-		int slave_id = pair.first;
-		const InnerMap& inner_map = pair.second;
+	// Списки берутся по ссылке из обхода, без повторного поиска m_ranges[slave_id][func]
+	for (auto& pair : m_ranges) {
+		for (auto& inner_pair : pair.second) normalizeRangeList(inner_pair.second);
+	}
+}
 
-		for (const auto& inner_pair : inner_map) {
-			FuncNumber func_key = inner_pair.first;
-			normalizeRanges(slave_id, func_key);
-		}
+void RangeManager::normalizeRanges(work::WorkPool& pool) {
+	std::vector<std::vector<Range>*> lists;
+	for (auto& pair : m_ranges) {
+		for (auto& inner_pair : pair.second) lists.push_back(&inner_pair.second);
 	}
+	pool.parallelFor(lists.size(), [&lists](size_t i) { normalizeRangeList(*lists[i]); });
 }
 
 void RangeManager::normalizeRanges(const int slave_id, const FuncNumber func) {
-	std::vector<Range>& ranges = m_ranges[slave_id][func];
-	std::vector<Range> result;
-
-	if (ranges.empty()) return;
-
-	std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { 
-		bool result;
-		if (a.start == b.start) result = a.end < b.end;
-		else result = a.start < b.start;
-		return result; 
-	});
-
-	result.push_back(ranges.at(0));
+	normalizeRangeList(m_ranges[slave_id][func]);
+}
 
-	for (int i = 1; i < ranges.size(); i++) {
-		Range& last = result.back();
-		if (last.overlaps(ranges.at(i).start, ranges.at(i).end)) last.merge(ranges.at(i).start, ranges.at(i).end);
-		else result.push_back(ranges.at(i));
+void RangeManager::fillScanScheduler(ScanScheduler& scheduler, uint32_t default_scan_ms) {
+	for (const auto& pair : m_ranges) {
+		for (const auto& inner_pair : pair.second) {
+			for (const Range& range : inner_pair.second) {
+				scheduler.addRange(pair.first, static_cast<int>(inner_pair.first), range, default_scan_ms);
+			}
+		}
 	}
-
-	m_ranges[slave_id][func] = std::move(result);
 }
 
 bool RangeManager::tryMergeRanges(Range& r1, const Range& r2) const {
 	bool result = false;
-	if (r1.overlaps(r2.start, r2.end)) { 
+	if (r1.scan_ms == r2.scan_ms && r1.overlaps(r2.start, r2.end)) { 
 		r1.merge(r2.start, r2.end);
 		result = true;
 	}
@@ -132,7 +138,8 @@ void RangeManager::printInfo() {
 			Logger::Instance()->rawLog("FUNC %d", func);
 
 			for (const Range& range : ranges) {
-				Logger::Instance()->rawLog("[%d-%d]", range.start, range.end);
+				if (range.scan_ms) Logger::Instance()->rawLog("[%d-%d] %u ms", range.start, range.end, range.scan_ms);
+				else Logger::Instance()->rawLog("[%d-%d]", range.start, range.end);
 			}
 		}
 	}
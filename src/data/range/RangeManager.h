@@ -3,6 +3,8 @@
 
 #include "ModbusEnums.h"
 #include "ModbusRegister.h"
+#include "Range.h"
+#include "ConfigParser.h"
 
 #include <vector>
 #include <cstdint> 
@@ -12,33 +14,18 @@
 #include <unordered_map>
 
 namespace mb {
+namespace work {
+class WorkPool;
+}
+
 namespace data {
 
 using namespace mb::types;
 
-struct Range;
-
 using InnerMap = std::unordered_map<FuncNumber, std::vector<Range>>;
 using RangesMap = std::unordered_map<int, InnerMap>;
 
-struct Range {
-    uint16_t start;
-    uint16_t end;
-    
-    Range() : start(0), end(0) {}
-    Range(uint16_t s, uint16_t e) : start(s), end(e) {}
-
-    bool overlaps(const uint16_t& o_start, const uint16_t& o_end) const { 
-        int diff_start = 0;
-        if (start != 0) diff_start = 1;
-        return start - diff_start <= o_end && end + 1 >= o_start; 
-    }
-    
-    void merge(const uint16_t& o_start, const uint16_t& o_end) {
-    	start = std::min(start, o_start);
-    	end = std::max(end, o_end);
-    }
-};
+class ScanScheduler;
 
 class RangeManager {    
     public:
@@ -48,7 +35,11 @@ class RangeManager {
         RangesMap& getRanges();
         bool addRange(const int slave_id, const FuncNumber func, std::string& range_str);
         void addRange(const int slave_id, const FuncNumber func, int start, int end);
+        void addRange(const int slave_id, const FuncNumber func, int start, int end, uint32_t scan_ms); // Диапазон с классом опроса
+        void addRanges(const std::vector<ConfigRange>& ranges); // Диапазоны, разобранные ConfigParser
         void normalizeRanges();
+        void normalizeRanges(work::WorkPool& pool); // Пары slave_id/func независимы и нормализуются параллельно
+        void fillScanScheduler(ScanScheduler& scheduler, uint32_t default_scan_ms); // Передача нормализованных диапазонов планировщику опроса
 
         void printInfo();
 
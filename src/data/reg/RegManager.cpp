@@ -71,21 +71,79 @@ bool RegManager::addReg(const bool is_describe, const int slave_id, const FuncNu
 	if (isDwordDataType(reg_info.data_type) && reg_info.order == RegDataOrder::NONE) reg_info.order = m_data_order;
 	
 	if (result) { 
-		if (is_describe) m_describe_regs.emplace_front(address, reg_info, name, slave_id, func); 
-		else if (isReadFunc(func)) m_regs.emplace_front(address, reg_info, name, slave_id, func);
+		if (is_describe) {
+			m_describe_regs.emplace_front(address, reg_info, name, slave_id, func); 
+			indexReg(true, m_describe_regs.front());
+		}
+		else if (isReadFunc(func)) {
+			m_regs.emplace_front(address, reg_info, name, slave_id, func);
+			indexReg(false, m_regs.front());
+		}
 	}
 
 	return result;
 }
 
+bool RegManager::addReg(const bool is_describe, const ConfigTag& tag) {
+	RegisterInfo reg_info;
+	FuncNumber func = static_cast<FuncNumber>(tag.func);
+
+	// Имена ключевых слов короткие и помещаются в буфер std::string без выделения памяти
+	if (tag.data_type != CfgDataType::NONE && !getRegDataTypeFromStr(reg_info.data_type, cfgDataTypeToString(tag.data_type))) return false;
+	if (tag.order != CfgDataOrder::NONE && !getRegDataOrderFromStr(reg_info.order, cfgDataOrderToString(tag.order))) return false;
+	if (isFloatDataType(reg_info.data_type)) reg_info.precision = tag.precision;
+
+	if (isDwordDataType(reg_info.data_type) && reg_info.order == RegDataOrder::NONE) reg_info.order = m_data_order;
+
+	std::string name(tag.name);
+	if (is_describe) {
+		m_describe_regs.emplace_front(tag.address, reg_info, name, tag.slave_id, func);
+		indexReg(true, m_describe_regs.front());
+	}
+	else if (isReadFunc(func)) {
+		m_regs.emplace_front(tag.address, reg_info, name, tag.slave_id, func);
+		indexReg(false, m_regs.front());
+	}
+	return true;
+}
+
 Register* RegManager::addReadReg(const int address, const int slave_id, const FuncNumber func) {
 	RegisterInfo reg_info; 
 	m_regs.emplace_front(address, reg_info, "", slave_id, func);
 	auto it = m_regs.begin();
 	Register* reg = &(*it);
+	indexReg(false, *reg);
 	return reg;
 }
 
+void RegManager::indexReg(const bool is_describe, Register& reg) {
+	TagIndex& index = is_describe ? m_describe_index : m_index;
+	std::vector<Register*>& handles = is_describe ? m_describe_handles : m_reg_handles;
+	TagHandle handle = static_cast<TagHandle>(handles.size());
+	handles.push_back(&reg);
+	// Элементы forward_list не перемещаются, поэтому указатели в handles остаются действительными
+	index.add(reg.name, reg.slave_id, static_cast<int>(reg.function), static_cast<uint16_t>(reg.address), reg.isDword() ? 2 : 1, handle);
+}
+
+Register* RegManager::findReg(std::string_view name) {
+	TagHandle handle = m_index.findByName(name);
+	return handle == INVALID_TAG_HANDLE ? nullptr : m_reg_handles[handle];
+}
+
+Register* RegManager::findDescribeReg(std::string_view name) {
+	TagHandle handle = m_describe_index.findByName(name);
+	return handle == INVALID_TAG_HANDLE ? nullptr : m_describe_handles[handle];
+}
+
+size_t RegManager::findRegs(const int slave_id, const FuncNumber func, const int address, std::vector<Register*>& out) const {
+	if (address < 0 || address > 0xFFFF) return 0;
+	// Локальный буфер: поиск из нескольких потоков одновременно не делит состояние
+	std::vector<TagHandle> found;
+	m_index.findByAddress(slave_id, static_cast<int>(func), static_cast<uint16_t>(address), found);
+	for (TagHandle handle : found) out.push_back(m_reg_handles[handle]);
+	return found.size();
+}
+
 std::forward_list<Register>& RegManager::getReadRegs() { return m_regs; }
 
 std::forward_list<Register> &RegManager::getDescribeRegs() { return m_describe_regs; }
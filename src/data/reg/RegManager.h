@@ -4,9 +4,13 @@
 #include "ModbusEnums.h"
 #include "ModbusTrans.h"
 #include "ModbusRegister.h"
+#include "ConfigParser.h"
+#include "TagIndex.h"
 
 #include <forward_list>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace mb {
 namespace data {
@@ -24,6 +28,13 @@ class RegManager {
         std::forward_list<Register>& getDescribeRegs();
         bool addReg(bool is_describe, const int slave_id, const FuncNumber func, const std::string& name, std::string& reg_str);
         Register* addReadReg(const int address, const int slave_id, const FuncNumber func);
+        bool addReg(bool is_describe, const ConfigTag& tag); // Тег, разобранный ConfigParser, без повторного разбора строки
+
+        // Поиск по индексу, при совпадении имен находится первый добавленный регистр
+        Register* findReg(std::string_view name);
+        Register* findDescribeReg(std::string_view name);
+        // Регистры чтения slave_id/func, занимающие адрес address (DWORD занимает два адреса)
+        size_t findRegs(const int slave_id, const FuncNumber func, const int address, std::vector<Register*>& out) const;
 
         void printInfo();
 
@@ -33,7 +44,13 @@ class RegManager {
         std::forward_list<Register> m_regs;
         std::forward_list<Register> m_describe_regs;
 
+        TagIndex m_index;                           // Индекс m_regs, дескриптор - номер в m_reg_handles
+        TagIndex m_describe_index;
+        std::vector<Register*> m_reg_handles;
+        std::vector<Register*> m_describe_handles;
+
         bool parseReg(const bool is_describe, const std::string &reg_str, int &address, RegisterInfo &reg_info);
+        void indexReg(const bool is_describe, Register& reg);
 
         void printRegInfo(const Register &r);
 };
@@ -0,0 +1,342 @@
+#include "TagHistory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace mb {
+namespace data {
+
+/* Формат блока (биты со старшего):
+   время:    '0' - разность разностей 0; '10' + 7 бит, '110' + 9 бит, '1110' + 12 бит, '1111' + 64 бита - разность разностей в zigzag
+   значение: '0' - совпадает с предыдущим; '10' + значащие биты XOR в окне предыдущего значения;
+             '11' + 5 бит ведущих нулей + 6 бит (значащих бит - 1) + значащие биты - новое окно */
+
+static inline uint64_t lowMask(const uint32_t n) {
+	return n >= 64 ? ~0ull : (1ull << n) - 1;
+}
+
+static inline void putBits(uint64_t* words, uint32_t& pos, const uint64_t value, const uint32_t n) {
+	if (n == 0) return;
+	const uint64_t v = value & lowMask(n);
+	const uint32_t idx = pos >> 6;
+	const uint32_t free = 64 - (pos & 63);
+	if (n <= free) words[idx] |= v << (free - n);
+	else {
+		words[idx] |= v >> (n - free);
+		words[idx + 1] |= v << (64 - (n - free));
+	}
+	pos += n;
+}
+
+static inline uint64_t getBits(const uint64_t* words, uint32_t& pos, const uint32_t n) {
+	const uint32_t idx = pos >> 6;
+	const uint32_t free = 64 - (pos & 63);
+	uint64_t v;
+	if (n <= free) v = (words[idx] >> (free - n)) & lowMask(n);
+	else {
+		const uint32_t rest = n - free;
+		v = (words[idx] & lowMask(free)) << rest | words[idx + 1] >> (64 - rest);
+	}
+	pos += n;
+	return v;
+}
+
+static inline uint64_t toBits(const double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static inline double fromBits(const uint64_t bits) {
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// Длина кода разности разностей времени
+static inline uint32_t timeCodeBits(const uint64_t zz) {
+	if (zz == 0) return 1;
+	if (zz < (1u << 7)) return 2 + 7;
+	if (zz < (1u << 9)) return 3 + 9;
+	if (zz < (1u << 12)) return 4 + 12;
+	return 4 + 64;
+}
+
+/** @brief Последовательное чтение значений блока */
+class TagHistory::Reader {
+public:
+	Reader(const Block& block, const uint64_t* bits)
+		: m_block(block), m_bits(bits), m_pos(0), m_index(0), m_ts(block.first_ts), m_delta(0), m_value(toBits(block.first)), m_leading(0), m_trailing(0) {}
+
+	bool next(TagSample& sample) {
+		if (m_index == m_block.count) return false;
+		if (m_index++ > 0) {
+			uint64_t zz = 0;
+			if (getBits(m_bits, m_pos, 1)) {
+				if (!getBits(m_bits, m_pos, 1)) zz = getBits(m_bits, m_pos, 7);
+				else if (!getBits(m_bits, m_pos, 1)) zz = getBits(m_bits, m_pos, 9);
+				else if (!getBits(m_bits, m_pos, 1)) zz = getBits(m_bits, m_pos, 12);
+				else zz = getBits(m_bits, m_pos, 64);
+			}
+			m_delta += static_cast<int64_t>((zz >> 1) ^ (0 - (zz & 1)));
+			m_ts += static_cast<uint64_t>(m_delta);
+
+			if (getBits(m_bits, m_pos, 1)) {
+				if (getBits(m_bits, m_pos, 1)) {
+					m_leading = static_cast<uint32_t>(getBits(m_bits, m_pos, 5));
+					m_trailing = 64 - m_leading - static_cast<uint32_t>(getBits(m_bits, m_pos, 6) + 1);
+				}
+				m_value ^= getBits(m_bits, m_pos, 64 - m_leading - m_trailing) << m_trailing;
+			}
+		}
+		sample.ts = m_ts;
+		sample.value = fromBits(m_value);
+		return true;
+	}
+
+private:
+	const Block& m_block;
+	const uint64_t* m_bits;
+	uint32_t m_pos;
+	uint32_t m_index;
+	uint64_t m_ts;
+	int64_t m_delta;
+	uint64_t m_value;
+	uint32_t m_leading;
+	uint32_t m_trailing;
+};
+
+TagHistory::TagHistory() : m_blocks_per_tag(0), m_block_words(0) {}
+
+bool TagHistory::init(const size_t tags, const size_t block_bytes, const size_t blocks) {
+	if (tags == 0 || tags >= INVALID_TAG_HANDLE || block_bytes % 8 || block_bytes < 32 || block_bytes > 65536 || blocks < 2 || blocks > UINT32_MAX) return false;
+	m_blocks_per_tag = blocks;
+	m_block_words = block_bytes / 8;
+	m_tags.assign(tags, TagState{ 0, 0, 0, 0, 0, 0xFF, 0 });
+	m_blocks.assign(tags * blocks, Block{});
+	m_bits.assign(tags * blocks * m_block_words, 0);
+	return true;
+}
+
+void TagHistory::clear() {
+	for (TagState& st : m_tags) {
+		st.head = 0;
+		st.used = 0;
+	}
+}
+
+void TagHistory::startBlock(const TagHandle handle, TagState& st, const uint64_t ts, const double value) {
+	if (st.used == 0) {
+		st.head = 0;
+		st.used = 1;
+	}
+	else {
+		// Кольцо заполнено - затирается самый старый блок
+		st.head = static_cast<uint32_t>((st.head + 1) % m_blocks_per_tag);
+		if (st.used < m_blocks_per_tag) st.used++;
+	}
+	memset(bitsOf(handle, st.head), 0, m_block_words * sizeof(uint64_t));
+	Block* b = blockOf(handle, st.head);
+	const bool finite = std::isfinite(value);
+	b->first_ts = ts;
+	b->last_ts = ts;
+	b->first = value;
+	b->min = finite ? value : std::numeric_limits<double>::infinity();
+	b->max = finite ? value : -std::numeric_limits<double>::infinity();
+	b->sum = finite ? value : 0;
+	b->count = 1;
+	b->finite = finite;
+	b->bits = 0;
+
+	st.prev_ts = ts;
+	st.prev_delta = 0;
+	st.prev_value = toBits(value);
+	st.leading = 0xFF;
+	st.trailing = 0;
+}
+
+bool TagHistory::append(const TagHandle handle, const uint64_t ts, const double value) {
+	if (handle >= m_tags.size()) return false;
+	std::lock_guard<std::mutex> lock(lockOf(handle));
+	return appendLocked(handle, ts, value);
+}
+
+size_t TagHistory::append(const TagHandle first, const size_t count, const uint64_t ts, const double* values) {
+	if (first >= m_tags.size()) return 0;
+	const size_t end = std::min(m_tags.size(), first + count);
+	size_t written = 0;
+	for (size_t handle = first; handle < end;) {
+		const size_t group_end = std::min(end, ((handle >> LOCK_GROUP_BITS) + 1) << LOCK_GROUP_BITS);
+		std::lock_guard<std::mutex> lock(lockOf(static_cast<TagHandle>(handle)));
+		for (; handle < group_end; handle++) written += appendLocked(static_cast<TagHandle>(handle), ts, values[handle - first]);
+	}
+	return written;
+}
+
+bool TagHistory::appendLocked(const TagHandle handle, const uint64_t ts, const double value) {
+	TagState& st = m_tags[handle];
+	if (st.used == 0) {
+		startBlock(handle, st, ts, value);
+		return true;
+	}
+	if (ts < st.prev_ts) return false;
+
+	const int64_t delta = static_cast<int64_t>(ts - st.prev_ts);
+	const int64_t dod = delta - st.prev_delta;
+	const uint64_t zz = static_cast<uint64_t>(dod) << 1 ^ static_cast<uint64_t>(dod >> 63);
+	const uint32_t time_bits = timeCodeBits(zz);
+
+	const uint64_t bits = toBits(value);
+	const uint64_t x = bits ^ st.prev_value;
+	uint32_t leading = 0, trailing = 0, value_bits = 1;
+	bool reuse = false;
+	if (x) {
+		leading = std::min(static_cast<uint32_t>(__builtin_clzll(x)), 31u);
+		trailing = static_cast<uint32_t>(__builtin_ctzll(x));
+		reuse = st.leading != 0xFF && leading >= st.leading && trailing >= st.trailing;
+		value_bits = reuse ? 2 + 64 - st.leading - st.trailing : 2 + 5 + 6 + 64 - leading - trailing;
+	}
+
+	Block* b = blockOf(handle, st.head);
+	if (b->bits + time_bits + value_bits > m_block_words * 64) {
+		startBlock(handle, st, ts, value);
+		return true;
+	}
+
+	uint64_t* words = bitsOf(handle, st.head);
+	uint32_t pos = b->bits;
+	switch (time_bits) {
+		case 1: putBits(words, pos, 0, 1); break;
+		case 9: putBits(words, pos, 0b10, 2); putBits(words, pos, zz, 7); break;
+		case 12: putBits(words, pos, 0b110, 3); putBits(words, pos, zz, 9); break;
+		case 16: putBits(words, pos, 0b1110, 4); putBits(words, pos, zz, 12); break;
+		default: putBits(words, pos, 0b1111, 4); putBits(words, pos, zz, 64); break;
+	}
+	if (x == 0) putBits(words, pos, 0, 1);
+	else if (reuse) {
+		putBits(words, pos, 0b10, 2);
+		putBits(words, pos, x >> st.trailing, 64 - st.leading - st.trailing);
+	}
+	else {
+		const uint32_t significant = 64 - leading - trailing;
+		putBits(words, pos, 0b11, 2);
+		putBits(words, pos, leading, 5);
+		putBits(words, pos, significant - 1, 6);
+		putBits(words, pos, x >> trailing, significant);
+		st.leading = static_cast<uint8_t>(leading);
+		st.trailing = static_cast<uint8_t>(trailing);
+	}
+	b->bits = pos;
+	b->last_ts = ts;
+	b->count++;
+	if (std::isfinite(value)) {
+		b->min = std::min(b->min, value);
+		b->max = std::max(b->max, value);
+		b->sum += value;
+		b->finite++;
+	}
+
+	st.prev_ts = ts;
+	st.prev_delta = delta;
+	st.prev_value = bits;
+	return true;
+}
+
+size_t TagHistory::query(const TagHandle handle, const uint64_t from, const uint64_t to, std::vector<TagSample>& out) const {
+	if (handle >= m_tags.size() || from > to) return 0;
+	std::lock_guard<std::mutex> lock(lockOf(handle));
+	const TagState& st = m_tags[handle];
+	const size_t base = out.size();
+	const uint32_t oldest = static_cast<uint32_t>((st.head + m_blocks_per_tag + 1 - st.used) % m_blocks_per_tag);
+	for (uint32_t k = 0; k < st.used; k++) {
+		const uint32_t n = static_cast<uint32_t>((oldest + k) % m_blocks_per_tag);
+		const Block& b = *blockOf(handle, n);
+		if (b.first_ts > to) break;
+		if (b.last_ts < from) continue;
+		Reader reader(b, bitsOf(handle, n));
+		TagSample s;
+		while (reader.next(s) && s.ts <= to) {
+			if (s.ts >= from) out.push_back(s);
+		}
+	}
+	return out.size() - base;
+}
+
+size_t TagHistory::queryBuckets(const TagHandle handle, const uint64_t from, const uint64_t to, const uint64_t bucket, std::vector<TagBucket>& out) const {
+	if (handle >= m_tags.size() || from > to || bucket == 0 || (to - from) / bucket >= MAX_BUCKETS) return 0;
+	const size_t count = static_cast<size_t>((to - from) / bucket + 1);
+	const size_t base = out.size();
+	// Пока идет сбор, avg хранит сумму
+	out.resize(base + count);
+	for (size_t i = 0; i < count; i++) {
+		out[base + i] = TagBucket{ from + i * bucket, 0, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), 0 };
+	}
+	TagBucket* buckets = &out[base];
+
+	{
+		std::lock_guard<std::mutex> lock(lockOf(handle));
+		const TagState& st = m_tags[handle];
+		const uint32_t oldest = static_cast<uint32_t>((st.head + m_blocks_per_tag + 1 - st.used) % m_blocks_per_tag);
+		for (uint32_t k = 0; k < st.used; k++) {
+			const uint32_t n = static_cast<uint32_t>((oldest + k) % m_blocks_per_tag);
+			const Block& b = *blockOf(handle, n);
+			if (b.first_ts > to) break;
+			if (b.last_ts < from) continue;
+			// Блок целиком в одном интервале - по заголовку, без распаковки
+			if (b.first_ts >= from && b.last_ts <= to && (b.first_ts - from) / bucket == (b.last_ts - from) / bucket) {
+				if (b.finite == 0) continue;
+				TagBucket& t = buckets[(b.first_ts - from) / bucket];
+				t.count += b.finite;
+				t.min = std::min(t.min, b.min);
+				t.max = std::max(t.max, b.max);
+				t.avg += b.sum;
+				continue;
+			}
+			Reader reader(b, bitsOf(handle, n));
+			TagSample s;
+			while (reader.next(s) && s.ts <= to) {
+				if (s.ts < from || !std::isfinite(s.value)) continue;
+				TagBucket& t = buckets[(s.ts - from) / bucket];
+				t.count++;
+				t.min = std::min(t.min, s.value);
+				t.max = std::max(t.max, s.value);
+				t.avg += s.value;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		TagBucket& t = buckets[i];
+		if (t.count) t.avg /= t.count;
+		else t.min = t.max = 0;
+	}
+	return count;
+}
+
+bool TagHistory::last(const TagHandle handle, TagSample* sample) const {
+	if (handle >= m_tags.size() || sample == nullptr) return false;
+	std::lock_guard<std::mutex> lock(lockOf(handle));
+	const TagState& st = m_tags[handle];
+	if (st.used == 0) return false;
+	sample->ts = st.prev_ts;
+	sample->value = fromBits(st.prev_value);
+	return true;
+}
+
+size_t TagHistory::getSampleCount(const TagHandle handle) const {
+	if (handle >= m_tags.size()) return 0;
+	std::lock_guard<std::mutex> lock(lockOf(handle));
+	const TagState& st = m_tags[handle];
+	size_t count = 0;
+	for (uint32_t k = 0; k < st.used; k++) count += blockOf(handle, static_cast<uint32_t>((st.head + m_blocks_per_tag - k) % m_blocks_per_tag))->count;
+	return count;
+}
+
+size_t TagHistory::getMemorySize() const {
+	return m_tags.size() * sizeof(TagState) + m_blocks.size() * sizeof(Block) + m_bits.size() * sizeof(uint64_t);
+}
+
+} // data
+} // mb
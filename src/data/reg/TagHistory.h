@@ -0,0 +1,114 @@
+#ifndef MB_TAG_HISTORY_H
+#define MB_TAG_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "TagIndex.h"
+
+namespace mb {
+namespace data {
+
+/** @brief Значение тега в истории, ts - время в мс */
+struct TagSample {
+	uint64_t ts;
+	double value;
+};
+
+/** @brief Интервал прореженной истории [start, start + bucket). Нечисловые значения (NaN, inf) не учитываются,
+	count = 0 - в интервале нет значений, min/max/avg тогда 0 */
+struct TagBucket {
+	uint64_t start;
+	uint32_t count;
+	double min;
+	double max;
+	double avg;
+};
+
+/** @brief Краткосрочная история значений тегов по дескриптору TagHandle.
+	На каждый тег - кольцо из blocks блоков фиксированного размера, память выделяется один раз в init.
+	Блок сжат как в Gorilla (Facebook TSDB): первое значение хранится целиком в заголовке, далее время - разностью
+	разностей, значение - XOR с предыдущим. Блоки независимы, при заполнении кольца затирается самый старый.
+	Заголовок блока хранит min/max/сумму, поэтому прореживание не распаковывает блоки, целиком попавшие в один интервал.
+	append и запросы можно вызывать из разных потоков (блокировка по группе тегов), init и clear - нет */
+class TagHistory {
+public:
+	TagHistory();
+	~TagHistory() {}
+
+	// tags - дескрипторы 0..tags-1, block_bytes - размер сжатых данных блока (кратен 8, от 32 до 65536), blocks - блоков на тег (от 2)
+	bool init(const size_t tags, const size_t block_bytes = 256, const size_t blocks = 4);
+	// Удаление всех значений, память остается
+	void clear();
+
+	// Время не должно убывать: false - значение старее последнего или неверный дескриптор
+	bool append(const TagHandle handle, const uint64_t ts, const double value);
+	// Значения тегов first..first+count-1 за один цикл опроса (блокировка на группу тегов, а не на каждый).
+	// Возвращает количество записанных
+	size_t append(const TagHandle first, const size_t count, const uint64_t ts, const double* values);
+
+	// Значения за [from, to] добавляются в out по возрастанию времени. Возвращает количество добавленных
+	size_t query(const TagHandle handle, const uint64_t from, const uint64_t to, std::vector<TagSample>& out) const;
+	// Интервалы по bucket мс от from до to включительно добавляются в out, в том числе пустые. Возвращает количество интервалов,
+	// 0 - неверные параметры или больше MAX_BUCKETS интервалов
+	size_t queryBuckets(const TagHandle handle, const uint64_t from, const uint64_t to, const uint64_t bucket, std::vector<TagBucket>& out) const;
+	bool last(const TagHandle handle, TagSample* sample) const;
+
+	size_t getSampleCount(const TagHandle handle) const;
+	size_t getTagCount() const { return m_tags.size(); }
+	// Память истории, байт
+	size_t getMemorySize() const;
+
+	static constexpr size_t MAX_BUCKETS = 100000;
+
+private:
+	struct Block {
+		uint64_t first_ts;
+		uint64_t last_ts;
+		double first;
+		double min;
+		double max;
+		double sum;
+		uint32_t count;
+		uint32_t finite;			// Значений в min/max/sum
+		uint32_t bits;				// Занято бит в данных блока
+	};
+
+	// Состояние кодировщика текущего блока тега
+	struct TagState {
+		uint64_t prev_ts;
+		int64_t prev_delta;
+		uint64_t prev_value;		// Биты double
+		uint32_t head;				// Текущий блок
+		uint32_t used;				// Блоков с данными
+		uint8_t leading;			// Окно значащих бит предыдущего XOR, leading = 0xFF - окна нет
+		uint8_t trailing;
+	};
+
+	class Reader;
+
+	static constexpr size_t LOCKS = 64;
+	static constexpr size_t LOCK_GROUP_BITS = 6;	// Соседние 64 тега - под одной блокировкой
+
+	std::mutex& lockOf(const TagHandle handle) const { return m_locks[(handle >> LOCK_GROUP_BITS) % LOCKS]; }
+	Block* blockOf(const TagHandle handle, const uint32_t n) { return &m_blocks[handle * m_blocks_per_tag + n]; }
+	const Block* blockOf(const TagHandle handle, const uint32_t n) const { return &m_blocks[handle * m_blocks_per_tag + n]; }
+	uint64_t* bitsOf(const TagHandle handle, const uint32_t n) { return &m_bits[(handle * m_blocks_per_tag + n) * m_block_words]; }
+	const uint64_t* bitsOf(const TagHandle handle, const uint32_t n) const { return &m_bits[(handle * m_blocks_per_tag + n) * m_block_words]; }
+	void startBlock(const TagHandle handle, TagState& st, const uint64_t ts, const double value);
+	bool appendLocked(const TagHandle handle, const uint64_t ts, const double value);
+
+	size_t m_blocks_per_tag;
+	size_t m_block_words;
+	std::vector<TagState> m_tags;
+	std::vector<Block> m_blocks;			// Тег handle - блоки [handle * m_blocks_per_tag, ...)
+	std::vector<uint64_t> m_bits;			// Сжатые данные блоков, m_block_words слов на блок
+	mutable std::mutex m_locks[LOCKS];
+};
+
+} // data
+} // mb
+
+#endif // MB_TAG_HISTORY_H
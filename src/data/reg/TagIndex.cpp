@@ -0,0 +1,120 @@
+#include "TagIndex.h"
+
+#include <algorithm>
+
+namespace mb {
+namespace data {
+
+constexpr size_t INITIAL_NAME_SLOTS = 64;
+
+TagIndex::TagIndex() : m_slots(INITIAL_NAME_SLOTS, NameSlot{ 0, INVALID_TAG_HANDLE }), m_names(0), m_count(0) {}
+
+uint32_t TagIndex::hashName(std::string_view name) {
+	// FNV-1a
+	uint32_t h = 2166136261u;
+	for (char c : name) {
+		h ^= static_cast<uint8_t>(c);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+void TagIndex::clear() {
+	m_slots.assign(INITIAL_NAME_SLOTS, NameSlot{ 0, INVALID_TAG_HANDLE });
+	m_names = 0;
+	m_pool.clear();
+	m_refs.clear();
+	m_groups.clear();
+	m_count = 0;
+}
+
+bool TagIndex::add(std::string_view name, const int slave_id, const int func, const uint16_t address, const uint8_t width, const TagHandle handle) {
+	if (handle == INVALID_TAG_HANDLE) return false;
+	bool result = name.empty() || insertName(name, handle);
+
+	AdrGroup& g = m_groups[keyOf(slave_id, func)];
+	AdrEntry e = { address, static_cast<uint8_t>(width ? width : 1), handle };
+	// Добавление по возрастанию адресов - в конец, иначе вставка после тегов с тем же адресом (порядок добавления сохраняется)
+	if (g.entries.empty() || address >= g.entries.back().address) g.entries.push_back(e);
+	else g.entries.insert(std::upper_bound(g.entries.begin(), g.entries.end(), address, [](uint16_t adr, const AdrEntry& a) { return adr < a.address; }), e);
+	g.max_width = std::max(g.max_width, e.width);
+	++m_count;
+	return result;
+}
+
+bool TagIndex::insertName(std::string_view name, const TagHandle handle) {
+	if ((m_names + 1) * 2 > m_slots.size()) growNames();
+
+	const uint32_t h = hashName(name);
+	const size_t mask = m_slots.size() - 1;
+	for (size_t i = h & mask;; i = (i + 1) & mask) {
+		NameSlot& slot = m_slots[i];
+		if (slot.handle == INVALID_TAG_HANDLE) {
+			if (m_refs.size() <= handle) m_refs.resize(handle + 1, NameRef{ 0, 0 });
+			m_refs[handle] = NameRef{ static_cast<uint32_t>(m_pool.size()), static_cast<uint32_t>(name.size()) };
+			m_pool.append(name);
+			slot.hash = h;
+			slot.handle = handle;
+			++m_names;
+			return true;
+		}
+		if (slot.hash == h && getName(slot.handle) == name) return false;
+	}
+}
+
+void TagIndex::growNames() {
+	std::vector<NameSlot> old(m_slots.size() * 2, NameSlot{ 0, INVALID_TAG_HANDLE });
+	old.swap(m_slots);
+	const size_t mask = m_slots.size() - 1;
+	for (const NameSlot& s : old) {
+		if (s.handle == INVALID_TAG_HANDLE) continue;
+		size_t i = s.hash & mask;
+		while (m_slots[i].handle != INVALID_TAG_HANDLE) i = (i + 1) & mask;
+		m_slots[i] = s;
+	}
+}
+
+TagHandle TagIndex::findByName(std::string_view name) const {
+	const uint32_t h = hashName(name);
+	const size_t mask = m_slots.size() - 1;
+	for (size_t i = h & mask;; i = (i + 1) & mask) {
+		const NameSlot& slot = m_slots[i];
+		if (slot.handle == INVALID_TAG_HANDLE) return INVALID_TAG_HANDLE;
+		if (slot.hash == h && getName(slot.handle) == name) return slot.handle;
+	}
+}
+
+std::string_view TagIndex::getName(const TagHandle handle) const {
+	if (handle >= m_refs.size()) return std::string_view();
+	const NameRef& r = m_refs[handle];
+	return std::string_view(m_pool.data() + r.offset, r.len);
+}
+
+const TagIndex::AdrGroup* TagIndex::findGroup(const int slave_id, const int func) const {
+	auto it = m_groups.find(keyOf(slave_id, func));
+	return it == m_groups.end() ? nullptr : &it->second;
+}
+
+size_t TagIndex::findByAddress(const int slave_id, const int func, const uint16_t address, std::vector<TagHandle>& out) const {
+	return findByRange(slave_id, func, address, address, out);
+}
+
+size_t TagIndex::findByRange(const int slave_id, const int func, const uint16_t start, const uint16_t end, std::vector<TagHandle>& out) const {
+	const AdrGroup* g = findGroup(slave_id, func);
+	if (g == nullptr || start > end) return 0;
+
+	// Тег, начинающийся не раньше start - (max_width - 1), может накрывать start
+	const uint16_t from = start >= g->max_width - 1 ? start - (g->max_width - 1) : 0;
+	auto it = std::lower_bound(g->entries.begin(), g->entries.end(), from, [](const AdrEntry& e, uint16_t adr) { return e.address < adr; });
+
+	size_t found = 0;
+	for (; it != g->entries.end() && it->address <= end; ++it) {
+		if (static_cast<uint32_t>(it->address) + it->width <= start) continue;
+		out.push_back(it->handle);
+		++found;
+	}
+	return found;
+}
+
+} // data
+} // mb
@@ -0,0 +1,85 @@
+#ifndef MB_TAG_INDEX_H
+#define MB_TAG_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mb {
+namespace data {
+
+using TagHandle = uint32_t;
+
+constexpr TagHandle INVALID_TAG_HANDLE = UINT32_MAX;
+
+/** @brief Индекс тегов по имени и по адресу.
+	Тег задается дескриптором handle, который назначает владелец тегов (например, номер регистра в RegManager).
+	Имена копируются в общий буфер (интернирование) и ищутся в хеш-таблице с открытой адресацией.
+	Адреса хранятся в отсортированном массиве на каждую пару slave_id/func, поиск - двоичный.
+	Порядок поддерживается при добавлении, поэтому поиск константный и может выполняться из нескольких потоков
+	одновременно (но не одновременно с add) */
+class TagIndex {
+public:
+	TagIndex();
+	~TagIndex() {}
+
+	// Добавление тега, width - количество занимаемых адресов (2 для DWORD). Пустое имя в индекс имен не попадает.
+	// false - тег с таким именем уже есть: имя остается за первым тегом, в индекс адресов тег добавляется
+	bool add(std::string_view name, const int slave_id, const int func, const uint16_t address, const uint8_t width, const TagHandle handle);
+	void clear();
+
+	TagHandle findByName(std::string_view name) const;
+	// Теги slave_id/func, занимающие адрес address, добавляются в out. Возвращает количество найденных
+	size_t findByAddress(const int slave_id, const int func, const uint16_t address, std::vector<TagHandle>& out) const;
+	// Теги, пересекающиеся с [start-end]
+	size_t findByRange(const int slave_id, const int func, const uint16_t start, const uint16_t end, std::vector<TagHandle>& out) const;
+
+	// Имя тега из буфера индекса
+	std::string_view getName(const TagHandle handle) const;
+	size_t size() const { return m_count; }
+
+private:
+	struct NameSlot {
+		uint32_t hash;
+		TagHandle handle;		// INVALID_TAG_HANDLE - слот пуст
+	};
+
+	struct NameRef {
+		uint32_t offset;
+		uint32_t len;
+	};
+
+	struct AdrEntry {
+		uint16_t address;
+		uint8_t width;
+		TagHandle handle;
+	};
+
+	struct AdrGroup {
+		std::vector<AdrEntry> entries;
+		uint8_t max_width = 1;
+	};
+
+	static uint32_t hashName(std::string_view name);
+	static int keyOf(const int slave_id, const int func) { return (slave_id << 8) | (func & 0xFF); }
+
+	bool insertName(std::string_view name, const TagHandle handle);
+	void growNames();
+	const AdrGroup* findGroup(const int slave_id, const int func) const;
+
+	std::vector<NameSlot> m_slots;					// Размер - степень двойки, заполнение не больше половины
+	size_t m_names;
+	std::string m_pool;									// Интернированные имена
+	std::vector<NameRef> m_refs;						// handle -> имя в m_pool
+
+	std::unordered_map<int, AdrGroup> m_groups;	// (slave_id, func) -> адреса
+	size_t m_count;
+};
+
+} // data
+} // mb
+
+#endif // MB_TAG_INDEX_H
@@ -0,0 +1,230 @@
+#include "MapRegistry.h"
+#include "Arena.h"
+#include "WorkPool.h"
+
+#include <algorithm>
+
+namespace mb {
+namespace data {
+
+MapRegistry::MapRegistry(mem::Arena* arena) : m_arena(arena) {}
+
+int MapRegistry::tableOf(const int func) {
+	switch (func) {
+		case 1: case 5: case 15: return 0;
+		case 2: return 1;
+		case 3: case 6: case 16: return 2;
+		case 4: return 3;
+		default: return -1;
+	}
+}
+
+const MapRegistry::Slot* MapRegistry::slotOf(const int slave_id, const int func) const {
+	const int table = tableOf(func);
+	if (table < 0 || slave_id < 0 || slave_id > 255) return nullptr;
+	return m_slots[slave_id * TABLES + table].get();
+}
+
+MapRegistry::Slot& MapRegistry::slotFor(const int slave_id, const int table) {
+	std::unique_ptr<Slot>& slot = m_slots[slave_id * TABLES + table];
+	if (!slot) {
+		slot.reset(new Slot());
+		slot->pages.fill(0);
+	}
+	return *slot;
+}
+
+Map* MapRegistry::addMap(const int slave_id, const int func, const WORD start_adr, const WORD quantity) {
+	const int table = tableOf(func);
+	if (table < 0 || slave_id < 0 || slave_id > 255 || quantity == 0 || start_adr + quantity - 1 > 0xFFFF) return nullptr;
+	const WORD end_adr = static_cast<WORD>(start_adr + quantity - 1);
+
+	Slot* slot = &slotFor(slave_id, table);
+	// Карты таблицы устройства не должны пересекаться
+	auto pos = std::lower_bound(slot->maps.begin(), slot->maps.end(), start_adr, [this](uint32_t idx, WORD adr) { return m_entries[idx].start < adr; });
+	if (pos != slot->maps.end() && m_entries[*pos].start <= end_adr) return nullptr;
+	if (pos != slot->maps.begin() && m_entries[*(pos - 1)].end >= start_adr) return nullptr;
+
+	std::unique_ptr<Map> map(new Map());
+	const MapType type = table < 2 ? MapType::BIT_MAP : MapType::WORD_MAP;
+	const bool ok = m_arena ? map->initArenaMemory(start_adr, quantity, type, *m_arena) : map->initNewMemory(start_adr, quantity, type);
+	if (!ok) return nullptr;
+
+	Map* result = map.get();
+	slot->maps.insert(pos, static_cast<uint32_t>(m_entries.size()));
+	m_entries.push_back({ std::move(map), slave_id, table, start_adr, end_adr });
+	rebuildPages(*slot);
+	return result;
+}
+
+void MapRegistry::rebuildPages(Slot& slot) {
+	slot.pages.fill(0);
+	// Обход с конца: на странице остается первая по адресу карта
+	for (size_t i = slot.maps.size(); i > 0; i--) {
+		const Entry& e = m_entries[slot.maps[i - 1]];
+		for (size_t p = e.start >> PAGE_BITS; p <= static_cast<size_t>(e.end >> PAGE_BITS); p++) slot.pages[p] = static_cast<uint16_t>(i);
+	}
+}
+
+void MapRegistry::mapSpans(std::vector<Range>& ranges, const WORD max_gap, std::vector<Span>& spans) {
+	normalizeRangeList(ranges);
+	std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.start < b.start; });
+
+	spans.clear();
+	size_t i = 0;
+	while (i < ranges.size()) {
+		uint32_t start = ranges[i].start;
+		uint32_t end = ranges[i].end;
+		for (++i; i < ranges.size() && ranges[i].start <= end + 1 + max_gap; i++) end = std::max<uint32_t>(end, ranges[i].end);
+		spans.push_back(Span{ static_cast<WORD>(start), static_cast<WORD>(end) });
+	}
+}
+
+size_t MapRegistry::addRanges(const int slave_id, const int func, std::vector<Range> ranges, const WORD max_gap) {
+	std::vector<Span> spans;
+	mapSpans(ranges, max_gap, spans);
+
+	size_t created = 0;
+	for (const Span& sp : spans) {
+		if (addMap(slave_id, func, sp.start, static_cast<WORD>(sp.end - sp.start + 1))) ++created;
+	}
+	return created;
+}
+
+size_t MapRegistry::addBuckets(std::vector<RangeBucket>& buckets, const WORD max_gap, work::WorkPool* pool) {
+	auto forAll = [pool](size_t count, auto fn) {
+		if (pool) pool->parallelFor(count, fn);
+		else for (size_t i = 0; i < count; i++) fn(i);
+	};
+
+	// Нормализация групп независима
+	std::vector<std::vector<Span>> spans(buckets.size());
+	forAll(buckets.size(), [&](size_t i) { mapSpans(buckets[i].ranges, max_gap, spans[i]); });
+
+	// Записи карт без памяти: отрезки, не пересекающиеся с картами таблицы, вливаются в ее упорядоченный список
+	const size_t first = m_entries.size();
+	std::vector<Slot*> touched;
+	std::vector<uint32_t> added, merged;
+	for (size_t b = 0; b < buckets.size(); b++) {
+		const int slave_id = buckets[b].slave_id;
+		const int table = tableOf(buckets[b].func);
+		if (table < 0 || slave_id < 0 || slave_id > 255 || spans[b].empty()) continue;
+		Slot& slot = slotFor(slave_id, table);
+
+		added.clear();
+		for (const Span& sp : spans[b]) {
+			auto pos = std::lower_bound(slot.maps.begin(), slot.maps.end(), sp.start, [this](uint32_t idx, WORD adr) { return m_entries[idx].start < adr; });
+			if (pos != slot.maps.end() && m_entries[*pos].start <= sp.end) continue;
+			if (pos != slot.maps.begin() && m_entries[*(pos - 1)].end >= sp.start) continue;
+			added.push_back(static_cast<uint32_t>(m_entries.size()));
+			m_entries.push_back({ nullptr, slave_id, table, sp.start, sp.end });
+		}
+		if (added.empty()) continue;
+		if (std::find(touched.begin(), touched.end(), &slot) == touched.end()) touched.push_back(&slot);
+		merged.resize(slot.maps.size() + added.size());
+		std::merge(slot.maps.begin(), slot.maps.end(), added.begin(), added.end(), merged.begin(), [this](uint32_t a, uint32_t b) { return m_entries[a].start < m_entries[b].start; });
+		slot.maps.swap(merged);
+	}
+
+	// Память карт. Арена не потокобезопасна - с ней выделение последовательное
+	const size_t count = m_entries.size() - first;
+	std::vector<uint8_t> ok(count, 0);
+	auto init = [this, first, &ok](size_t i) {
+		Entry& e = m_entries[first + i];
+		e.map.reset(new Map());
+		const MapType type = e.table < 2 ? MapType::BIT_MAP : MapType::WORD_MAP;
+		const WORD quantity = static_cast<WORD>(e.end - e.start + 1);
+		ok[i] = m_arena ? e.map->initArenaMemory(e.start, quantity, type, *m_arena) : e.map->initNewMemory(e.start, quantity, type);
+	};
+	if (m_arena) for (size_t i = 0; i < count; i++) init(i);
+	else forAll(count, init);
+
+	// Карты без памяти удаляются, индексы новых записей в таблицах сдвигаются
+	size_t created = count;
+	if (std::find(ok.begin(), ok.end(), 0) != ok.end()) {
+		std::vector<uint32_t> remap(count);
+		size_t to = first;
+		for (size_t i = 0; i < count; i++) {
+			remap[i] = ok[i] ? static_cast<uint32_t>(to) : UINT32_MAX;
+			if (ok[i]) m_entries[to++] = std::move(m_entries[first + i]);
+		}
+		m_entries.resize(to);
+		created = to - first;
+		for (Slot* slot : touched) {
+			size_t n = 0;
+			for (uint32_t idx : slot->maps) {
+				const uint32_t moved = idx < first ? idx : remap[idx - first];
+				if (moved != UINT32_MAX) slot->maps[n++] = moved;
+			}
+			slot->maps.resize(n);
+		}
+	}
+
+	// Страничный индекс - один раз на таблицу, а не после каждой карты
+	forAll(touched.size(), [this, &touched](size_t i) { rebuildPages(*touched[i]); });
+	return created;
+}
+
+void MapRegistry::clear() {
+	for (std::unique_ptr<Slot>& slot : m_slots) slot.reset();
+	m_entries.clear();
+}
+
+bool MapRegistry::route(const int slave_id, const int func, const WORD adr, MapRoute& out) const {
+	const Slot* slot = slotOf(slave_id, func);
+	if (slot == nullptr) return false;
+	const uint16_t first = slot->pages[adr >> PAGE_BITS];
+	if (first == 0) return false;
+
+	for (size_t i = first - 1; i < slot->maps.size(); i++) {
+		const Entry& e = m_entries[slot->maps[i]];
+		if (adr < e.start) return false;
+		if (adr <= e.end) {
+			out.map = e.map.get();
+			out.offset = adr - e.start;
+			out.available = static_cast<WORD>(e.end - adr + 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+Map* MapRegistry::find(const int slave_id, const int func, const WORD start_adr, const WORD quantity) const {
+	MapRoute r;
+	if (quantity == 0 || !route(slave_id, func, start_adr, r) || r.available < quantity) return nullptr;
+	return r.map;
+}
+
+template <typename T, typename Op>
+bool MapRegistry::forSpan(const int slave_id, const int func, const WORD start_adr, const WORD quantity, T* vals, Op op) const {
+	if (vals == nullptr || quantity == 0 || start_adr + quantity - 1 > 0xFFFF) return false;
+	const uint32_t end = start_adr + quantity - 1;
+	uint32_t adr = start_adr;
+	while (adr <= end) {
+		MapRoute r;
+		if (!route(slave_id, func, static_cast<WORD>(adr), r)) return false;
+		const WORD n = static_cast<WORD>(std::min<uint32_t>(r.available, end - adr + 1));
+		if (!op(*r.map, static_cast<WORD>(adr), n, vals + (adr - start_adr))) return false;
+		adr += n;
+	}
+	return true;
+}
+
+bool MapRegistry::readWords(const int slave_id, const int func, const WORD start_adr, const WORD quantity, WORD* vals) const {
+	return forSpan(slave_id, func, start_adr, quantity, vals, [](Map& m, WORD adr, WORD n, WORD* v) { return m.readWords(adr, n, v); });
+}
+
+bool MapRegistry::writeWords(const int slave_id, const int func, const WORD start_adr, const WORD quantity, const WORD* vals) const {
+	return forSpan(slave_id, func, start_adr, quantity, vals, [](Map& m, WORD adr, WORD n, const WORD* v) { return m.writeWords(adr, n, const_cast<WORD*>(v)); });
+}
+
+bool MapRegistry::readBits(const int slave_id, const int func, const WORD start_adr, const WORD quantity, BIT* vals) const {
+	return forSpan(slave_id, func, start_adr, quantity, vals, [](Map& m, WORD adr, WORD n, BIT* v) { return m.readBits(adr, n, v); });
+}
+
+bool MapRegistry::writeBits(const int slave_id, const int func, const WORD start_adr, const WORD quantity, const BIT* vals) const {
+	return forSpan(slave_id, func, start_adr, quantity, vals, [](Map& m, WORD adr, WORD n, const BIT* v) { return m.writeBits(adr, n, const_cast<BIT*>(v)); });
+}
+
+} // data
+} // mb
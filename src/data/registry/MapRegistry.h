@@ -0,0 +1,126 @@
+#ifndef MB_MAP_REGISTRY_H
+#define MB_MAP_REGISTRY_H
+
+#include "Map.h"
+#include "Range.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace mb {
+namespace mem {
+class Arena;
+}
+
+namespace work {
+class WorkPool;
+}
+
+namespace data {
+
+/** @brief Результат маршрутизации адреса: карта, смещение адреса в ней и количество адресов до конца карты */
+struct MapRoute {
+	Map* map = nullptr;
+	WORD offset = 0;
+	WORD available = 0;
+};
+
+/** @brief Диапазоны опроса одной пары slave_id/func для MapRegistry::addBuckets */
+struct RangeBucket {
+	int slave_id;
+	int func;
+	std::vector<Range> ranges;
+};
+
+/** @brief Реестр карт памяти всех устройств: владеет картами и находит карту по (slave_id, func, адрес) за O(1).
+	Функции сводятся к таблицам Modbus: 1, 5, 15 - катушки, 2 - дискретные входы, 3, 6, 16 - регистры хранения,
+	4 - входные регистры. Катушки и входы хранятся в картах битов, регистры - в картах слов.
+	Адреса карт совпадают с адресами Modbus.
+	Маршрутизация: прямая таблица [slave_id][таблица] -> страничный индекс адресов по 64 адреса,
+	элемент страницы - первая карта, пересекающая страницу. Карты таблицы устройства не пересекаются,
+	поэтому поиск внутри страницы проходит не больше карт, начинающихся на этой странице.
+	Карты добавляются до начала работы потоков; маршрутизация и операции над картами потокобезопасны за счет мьютексов Map */
+class MapRegistry {
+public:
+	// arena - память карт из арены (например, на huge pages), nullptr - собственная память каждой карты
+	explicit MapRegistry(mem::Arena* arena = nullptr);
+	~MapRegistry() {}
+
+	MapRegistry(const MapRegistry&) = delete;
+	MapRegistry& operator=(const MapRegistry&) = delete;
+
+	// Создание карты [start_adr, start_adr + quantity - 1], nullptr - неверная функция или пересечение с картой той же таблицы
+	Map* addMap(const int slave_id, const int func, const WORD start_adr, const WORD quantity);
+	// Карты по диапазонам опроса: диапазоны нормализуются, затем сливаются без учета класса опроса,
+	// разрывы не длиннее max_gap закрываются одной картой. Возвращает количество созданных карт
+	size_t addRanges(const int slave_id, const int func, std::vector<Range> ranges, const WORD max_gap = 0);
+	// То же для всех устройств сразу (запуск): нормализация групп и выделение памяти карт идут в пуле потоков,
+	// страничные индексы строятся один раз на таблицу. Диапазоны групп нормализуются на месте.
+	// pool == nullptr или арена - выделение памяти в вызывающем потоке. Возвращает количество созданных карт
+	size_t addBuckets(std::vector<RangeBucket>& buckets, const WORD max_gap = 0, work::WorkPool* pool = nullptr);
+	void clear();
+
+	bool route(const int slave_id, const int func, const WORD adr, MapRoute& out) const;
+	// Карта, целиком содержащая [start_adr, start_adr + quantity - 1] (например, для записи ответа ModbusMaster::readToMap)
+	Map* find(const int slave_id, const int func, const WORD start_adr, const WORD quantity = 1) const;
+
+	// Пакетные операции над диапазоном, который может проходить через несколько соседних карт.
+	// false - часть адресов не принадлежит ни одной карте (данные до этого места уже прочитаны/записаны)
+	bool readWords(const int slave_id, const int func, const WORD start_adr, const WORD quantity, WORD* vals) const;
+	bool writeWords(const int slave_id, const int func, const WORD start_adr, const WORD quantity, const WORD* vals) const;
+	bool readBits(const int slave_id, const int func, const WORD start_adr, const WORD quantity, BIT* vals) const;
+	bool writeBits(const int slave_id, const int func, const WORD start_adr, const WORD quantity, const BIT* vals) const;
+
+	// Обход всех карт: fn(slave_id, func чтения таблицы (1-4), Map&)
+	template <typename Fn>
+	void forEachMap(Fn fn) const {
+		for (const Entry& e : m_entries) fn(e.slave_id, e.table + 1, *e.map);
+	}
+
+	size_t getMapCount() const { return m_entries.size(); }
+
+	// Номер таблицы функции 0-3, -1 - функция не работает с таблицами
+	static int tableOf(const int func);
+
+private:
+	static constexpr int TABLES = 4;
+	static constexpr int PAGE_BITS = 6;
+	static constexpr size_t PAGES = 65536 >> PAGE_BITS;
+
+	struct Entry {
+		std::unique_ptr<Map> map;
+		int slave_id;
+		int table;
+		WORD start;
+		WORD end;
+	};
+
+	struct Slot {
+		std::vector<uint32_t> maps;				// Индексы m_entries по возрастанию адреса
+		std::array<uint16_t, PAGES> pages;		// Позиция в maps + 1 первой карты, пересекающей страницу, 0 - нет
+	};
+
+	struct Span {
+		WORD start;
+		WORD end;
+	};
+
+	const Slot* slotOf(const int slave_id, const int func) const;
+	Slot& slotFor(const int slave_id, const int table);
+	// Нормализация диапазонов и слияние в отрезки карт по возрастанию адреса
+	static void mapSpans(std::vector<Range>& ranges, const WORD max_gap, std::vector<Span>& spans);
+	void rebuildPages(Slot& slot);
+	template <typename T, typename Op>
+	bool forSpan(const int slave_id, const int func, const WORD start_adr, const WORD quantity, T* vals, Op op) const;
+
+	mem::Arena* m_arena;
+	std::vector<Entry> m_entries;
+	std::array<std::unique_ptr<Slot>, 256 * TABLES> m_slots;	// slave_id * TABLES + таблица
+};
+
+} // data
+} // mb
+
+#endif // MB_MAP_REGISTRY_H
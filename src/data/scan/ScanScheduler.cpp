@@ -0,0 +1,262 @@
+#include "ScanScheduler.h"
+#include "ModbusDefs.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace mb {
+namespace data {
+
+bool ScanScheduler::heapGreater(const HeapItem& a, const HeapItem& b) {
+	return a.due_ms > b.due_ms;
+}
+
+bool ScanScheduler::addRange(int slave_id, int func, const Range& range, uint32_t default_ms) {
+	Entry e;
+	e.slave_id = slave_id;
+	e.func = func;
+	e.range = range;
+	if (e.range.scan_ms == 0) e.range.scan_ms = default_ms;
+	if (e.range.scan_ms == 0 || e.range.start > e.range.end) return false;
+	e.due_ms = 0;
+	e.cycle = 0;
+	m_entries.push_back(e);
+	m_sorted = false;
+	return true;
+}
+
+void ScanScheduler::clear() {
+	m_entries.clear();
+	m_heap.clear();
+	m_due.clear();
+	m_sorted = true;
+}
+
+void ScanScheduler::replaceRanges(int slave_id, int func, const std::vector<Range>& ranges, uint32_t default_ms, uint64_t now_ms) {
+	replaceGroups(std::vector<ScanGroup>(1, ScanGroup{ slave_id, func, &ranges }), default_ms, now_ms);
+}
+
+void ScanScheduler::replaceGroups(const std::vector<ScanGroup>& groups, uint32_t default_ms, uint64_t now_ms) {
+	if (!m_sorted) sortEntries();
+
+	auto keyOf = [](const Entry& e) { return std::make_pair(e.slave_id, e.func); };
+	std::vector<std::pair<int, int>> keys;
+	std::vector<Entry> staged;
+	keys.reserve(groups.size());
+	for (const ScanGroup& g : groups) {
+		keys.emplace_back(g.slave_id, g.func);
+		if (g.ranges == nullptr) continue;
+		for (const Range& r : *g.ranges) {
+			Entry e;
+			e.slave_id = g.slave_id;
+			e.func = g.func;
+			e.range = r;
+			if (e.range.scan_ms == 0) e.range.scan_ms = default_ms;
+			if (e.range.scan_ms == 0 || e.range.start > e.range.end) continue;
+			e.due_ms = now_ms;
+			e.cycle = 0;
+			staged.push_back(e);
+		}
+	}
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	std::sort(staged.begin(), staged.end(), entryLess);
+
+	// Слияние за один проход: группы вне keys копируются как есть, в заменяемых группах старые и новые
+	// диапазоны идут в одном порядке, поэтому неизменившиеся находятся встречным проходом двух указателей
+	std::vector<Entry> merged;
+	merged.reserve(m_entries.size() + staged.size());
+	size_t i = 0;
+	size_t j = 0;
+	for (const auto& key : keys) {
+		while (i < m_entries.size() && keyOf(m_entries[i]) < key) merged.push_back(m_entries[i++]);
+		size_t old_end = i;
+		while (old_end < m_entries.size() && keyOf(m_entries[old_end]) == key) ++old_end;
+
+		for (; j < staged.size() && keyOf(staged[j]) == key; j++) {
+			Entry e = staged[j];
+			while (i < old_end && entryLess(m_entries[i], e)) ++i;
+			// Неизменившийся диапазон продолжает свое расписание
+			if (i < old_end && !entryLess(e, m_entries[i])) {
+				e.due_ms = m_entries[i].due_ms;
+				e.cycle = m_entries[i].cycle;
+				++i;
+			}
+			merged.push_back(e);
+		}
+		i = old_end;
+	}
+	merged.insert(merged.end(), m_entries.begin() + i, m_entries.end());
+	m_entries.swap(merged);
+
+	// Индексы остальных диапазонов сдвигаются, поэтому куча строится заново по сохраненным срокам
+	rebuildHeap();
+}
+
+void ScanScheduler::rebuildHeap() {
+	m_heap.clear();
+	m_heap.reserve(m_entries.size() * 2);
+	for (uint32_t i = 0; i < m_entries.size(); i++) m_heap.push_back({ m_entries[i].due_ms, i });
+	std::make_heap(m_heap.begin(), m_heap.end(), heapGreater);
+}
+
+void ScanScheduler::setMaxGap(uint16_t max_gap) { m_max_gap = max_gap; }
+
+void ScanScheduler::setMergeWindow(double ratio) {
+	if (ratio < 0) ratio = 0;
+	if (ratio > 1) ratio = 1;
+	m_merge_window = ratio;
+}
+
+size_t ScanScheduler::size() const { return m_entries.size(); }
+
+uint16_t ScanScheduler::maxQuantity(int func) {
+	return (func == 1 || func == 2) ? MODBUS_MAX_READ_BITS : MODBUS_MAX_READ_REGISTERS;
+}
+
+bool ScanScheduler::entryLess(const Entry& a, const Entry& b) {
+	if (a.slave_id != b.slave_id) return a.slave_id < b.slave_id;
+	if (a.func != b.func) return a.func < b.func;
+	if (a.range.start != b.range.start) return a.range.start < b.range.start;
+	if (a.range.end != b.range.end) return a.range.end < b.range.end;
+	return a.range.scan_ms < b.range.scan_ms;
+}
+
+void ScanScheduler::sortEntries() {
+	std::sort(m_entries.begin(), m_entries.end(), entryLess);
+	m_sorted = true;
+}
+
+void ScanScheduler::start(uint64_t now_ms) {
+	if (!m_sorted) sortEntries();
+	for (Entry& e : m_entries) {
+		e.due_ms = now_ms;
+		e.cycle = 0;
+	}
+	rebuildHeap();
+	m_cycle = 0;
+}
+
+uint64_t ScanScheduler::nextDeadline() const {
+	if (m_heap.empty()) return std::numeric_limits<uint64_t>::max();
+	return m_heap.front().due_ms;
+}
+
+void ScanScheduler::push(uint32_t idx) {
+	m_heap.push_back({ m_entries[idx].due_ms, idx });
+	std::push_heap(m_heap.begin(), m_heap.end(), heapGreater);
+}
+
+bool ScanScheduler::isNeighbour(const Entry& a, const Entry& b) const {
+	return a.slave_id == b.slave_id && a.func == b.func;
+}
+
+bool ScanScheduler::isEligible(const Entry& e, uint64_t now_ms) const {
+	if (e.cycle == m_cycle) return false;
+	if (e.due_ms <= now_ms) return true;
+	return (e.due_ms - now_ms) <= static_cast<uint64_t>(e.range.scan_ms * m_merge_window);
+}
+
+void ScanScheduler::reschedule(Entry& e, uint64_t now_ms) {
+	uint64_t next;
+	// Опрос в срок - следующий срок отсчитывается от предыдущего, чтобы период не "уплывал"
+	if (e.due_ms <= now_ms) {
+		next = e.due_ms + e.range.scan_ms;
+		if (next <= now_ms) next = now_ms + e.range.scan_ms; // Пропущенные сроки не накапливаются
+	}
+	// Досрочный опрос вместе с соседом
+	else next = now_ms + e.range.scan_ms;
+	e.due_ms = next;
+}
+
+size_t ScanScheduler::buildCycle(uint64_t now_ms, std::vector<ScanRequest>& out) {
+	if (!m_sorted) start(now_ms);
+
+	size_t first_out = out.size();
+	size_t added = 0;
+	++m_cycle;
+	m_due.clear();
+
+	// Извлекаем из кучи все наступившие сроки
+	while (!m_heap.empty() && m_heap.front().due_ms <= now_ms) {
+		HeapItem item = m_heap.front();
+		std::pop_heap(m_heap.begin(), m_heap.end(), heapGreater);
+		m_heap.pop_back();
+		if (m_entries[item.idx].due_ms != item.due_ms) continue; // Устаревший элемент (диапазон опрошен досрочно)
+		m_due.push_back(item.idx);
+	}
+
+	// Индексы соответствуют порядку адресов, поэтому запросы формируются слева направо
+	std::sort(m_due.begin(), m_due.end());
+
+	for (uint32_t idx : m_due) {
+		Entry& first = m_entries[idx];
+		if (first.cycle == m_cycle) continue;
+
+		const uint16_t max_q = maxQuantity(first.func);
+		uint32_t span_start = first.range.start;
+		uint32_t span_end = first.range.end;
+		uint32_t scan_ms = first.range.scan_ms;
+		size_t lo = idx;
+		size_t hi = idx;
+
+		// Присоединяем соседей справа. Диапазон, целиком лежащий внутри запроса, присоединяется и до своего срока
+		auto extendRight = [&]() {
+			while (hi + 1 < m_entries.size()) {
+				const Entry& e = m_entries[hi + 1];
+				if (!isNeighbour(first, e) || e.range.start > span_end + 1 + m_max_gap) break;
+				if (e.range.end > span_end) {
+					if (e.range.end - span_start + 1 > max_q || !isEligible(e, now_ms)) break;
+					span_end = e.range.end;
+				}
+				++hi;
+			}
+		};
+		extendRight();
+		// Присоединяем соседей слева. Диапазоны упорядочены по началу, а не по концу, поэтому короткий диапазон,
+		// не достающий до запроса, не останавливает поиск: левее может лежать длинный перекрывающий диапазон.
+		// Поиск ограничен протокольным лимитом - начала левее только меньше
+		for (size_t j = lo; j > 0; j--) {
+			const Entry& e = m_entries[j - 1];
+			if (!isNeighbour(first, e) || span_end - e.range.start + 1 > max_q) break;
+			if (static_cast<uint32_t>(e.range.end) + 1 + m_max_gap < span_start) continue;
+			uint32_t new_end = std::max<uint32_t>(span_end, e.range.end);
+			if (new_end - e.range.start + 1 > max_q || !isEligible(e, now_ms)) break;
+			// Пропущенные короткие диапазоны оказываются внутри запроса и опрашиваются вместе с ним
+			span_start = e.range.start;
+			span_end = new_end;
+			lo = j - 1;
+		}
+		// Диапазон слева мог продлить запрос вправо
+		extendRight();
+
+		for (size_t i = lo; i <= hi; i++) {
+			Entry& e = m_entries[i];
+			if (e.cycle == m_cycle) continue; // Уже вошел в более ранний запрос цикла
+			e.cycle = m_cycle;
+			scan_ms = std::min(scan_ms, e.range.scan_ms);
+			reschedule(e, now_ms);
+			push(static_cast<uint32_t>(i));
+		}
+
+		// Диапазон длиннее протокольного лимита делится на несколько запросов
+		added += splitRange(span_start, span_end, max_q, [&](uint16_t start, uint16_t quantity) {
+			out.push_back({ first.slave_id, first.func, start, quantity, scan_ms });
+		});
+	}
+
+	// Приоритет: запросы более быстрых классов опроса выполняются в цикле первыми.
+	// Внутри класса запросы остаются в порядке адресов. std::stable_sort выделял бы временный буфер на каждом цикле,
+	// поэтому порядок адресов задается явно вторичным ключом
+	std::sort(out.begin() + first_out, out.end(), [](const ScanRequest& a, const ScanRequest& b) {
+		if (a.scan_ms != b.scan_ms) return a.scan_ms < b.scan_ms;
+		if (a.slave_id != b.slave_id) return a.slave_id < b.slave_id;
+		if (a.func != b.func) return a.func < b.func;
+		return a.start < b.start;
+	});
+
+	return added;
+}
+
+} // data
+} // mb
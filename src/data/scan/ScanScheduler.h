@@ -0,0 +1,111 @@
+#ifndef MB_SCAN_SCHEDULER_H
+#define MB_SCAN_SCHEDULER_H
+
+#include "Range.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace mb {
+namespace data {
+
+/** @brief Запрос чтения, который необходимо выполнить в текущем цикле опроса */
+struct ScanRequest {
+	int slave_id;
+	int func;
+	uint16_t start;
+	uint16_t quantity;
+	uint32_t scan_ms; // Минимальный период опроса среди вошедших в запрос диапазонов
+};
+
+/** @brief Диапазоны одного slave_id/func для пакетной замены */
+struct ScanGroup {
+	int slave_id;
+	int func;
+	const std::vector<Range>* ranges; // nullptr - диапазоны группы удаляются
+};
+
+/** @brief Планировщик опроса диапазонов по классам (периодам) опроса.
+	Каждый диапазон имеет свой срок следующего опроса, сроки хранятся в куче (min-heap).
+	На каждом цикле формируется набор запросов только по тем диапазонам, срок которых наступил.
+	Соседние диапазоны того же slave_id/func, срок которых скоро наступит (окно слияния),
+	присоединяются к запросу, если это не превышает протокольный лимит количества регистров
+*/
+
+// Пример. Диапазоны [1-10] 100 мс и [11-40] 60000 мс, окно слияния 0.25
+// t = 0      -> [1-40]  (оба диапазона должны быть опрошены)
+// t = 100    -> [1-10]
+// ...
+// t = 45000  -> [1-40]  (до опроса [11-40] осталось меньше 25% периода, запрос объединяется)
+
+class ScanScheduler {
+public:
+	ScanScheduler() : m_max_gap(0), m_merge_window(0.25), m_cycle(0), m_sorted(true) {}
+	~ScanScheduler() {}
+
+	// Добавление диапазона, если у диапазона не задан класс опроса (scan_ms == 0), используется default_ms
+	bool addRange(int slave_id, int func, const Range& range, uint32_t default_ms);
+	void clear();
+	// Замена всех диапазонов slave_id/func без перезапуска расписания остальных диапазонов.
+	// Диапазоны, совпавшие со старыми, сохраняют свой срок, новые опрашиваются сразу (срок now_ms)
+	void replaceRanges(int slave_id, int func, const std::vector<Range>& ranges, uint32_t default_ms, uint64_t now_ms);
+	// Замена диапазонов нескольких групп за один проход по списку диапазонов и одно перестроение кучи
+	void replaceGroups(const std::vector<ScanGroup>& groups, uint32_t default_ms, uint64_t now_ms);
+
+	// Максимальный разрыв в адресах между диапазонами, который допускается закрыть одним запросом
+	void setMaxGap(uint16_t max_gap);
+	// Доля периода диапазона, в пределах которой его опрос может быть выполнен досрочно вместе с соседом
+	void setMergeWindow(double ratio);
+
+	// Взвод сроков всех диапазонов на момент now_ms
+	void start(uint64_t now_ms);
+	// Формирование запросов текущего цикла, возвращает количество добавленных в out запросов.
+	// Запросы упорядочены по приоритету - сначала более быстрые классы опроса
+	size_t buildCycle(uint64_t now_ms, std::vector<ScanRequest>& out);
+	// Ближайший срок опроса, если диапазонов нет - UINT64_MAX
+	uint64_t nextDeadline() const;
+
+	size_t size() const;
+
+	// Протокольный лимит количества регистров (битов) в одном запросе чтения
+	static uint16_t maxQuantity(int func);
+
+private:
+	struct Entry {
+		int slave_id;
+		int func;
+		Range range;
+		uint64_t due_ms;		// Срок следующего опроса
+		uint32_t cycle;		// Номер цикла, в котором диапазон уже вошел в запрос
+	};
+
+	struct HeapItem {
+		uint64_t due_ms;
+		uint32_t idx;
+	};
+
+	static bool heapGreater(const HeapItem& a, const HeapItem& b);
+	// Порядок диапазонов (slave_id, func, start, end, scan_ms)
+	static bool entryLess(const Entry& a, const Entry& b);
+
+	void sortEntries();
+	void rebuildHeap();
+	void push(uint32_t idx);
+	bool isNeighbour(const Entry& a, const Entry& b) const;
+	bool isEligible(const Entry& e, uint64_t now_ms) const;
+	void reschedule(Entry& e, uint64_t now_ms);
+
+	uint16_t m_max_gap;
+	double m_merge_window;
+	uint32_t m_cycle;
+	bool m_sorted;
+
+	std::vector<Entry> m_entries;	 		// Диапазоны, упорядоченные по entryLess
+	std::vector<HeapItem> m_heap;	 		// Сроки опроса, устаревшие элементы отбрасываются при извлечении
+	std::vector<uint32_t> m_due;			// Буфер индексов диапазонов, срок которых наступил
+};
+
+} // data
+} // mb
+
+#endif // MB_SCAN_SCHEDULER_H
@@ -0,0 +1,304 @@
+#include "SubscriptionHub.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace mb {
+namespace data {
+
+static uint64_t nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** @brief Наблюдатель одной карты: подписки всех подписчиков по возрастанию начального адреса */
+class SubscriptionHub::Watch : public MapObserver {
+public:
+	struct Ref {
+		WORD start;
+		WORD end;
+		Channel* channel;
+		uint32_t entry;
+	};
+
+	explicit Watch(Map& map) : m_map(map), m_max_len(1) {}
+
+	Map& getMap() { return m_map; }
+
+	void add(Channel* channel, const uint32_t entry) {
+		const Entry& e = channel->entries[entry];
+		const Ref ref = { e.start, e.end, channel, entry };
+		auto pos = std::upper_bound(m_refs.begin(), m_refs.end(), ref.start, [](WORD adr, const Ref& r) { return adr < r.start; });
+		m_refs.insert(pos, ref);
+		m_max_len = std::max<uint32_t>(m_max_len, e.end - e.start + 1u);
+	}
+
+	void onWords(const WORD adr, const WORD quantity, const WORD* old_val, const WORD* new_val, const uint64_t timestamp_ns) override {
+		const uint32_t last = adr + quantity - 1u;
+		for (auto it = firstRef(adr); it != m_refs.end() && it->start <= last; ++it) {
+			if (it->end < adr) continue;
+			Channel& ch = *it->channel;
+			Entry& e = ch.entries[it->entry];
+			const uint32_t lo = std::max<uint32_t>(e.start, adr), hi = std::min<uint32_t>(e.end, last);
+			if (e.tag != INVALID_TAG_HANDLE) {
+				bool changed = false;
+				for (uint32_t a = lo; a <= hi; a++) {
+					WORD& s = e.shadow[a - e.start];
+					changed |= s != new_val[a - adr];
+					s = new_val[a - adr];
+				}
+				if (changed) push(ch, e.dirty, tagEvent(e, timestamp_ns));
+				continue;
+			}
+			for (uint32_t a = lo; a <= hi; a++) {
+				// Ответ обычно меняет несколько слов: без изменений пропускается по 4 слова за сравнение
+				if (a + 3 <= hi && memcmp(old_val + (a - adr), new_val + (a - adr), 4 * sizeof(WORD)) == 0) {
+					a += 3;
+					continue;
+				}
+				if (old_val[a - adr] == new_val[a - adr]) continue;
+				push(ch, e.dirty + (a - e.start), ChangeEvent{ timestamp_ns, &m_map, INVALID_TAG_HANDLE, static_cast<WORD>(a), 1, 0, { new_val[a - adr], 0, 0, 0 } });
+			}
+		}
+	}
+
+	void onBits(const WORD adr, const WORD quantity, const BIT* old_val, const BIT* new_val, const uint64_t timestamp_ns) override {
+		const uint32_t last = adr + quantity - 1u;
+		for (auto it = firstRef(adr); it != m_refs.end() && it->start <= last; ++it) {
+			if (it->end < adr) continue;
+			Channel& ch = *it->channel;
+			Entry& e = ch.entries[it->entry];
+			const uint32_t lo = std::max<uint32_t>(e.start, adr), hi = std::min<uint32_t>(e.end, last);
+			for (uint32_t a = lo; a <= hi; a++) {
+				const WORD bit = new_val[a - adr] != 0;
+				if (e.tag != INVALID_TAG_HANDLE) {
+					if (e.shadow[0] == bit) continue;
+					e.shadow[0] = bit;
+					push(ch, e.dirty, tagEvent(e, timestamp_ns));
+				}
+				else if ((old_val[a - adr] != 0) != bit) {
+					push(ch, e.dirty + (a - e.start), ChangeEvent{ timestamp_ns, &m_map, INVALID_TAG_HANDLE, static_cast<WORD>(a), 1, 0, { bit, 0, 0, 0 } });
+				}
+			}
+		}
+	}
+
+private:
+	std::vector<Ref>::const_iterator firstRef(const WORD adr) const {
+		// Подписка, начавшаяся раньше adr, короче m_max_len
+		const WORD from = adr >= m_max_len ? static_cast<WORD>(adr - m_max_len + 1) : 0;
+		return std::lower_bound(m_refs.begin(), m_refs.end(), from, [](const Ref& r, WORD a) { return r.start < a; });
+	}
+
+	ChangeEvent tagEvent(const Entry& e, const uint64_t timestamp_ns) const {
+		ChangeEvent ev = { timestamp_ns, &m_map, e.tag, e.start, static_cast<uint8_t>(e.end - e.start + 1), 0, {} };
+		memcpy(ev.value, e.shadow, sizeof(ev.value));
+		return ev;
+	}
+
+	// Писатель кольца один - запись в карту идет под ее блокировкой, счетчики писателя меняются без атомарных RMW
+	static void push(Channel& ch, const uint32_t dirty, const ChangeEvent& ev) {
+		const uint64_t head = ch.head.load(std::memory_order_relaxed);
+		const uint64_t tail = ch.tail.load(std::memory_order_acquire);
+		if (head - tail > ch.mask) {
+			if (ch.policy == OverflowPolicy::COALESCE) {
+				ch.dirty[dirty].store(1, std::memory_order_relaxed);
+				ch.dirty_any.store(true, std::memory_order_release);
+				ch.coalesced.store(ch.coalesced.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+			else ch.dropped.store(ch.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return;
+		}
+		ch.ring[head & ch.mask] = ev;
+		ch.head.store(head + 1, std::memory_order_release);
+		ch.published.store(ch.published.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (head + 1 - tail > ch.max_pending.load(std::memory_order_relaxed)) ch.max_pending.store(head + 1 - tail, std::memory_order_relaxed);
+	}
+
+	Map& m_map;
+	std::vector<Ref> m_refs;
+	uint32_t m_max_len;
+};
+
+SubscriptionHub::SubscriptionHub() {}
+
+SubscriptionHub::~SubscriptionHub() {
+	clear();
+}
+
+void SubscriptionHub::clear() {
+	for (std::unique_ptr<Watch>& w : m_watches) w->getMap().setObserver(nullptr);
+	m_watches.clear();
+	m_subs.clear();
+}
+
+SubscriberId SubscriptionHub::addSubscriber(const size_t capacity, const OverflowPolicy policy) {
+	std::unique_ptr<Subscriber> sub(new Subscriber);
+	sub->capacity = 16;
+	while (sub->capacity < capacity) sub->capacity <<= 1;
+	sub->policy = policy;
+	sub->next = 0;
+	m_subs.push_back(std::move(sub));
+	return static_cast<SubscriberId>(m_subs.size() - 1);
+}
+
+SubscriptionHub::Watch* SubscriptionHub::watchOf(Map& map) {
+	for (std::unique_ptr<Watch>& w : m_watches) {
+		if (&w->getMap() == &map) return w.get();
+	}
+	if (map.getObserver() != nullptr) return nullptr;
+	m_watches.emplace_back(new Watch(map));
+	map.setObserver(m_watches.back().get());
+	return m_watches.back().get();
+}
+
+SubscriptionHub::Channel* SubscriptionHub::channelOf(const SubscriberId id, Map& map) {
+	Subscriber& sub = *m_subs[id];
+	for (std::unique_ptr<Channel>& ch : sub.channels) {
+		if (ch->map == &map) return ch.get();
+	}
+	std::unique_ptr<Channel> ch(new Channel);
+	ch->map = &map;
+	ch->policy = sub.policy;
+	ch->mask = sub.capacity - 1;
+	ch->ring.reset(new ChangeEvent[sub.capacity]);
+	ch->dirty_count = 0;
+	ch->head.store(0);
+	ch->published.store(0);
+	ch->dropped.store(0);
+	ch->coalesced.store(0);
+	ch->max_pending.store(0);
+	ch->dirty_any.store(false);
+	ch->tail.store(0);
+	ch->delivered.store(0);
+	ch->lag_sum.store(0);
+	ch->lag_max.store(0);
+	sub.channels.push_back(std::move(ch));
+	return sub.channels.back().get();
+}
+
+bool SubscriptionHub::addEntry(const SubscriberId id, Map& map, const Entry& entry, const uint32_t flags) {
+	Watch* watch = watchOf(map);
+	if (watch == nullptr) return false;
+	Channel* ch = channelOf(id, map);
+	ch->entries.push_back(entry);
+	ch->entries.back().dirty = static_cast<uint32_t>(ch->dirty_count);
+	// Флаги задаются до начала работы потоков: массив пересоздается
+	ch->dirty_count += flags;
+	ch->dirty.reset(new std::atomic<uint8_t>[ch->dirty_count]);
+	for (size_t i = 0; i < ch->dirty_count; i++) ch->dirty[i].store(0, std::memory_order_relaxed);
+	watch->add(ch, static_cast<uint32_t>(ch->entries.size() - 1));
+	return true;
+}
+
+bool SubscriptionHub::watchRange(const SubscriberId id, Map& map, const WORD start_adr, const WORD quantity) {
+	if (id >= m_subs.size() || quantity == 0 || start_adr < map.getStartAdr() || start_adr + quantity - 1u > map.getEndAdr()) return false;
+	const Entry e = { start_adr, static_cast<WORD>(start_adr + quantity - 1), INVALID_TAG_HANDLE, 0, {} };
+	return addEntry(id, map, e, quantity);
+}
+
+bool SubscriptionHub::watchTag(const SubscriberId id, Map& map, const TagHandle tag, const WORD address, const uint8_t width) {
+	const bool bits = map.getMapType() == MapType::BIT_MAP;
+	if (id >= m_subs.size() || tag == INVALID_TAG_HANDLE || width == 0 || width > 4 || (bits && width != 1)) return false;
+	if (address < map.getStartAdr() || address + width - 1u > map.getEndAdr()) return false;
+	Entry e = { address, static_cast<WORD>(address + width - 1), tag, 0, {} };
+	// Начальное значение тега - из карты, дальше его ведет писатель карты
+	if (bits) {
+		BIT b = 0;
+		map.readBits(address, 1, &b);
+		e.shadow[0] = b != 0;
+	}
+	else map.readWords(address, width, e.shadow);
+	return addEntry(id, map, e, 1);
+}
+
+// Последние значения помеченных при переполнении адресов и тегов - из карты
+size_t SubscriptionHub::collect(Channel& ch, ChangeEvent* out, const size_t max) {
+	const bool bits = ch.map->getMapType() == MapType::BIT_MAP;
+	const uint64_t now = nowNs();
+	size_t n = 0;
+	for (const Entry& e : ch.entries) {
+		const uint32_t flags = e.tag != INVALID_TAG_HANDLE ? 1 : e.end - e.start + 1u;
+		for (uint32_t i = 0; i < flags; i++) {
+			if (ch.dirty[e.dirty + i].load(std::memory_order_relaxed) == 0) continue;
+			if (n == max) {
+				ch.dirty_any.store(true, std::memory_order_relaxed);
+				return n;
+			}
+			if (ch.dirty[e.dirty + i].exchange(0, std::memory_order_acquire) == 0) continue;
+			ChangeEvent& ev = out[n];
+			MapMeta meta;
+			ev.map = ch.map;
+			ev.tag = e.tag;
+			ev.address = static_cast<WORD>(e.start + i);
+			ev.count = static_cast<uint8_t>(e.tag != INVALID_TAG_HANDLE ? e.end - e.start + 1 : 1);
+			ev.coalesced = 1;
+			memset(ev.value, 0, sizeof(ev.value));
+			bool read;
+			if (bits) {
+				BIT b = 0;
+				read = ch.map->readBits(ev.address, 1, &b, &meta);
+				ev.value[0] = b != 0;
+			}
+			else read = ch.map->readWords(ev.address, ev.count, ev.value, &meta);
+			if (!read) continue;
+			ev.timestamp_ns = meta.timestamp_ns ? meta.timestamp_ns : now;
+			n++;
+		}
+	}
+	return n;
+}
+
+size_t SubscriptionHub::poll(const SubscriberId id, ChangeEvent* out, const size_t max) {
+	if (id >= m_subs.size() || out == nullptr || max == 0) return 0;
+	Subscriber& sub = *m_subs[id];
+	const size_t channels = sub.channels.size();
+	const uint64_t now = nowNs();
+	size_t n = 0;
+	for (size_t k = 0; k < channels && n < max; k++) {
+		Channel& ch = *sub.channels[(sub.next + k) % channels];
+		uint64_t tail = ch.tail.load(std::memory_order_relaxed);
+		const uint64_t head = ch.head.load(std::memory_order_acquire);
+		const size_t first = n;
+		while (tail != head && n < max) out[n++] = ch.ring[tail++ & ch.mask];
+		ch.tail.store(tail, std::memory_order_release);
+		// Последние значения - только после разбора кольца, чтобы не обогнать более старые события из него
+		if (tail == head && n < max && ch.policy == OverflowPolicy::COALESCE && ch.dirty_any.exchange(false, std::memory_order_acquire)) {
+			n += collect(ch, out + n, max - n);
+		}
+
+		uint64_t lag_sum = 0, lag_max = ch.lag_max.load(std::memory_order_relaxed);
+		for (size_t i = first; i < n; i++) {
+			const uint64_t lag = now > out[i].timestamp_ns ? now - out[i].timestamp_ns : 0;
+			lag_sum += lag;
+			lag_max = std::max(lag_max, lag);
+		}
+		ch.delivered.store(ch.delivered.load(std::memory_order_relaxed) + (n - first), std::memory_order_relaxed);
+		ch.lag_sum.store(ch.lag_sum.load(std::memory_order_relaxed) + lag_sum, std::memory_order_relaxed);
+		ch.lag_max.store(lag_max, std::memory_order_relaxed);
+	}
+	if (channels) sub.next = (sub.next + 1) % channels;
+	return n;
+}
+
+SubscriberStats SubscriptionHub::getStats(const SubscriberId id) const {
+	SubscriberStats st = {};
+	if (id >= m_subs.size()) return st;
+	for (const std::unique_ptr<Channel>& ch : m_subs[id]->channels) {
+		const uint64_t tail = ch->tail.load(std::memory_order_relaxed);
+		const uint64_t head = ch->head.load(std::memory_order_relaxed);
+		st.published += ch->published.load(std::memory_order_relaxed);
+		st.delivered += ch->delivered.load(std::memory_order_relaxed);
+		st.dropped += ch->dropped.load(std::memory_order_relaxed);
+		st.coalesced += ch->coalesced.load(std::memory_order_relaxed);
+		st.pending += head > tail ? head - tail : 0;
+		st.max_pending = std::max(st.max_pending, ch->max_pending.load(std::memory_order_relaxed));
+		st.max_lag_ns = std::max(st.max_lag_ns, ch->lag_max.load(std::memory_order_relaxed));
+		st.avg_lag_ns += ch->lag_sum.load(std::memory_order_relaxed);
+	}
+	st.avg_lag_ns = st.delivered ? st.avg_lag_ns / st.delivered : 0;
+	return st;
+}
+
+} // data
+} // mb
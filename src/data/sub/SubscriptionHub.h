@@ -0,0 +1,126 @@
+#ifndef MB_SUBSCRIPTION_HUB_H
+#define MB_SUBSCRIPTION_HUB_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Map.h"
+#include "TagIndex.h"
+
+namespace mb {
+namespace data {
+
+/** @brief Поведение при переполнении кольца подписчика */
+enum class OverflowPolicy {
+	DROP,			// Новые события теряются, учитываются в dropped
+	COALESCE,	// Изменившиеся адреса и теги помечаются, после разбора кольца выдаются последние значения из карты
+};
+
+/** @brief Изменение значения: слово или бит подписки на диапазон, либо тег целиком */
+struct ChangeEvent {
+	uint64_t timestamp_ns;		// Время записи ответа (steady_clock, как MapMeta)
+	const Map* map;
+	TagHandle tag;					// INVALID_TAG_HANDLE - подписка на диапазон адресов
+	WORD address;					// Адрес слова или бита, для тега - первый адрес
+	uint8_t count;					// Значений в value: 1 для диапазона, ширина тега
+	uint8_t coalesced;			// 1 - значение прочитано из карты после переполнения кольца
+	WORD value[4];					// Слова или биты (0/1)
+};
+
+/** @brief Счетчики подписчика по всем его картам */
+struct SubscriberStats {
+	uint64_t published;		// Записано в кольца
+	uint64_t delivered;		// Выдано poll, включая последние значения после переполнения
+	uint64_t dropped;			// DROP: потеряно при переполнении
+	uint64_t coalesced;		// COALESCE: изменений, не попавших в кольцо и слитых в последнее значение
+	uint64_t pending;			// В кольцах сейчас
+	uint64_t max_pending;	// Наибольшее заполнение кольца
+	uint64_t max_lag_ns;		// Время от записи ответа до выдачи события: наибольшее и среднее
+	uint64_t avg_lag_ns;
+};
+
+using SubscriberId = uint32_t;
+
+/** @brief Подписки на изменения значений карт.
+	Подписчик задает интерес: диапазоны адресов или теги (адрес и ширина тега из RegManager/TagIndex).
+	Хаб становится наблюдателем карт (MapObserver): при записи ответа устройства (update*) изменившиеся значения
+	записываются в кольца подписчиков. На каждую пару подписчик/карта - свое кольцо SPSC: писатель один (запись в карту
+	идет под ее блокировкой), читатель - поток подписчика, выдача событий (poll) идет без блокировок хаба.
+	Тег выдается одним событием, даже если изменилось несколько его слов или он записан двумя ответами.
+	Подписки задаются до начала работы потоков, карты должны жить дольше хаба (или до clear) */
+class SubscriptionHub {
+public:
+	SubscriptionHub();
+	~SubscriptionHub();
+
+	SubscriptionHub(const SubscriptionHub&) = delete;
+	SubscriptionHub& operator=(const SubscriptionHub&) = delete;
+
+	// capacity - событий в кольце каждой карты подписчика, округляется вверх до степени двойки (не меньше 16)
+	SubscriberId addSubscriber(const size_t capacity = 1024, const OverflowPolicy policy = OverflowPolicy::COALESCE);
+	// Адреса слов карты слов или битов карты битов. false - неверный подписчик, выход за карту или у карты другой наблюдатель
+	bool watchRange(const SubscriberId id, Map& map, const WORD start_adr, const WORD quantity);
+	// Тег шириной 1-4 слова (в карте битов - 1 бит)
+	bool watchTag(const SubscriberId id, Map& map, const TagHandle tag, const WORD address, const uint8_t width);
+	// Удаление подписчиков и подписок, карты отвязываются
+	void clear();
+
+	// Выдача до max событий подписчика. Вызывается из одного потока на подписчика
+	size_t poll(const SubscriberId id, ChangeEvent* out, const size_t max);
+	SubscriberStats getStats(const SubscriberId id) const;
+	size_t getSubscriberCount() const { return m_subs.size(); }
+
+private:
+	struct Entry {
+		WORD start;
+		WORD end;
+		TagHandle tag;
+		uint32_t dirty;				// Первый флаг COALESCE: на слово диапазона или один на тег
+		WORD shadow[4];				// Тег: последние значения, пишет только писатель карты
+	};
+
+	struct Channel {
+		Map* map;
+		OverflowPolicy policy;
+		size_t mask;
+		std::unique_ptr<ChangeEvent[]> ring;
+		std::vector<Entry> entries;
+		std::unique_ptr<std::atomic<uint8_t>[]> dirty;
+		size_t dirty_count;
+		alignas(64) std::atomic<uint64_t> head;		// Писатель карты
+		std::atomic<uint64_t> published;
+		std::atomic<uint64_t> dropped;
+		std::atomic<uint64_t> coalesced;
+		std::atomic<uint64_t> max_pending;
+		std::atomic<bool> dirty_any;
+		alignas(64) std::atomic<uint64_t> tail;		// Подписчик
+		std::atomic<uint64_t> delivered;
+		std::atomic<uint64_t> lag_sum;
+		std::atomic<uint64_t> lag_max;
+	};
+
+	struct Subscriber {
+		size_t capacity;
+		OverflowPolicy policy;
+		std::vector<std::unique_ptr<Channel>> channels;
+		size_t next;					// Канал, с которого начинается следующий poll
+	};
+
+	class Watch;
+
+	Channel* channelOf(const SubscriberId id, Map& map);
+	Watch* watchOf(Map& map);
+	bool addEntry(const SubscriberId id, Map& map, const Entry& entry, const uint32_t flags);
+	size_t collect(Channel& ch, ChangeEvent* out, const size_t max);
+
+	std::vector<std::unique_ptr<Subscriber>> m_subs;
+	std::vector<std::unique_ptr<Watch>> m_watches;
+};
+
+} // data
+} // mb
+
+#endif // MB_SUBSCRIPTION_HUB_H
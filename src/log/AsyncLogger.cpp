@@ -0,0 +1,647 @@
+#include "AsyncLogger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+
+namespace mb {
+namespace log {
+
+constexpr size_t MAX_RECORD = 1024;		// Байт записи с аргументами, длинные строки %s обрезаются
+constexpr size_t MAX_LINE = 4096;
+
+// Запись кольца: заголовок, затем аргументы (тег и значение), размер выровнен до 8
+struct RecordHeader {
+	uint32_t size;
+	uint32_t suppressed;		// Отброшенные повторы этого сообщения перед ним
+	uint64_t real_ns;
+	const char* fmt;
+};
+
+enum ArgTag : uint8_t {
+	ARG_INT,
+	ARG_UINT,
+	ARG_DOUBLE,
+	ARG_PTR,
+	ARG_STR,
+};
+
+/* Разбор строки формата printf */
+
+enum LenMod { LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_Z, LEN_J, LEN_T, LEN_BIG_L };
+
+struct Spec {
+	const char* begin;		// '%'
+	const char* end;			// За символом преобразования
+	LenMod len;
+	int stars;					// Ширина и/или точность '*'
+	char conv;					// 0 - строка оборвалась
+};
+
+// p указывает за '%'
+static const char* parseSpec(const char* p, Spec& s) {
+	s.begin = p - 1;
+	s.stars = 0;
+	s.len = LEN_NONE;
+	while (*p && strchr("-+ #0'", *p)) p++;
+	if (*p == '*') { s.stars++; p++; }
+	else while (*p >= '0' && *p <= '9') p++;
+	if (*p == '.') {
+		p++;
+		if (*p == '*') { s.stars++; p++; }
+		else while (*p >= '0' && *p <= '9') p++;
+	}
+	switch (*p) {
+		case 'h': p++; if (*p == 'h') { p++; s.len = LEN_HH; } else s.len = LEN_H; break;
+		case 'l': p++; if (*p == 'l') { p++; s.len = LEN_LL; } else s.len = LEN_L; break;
+		case 'z': p++; s.len = LEN_Z; break;
+		case 'j': p++; s.len = LEN_J; break;
+		case 't': p++; s.len = LEN_T; break;
+		case 'L': p++; s.len = LEN_BIG_L; break;
+		default: break;
+	}
+	s.conv = *p;
+	if (*p) p++;
+	s.end = p;
+	return p;
+}
+
+/* Кодирование аргументов в вызывающем потоке */
+
+class ArgWriter {
+public:
+	ArgWriter(uint8_t* buf, size_t cap) : m_buf(buf), m_cap(cap), m_len(0), m_full(false) {}
+
+	template <typename T>
+	void put(ArgTag tag, T v) {
+		if (m_full || m_len + 1 + sizeof(T) > m_cap) {
+			m_full = true;
+			return;
+		}
+		m_buf[m_len++] = tag;
+		memcpy(m_buf + m_len, &v, sizeof(T));
+		m_len += sizeof(T);
+	}
+
+	void putStr(const char* s) {
+		if (s == nullptr) s = "(null)";
+		if (m_full || m_len + 4 > m_cap) {
+			m_full = true;
+			return;
+		}
+		size_t n = std::min(strlen(s), m_cap - m_len - 4);
+		uint16_t len = static_cast<uint16_t>(n + 1);
+		m_buf[m_len++] = ARG_STR;
+		memcpy(m_buf + m_len, &len, 2);
+		memcpy(m_buf + m_len + 2, s, n);
+		m_buf[m_len + 2 + n] = 0;
+		m_len += 2 + len;
+	}
+
+	size_t size() const { return m_len; }
+
+private:
+	uint8_t* m_buf;
+	size_t m_cap;
+	size_t m_len;
+	bool m_full;
+};
+
+static size_t captureArgs(const char* fmt, va_list args, uint8_t* buf, size_t cap) {
+	ArgWriter w(buf, cap);
+	for (const char* p = fmt; *p;) {
+		if (*p++ != '%') continue;
+		if (*p == '%') {
+			p++;
+			continue;
+		}
+		Spec s;
+		p = parseSpec(p, s);
+		for (int i = 0; i < s.stars; i++) w.put<int64_t>(ARG_INT, va_arg(args, int));
+
+		switch (s.conv) {
+			case 'd': case 'i': {
+				int64_t v;
+				switch (s.len) {
+					case LEN_HH: v = static_cast<signed char>(va_arg(args, int)); break;
+					case LEN_H: v = static_cast<short>(va_arg(args, int)); break;
+					case LEN_L: v = va_arg(args, long); break;
+					case LEN_LL: v = va_arg(args, long long); break;
+					case LEN_Z: v = static_cast<int64_t>(va_arg(args, size_t)); break;
+					case LEN_J: v = va_arg(args, intmax_t); break;
+					case LEN_T: v = va_arg(args, ptrdiff_t); break;
+					default: v = va_arg(args, int); break;
+				}
+				w.put(ARG_INT, v);
+				break;
+			}
+			case 'u': case 'o': case 'x': case 'X': {
+				uint64_t v;
+				switch (s.len) {
+					case LEN_HH: v = static_cast<unsigned char>(va_arg(args, unsigned)); break;
+					case LEN_H: v = static_cast<unsigned short>(va_arg(args, unsigned)); break;
+					case LEN_L: v = va_arg(args, unsigned long); break;
+					case LEN_LL: v = va_arg(args, unsigned long long); break;
+					case LEN_Z: v = va_arg(args, size_t); break;
+					case LEN_J: v = va_arg(args, uintmax_t); break;
+					case LEN_T: v = static_cast<uint64_t>(va_arg(args, ptrdiff_t)); break;
+					default: v = va_arg(args, unsigned); break;
+				}
+				w.put(ARG_UINT, v);
+				break;
+			}
+			case 'c':
+				w.put<int64_t>(ARG_INT, va_arg(args, int));
+				break;
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+				w.put(ARG_DOUBLE, s.len == LEN_BIG_L ? static_cast<double>(va_arg(args, long double)) : va_arg(args, double));
+				break;
+			case 's':
+				w.putStr(va_arg(args, const char*));
+				break;
+			case 'p':
+				w.put(ARG_PTR, va_arg(args, void*));
+				break;
+			case 'n':
+				(void)va_arg(args, void*);
+				break;
+			default:
+				return w.size();	// Неизвестное преобразование - дальше аргументы не разбираются
+		}
+	}
+	return w.size();
+}
+
+/* Форматирование в фоновом потоке */
+
+class ArgReader {
+public:
+	ArgReader(const uint8_t* buf, size_t len) : m_buf(buf), m_len(len), m_pos(0) {}
+
+	bool next(ArgTag& tag, const uint8_t*& val) {
+		if (m_pos >= m_len) return false;
+		tag = static_cast<ArgTag>(m_buf[m_pos++]);
+		val = m_buf + m_pos;
+		if (tag == ARG_STR) {
+			uint16_t len;
+			memcpy(&len, val, 2);
+			val += 2;
+			m_pos += 2 + len;
+		}
+		else m_pos += 8;
+		return m_pos <= m_len;
+	}
+
+private:
+	const uint8_t* m_buf;
+	size_t m_len;
+	size_t m_pos;
+};
+
+// Спецификация с подставленными '*' и длиной, соответствующей сохраненному типу
+static void buildSpec(const Spec& s, const int64_t* stars, char* out, size_t cap) {
+	size_t n = 0;
+	int star = 0;
+	for (const char* p = s.begin; p < s.end - 1 && n + 24 < cap; p++) {
+		if (strchr("hlzjtL", *p)) continue;
+		if (*p == '*') n += snprintf(out + n, cap - n, "%lld", static_cast<long long>(stars[star++]));
+		else out[n++] = *p;
+	}
+	if (strchr("diuoxX", s.conv)) {
+		out[n++] = 'l';
+		out[n++] = 'l';
+	}
+	out[n++] = s.conv;
+	out[n] = 0;
+}
+
+static void formatMessage(const char* fmt, const uint8_t* args, size_t args_len, std::string& out) {
+	ArgReader r(args, args_len);
+	char spec[64];
+	char tmp[512];
+
+	for (const char* p = fmt; *p;) {
+		const char* pct = strchr(p, '%');
+		if (pct == nullptr) {
+			out.append(p);
+			break;
+		}
+		out.append(p, pct - p);
+		p = pct + 1;
+		if (*p == '%') {
+			out += '%';
+			p++;
+			continue;
+		}
+
+		Spec s;
+		p = parseSpec(p, s);
+		ArgTag tag;
+		const uint8_t* val;
+		int64_t stars[2] = { 0, 0 };
+		bool ok = true;
+		for (int i = 0; i < s.stars && ok; i++) {
+			ok = r.next(tag, val);
+			if (ok) memcpy(&stars[i], val, 8);
+		}
+		if (s.conv == 'n') continue;
+		if (!ok || s.conv == 0 || !r.next(tag, val)) {
+			out.append("<?>");
+			break;
+		}
+
+		buildSpec(s, stars, spec, sizeof(spec));
+		int n = 0;
+		switch (tag) {
+			case ARG_INT: {
+				int64_t v;
+				memcpy(&v, val, 8);
+				n = s.conv == 'c' ? snprintf(tmp, sizeof(tmp), spec, static_cast<int>(v)) : snprintf(tmp, sizeof(tmp), spec, static_cast<long long>(v));
+				break;
+			}
+			case ARG_UINT: {
+				uint64_t v;
+				memcpy(&v, val, 8);
+				n = snprintf(tmp, sizeof(tmp), spec, static_cast<unsigned long long>(v));
+				break;
+			}
+			case ARG_DOUBLE: {
+				double v;
+				memcpy(&v, val, 8);
+				n = snprintf(tmp, sizeof(tmp), spec, v);
+				break;
+			}
+			case ARG_PTR: {
+				void* v;
+				memcpy(&v, val, sizeof(v));
+				n = snprintf(tmp, sizeof(tmp), spec, v);
+				break;
+			}
+			case ARG_STR:
+				n = snprintf(tmp, sizeof(tmp), spec, reinterpret_cast<const char*>(val));
+				break;
+		}
+		if (n > 0) out.append(tmp, std::min<size_t>(n, sizeof(tmp) - 1));
+	}
+}
+
+static uint64_t realNs() {
+	timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+static void appendTimestamp(uint64_t real_ns, std::string& out) {
+	time_t sec = static_cast<time_t>(real_ns / 1000000000ull);
+	tm t;
+	localtime_r(&sec, &t);
+	char buf[32];
+	int n = snprintf(buf, sizeof(buf), "%02d:%02d:%02d.%03u ", t.tm_hour, t.tm_min, t.tm_sec, static_cast<unsigned>(real_ns % 1000000000ull / 1000000));
+	out.append(buf, n);
+}
+
+static uint64_t hashBytes(uint64_t h, const void* data, size_t len) {
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+/* Кольца потоков */
+
+// Кольца потока по номерам журналов. При завершении потока кольца помечаются закрытыми,
+// фоновый поток дописывает их и освобождает
+namespace {
+
+struct ThreadRings {
+	std::vector<std::shared_ptr<void>> rings;
+	std::vector<std::atomic<bool>*> closed;
+
+	~ThreadRings() {
+		for (std::atomic<bool>* c : closed) {
+			if (c) c->store(true, std::memory_order_release);
+		}
+	}
+};
+
+thread_local ThreadRings t_rings;
+thread_local uint32_t t_last_id = UINT32_MAX;
+thread_local void* t_last_ring = nullptr;
+std::atomic<uint32_t> g_next_id(0);
+
+} // namespace
+
+/* AsyncLogger */
+
+AsyncLogger::AsyncLogger() {
+	init();
+}
+
+AsyncLogger::AsyncLogger(const LogConfig& config) : m_config(config) {
+	init();
+}
+
+void AsyncLogger::init() {
+	size_t size = 1024;
+	while (size < m_config.ring_size) size <<= 1;
+	m_config.ring_size = size;
+
+	m_id = g_next_id.fetch_add(1);
+	m_mode = LogMode::SYNC;
+	m_out = stdout;
+	m_own_out = false;
+	m_retired_dropped = 0;
+	m_retired_suppressed = 0;
+	m_written = 0;
+	m_running = false;
+	m_flush_req = 0;
+	m_flush_done = 0;
+}
+
+AsyncLogger::~AsyncLogger() {
+	stopThread();
+	if (m_own_out) fclose(m_out);
+}
+
+AsyncLogger* AsyncLogger::Instance() {
+	static AsyncLogger instance;
+	return &instance;
+}
+
+bool AsyncLogger::open(const std::string& path) {
+	FILE* f = fopen(path.c_str(), "a");
+	if (f == nullptr) return false;
+	std::lock_guard<std::mutex> lock(m_out_mtx);
+	if (m_own_out) fclose(m_out);
+	m_out = f;
+	m_own_out = true;
+	return true;
+}
+
+void AsyncLogger::setMode(LogMode mode) {
+	if (mode == m_mode.exchange(mode)) return;
+	if (mode == LogMode::ASYNC) startThread();
+	else stopThread();
+}
+
+void AsyncLogger::writeOut(const std::string& text) {
+	std::lock_guard<std::mutex> lock(m_out_mtx);
+	fwrite(text.data(), 1, text.size(), m_out);
+	fflush(m_out);
+}
+
+AsyncLogger::Ring& AsyncLogger::ring() {
+	if (t_last_id == m_id) return *static_cast<Ring*>(t_last_ring);
+	Ring* r = nullptr;
+	if (m_id < t_rings.rings.size()) r = static_cast<Ring*>(t_rings.rings[m_id].get());
+	if (r == nullptr) r = &attachRing();
+	t_last_id = m_id;
+	t_last_ring = r;
+	return *r;
+}
+
+AsyncLogger::Ring& AsyncLogger::attachRing() {
+	std::shared_ptr<Ring> r = std::make_shared<Ring>();
+	r->buf.resize(m_config.ring_size);
+	r->mask = m_config.ring_size - 1;
+	r->head = 0;
+	r->tail = 0;
+	r->dropped = 0;
+	r->suppressed = 0;
+	r->evicted = 0;
+	r->closed = false;
+	r->reported_dropped = 0;
+	for (RateSlot& slot : r->rate) {
+		slot.hash = 0;
+		slot.window_start_ms = 0;
+		slot.count = 0;
+		slot.suppressed = 0;
+	}
+
+	if (t_rings.rings.size() <= m_id) {
+		t_rings.rings.resize(m_id + 1);
+		t_rings.closed.resize(m_id + 1, nullptr);
+	}
+	t_rings.rings[m_id] = r;
+	t_rings.closed[m_id] = &r->closed;
+
+	std::lock_guard<std::mutex> lock(m_rings_mtx);
+	m_rings.push_back(r);
+	return *r;
+}
+
+bool AsyncLogger::rateLimit(Ring& r, uint64_t hash, uint64_t now_ms, uint32_t& carried) {
+	RateSlot& slot = r.rate[hash & 63];
+	const uint64_t window_start = slot.window_start_ms.load(std::memory_order_relaxed);
+	if (slot.hash != hash) {
+		// Слот занимает другое сообщение, неотчитанные повторы прежнего выводит фоновый поток
+		const uint32_t pending = slot.suppressed.exchange(0, std::memory_order_relaxed);
+		if (pending) r.evicted.fetch_add(pending, std::memory_order_relaxed);
+		slot.hash = hash;
+		slot.window_start_ms.store(now_ms, std::memory_order_relaxed);
+		slot.count = 0;
+	}
+	else if (now_ms < window_start || now_ms - window_start >= m_config.rate_window_ms) {
+		// Повторы прошлого окна, если их еще не вывел фоновый поток
+		carried = slot.suppressed.exchange(0, std::memory_order_relaxed);
+		slot.window_start_ms.store(now_ms, std::memory_order_relaxed);
+		slot.count = 0;
+	}
+	if (slot.count < m_config.rate_burst) {
+		++slot.count;
+		return true;
+	}
+	slot.suppressed.fetch_add(1, std::memory_order_relaxed);
+	r.suppressed.store(r.suppressed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	return false;
+}
+
+void AsyncLogger::rawLog(const char* fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+
+	if (m_mode.load(std::memory_order_relaxed) == LogMode::SYNC) {
+		char buf[MAX_LINE];
+		vsnprintf(buf, sizeof(buf), fmt, args);
+		va_end(args);
+		std::string line;
+		if (m_config.timestamps) appendTimestamp(realNs(), line);
+		line.append(buf);
+		line += '\n';
+		writeOut(line);
+		m_written.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	alignas(8) uint8_t rec[MAX_RECORD];
+	const size_t args_len = captureArgs(fmt, args, rec + sizeof(RecordHeader), MAX_RECORD - sizeof(RecordHeader));
+	va_end(args);
+
+	const uint64_t now_ns = realNs();
+	Ring& r = ring();
+	uint32_t carried = 0;
+	if (m_config.rate_window_ms) {
+		uint64_t hash = hashBytes(14695981039346656037ull, &fmt, sizeof(fmt));
+		hash = hashBytes(hash, rec + sizeof(RecordHeader), args_len);
+		if (!rateLimit(r, hash, now_ns / 1000000, carried)) return;
+	}
+
+	const size_t size = (sizeof(RecordHeader) + args_len + 7) & ~size_t(7);
+	RecordHeader h = { static_cast<uint32_t>(size), carried, now_ns, fmt };
+	memcpy(rec, &h, sizeof(h));
+
+	const uint64_t head = r.head.load(std::memory_order_relaxed);
+	if (r.buf.size() - (head - r.tail.load(std::memory_order_acquire)) < size) {
+		r.dropped.store(r.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+	const size_t pos = head & r.mask;
+	const size_t first = std::min(size, r.buf.size() - pos);
+	memcpy(&r.buf[pos], rec, first);
+	memcpy(&r.buf[0], rec + first, size - first);
+	r.head.store(head + size, std::memory_order_release);
+}
+
+void AsyncLogger::formatRecord(const uint8_t* rec, size_t size, std::string& out) const {
+	RecordHeader h;
+	memcpy(&h, rec, sizeof(h));
+	if (m_config.timestamps) appendTimestamp(h.real_ns, out);
+	formatMessage(h.fmt, rec + sizeof(RecordHeader), size - sizeof(RecordHeader), out);
+	if (h.suppressed) out += " (повторов отброшено: " + std::to_string(h.suppressed) + ")";
+	out += '\n';
+}
+
+bool AsyncLogger::drain(Ring& r, std::string& out, bool final) {
+	alignas(8) uint8_t rec[MAX_RECORD];
+	const uint64_t head = r.head.load(std::memory_order_acquire);
+	uint64_t tail = r.tail.load(std::memory_order_relaxed);
+	bool any = tail != head;
+
+	while (tail != head) {
+		const size_t pos = tail & r.mask;
+		uint32_t size;
+		const size_t first_hdr = std::min<size_t>(sizeof(size), r.buf.size() - pos);
+		memcpy(&size, &r.buf[pos], first_hdr);
+		memcpy(reinterpret_cast<uint8_t*>(&size) + first_hdr, &r.buf[0], sizeof(size) - first_hdr);
+
+		const size_t first = std::min<size_t>(size, r.buf.size() - pos);
+		memcpy(rec, &r.buf[pos], first);
+		memcpy(rec + first, &r.buf[0], size - first);
+		tail += size;
+		r.tail.store(tail, std::memory_order_release);
+
+		formatRecord(rec, size, out);
+		m_written.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	const uint64_t dropped = r.dropped.load(std::memory_order_relaxed);
+	if (dropped != r.reported_dropped) {
+		if (m_config.timestamps) appendTimestamp(realNs(), out);
+		out += "[log] потеряно сообщений (переполнение очереди): " + std::to_string(dropped - r.reported_dropped) + "\n";
+		r.reported_dropped = dropped;
+		any = true;
+	}
+
+	// Повторы, окно которых истекло без нового сообщения, иначе о них не узнать до следующего такого же сообщения.
+	// При завершении потока-источника или журнала выводятся все неотчитанные повторы
+	uint64_t suppressed = r.evicted.exchange(0, std::memory_order_relaxed);
+	if (m_config.rate_window_ms) {
+		const uint64_t now_ms = realNs() / 1000000;
+		for (RateSlot& slot : r.rate) {
+			if (slot.suppressed.load(std::memory_order_relaxed) == 0) continue;
+			const uint64_t window_start = slot.window_start_ms.load(std::memory_order_relaxed);
+			if (final || now_ms < window_start || now_ms - window_start >= m_config.rate_window_ms) {
+				suppressed += slot.suppressed.exchange(0, std::memory_order_relaxed);
+			}
+		}
+	}
+	if (suppressed) {
+		if (m_config.timestamps) appendTimestamp(realNs(), out);
+		out += "[log] повторов отброшено (окно ограничения истекло): " + std::to_string(suppressed) + "\n";
+		any = true;
+	}
+	return any;
+}
+
+void AsyncLogger::run() {
+	std::string out;
+	std::vector<std::shared_ptr<Ring>> rings;
+
+	for (;;) {
+		uint64_t req;
+		{
+			std::lock_guard<std::mutex> lock(m_wake_mtx);
+			req = m_flush_req;
+		}
+		const bool running = m_running.load();
+
+		{
+			std::lock_guard<std::mutex> lock(m_rings_mtx);
+			rings = m_rings;
+		}
+		for (const std::shared_ptr<Ring>& r : rings) {
+			// Кольцо закрыто до опустошения - после этого прохода новых записей в нем не будет
+			const bool closed = r->closed.load(std::memory_order_acquire);
+			drain(*r, out, closed || !running);
+			if (!out.empty()) {
+				writeOut(out);
+				out.clear();
+			}
+			if (closed) {
+				std::lock_guard<std::mutex> lock(m_rings_mtx);
+				m_retired_dropped += r->dropped.load(std::memory_order_relaxed);
+				m_retired_suppressed += r->suppressed.load(std::memory_order_relaxed);
+				m_rings.erase(std::find(m_rings.begin(), m_rings.end(), r));
+			}
+		}
+		rings.clear();
+
+		std::unique_lock<std::mutex> lock(m_wake_mtx);
+		m_flush_done = req;
+		m_done_cv.notify_all();
+		if (!running) break;
+		if (m_flush_req == req) m_wake_cv.wait_for(lock, std::chrono::milliseconds(m_config.flush_ms));
+	}
+}
+
+void AsyncLogger::flush() {
+	if (!m_running.load()) return;
+	std::unique_lock<std::mutex> lock(m_wake_mtx);
+	const uint64_t want = ++m_flush_req;
+	m_wake_cv.notify_one();
+	m_done_cv.wait(lock, [&]() { return m_flush_done >= want || !m_running.load(); });
+}
+
+void AsyncLogger::startThread() {
+	if (m_running.exchange(true)) return;
+	m_thread = std::thread(&AsyncLogger::run, this);
+}
+
+void AsyncLogger::stopThread() {
+	if (!m_running.exchange(false)) return;
+	{
+		std::lock_guard<std::mutex> lock(m_wake_mtx);
+		m_wake_cv.notify_one();
+	}
+	if (m_thread.joinable()) m_thread.join();
+}
+
+LogStats AsyncLogger::getStats() const {
+	LogStats s = { m_written.load(std::memory_order_relaxed), 0, 0 };
+	std::lock_guard<std::mutex> lock(m_rings_mtx);
+	s.dropped = m_retired_dropped;
+	s.suppressed = m_retired_suppressed;
+	for (const std::shared_ptr<Ring>& r : m_rings) {
+		s.dropped += r->dropped.load(std::memory_order_relaxed);
+		s.suppressed += r->suppressed.load(std::memory_order_relaxed);
+	}
+	return s;
+}
+
+} // log
+} // mb
@@ -0,0 +1,129 @@
+#ifndef MB_ASYNC_LOGGER_H
+#define MB_ASYNC_LOGGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mb {
+namespace log {
+
+/** @brief Режим вывода журнала */
+enum class LogMode {
+	SYNC,		// Форматирование и запись в вызывающем потоке
+	ASYNC,	// Аргументы копируются в кольцо потока, форматирует и пишет фоновый поток
+};
+
+/** @brief Параметры журнала */
+struct LogConfig {
+	size_t ring_size = 64 * 1024;		// Байт кольца одного потока (степень двойки)
+	uint32_t flush_ms = 10;				// Период опроса колец фоновым потоком
+	uint32_t rate_burst = 5;			// Одинаковых сообщений за окно без ограничения
+	uint32_t rate_window_ms = 1000;	// Окно ограничения одинаковых сообщений (0 - без ограничения)
+	bool timestamps = true;				// Метка времени в начале строки
+};
+
+/** @brief Счетчики журнала */
+struct LogStats {
+	uint64_t written;			// Выведено строк
+	uint64_t dropped;			// Потеряно из-за переполнения кольца
+	uint64_t suppressed;		// Отброшено ограничением повторов
+};
+
+/** @brief Журнал с асинхронным режимом.
+	В режиме ASYNC rawLog только разбирает строку формата, копирует аргументы (строки %s - по значению) в кольцо
+	своего потока (SPSC, один писатель - один читатель) и возвращается: форматирование и ввод-вывод выполняет фоновый поток.
+	Память ограничена: у каждого потока кольцо фиксированного размера, при переполнении сообщение отбрасывается
+	и учитывается в счетчике потерь, о потерях фоновый поток пишет отдельной строкой.
+	Одинаковые сообщения (та же строка формата и те же аргументы) ограничиваются в потоке-источнике: за окно rate_window_ms
+	выводится не больше rate_burst, количество отброшенных повторов дописывается к следующему выведенному,
+	а если повтора после окна не было - фоновый поток выводит его отдельной строкой по истечении окна.
+	Строка формата должна жить до вывода (строковый литерал). Порядок строк сохраняется в пределах потока */
+class AsyncLogger {
+public:
+	AsyncLogger();
+	AsyncLogger(const LogConfig& config);
+	~AsyncLogger();
+
+	AsyncLogger(const AsyncLogger&) = delete;
+	AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+	static AsyncLogger* Instance();
+
+	// Вывод в файл (дописывание), по умолчанию - stdout
+	bool open(const std::string& path);
+	void setMode(LogMode mode);
+	LogMode getMode() const { return m_mode.load(std::memory_order_relaxed); }
+
+	void rawLog(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+	// Ожидание вывода всех сообщений, записанных до вызова
+	void flush();
+	LogStats getStats() const;
+
+private:
+	struct RateSlot {
+		uint64_t hash;
+		std::atomic<uint64_t> window_start_ms;	// Пишет поток-источник, читает фоновый поток
+		uint32_t count;
+		std::atomic<uint32_t> suppressed;		// Повторы, о которых еще не сообщено: забирает тот, кто выведет первым
+	};
+
+	struct Ring {
+		std::vector<uint8_t> buf;
+		size_t mask;
+		std::atomic<uint64_t> head;		// Пишет поток-источник
+		std::atomic<uint64_t> tail;		// Пишет фоновый поток
+		std::atomic<uint64_t> dropped;	// Пишет поток-источник
+		std::atomic<uint64_t> suppressed;
+		std::atomic<uint64_t> evicted;	// Неотчитанные повторы сообщений, вытесненных из слотов rate
+		std::atomic<bool> closed;			// Поток-источник завершился
+		uint64_t reported_dropped;			// Фоновый поток: о скольких потерях уже сообщено
+		RateSlot rate[64];					// Поток-источник: последние сообщения для ограничения повторов
+	};
+
+	void init();
+	Ring& ring();
+	Ring& attachRing();
+	bool rateLimit(Ring& r, uint64_t hash, uint64_t now_ms, uint32_t& carried);
+
+	void run();
+	bool drain(Ring& r, std::string& out, bool final);
+	void formatRecord(const uint8_t* rec, size_t size, std::string& out) const;
+	void writeOut(const std::string& text);
+	void startThread();
+	void stopThread();
+
+	LogConfig m_config;
+	uint32_t m_id;							// Номер журнала в thread-local таблице колец потока
+	std::atomic<LogMode> m_mode;
+
+	FILE* m_out;
+	bool m_own_out;
+	std::mutex m_out_mtx;				// Вывод в режиме SYNC
+
+	mutable std::mutex m_rings_mtx;
+	std::vector<std::shared_ptr<Ring>> m_rings;
+	uint64_t m_retired_dropped;		// Счетчики колец завершившихся потоков
+	uint64_t m_retired_suppressed;
+	std::atomic<uint64_t> m_written;
+
+	std::atomic<bool> m_running;
+	std::thread m_thread;
+	std::mutex m_wake_mtx;
+	std::condition_variable m_wake_cv;
+	uint64_t m_flush_req;				// Номер запроса flush, под m_wake_mtx
+	uint64_t m_flush_done;
+	std::condition_variable m_done_cv;
+};
+
+} // log
+} // mb
+
+#endif // MB_ASYNC_LOGGER_H
@@ -0,0 +1,106 @@
+#include "AllocHook.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace mb {
+namespace mem {
+
+static thread_local uint64_t t_allocs = 0;
+static std::atomic<uint64_t> g_allocs(0);
+static std::atomic<AllocFailHandler> g_handler(nullptr);
+
+static void* countedAlloc(size_t size) {
+	++t_allocs;
+	g_allocs.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size ? size : 1);
+}
+
+static void* countedAlignedAlloc(size_t size, size_t align) {
+	++t_allocs;
+	g_allocs.fetch_add(1, std::memory_order_relaxed);
+	if (align < sizeof(void*)) align = sizeof(void*);
+	void* p = nullptr;
+	if (posix_memalign(&p, align, size ? size : 1) != 0) return nullptr;
+	return p;
+}
+
+uint64_t threadAllocations() {
+	return t_allocs;
+}
+
+uint64_t totalAllocations() {
+	return g_allocs.load(std::memory_order_relaxed);
+}
+
+void setAllocFailHandler(AllocFailHandler handler) {
+	g_handler.store(handler);
+}
+
+NoAllocScope::NoAllocScope(const char* name) : m_name(name), m_start(t_allocs) {}
+
+NoAllocScope::~NoAllocScope() {
+	const uint64_t n = allocations();
+	if (n == 0) return;
+	AllocFailHandler handler = g_handler.load();
+	if (handler) {
+		handler(m_name, n);
+		return;
+	}
+	std::fprintf(stderr, "NoAllocScope '%s': %llu allocations\n", m_name, static_cast<unsigned long long>(n));
+	std::abort();
+}
+
+uint64_t NoAllocScope::allocations() const {
+	return t_allocs - m_start;
+}
+
+} // mem
+} // mb
+
+/* Подмена глобальных operator new/delete */
+
+void* operator new(size_t size) {
+	void* p = mb::mem::countedAlloc(size);
+	if (p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size) {
+	void* p = mb::mem::countedAlloc(size);
+	if (p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return mb::mem::countedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return mb::mem::countedAlloc(size);
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+	void* p = mb::mem::countedAlignedAlloc(size, static_cast<size_t>(align));
+	if (p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+	void* p = mb::mem::countedAlignedAlloc(size, static_cast<size_t>(align));
+	if (p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
@@ -0,0 +1,45 @@
+#ifndef MB_ALLOC_HOOK_H
+#define MB_ALLOC_HOOK_H
+
+#include <cstdint>
+
+namespace mb {
+namespace mem {
+
+/* Счетчик выделений памяти для проверки установившегося режима опроса.
+	Библиотека alloc_hook подменяет глобальные operator new/delete, поэтому подключается только
+	к тестовым сборкам и бенчмаркам: target_link_libraries(<цель> alloc_hook mem).
+	Учитываются все формы operator new (в том числе контейнеры STL), malloc напрямую не учитывается */
+
+// Количество выделений в текущем потоке и во всем процессе с момента запуска
+uint64_t threadAllocations();
+uint64_t totalAllocations();
+
+// Обработчик нарушения: scope - имя области NoAllocScope, allocations - выделения в ней
+using AllocFailHandler = void (*)(const char* scope, uint64_t allocations);
+// По умолчанию сообщение в stderr и abort
+void setAllocFailHandler(AllocFailHandler handler);
+
+/** @brief Область, в которой текущий поток не должен выделять память (например, один цикл опроса после прогрева).
+	При выходе из области с выделениями вызывается обработчик AllocFailHandler.
+	Выделения в других потоках (симулятор, логгер) не учитываются */
+class NoAllocScope {
+public:
+	explicit NoAllocScope(const char* name);
+	~NoAllocScope();
+
+	NoAllocScope(const NoAllocScope&) = delete;
+	NoAllocScope& operator=(const NoAllocScope&) = delete;
+
+	// Выделения с начала области
+	uint64_t allocations() const;
+
+private:
+	const char* m_name;
+	uint64_t m_start;
+};
+
+} // mem
+} // mb
+
+#endif // MB_ALLOC_HOOK_H
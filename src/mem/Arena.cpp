@@ -0,0 +1,115 @@
+#include "Arena.h"
+
+#include <cstdlib>
+#include <sys/mman.h>
+
+namespace mb {
+namespace mem {
+
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static size_t alignUp(size_t v, size_t align) {
+	return (v + align - 1) & ~(align - 1);
+}
+
+Arena::Arena(size_t block_size, ArenaBacking backing) : m_current(0),
+																		  m_offset(0),
+																		  m_passed(0),
+																		  m_block_size(block_size ? block_size : 4096),
+																		  m_backing(backing) {
+	if (m_backing == ArenaBacking::HUGE_PAGES) m_block_size = alignUp(m_block_size, HUGE_PAGE_SIZE);
+}
+
+Arena::~Arena() {
+	release();
+}
+
+bool Arena::addBlock(size_t min_size) {
+	Block b = { nullptr, m_block_size > min_size ? m_block_size : min_size, false, false };
+	if (m_backing == ArenaBacking::HUGE_PAGES) {
+		b.size = alignUp(b.size, HUGE_PAGE_SIZE);
+		void* p = mmap(nullptr, b.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		b.huge = p != MAP_FAILED;
+		// Пул huge pages не настроен - прозрачные huge pages по возможности
+		if (p == MAP_FAILED) {
+			p = mmap(nullptr, b.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED) return false;
+			madvise(p, b.size, MADV_HUGEPAGE);
+		}
+		b.data = static_cast<char*>(p);
+		b.mapped = true;
+	}
+	else {
+		b.data = static_cast<char*>(std::malloc(b.size));
+		if (b.data == nullptr) return false;
+	}
+	m_blocks.push_back(b);
+	return true;
+}
+
+void* Arena::allocate(size_t size, size_t align) {
+	if (align == 0) align = 1;
+	while (true) {
+		if (m_current < m_blocks.size()) {
+			Block& b = m_blocks[m_current];
+			// Выравнивается адрес, а не смещение: блоки malloc выровнены только по max_align_t
+			const uintptr_t base = reinterpret_cast<uintptr_t>(b.data);
+			const size_t offset = alignUp(base + m_offset, align) - base;
+			if (offset + size <= b.size) {
+				m_offset = offset + size;
+				return b.data + offset;
+			}
+			// Блок исчерпан, следующий уже выделен при прошлых циклах или выделяется сейчас
+			if (m_current + 1 < m_blocks.size() || addBlock(size + align)) {
+				m_passed += b.size;
+				m_current++;
+				m_offset = 0;
+				continue;
+			}
+			return nullptr;
+		}
+		if (!addBlock(size + align)) return nullptr;
+	}
+}
+
+bool Arena::reserve(size_t bytes) {
+	while (capacity() < bytes) {
+		if (!addBlock(m_block_size)) return false;
+	}
+	return true;
+}
+
+void Arena::reset() {
+	m_current = 0;
+	m_offset = 0;
+	m_passed = 0;
+}
+
+void Arena::release() {
+	for (Block& b : m_blocks) {
+		if (b.mapped) munmap(b.data, b.size);
+		else std::free(b.data);
+	}
+	m_blocks.clear();
+	reset();
+}
+
+size_t Arena::used() const {
+	return m_passed + m_offset;
+}
+
+size_t Arena::capacity() const {
+	size_t total = 0;
+	for (const Block& b : m_blocks) total += b.size;
+	return total;
+}
+
+bool Arena::isHugePages() const {
+	for (const Block& b : m_blocks) {
+		if (b.huge) return true;
+	}
+	return false;
+}
+
+} // mem
+} // mb
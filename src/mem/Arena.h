@@ -0,0 +1,94 @@
+#ifndef MB_ARENA_H
+#define MB_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mb {
+namespace mem {
+
+/** @brief Источник памяти блоков арены */
+enum class ArenaBacking {
+	HEAP,				// malloc
+	HUGE_PAGES,		// mmap MAP_HUGETLB блоками по 2 МБ, если huge pages не настроены - mmap с madvise(MADV_HUGEPAGE)
+};
+
+/** @brief Монотонная арена (bump allocator) для данных одного потока опроса.
+	Память выдается сдвигом указателя в текущем блоке, освобождения по одному объекту нет.
+	reset возвращает арену к началу без освобождения блоков, поэтому после прогрева цикл
+	"reset - выделения цикла" не обращается к системному распределителю.
+	Арена не потокобезопасна: у каждого потока опроса своя */
+class Arena {
+public:
+	Arena(size_t block_size = 64 * 1024, ArenaBacking backing = ArenaBacking::HEAP);
+	~Arena();
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	// Выделение size байт с выравниванием align (степень 2), nullptr - не удалось получить блок
+	void* allocate(size_t size, size_t align = alignof(std::max_align_t));
+	template <typename T>
+	T* allocArray(size_t n) { return static_cast<T*>(allocate(sizeof(T) * n, alignof(T))); }
+
+	// Заранее выделить блоки общим объемом не меньше bytes (прогрев до входа в цикл опроса)
+	bool reserve(size_t bytes);
+	// Начать заполнение заново, блоки сохраняются
+	void reset();
+	// Вернуть все блоки системе
+	void release();
+
+	size_t used() const;
+	size_t capacity() const;
+	size_t getBlockCount() const { return m_blocks.size(); }
+	ArenaBacking getBacking() const { return m_backing; }
+	// Хотя бы один блок получен из huge pages (MAP_HUGETLB)
+	bool isHugePages() const;
+
+private:
+	struct Block {
+		char* data;
+		size_t size;
+		bool mapped;	// mmap, иначе malloc
+		bool huge;		// MAP_HUGETLB
+	};
+
+	bool addBlock(size_t min_size);
+
+	std::vector<Block> m_blocks;
+	size_t m_current;		// Текущий блок
+	size_t m_offset;		// Занято в текущем блоке
+	size_t m_passed;		// Объем блоков до текущего
+	size_t m_block_size;
+	ArenaBacking m_backing;
+};
+
+/** @brief Распределитель для контейнеров STL поверх арены, deallocate ничего не делает */
+template <typename T>
+class ArenaAllocator {
+public:
+	using value_type = T;
+
+	explicit ArenaAllocator(Arena* arena) : m_arena(arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& o) : m_arena(o.getArena()) {}
+
+	T* allocate(size_t n) { return m_arena->allocArray<T>(n); }
+	void deallocate(T*, size_t) {}
+
+	Arena* getArena() const { return m_arena; }
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& o) const { return m_arena == o.getArena(); }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& o) const { return m_arena != o.getArena(); }
+
+private:
+	Arena* m_arena;
+};
+
+} // mem
+} // mb
+
+#endif // MB_ARENA_H
@@ -0,0 +1,52 @@
+#include "Pool.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace mb {
+namespace mem {
+
+Pool::Pool(size_t block_size, size_t blocks) : m_slab(nullptr),
+															  m_block_size(0),
+															  m_blocks(0),
+															  m_available(0),
+															  m_free(nullptr) {
+	// Размер блока кратен max_align_t, чтобы в блоке можно было разместить любой объект
+	const size_t align = alignof(std::max_align_t);
+	m_block_size = (std::max(block_size, sizeof(FreeNode)) + align - 1) / align * align;
+	if (blocks == 0) return;
+	m_slab = static_cast<char*>(std::malloc(m_block_size * blocks));
+	if (m_slab == nullptr) return;
+	m_blocks = blocks;
+
+	// Список свободных блоков в порядке адресов
+	for (size_t i = blocks; i > 0; i--) release(m_slab + (i - 1) * m_block_size);
+}
+
+Pool::~Pool() {
+	std::free(m_slab);
+}
+
+void* Pool::acquire() {
+	FreeNode* node = m_free;
+	if (node == nullptr) return nullptr;
+	m_free = node->next;
+	--m_available;
+	return node;
+}
+
+void Pool::release(void* p) {
+	if (p == nullptr) return;
+	FreeNode* node = static_cast<FreeNode*>(p);
+	node->next = m_free;
+	m_free = node;
+	++m_available;
+}
+
+bool Pool::owns(const void* p) const {
+	const char* c = static_cast<const char*>(p);
+	return c >= m_slab && c < m_slab + m_block_size * m_blocks;
+}
+
+} // mem
+} // mb
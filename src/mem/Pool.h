@@ -0,0 +1,92 @@
+#ifndef MB_POOL_H
+#define MB_POOL_H
+
+#include "ModbusDefs.h"
+
+#include <cstddef>
+#include <new>
+
+namespace mb {
+namespace mem {
+
+/** @brief Пул блоков одного размера в одном непрерывном участке памяти.
+	Свободные блоки связаны в список через свое же содержимое, acquire и release - O(1) без обращения
+	к системному распределителю. Количество блоков задается при создании, при исчерпании acquire возвращает nullptr.
+	Пул не потокобезопасен: у каждого потока опроса свой, либо доступ под мьютексом владельца */
+class Pool {
+public:
+	Pool(size_t block_size, size_t blocks);
+	~Pool();
+
+	Pool(const Pool&) = delete;
+	Pool& operator=(const Pool&) = delete;
+
+	void* acquire();
+	void release(void* p);
+	// Блок принадлежит пулу (для распределителей с запасным путем через operator new)
+	bool owns(const void* p) const;
+
+	size_t getBlockSize() const { return m_block_size; }
+	size_t getCapacity() const { return m_blocks; }
+	size_t getAvailable() const { return m_available; }
+
+private:
+	struct FreeNode {
+		FreeNode* next;
+	};
+
+	char* m_slab;
+	size_t m_block_size;
+	size_t m_blocks;
+	size_t m_available;
+	FreeNode* m_free;
+};
+
+/** @brief Пул буферов кадра Modbus размером MODBUS_MAX_ADU_LENGTH */
+class FramePool : public Pool {
+public:
+	explicit FramePool(size_t frames) : Pool(MODBUS_MAX_ADU_LENGTH, frames) {}
+
+	BYTE* acquireFrame() { return static_cast<BYTE*>(acquire()); }
+};
+
+/** @brief Распределитель STL для узловых контейнеров (list, map, unordered_map) поверх Pool.
+	Одиночные объекты, помещающиеся в блок, берутся из пула, остальное (массивы корзин, исчерпанный пул) -
+	через operator new. Пул должен жить дольше контейнера */
+template <typename T>
+class PoolAllocator {
+public:
+	using value_type = T;
+
+	explicit PoolAllocator(Pool* pool) : m_pool(pool) {}
+	template <typename U>
+	PoolAllocator(const PoolAllocator<U>& o) : m_pool(o.getPool()) {}
+
+	T* allocate(size_t n) {
+		if (n == 1 && sizeof(T) <= m_pool->getBlockSize()) {
+			void* p = m_pool->acquire();
+			if (p) return static_cast<T*>(p);
+		}
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, size_t) {
+		if (m_pool->owns(p)) m_pool->release(p);
+		else ::operator delete(p);
+	}
+
+	Pool* getPool() const { return m_pool; }
+
+	template <typename U>
+	bool operator==(const PoolAllocator<U>& o) const { return m_pool == o.getPool(); }
+	template <typename U>
+	bool operator!=(const PoolAllocator<U>& o) const { return m_pool != o.getPool(); }
+
+private:
+	Pool* m_pool;
+};
+
+} // mem
+} // mb
+
+#endif // MB_POOL_H
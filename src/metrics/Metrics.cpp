@@ -0,0 +1,437 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace mb {
+namespace metrics {
+
+using modbus::RttHistogram;
+
+const char* counterToString(Counter counter) {
+	switch (counter) {
+		case Counter::REQUESTS: return "requests";
+		case Counter::RESPONSES: return "responses";
+		case Counter::EXCEPTIONS: return "exceptions";
+		case Counter::TIMEOUTS: return "timeouts";
+		case Counter::CRC_ERRORS: return "crc_errors";
+		case Counter::BAD_RESPONSES: return "bad_responses";
+		case Counter::IO_ERRORS: return "io_errors";
+		case Counter::SKIPPED: return "skipped";
+		case Counter::BYTES_OUT: return "pdu_bytes_out";
+		case Counter::BYTES_IN: return "pdu_bytes_in";
+		default: return "unknown";
+	}
+}
+
+/* Histogram */
+
+uint32_t Histogram::percentile(double p) const {
+	if (count == 0) return 0;
+	uint64_t rank = static_cast<uint64_t>(p * count + 0.5);
+	if (rank == 0) rank = 1;
+	uint64_t acc = 0;
+	for (int i = 0; i < HIST_BUCKETS; i++) {
+		acc += buckets[i];
+		if (acc >= rank) return std::min(RttHistogram::bucketUpper(i), max);
+	}
+	return max;
+}
+
+uint64_t Histogram::countUpTo(uint32_t value) const {
+	uint64_t acc = 0;
+	for (int i = 0; i < HIST_BUCKETS && RttHistogram::bucketUpper(i) <= value; i++) acc += buckets[i];
+	return acc;
+}
+
+/* Metrics */
+
+// Шарды потока по номерам реестров. Номера не переиспользуются, поэтому запись уничтоженного реестра
+// больше никогда не читается. При завершении потока шарды возвращаются в еще существующие реестры
+namespace {
+
+struct ThreadShards {
+	struct Ref {
+		void* shard = nullptr;
+		std::weak_ptr<void> pool;
+		void (*release)(void* pool, void* shard) = nullptr;
+	};
+	std::vector<Ref> refs;
+
+	~ThreadShards() {
+		for (Ref& r : refs) {
+			if (r.shard == nullptr) continue;
+			std::shared_ptr<void> pool = r.pool.lock();
+			if (pool) r.release(pool.get(), r.shard);
+		}
+	}
+};
+
+thread_local ThreadShards t_shards;
+// Последний использованный шард потока. Тривиальные thread_local не требуют проверки инициализации при обращении
+thread_local uint32_t t_last_id = UINT32_MAX;
+thread_local void* t_last_shard = nullptr;
+std::atomic<uint32_t> g_next_id(0);
+std::atomic<Metrics*> g_map_lock_metrics(nullptr);
+
+} // namespace
+
+Metrics::Metrics() : m_id(g_next_id.fetch_add(1)), m_pool(std::make_shared<Pool>()) {}
+
+Metrics::~Metrics() {
+	Metrics* self = this;
+	g_map_lock_metrics.compare_exchange_strong(self, nullptr);
+}
+
+int Metrics::funcSlot(const int func) {
+	switch (func) {
+		case 1: case 2: case 3: case 4: case 5: case 6: return func - 1;
+		case 15: return 6;
+		case 16: return 7;
+		default: return 8;
+	}
+}
+
+int Metrics::funcOfSlot(const int slot) {
+	static const int funcs[FUNC_SLOTS] = { 1, 2, 3, 4, 5, 6, 15, 16, 0 };
+	return funcs[slot];
+}
+
+Metrics::Shard& Metrics::shard() {
+	if (t_last_id == m_id) return *static_cast<Shard*>(t_last_shard);
+	Shard* s = nullptr;
+	if (m_id < t_shards.refs.size()) s = static_cast<Shard*>(t_shards.refs[m_id].shard);
+	if (s == nullptr) s = &attachShard();
+	t_last_id = m_id;
+	t_last_shard = s;
+	return *s;
+}
+
+Metrics::Shard& Metrics::attachShard() {
+	Shard* s;
+	{
+		std::lock_guard<std::mutex> lock(m_pool->mtx);
+		if (!m_pool->free.empty()) {
+			s = m_pool->free.back();
+			m_pool->free.pop_back();
+		}
+		else {
+			m_pool->shards.emplace_back(new Shard());
+			s = m_pool->shards.back().get();
+		}
+	}
+
+	if (t_shards.refs.size() <= m_id) t_shards.refs.resize(m_id + 1);
+	ThreadShards::Ref& ref = t_shards.refs[m_id];
+	ref.shard = s;
+	ref.pool = m_pool;
+	ref.release = [](void* pool, void* shard) {
+		Pool* p = static_cast<Pool*>(pool);
+		std::lock_guard<std::mutex> lock(p->mtx);
+		p->free.push_back(static_cast<Shard*>(shard));
+	};
+	return *s;
+}
+
+Metrics::Series* Metrics::series(const int slave_id, const int func) {
+	if (slave_id < 0 || slave_id > MAX_SLAVE_ID) return nullptr;
+	std::atomic<Series*>& slot = shard().series[slave_id * FUNC_SLOTS + funcSlot(func)];
+	Series* s = slot.load(std::memory_order_relaxed);
+	if (s == nullptr) {
+		s = new Series();
+		slot.store(s, std::memory_order_release);
+	}
+	return s;
+}
+
+void Metrics::recordHist(std::atomic<uint32_t>* buckets, std::atomic<uint64_t>& sum, std::atomic<uint32_t>& max, const uint64_t value) {
+	const uint32_t v = static_cast<uint32_t>(std::min<uint64_t>(value, UINT32_MAX));
+	bump(buckets[RttHistogram::bucketOf(v)], 1u);
+	bump(sum, value);
+	if (v > max.load(std::memory_order_relaxed)) max.store(v, std::memory_order_relaxed);
+}
+
+void Metrics::mergeHist(const std::atomic<uint32_t>* buckets, const std::atomic<uint64_t>& sum, const std::atomic<uint32_t>& max, Histogram& h) {
+	for (int i = 0; i < HIST_BUCKETS; i++) {
+		uint32_t n = buckets[i].load(std::memory_order_relaxed);
+		h.buckets[i] += n;
+		h.count += n;
+	}
+	h.sum += sum.load(std::memory_order_relaxed);
+	h.max = std::max(h.max, max.load(std::memory_order_relaxed));
+}
+
+void Metrics::add(const int slave_id, const int func, const Counter counter, const uint64_t n) {
+	Series* s = series(slave_id, func);
+	if (s) bump(s->counters[static_cast<int>(counter)], n);
+}
+
+void Metrics::addException(const int slave_id, const int func, const modbus::ModbusExceptionCode code) {
+	Series* s = series(slave_id, func);
+	const int c = static_cast<int>(code);
+	if (s == nullptr || c <= 0 || c >= EXCEPTION_CODES) return;
+	bump(s->exceptions[c], uint64_t(1));
+}
+
+void Metrics::recordRtt(const int slave_id, const int func, const uint32_t rtt_us) {
+	Series* s = series(slave_id, func);
+	if (s) recordHist(s->rtt, s->rtt_sum, s->rtt_max, rtt_us);
+}
+
+void Metrics::onTransaction(const int slave_id, const int func, const Counter result, const uint32_t rtt_us, const uint32_t bytes_out, const uint32_t bytes_in) {
+	Series* s = series(slave_id, func);
+	if (s == nullptr) return;
+	bump(s->counters[static_cast<int>(Counter::REQUESTS)], uint64_t(1));
+	bump(s->counters[static_cast<int>(result)], uint64_t(1));
+	bump(s->counters[static_cast<int>(Counter::BYTES_OUT)], uint64_t(bytes_out));
+	bump(s->counters[static_cast<int>(Counter::BYTES_IN)], uint64_t(bytes_in));
+	// Время до таймаута - не RTT устройства
+	if (result == Counter::RESPONSES || result == Counter::EXCEPTIONS) recordHist(s->rtt, s->rtt_sum, s->rtt_max, rtt_us);
+}
+
+void Metrics::recordMapLockWait(const uint64_t wait_ns) {
+	Shard& s = shard();
+	bump(s.lock_waits, uint64_t(1));
+	recordHist(s.lock_wait, s.lock_wait_sum, s.lock_wait_max, wait_ns);
+}
+
+void Metrics::setMapLockMetrics(Metrics* metrics) {
+	g_map_lock_metrics.store(metrics);
+}
+
+void Metrics::onMapLockWait(uint64_t wait_ns) {
+	Metrics* m = g_map_lock_metrics.load(std::memory_order_acquire);
+	if (m) m->recordMapLockWait(wait_ns);
+}
+
+void Metrics::snapshot(MetricsSnapshot& snap) const {
+	snap.series.clear();
+	snap.map_lock_waits = 0;
+	snap.map_lock_wait_ns = Histogram();
+
+	std::vector<SeriesStats*> index(SERIES, nullptr);
+	std::vector<std::unique_ptr<SeriesStats>> stats;
+
+	std::lock_guard<std::mutex> lock(m_pool->mtx);
+	for (const std::unique_ptr<Shard>& sh : m_pool->shards) {
+		for (int i = 0; i < SERIES; i++) {
+			const Series* s = sh->series[i].load(std::memory_order_acquire);
+			if (s == nullptr) continue;
+			SeriesStats*& st = index[i];
+			if (st == nullptr) {
+				stats.emplace_back(new SeriesStats());
+				st = stats.back().get();
+				st->slave_id = i / FUNC_SLOTS;
+				st->func = funcOfSlot(i % FUNC_SLOTS);
+				st->counters.fill(0);
+				st->exceptions.fill(0);
+			}
+			for (int c = 0; c < static_cast<int>(Counter::COUNT); c++) st->counters[c] += s->counters[c].load(std::memory_order_relaxed);
+			for (int c = 0; c < EXCEPTION_CODES; c++) st->exceptions[c] += s->exceptions[c].load(std::memory_order_relaxed);
+			mergeHist(s->rtt, s->rtt_sum, s->rtt_max, st->rtt_us);
+		}
+		snap.map_lock_waits += sh->lock_waits.load(std::memory_order_relaxed);
+		mergeHist(sh->lock_wait, sh->lock_wait_sum, sh->lock_wait_max, snap.map_lock_wait_ns);
+	}
+
+	for (SeriesStats* st : index) {
+		if (st) snap.series.push_back(*st);
+	}
+}
+
+static void appendf(std::string& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void appendf(std::string& out, const char* fmt, ...) {
+	char buf[256];
+	va_list args;
+	va_start(args, fmt);
+	int n = vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	if (n > 0) out.append(buf, std::min<size_t>(n, sizeof(buf) - 1));
+}
+
+void Metrics::writeText(std::string& out) const {
+	MetricsSnapshot snap;
+	snapshot(snap);
+
+	appendf(out, "%5s %4s %10s %10s %8s %8s %6s %8s %12s %12s %8s %8s %8s\n",
+			  "slave", "func", "requests", "responses", "except", "timeout", "crc", "bad", "bytes_out", "bytes_in", "p50_us", "p99_us", "max_us");
+	for (const SeriesStats& s : snap.series) {
+		appendf(out, "%5d %4d %10llu %10llu %8llu %8llu %6llu %8llu %12llu %12llu %8u %8u %8u\n", s.slave_id, s.func,
+				  (unsigned long long)s.get(Counter::REQUESTS), (unsigned long long)s.get(Counter::RESPONSES),
+				  (unsigned long long)s.get(Counter::EXCEPTIONS), (unsigned long long)s.get(Counter::TIMEOUTS),
+				  (unsigned long long)s.get(Counter::CRC_ERRORS), (unsigned long long)(s.get(Counter::BAD_RESPONSES) + s.get(Counter::IO_ERRORS)),
+				  (unsigned long long)s.get(Counter::BYTES_OUT), (unsigned long long)s.get(Counter::BYTES_IN),
+				  s.rtt_us.percentile(0.5), s.rtt_us.percentile(0.99), s.rtt_us.max);
+		for (int c = 1; c < EXCEPTION_CODES; c++) {
+			if (s.exceptions[c]) appendf(out, "%5s %4s   exception %02X: %llu\n", "", "", c, (unsigned long long)s.exceptions[c]);
+		}
+	}
+	appendf(out, "map lock waits: %llu, p50 %u ns, p99 %u ns, max %u ns\n", (unsigned long long)snap.map_lock_waits,
+			  snap.map_lock_wait_ns.percentile(0.5), snap.map_lock_wait_ns.percentile(0.99), snap.map_lock_wait_ns.max);
+}
+
+// Гистограмма Prometheus: границы le = 2^k - 1 совпадают с границами корзин, поэтому накопленные значения точные
+static void writeHistogram(std::string& out, const char* name, const char* labels, const Histogram& h, int k_from, int k_to) {
+	const char* sep = labels[0] ? "," : "";
+	for (int k = k_from; k <= k_to; k++) {
+		appendf(out, "%s_bucket{%s%sle=\"%u\"} %llu\n", name, labels, sep, (1u << k) - 1, (unsigned long long)h.countUpTo((1u << k) - 1));
+	}
+	appendf(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long)h.count);
+	const char* open = labels[0] ? "{" : "";
+	const char* close = labels[0] ? "}" : "";
+	appendf(out, "%s_sum%s%s%s %llu\n", name, open, labels, close, (unsigned long long)h.sum);
+	appendf(out, "%s_count%s%s%s %llu\n", name, open, labels, close, (unsigned long long)h.count);
+}
+
+void Metrics::writePrometheus(std::string& out) const {
+	MetricsSnapshot snap;
+	snapshot(snap);
+	char labels[64];
+
+	for (int c = 0; c < static_cast<int>(Counter::COUNT); c++) {
+		const char* name = counterToString(static_cast<Counter>(c));
+		appendf(out, "# TYPE mb_%s_total counter\n", name);
+		for (const SeriesStats& s : snap.series) {
+			appendf(out, "mb_%s_total{slave=\"%d\",func=\"%d\"} %llu\n", name, s.slave_id, s.func, (unsigned long long)s.counters[c]);
+		}
+	}
+
+	out += "# TYPE mb_exception_codes_total counter\n";
+	for (const SeriesStats& s : snap.series) {
+		for (int c = 1; c < EXCEPTION_CODES; c++) {
+			if (s.exceptions[c]) appendf(out, "mb_exception_codes_total{slave=\"%d\",func=\"%d\",code=\"%d\"} %llu\n", s.slave_id, s.func, c, (unsigned long long)s.exceptions[c]);
+		}
+	}
+
+	out += "# TYPE mb_request_rtt_us histogram\n";
+	for (const SeriesStats& s : snap.series) {
+		if (s.rtt_us.count == 0) continue;
+		snprintf(labels, sizeof(labels), "slave=\"%d\",func=\"%d\"", s.slave_id, s.func);
+		writeHistogram(out, "mb_request_rtt_us", labels, s.rtt_us, 4, 24);		// 15 мкс .. 16.7 с
+	}
+
+	out += "# TYPE mb_map_lock_waits_total counter\n";
+	appendf(out, "mb_map_lock_waits_total %llu\n", (unsigned long long)snap.map_lock_waits);
+	out += "# TYPE mb_map_lock_wait_ns histogram\n";
+	writeHistogram(out, "mb_map_lock_wait_ns", "", snap.map_lock_wait_ns, 6, 30);	// 63 нс .. 1 с
+}
+
+/* MetricsExporter */
+
+static uint64_t nowMs() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MetricsExporter::MetricsExporter(Metrics& metrics, uint32_t period_ms) : m_metrics(metrics),
+																								 m_period_ms(period_ms),
+																								 m_listen_fd(-1),
+																								 m_running(false) {}
+
+MetricsExporter::~MetricsExporter() {
+	stop();
+}
+
+void MetricsExporter::setFile(const std::string& path) {
+	m_file = path;
+}
+
+void MetricsExporter::setSocket(const std::string& path) {
+	m_socket_path = path;
+}
+
+bool MetricsExporter::writeFile() {
+	if (m_file.empty()) return false;
+	std::string text;
+	m_metrics.writePrometheus(text);
+
+	std::string tmp_path = m_file + ".tmp";
+	FILE* f = fopen(tmp_path.c_str(), "wb");
+	if (f == nullptr) return false;
+	bool result = fwrite(text.data(), 1, text.size(), f) == text.size();
+	result = fclose(f) == 0 && result;
+	if (result) result = rename(tmp_path.c_str(), m_file.c_str()) == 0;
+	if (!result) remove(tmp_path.c_str());
+	return result;
+}
+
+bool MetricsExporter::openSocket() {
+	sockaddr_un adr = {};
+	adr.sun_family = AF_UNIX;
+	if (m_socket_path.size() >= sizeof(adr.sun_path)) return false;
+	m_socket_path.copy(adr.sun_path, m_socket_path.size());
+
+	m_listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_listen_fd < 0) return false;
+	::unlink(m_socket_path.c_str());
+	if (::bind(m_listen_fd, reinterpret_cast<sockaddr*>(&adr), sizeof(adr)) != 0 || ::listen(m_listen_fd, 8) != 0) {
+		::close(m_listen_fd);
+		m_listen_fd = -1;
+		return false;
+	}
+	return true;
+}
+
+bool MetricsExporter::start() {
+	if (m_running) return false;
+	if (m_file.empty() && m_socket_path.empty()) return false;
+	if (!m_socket_path.empty() && !openSocket()) return false;
+
+	m_running = true;
+	m_thread = std::thread(&MetricsExporter::run, this);
+	return true;
+}
+
+void MetricsExporter::stop() {
+	if (!m_running.exchange(false)) return;
+	if (m_thread.joinable()) m_thread.join();
+	if (m_listen_fd >= 0) {
+		::close(m_listen_fd);
+		::unlink(m_socket_path.c_str());
+		m_listen_fd = -1;
+	}
+}
+
+void MetricsExporter::serveClient(int fd) {
+	std::string text;
+	m_metrics.writePrometheus(text);
+	size_t sent = 0;
+	while (sent < text.size()) {
+		ssize_t n = ::send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0) break;
+		sent += n;
+	}
+	::close(fd);
+}
+
+void MetricsExporter::run() {
+	uint64_t next_ms = nowMs();
+	while (m_running) {
+		uint64_t now = nowMs();
+		if (!m_file.empty() && now >= next_ms) {
+			writeFile();
+			next_ms = now + m_period_ms;
+		}
+
+		int wait_ms = 200;
+		if (!m_file.empty()) wait_ms = static_cast<int>(std::min<uint64_t>(wait_ms, next_ms > now ? next_ms - now : 0));
+		if (m_listen_fd < 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+			continue;
+		}
+		pollfd pfd = { m_listen_fd, POLLIN, 0 };
+		if (::poll(&pfd, 1, wait_ms) <= 0) continue;
+		int fd = ::accept(m_listen_fd, nullptr, nullptr);
+		if (fd >= 0) serveClient(fd);
+	}
+	if (!m_file.empty()) writeFile();
+}
+
+} // metrics
+} // mb
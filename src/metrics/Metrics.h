@@ -0,0 +1,190 @@
+#ifndef MB_METRICS_H
+#define MB_METRICS_H
+
+#include "ModbusDefs.h"
+#include "SlaveHealth.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mb {
+namespace metrics {
+
+/** @brief Счетчики серии slave_id/func */
+enum class Counter {
+	REQUESTS,			// Выданные запросы
+	RESPONSES,			// Нормальные ответы
+	EXCEPTIONS,			// Ответы исключением (по кодам - отдельно)
+	TIMEOUTS,
+	CRC_ERRORS,
+	BAD_RESPONSES,
+	IO_ERRORS,
+	SKIPPED,				// Запросы, не выданные из-за OFFLINE устройства
+	BYTES_OUT,			// Байты PDU запросов
+	BYTES_IN,			// Байты PDU ответов
+	COUNT
+};
+
+const char* counterToString(Counter counter);
+
+constexpr int EXCEPTION_CODES = static_cast<int>(modbus::ModbusExceptionCode::EXCEPTION_MAX);
+constexpr int HIST_BUCKETS = modbus::RttHistogram::BUCKETS;
+
+/** @brief Сводная гистограмма задержек (корзины RttHistogram, без окна старения) */
+struct Histogram {
+	std::array<uint64_t, HIST_BUCKETS> buckets;
+	uint64_t count;
+	uint64_t sum;
+	uint32_t max;
+
+	Histogram() { buckets.fill(0); count = 0; sum = 0; max = 0; }
+
+	// Верхняя граница корзины, в которую попал перцентиль p (0..1)
+	uint32_t percentile(double p) const;
+	// Количество замеров не больше value (value должно быть границей корзины, например 2^k - 1)
+	uint64_t countUpTo(uint32_t value) const;
+};
+
+/** @brief Статистика пары slave_id/func, сведенная по всем потокам */
+struct SeriesStats {
+	int slave_id;
+	int func;
+	std::array<uint64_t, static_cast<int>(Counter::COUNT)> counters;
+	std::array<uint64_t, EXCEPTION_CODES> exceptions;	// Индекс - код исключения
+	Histogram rtt_us;
+
+	uint64_t get(Counter counter) const { return counters[static_cast<int>(counter)]; }
+};
+
+/** @brief Снимок всех метрик */
+struct MetricsSnapshot {
+	std::vector<SeriesStats> series;		// Только серии, в которых были события, по возрастанию slave_id/func
+	uint64_t map_lock_waits;				// Захваты мьютекса Map, которым пришлось ждать
+	Histogram map_lock_wait_ns;
+};
+
+/** @brief Реестр метрик горячего пути.
+	Каждый поток пишет в свой шард (thread-local), поэтому запись - это несколько сохранений memory_order_relaxed
+	без атомарных read-modify-write и без блокировок: значение пишет только поток-владелец, читатель сводит шарды при снимке.
+	Шард закрепляется за потоком при первом событии и возвращается в реестр при завершении потока,
+	накопленные значения при этом сохраняются и переходят к следующему потоку.
+	Серии slave_id/func внутри шарда выделяются при первом событии серии */
+class Metrics {
+public:
+	Metrics();
+	~Metrics();
+
+	Metrics(const Metrics&) = delete;
+	Metrics& operator=(const Metrics&) = delete;
+
+	void add(const int slave_id, const int func, const Counter counter, const uint64_t n = 1);
+	void addException(const int slave_id, const int func, const modbus::ModbusExceptionCode code);
+	void recordRtt(const int slave_id, const int func, const uint32_t rtt_us);
+
+	// Одна транзакция целиком: запрос, результат (RESPONSES, EXCEPTIONS, TIMEOUTS ...), RTT и байты
+	void onTransaction(const int slave_id, const int func, const Counter result, const uint32_t rtt_us, const uint32_t bytes_out, const uint32_t bytes_in);
+
+	// Ожидание мьютекса Map (см. MB_MAP_LOCK_METRICS)
+	void recordMapLockWait(const uint64_t wait_ns);
+
+	void snapshot(MetricsSnapshot& snap) const;
+
+	// Текстовый снимок для журнала/консоли
+	void writeText(std::string& out) const;
+	// Формат экспозиции Prometheus (text/plain; version=0.0.4)
+	void writePrometheus(std::string& out) const;
+
+	// Реестр, в который Map передает время ожидания мьютекса (nullptr - не учитывать).
+	// Устанавливает обработчик Map::setLockWaitHook приложение, например: Map::setLockWaitHook(Metrics::onMapLockWait)
+	static void setMapLockMetrics(Metrics* metrics);
+	static void onMapLockWait(uint64_t wait_ns);
+
+private:
+	static constexpr int FUNC_SLOTS = 9;		// 1, 2, 3, 4, 5, 6, 15, 16 и прочие функции
+	static constexpr int SERIES = (MAX_SLAVE_ID + 1) * FUNC_SLOTS;
+
+	template <typename T>
+	static void bump(std::atomic<T>& a, const T n) { a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+	struct Series {
+		std::atomic<uint64_t> counters[static_cast<int>(Counter::COUNT)];
+		std::atomic<uint64_t> exceptions[EXCEPTION_CODES];
+		std::atomic<uint64_t> rtt_sum;
+		std::atomic<uint32_t> rtt_max;
+		std::atomic<uint32_t> rtt[HIST_BUCKETS];
+	};
+
+	struct Shard {
+		std::atomic<Series*> series[SERIES];		// Выделяются потоком-владельцем, читаются при снимке
+		std::atomic<uint64_t> lock_waits;
+		std::atomic<uint64_t> lock_wait_sum;
+		std::atomic<uint32_t> lock_wait_max;
+		std::atomic<uint32_t> lock_wait[HIST_BUCKETS];
+
+		~Shard() {
+			for (std::atomic<Series*>& s : series) delete s.load(std::memory_order_relaxed);
+		}
+	};
+
+	// Шарды реестра. Разделяется с потоками, чтобы поток мог вернуть шард, только если реестр еще существует
+	struct Pool {
+		std::mutex mtx;
+		std::vector<std::unique_ptr<Shard>> shards;
+		std::vector<Shard*> free;
+	};
+
+	static int funcSlot(const int func);
+	static int funcOfSlot(const int slot);
+	static void recordHist(std::atomic<uint32_t>* buckets, std::atomic<uint64_t>& sum, std::atomic<uint32_t>& max, const uint64_t value);
+	static void mergeHist(const std::atomic<uint32_t>* buckets, const std::atomic<uint64_t>& sum, const std::atomic<uint32_t>& max, Histogram& h);
+
+	Shard& shard();
+	Shard& attachShard();
+	Series* series(const int slave_id, const int func);
+
+	uint32_t m_id;								// Номер реестра в thread-local таблице шардов потока
+	std::shared_ptr<Pool> m_pool;
+};
+
+/** @brief Периодическая выгрузка метрик в формате Prometheus.
+	Файл перезаписывается атомарно (временный файл и rename), что подходит для textfile collector node_exporter.
+	На локальный сокет (AF_UNIX) каждому подключившемуся отдается текущая экспозиция, после чего соединение закрывается */
+class MetricsExporter {
+public:
+	MetricsExporter(Metrics& metrics, uint32_t period_ms = 1000);
+	~MetricsExporter();
+
+	void setFile(const std::string& path);
+	void setSocket(const std::string& path);
+
+	bool start();
+	void stop();
+
+	// Однократная запись файла
+	bool writeFile();
+
+private:
+	void run();
+	bool openSocket();
+	void serveClient(int fd);
+
+	Metrics& m_metrics;
+	uint32_t m_period_ms;
+	std::string m_file;
+	std::string m_socket_path;
+	int m_listen_fd;
+
+	std::atomic<bool> m_running;
+	std::thread m_thread;
+};
+
+} // metrics
+} // mb
+
+#endif // MB_METRICS_H
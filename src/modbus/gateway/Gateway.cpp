@@ -0,0 +1,457 @@
+#include "Gateway.h"
+#include "ModbusFrame.h"
+#include "ScanScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <limits>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace mb {
+namespace modbus {
+
+static uint64_t nowMs() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Чтение ровно len байт из сокета клиента, пока шлюз работает
+static bool readFull(int fd, BYTE* buf, size_t len, const std::atomic<bool>& running) {
+	size_t have = 0;
+	while (have < len) {
+		if (!running) return false;
+		pollfd pfd = { fd, POLLIN, 0 };
+		int rc = ::poll(&pfd, 1, 200);
+		if (rc < 0 && errno != EINTR) return false;
+		if (rc <= 0) continue;
+		ssize_t n = ::recv(fd, buf + have, len - have, 0);
+		if (n <= 0) {
+			if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+			return false;
+		}
+		have += n;
+	}
+	return true;
+}
+
+static bool sendAll(int fd, const BYTE* buf, size_t len) {
+	while (len > 0) {
+		ssize_t n = ::send(fd, buf, len, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+Gateway::Gateway(ModbusMaster* rtu_master) : m_master(rtu_master),
+															m_listen_fd(-1),
+															m_port(0),
+															m_running(false),
+															m_tcp_requests(0),
+															m_cache_hits(0),
+															m_serial_reads(0),
+															m_collapsed(0),
+															m_passthrough(0),
+															m_errors(0) {}
+
+Gateway::~Gateway() { stop(); }
+
+bool Gateway::addCacheRange(const int slave_id, const BYTE func, const WORD start_adr, const WORD end_adr, const uint32_t ttl_ms) {
+	if (!isReadFunc(func) || start_adr > end_adr) return false;
+	WORD quantity = end_adr - start_adr + 1;
+	if (quantity > (isBitFunc(func) ? MODBUS_MAX_READ_BITS : MODBUS_MAX_READ_REGISTERS)) return false;
+
+	std::lock_guard<std::mutex> lock(m_mtx);
+	std::unique_ptr<CacheRange> range(new CacheRange(start_adr, quantity));
+	range->slave_id = slave_id;
+	range->func = func;
+	range->start_adr = start_adr;
+	range->end_adr = end_adr;
+	range->ttl_ms = ttl_ms;
+	if (!range->map.initNewMemory(isBitFunc(func) ? data::MapType::BIT_MAP : data::MapType::WORD_MAP)) return false;
+
+	m_index[keyOf(slave_id, func)].push_back(range.get());
+	m_ranges.push_back(std::move(range));
+	// Работающий опросчик включает новый диапазон в расписание
+	m_poll_cv.notify_all();
+	return true;
+}
+
+Gateway::CacheRange* Gateway::findRange(const int slave_id, const BYTE func, const WORD adr, const WORD quantity) {
+	auto it = m_index.find(keyOf(slave_id, func));
+	if (it == m_index.end()) return nullptr;
+	uint32_t end = static_cast<uint32_t>(adr) + quantity - 1;
+	for (CacheRange* r : it->second) {
+		if (adr >= r->start_adr && end <= r->end_adr) return r;
+	}
+	return nullptr;
+}
+
+void Gateway::refreshSpan(std::unique_lock<std::mutex>& lock, const int slave_id, const BYTE func, const WORD start_adr, const WORD quantity, std::vector<CacheRange*>& targets) {
+	for (CacheRange* r : targets) {
+		r->inflight = true;
+		r->read_generation = r->generation;
+	}
+	lock.unlock();
+
+	BIT bits[MODBUS_MAX_READ_BITS];
+	WORD words[MODBUS_MAX_READ_REGISTERS];
+	MbStatus status;
+	ModbusExceptionCode exception = ModbusExceptionCode::EXCEPTION_NOT_DEFINED;
+	{
+		std::lock_guard<std::mutex> line_lock(m_line_mtx);
+		if (m_master == nullptr) status = MbStatus::IO_ERROR;
+		else if (isBitFunc(func)) status = m_master->readBits(slave_id, func, start_adr, quantity, bits);
+		else status = m_master->readWords(slave_id, func, start_adr, quantity, words);
+		if (status == MbStatus::EXCEPTION) exception = m_master->getLastException();
+	}
+	++m_serial_reads;
+
+	if (status == MbStatus::OK) {
+		for (CacheRange* r : targets) {
+			WORD offset = r->start_adr - start_adr;
+			WORD q = r->end_adr - r->start_adr + 1;
+			if (isBitFunc(func)) r->map.writeBits(r->start_adr, q, bits + offset);
+			else r->map.writeWords(r->start_adr, q, words + offset);
+		}
+	}
+
+	lock.lock();
+	uint64_t now = nowMs();
+	for (CacheRange* r : targets) {
+		r->inflight = false;
+		r->last_status = status;
+		r->last_exception = exception;
+		// Запись, выполненная во время чтения, сбросила кэш - прочитанные данные могут быть старее ее
+		r->valid = status == MbStatus::OK && r->read_generation == r->generation;
+		if (r->valid) r->updated_ms = now;
+		r->cv.notify_all();
+	}
+}
+
+void Gateway::invalidate(const int slave_id, const BYTE func, const WORD start_adr, const WORD quantity) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	auto it = m_index.find(keyOf(slave_id, func));
+	if (it == m_index.end()) return;
+	uint32_t end = static_cast<uint32_t>(start_adr) + quantity - 1;
+	for (CacheRange* r : it->second) {
+		if (start_adr <= r->end_adr && end >= r->start_adr) {
+			r->valid = false;
+			++r->generation;
+		}
+	}
+}
+
+size_t Gateway::statusResponse(const BYTE func, const MbStatus status, const ModbusExceptionCode exception, BYTE* resp) {
+	if (status == MbStatus::EXCEPTION) return pduException(resp, func, exception);
+	++m_errors;
+	if (status == MbStatus::IO_ERROR) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_GATEWAY_PATH);
+	return pduException(resp, func, ModbusExceptionCode::EXCEPTION_GATEWAY_TARGET);
+}
+
+size_t Gateway::handle(const BYTE unit_id, const BYTE* req, const size_t req_len, BYTE* resp) {
+	++m_tcp_requests;
+	if (req_len < 1) return 0;
+	const BYTE func = req[0];
+
+	if (isReadFunc(func)) {
+		if (req_len < 5) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE);
+		WORD adr = getWordBE(req + 1);
+		WORD quantity = getWordBE(req + 3);
+		if (quantity == 0 || quantity > (isBitFunc(func) ? MODBUS_MAX_READ_BITS : MODBUS_MAX_READ_REGISTERS)) {
+			return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE);
+		}
+		return handleRead(unit_id, func, adr, quantity, resp);
+	}
+	return handlePassthrough(unit_id, req, req_len, resp);
+}
+
+size_t Gateway::handleRead(const BYTE unit_id, const BYTE func, const WORD adr, const WORD quantity, BYTE* resp) {
+	std::unique_lock<std::mutex> lock(m_mtx);
+	CacheRange* r = findRange(unit_id, func, adr, quantity);
+	if (r == nullptr) {
+		lock.unlock();
+		BYTE req[5];
+		pduReadRequest(req, func, adr, quantity);
+		return handlePassthrough(unit_id, req, sizeof(req), resp);
+	}
+
+	uint64_t now = nowMs();
+	if (!r->valid || now - r->updated_ms > r->ttl_ms) {
+		// Диапазон уже читается по запросу другого клиента или опросчиком - ждем результат
+		if (r->inflight) {
+			++m_collapsed;
+			r->cv.wait(lock, [r] { return !r->inflight; });
+		}
+		else {
+			std::vector<CacheRange*> targets(1, r);
+			refreshSpan(lock, r->slave_id, r->func, r->start_adr, r->end_adr - r->start_adr + 1, targets);
+		}
+		if (r->last_status != MbStatus::OK) return statusResponse(func, r->last_status, r->last_exception, resp);
+	}
+	else ++m_cache_hits;
+	lock.unlock();
+
+	if (isBitFunc(func)) {
+		BIT bits[MODBUS_MAX_READ_BITS];
+		if (!r->map.readBits(adr, quantity, bits)) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_ADDRESS);
+		return pduReadBitsResponse(resp, func, quantity, bits);
+	}
+	WORD words[MODBUS_MAX_READ_REGISTERS];
+	if (!r->map.readWords(adr, quantity, words)) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_ADDRESS);
+	return pduReadWordsResponse(resp, func, quantity, words);
+}
+
+size_t Gateway::handlePassthrough(const BYTE unit_id, const BYTE* req, const size_t req_len, BYTE* resp) {
+	++m_passthrough;
+	const BYTE func = req[0];
+	if (req_len < 5) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE);
+
+	const WORD adr = getWordBE(req + 1);
+	const WORD val = getWordBE(req + 3);
+	BIT bits[MODBUS_MAX_READ_BITS];
+	WORD words[MODBUS_MAX_READ_REGISTERS];
+	MbStatus status;
+	ModbusExceptionCode exception = ModbusExceptionCode::EXCEPTION_NOT_DEFINED;
+
+	std::unique_lock<std::mutex> line_lock(m_line_mtx);
+	if (m_master == nullptr) return statusResponse(func, MbStatus::IO_ERROR, exception, resp);
+
+	switch (func) {
+		case 1: case 2: status = m_master->readBits(unit_id, func, adr, val, bits); break;
+		case 3: case 4: status = m_master->readWords(unit_id, func, adr, val, words); break;
+		case 5:
+			if (val != 0x0000 && val != 0xFF00) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE);
+			status = m_master->writeBit(unit_id, adr, val ? 1 : 0);
+			break;
+		case 6: status = m_master->writeWord(unit_id, adr, val); break;
+		case 15:
+			if (val == 0 || val > MODBUS_MAX_WRITE_BITS || req_len < 6 + static_cast<size_t>((val + 7) / 8) || req[5] != (val + 7) / 8) {
+				return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE);
+			}
+			unpackBits(req + 6, val, bits);
+			status = m_master->writeBits(unit_id, adr, val, bits);
+			break;
+		case 16:
+			if (val == 0 || val > MODBUS_MAX_WRITE_REGISTERS || req_len < 6 + static_cast<size_t>(val * 2) || req[5] != val * 2) {
+				return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE);
+			}
+			for (WORD i = 0; i < val; i++) words[i] = getWordBE(req + 6 + i * 2);
+			status = m_master->writeWords(unit_id, adr, val, words);
+			break;
+		default:
+			return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_FUNCTION);
+	}
+	if (status == MbStatus::EXCEPTION) exception = m_master->getLastException();
+	line_lock.unlock();
+
+	if (status != MbStatus::OK) return statusResponse(func, status, exception, resp);
+
+	switch (func) {
+		case 1: case 2: return pduReadBitsResponse(resp, func, val, bits);
+		case 3: case 4: return pduReadWordsResponse(resp, func, val, words);
+		case 5: case 15: invalidate(unit_id, 1, adr, func == 5 ? 1 : val); break;
+		case 6: case 16: invalidate(unit_id, 3, adr, func == 6 ? 1 : val); break;
+	}
+
+	// Ответ на запись - эхо адреса и значения/количества
+	resp[0] = func;
+	putWordBE(resp + 1, adr);
+	putWordBE(resp + 3, val);
+	return 5;
+}
+
+bool Gateway::start(const std::string& bind_adr, const uint16_t port) {
+	if (m_running) return false;
+
+	sockaddr_in adr = {};
+	adr.sin_family = AF_INET;
+	adr.sin_port = htons(port);
+	if (inet_pton(AF_INET, bind_adr.c_str(), &adr.sin_addr) != 1) return false;
+
+	m_listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (m_listen_fd < 0) return false;
+	int one = 1;
+	setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	socklen_t adr_len = sizeof(adr);
+	if (::bind(m_listen_fd, reinterpret_cast<sockaddr*>(&adr), sizeof(adr)) != 0 ||
+		 ::listen(m_listen_fd, 64) != 0 ||
+		 ::getsockname(m_listen_fd, reinterpret_cast<sockaddr*>(&adr), &adr_len) != 0) {
+		::close(m_listen_fd);
+		m_listen_fd = -1;
+		return false;
+	}
+	m_port = ntohs(adr.sin_port);
+
+	m_running = true;
+	m_accept_thread = std::thread(&Gateway::acceptLoop, this);
+	return true;
+}
+
+bool Gateway::startPoller() {
+	if (!m_running || m_poll_thread.joinable()) return false;
+	m_poll_thread = std::thread(&Gateway::pollLoop, this);
+	return true;
+}
+
+void Gateway::stop() {
+	if (!m_running.exchange(false)) return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_poll_cv.notify_all();
+	}
+	if (m_poll_thread.joinable()) m_poll_thread.join();
+	if (m_accept_thread.joinable()) m_accept_thread.join();
+	if (m_listen_fd >= 0) {
+		::close(m_listen_fd);
+		m_listen_fd = -1;
+	}
+
+	std::vector<std::unique_ptr<Client>> clients;
+	{
+		std::lock_guard<std::mutex> lock(m_clients_mtx);
+		for (const auto& c : m_clients) {
+			if (c->fd >= 0) ::shutdown(c->fd, SHUT_RDWR);
+		}
+		clients.swap(m_clients);
+	}
+	for (const auto& c : clients) c->thread.join();
+}
+
+void Gateway::reapClients() {
+	std::lock_guard<std::mutex> lock(m_clients_mtx);
+	for (auto it = m_clients.begin(); it != m_clients.end();) {
+		// Поток выставляет done под m_clients_mtx последним действием, поэтому join не блокируется
+		if ((*it)->done) {
+			(*it)->thread.join();
+			it = m_clients.erase(it);
+		}
+		else ++it;
+	}
+}
+
+void Gateway::acceptLoop() {
+	while (m_running) {
+		reapClients();
+		pollfd pfd = { m_listen_fd, POLLIN, 0 };
+		if (::poll(&pfd, 1, 200) <= 0) continue;
+
+		int fd = ::accept(m_listen_fd, nullptr, nullptr);
+		if (fd < 0) continue;
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		std::lock_guard<std::mutex> lock(m_clients_mtx);
+		std::unique_ptr<Client> client(new Client(fd));
+		client->thread = std::thread(&Gateway::clientLoop, this, client.get());
+		m_clients.push_back(std::move(client));
+	}
+}
+
+void Gateway::clientLoop(Client* client) {
+	const int fd = client->fd;
+	BYTE req[MODBUS_MAX_ADU_LENGTH];
+	BYTE resp[MODBUS_MAX_ADU_LENGTH];
+	MbapHeader header;
+
+	while (m_running) {
+		if (!readFull(fd, req, TCP_HEADER_SIZE, m_running)) break;
+		if (!mbapDecode(req, TCP_HEADER_SIZE, header)) break;
+		if (!readFull(fd, req + TCP_HEADER_SIZE, header.length - 1, m_running)) break;
+
+		size_t resp_len = handle(header.unit_id, req + TCP_HEADER_SIZE, header.length - 1, resp + TCP_HEADER_SIZE);
+		if (resp_len == 0) continue;
+		mbapEncode(resp, header.transaction_id, header.unit_id, resp_len);
+		if (!sendAll(fd, resp, TCP_HEADER_SIZE + resp_len)) break;
+	}
+
+	std::lock_guard<std::mutex> lock(m_clients_mtx);
+	::close(fd);
+	client->fd = -1;
+	client->done = true;
+}
+
+void Gateway::pollLoop() {
+	data::ScanScheduler scheduler;
+	std::vector<data::ScanRequest> requests;
+	std::vector<CacheRange*> targets;
+
+	size_t scheduled = 0;		// m_ranges только растет: диапазоны [0, scheduled) уже в расписании
+	std::vector<int> keys;
+	std::vector<std::vector<data::Range>> group_ranges;
+	std::vector<data::ScanGroup> groups;
+
+	// Новые диапазоны (все при запуске, затем добавленные addCacheRange) включаются в расписание
+	// заменой их групп, сроки остальных диапазонов сохраняются
+	auto scheduleNew = [&](uint64_t now) {
+		keys.clear();
+		for (; scheduled < m_ranges.size(); scheduled++) keys.push_back(keyOf(m_ranges[scheduled]->slave_id, m_ranges[scheduled]->func));
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		group_ranges.assign(keys.size(), std::vector<data::Range>());
+		groups.clear();
+		for (size_t i = 0; i < keys.size(); i++) {
+			// Диапазоны опрашиваются чаще ttl, чтобы клиенты получали данные из кэша
+			for (const CacheRange* r : m_index[keys[i]]) {
+				group_ranges[i].emplace_back(r->start_adr, r->end_adr, std::max<uint32_t>(1, r->ttl_ms * 3 / 4));
+			}
+			groups.push_back(data::ScanGroup{ keys[i] >> 8, keys[i] & 0xFF, &group_ranges[i] });
+		}
+		if (!groups.empty()) scheduler.replaceGroups(groups, 1, now);
+	};
+
+	std::unique_lock<std::mutex> lock(m_mtx);
+	while (m_running) {
+		uint64_t now = nowMs();
+		scheduleNew(now);
+		requests.clear();
+		scheduler.buildCycle(now, requests);
+
+		for (const data::ScanRequest& req : requests) {
+			if (!m_running) break;
+			auto it = m_index.find(keyOf(req.slave_id, req.func));
+			if (it == m_index.end()) continue;
+
+			// Пропускаем диапазоны, которые читаются сейчас или только что обновлены по запросу клиента
+			targets.clear();
+			uint32_t end = static_cast<uint32_t>(req.start) + req.quantity - 1;
+			for (CacheRange* r : it->second) {
+				if (r->start_adr < req.start || r->end_adr > end || r->inflight) continue;
+				if (r->valid && nowMs() - r->updated_ms < r->ttl_ms / 4) continue;
+				targets.push_back(r);
+			}
+			if (!targets.empty()) refreshSpan(lock, req.slave_id, static_cast<BYTE>(req.func), req.start, req.quantity, targets);
+		}
+
+		auto wake = [this, &scheduled] { return !m_running || scheduled != m_ranges.size(); };
+		uint64_t deadline = scheduler.nextDeadline();
+		// Нет диапазонов - ждем добавления или остановки, UINT64_MAX в time_point переполняется
+		if (deadline == std::numeric_limits<uint64_t>::max()) m_poll_cv.wait(lock, wake);
+		else m_poll_cv.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::milliseconds(deadline)), wake);
+	}
+}
+
+GatewayStats Gateway::getStats() const {
+	GatewayStats stats;
+	stats.tcp_requests = m_tcp_requests;
+	stats.cache_hits = m_cache_hits;
+	stats.serial_reads = m_serial_reads;
+	stats.collapsed = m_collapsed;
+	stats.passthrough = m_passthrough;
+	stats.errors = m_errors;
+	return stats;
+}
+
+} // modbus
+} // mb
@@ -0,0 +1,128 @@
+#ifndef MB_GATEWAY_H
+#define MB_GATEWAY_H
+
+#include "ModbusMaster.h"
+#include "Map.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mb {
+namespace modbus {
+
+/** @brief Счетчики шлюза */
+struct GatewayStats {
+	uint64_t tcp_requests;	// Запросы клиентов TCP
+	uint64_t cache_hits;		// Ответы из кэша без обращения к линии
+	uint64_t serial_reads;	// Транзакции чтения на линии RTU
+	uint64_t collapsed;		// Запросы, дождавшиеся уже выполняющегося чтения того же диапазона
+	uint64_t passthrough;	// Запросы, переданные на линию без кэша (записи и некэшируемые чтения)
+	uint64_t errors;			// Ответы исключением GATEWAY_PATH/GATEWAY_TARGET
+};
+
+/** @brief Шлюз Modbus TCP -> RTU с кэшированием ответов.
+	Чтения диапазонов, заданных addCacheRange, отдаются из карты памяти Map, пока данные свежее ttl_ms.
+	Устаревший диапазон перечитывается с линии одной транзакцией, параллельные запросы других
+	клиентов к тому же диапазону ждут ее результата, а не выдают свои транзакции.
+	Фоновый опросчик (startPoller) обновляет диапазоны заранее по планировщику ScanScheduler.
+	Записи передаются на линию и сбрасывают кэш пересекающихся диапазонов.
+	Неответ устройства - исключение EXCEPTION_GATEWAY_TARGET, линия недоступна - EXCEPTION_GATEWAY_PATH */
+class Gateway {
+public:
+	Gateway(ModbusMaster* rtu_master);
+	~Gateway();
+
+	// Кэшируемый диапазон [start_adr-end_adr] функции чтения func (1-4), можно добавлять и после startPoller
+	bool addCacheRange(const int slave_id, const BYTE func, const WORD start_adr, const WORD end_adr, const uint32_t ttl_ms);
+
+	// Запуск сервера TCP, port = 0 - выбрать свободный порт (см. getPort)
+	bool start(const std::string& bind_adr, const uint16_t port);
+	// Запуск фонового опроса кэшируемых диапазонов
+	bool startPoller();
+	void stop();
+
+	// Обработка PDU запроса клиента, возвращает длину PDU ответа
+	size_t handle(const BYTE unit_id, const BYTE* req_pdu, const size_t req_len, BYTE* resp_pdu);
+
+	uint16_t getPort() const { return m_port; }
+	GatewayStats getStats() const;
+
+private:
+	struct CacheRange {
+		int slave_id;
+		BYTE func;
+		WORD start_adr;
+		WORD end_adr;
+		uint32_t ttl_ms;
+		data::Map map;
+		uint64_t updated_ms = 0;
+		bool valid = false;
+		bool inflight = false;								// Идет чтение с линии
+		uint32_t generation = 0;							// Увеличивается при каждом сбросе кэша записью
+		uint32_t read_generation = 0;						// Поколение на момент начала чтения с линии
+		MbStatus last_status = MbStatus::OK;
+		ModbusExceptionCode last_exception = ModbusExceptionCode::EXCEPTION_NOT_DEFINED;
+		std::condition_variable cv;						// Ожидание завершения чтения
+
+		CacheRange(WORD start, WORD quantity) : map(start, quantity) {}
+	};
+
+	/** @brief Поток обслуживания клиента TCP, завершившийся поток освобождается в acceptLoop */
+	struct Client {
+		int fd;
+		bool done = false;
+		std::thread thread;
+
+		Client(int client_fd) : fd(client_fd) {}
+	};
+
+	static int keyOf(const int slave_id, const BYTE func) { return (slave_id << 8) | func; }
+
+	CacheRange* findRange(const int slave_id, const BYTE func, const WORD adr, const WORD quantity);
+	// Чтение диапазона с линии и раскладка по картам targets, вызывается с захваченным m_mtx
+	void refreshSpan(std::unique_lock<std::mutex>& lock, const int slave_id, const BYTE func, const WORD start_adr, const WORD quantity, std::vector<CacheRange*>& targets);
+	void invalidate(const int slave_id, const BYTE func, const WORD start_adr, const WORD quantity);
+
+	size_t handleRead(const BYTE unit_id, const BYTE func, const WORD adr, const WORD quantity, BYTE* resp);
+	size_t handlePassthrough(const BYTE unit_id, const BYTE* req, const size_t req_len, BYTE* resp);
+	size_t statusResponse(const BYTE func, const MbStatus status, const ModbusExceptionCode exception, BYTE* resp);
+
+	void acceptLoop();
+	void clientLoop(Client* client);
+	void reapClients();
+	void pollLoop();
+
+	ModbusMaster* m_master;
+
+	std::vector<std::unique_ptr<CacheRange>> m_ranges;
+	std::unordered_map<int, std::vector<CacheRange*>> m_index;	// (slave_id, func) -> диапазоны
+	std::mutex m_mtx;															// Мьютекс кэша
+	std::mutex m_line_mtx;													// Мьютекс линии RTU (транзакция + код исключения)
+
+	int m_listen_fd;
+	uint16_t m_port;
+	std::atomic<bool> m_running;
+	std::thread m_accept_thread;
+	std::thread m_poll_thread;
+	std::condition_variable m_poll_cv;
+	std::vector<std::unique_ptr<Client>> m_clients;
+	std::mutex m_clients_mtx;
+
+	std::atomic<uint64_t> m_tcp_requests;
+	std::atomic<uint64_t> m_cache_hits;
+	std::atomic<uint64_t> m_serial_reads;
+	std::atomic<uint64_t> m_collapsed;
+	std::atomic<uint64_t> m_passthrough;
+	std::atomic<uint64_t> m_errors;
+};
+
+} // modbus
+} // mb
+
+#endif // MB_GATEWAY_H
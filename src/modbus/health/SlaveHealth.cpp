@@ -0,0 +1,216 @@
+#include "SlaveHealth.h"
+
+#include <algorithm>
+
+namespace mb {
+namespace modbus {
+
+/* RttHistogram */
+
+int RttHistogram::bucketOf(uint32_t us) {
+	if (us < SUB_COUNT) return us;
+	int msb = 31 - __builtin_clz(us);
+	int shift = msb - SUB_BITS;
+	int sub = (us >> shift) & (SUB_COUNT - 1);
+	return (shift + 1) * SUB_COUNT + sub;
+}
+
+uint32_t RttHistogram::bucketUpper(int bucket) {
+	if (bucket < SUB_COUNT) return bucket;
+	int shift = bucket / SUB_COUNT - 1;
+	int sub = bucket % SUB_COUNT;
+	uint64_t lower = static_cast<uint64_t>(SUB_COUNT + sub) << shift;
+	return static_cast<uint32_t>(std::min<uint64_t>(lower + (1ull << shift) - 1, UINT32_MAX));
+}
+
+void RttHistogram::record(uint32_t us) {
+	// Окно заполнено - "старим" статистику
+	if (m_count >= WINDOW) {
+		m_count = 0;
+		for (uint32_t& b : m_buckets) {
+			b >>= 1;
+			m_count += b;
+		}
+	}
+	++m_buckets[bucketOf(us)];
+	++m_count;
+}
+
+uint32_t RttHistogram::percentile(double p) const {
+	if (m_count == 0) return 0;
+	uint64_t rank = static_cast<uint64_t>(p * m_count + 0.5);
+	if (rank == 0) rank = 1;
+	uint64_t acc = 0;
+	for (int i = 0; i < BUCKETS; i++) {
+		acc += m_buckets[i];
+		if (acc >= rank) return bucketUpper(i);
+	}
+	return bucketUpper(BUCKETS - 1);
+}
+
+void RttHistogram::reset() {
+	m_buckets.fill(0);
+	m_count = 0;
+}
+
+/* SlaveHealth */
+
+SlaveHealth::SlaveHealth() : SlaveHealth(HealthConfig()) {}
+
+SlaveHealth::SlaveHealth(const HealthConfig& config) : m_config(config) {
+	for (Slave& s : m_slaves) initSlave(s);
+}
+
+void SlaveHealth::initSlave(Slave& s) const {
+	s = Slave();
+	s.timeout_ms = m_config.initial_timeout_ms;
+	s.learned_ms = m_config.initial_timeout_ms;
+}
+
+bool SlaveHealth::shouldPoll(const int slave_id, const uint64_t now_ms) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (!isValid(slave_id)) return false;
+	Slave& s = m_slaves[slave_id];
+
+	if (s.state != SlaveState::OFFLINE) return true;
+
+	// Результат пробного запроса не сообщен за время таймаута (запрос потерян вызывающим) - считаем его неудачным
+	if (s.probing && now_ms >= s.probe_ms + m_config.max_timeout_ms) {
+		++s.requests;
+		++s.timeouts;
+		failed(s, now_ms);
+	}
+
+	// Пробный запрос по сроку, до получения его результата новые не выдаются
+	if (!s.probing && now_ms >= s.next_probe_ms) {
+		s.probing = true;
+		s.probe_ms = now_ms;
+		return true;
+	}
+	++s.skipped;
+	return false;
+}
+
+uint32_t SlaveHealth::timeoutMs(const int slave_id) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (!isValid(slave_id)) return m_config.initial_timeout_ms;
+	const Slave& s = m_slaves[slave_id];
+	// Пробный запрос ждет ответа максимально долго: устройство могло стать медленнее выученного таймаута
+	if (s.state == SlaveState::OFFLINE) return m_config.max_timeout_ms;
+	return s.timeout_ms;
+}
+
+uint32_t SlaveHealth::clampTimeout(const uint64_t timeout_ms) const {
+	return static_cast<uint32_t>(std::min<uint64_t>(std::max<uint64_t>(timeout_ms, m_config.min_timeout_ms), m_config.max_timeout_ms));
+}
+
+void SlaveHealth::updateTimeout(Slave& s) {
+	if (s.rtt.count() < m_config.min_samples) return;
+	uint64_t p99_ms = (s.rtt.percentile(0.99) + 999) / 1000;
+	s.learned_ms = clampTimeout(static_cast<uint64_t>(p99_ms * m_config.timeout_factor) + m_config.timeout_margin_ms);
+	s.timeout_ms = s.learned_ms;
+}
+
+void SlaveHealth::answered(Slave& s, const uint32_t rtt_us, const uint64_t now_ms) {
+	++s.requests;
+	s.last_seen_ms = now_ms;
+	const uint64_t rtt_ms = (static_cast<uint64_t>(rtt_us) + 999) / 1000;
+	if (rtt_ms > s.learned_ms) {
+		// Ответ дольше выученного таймаута (получен расширенным или пробным запросом) - задержка устройства изменилась.
+		// Прежняя статистика отбрасывается, до накопления min_samples таймаут задается по этому ответу
+		s.rtt.reset();
+		s.learned_ms = clampTimeout(static_cast<uint64_t>(rtt_ms * m_config.timeout_factor) + m_config.timeout_margin_ms);
+		s.timeout_ms = s.learned_ms;
+	}
+	s.rtt.record(rtt_us);
+	s.fails = 0;
+	s.backoff_ms = 0;
+	s.probing = false;
+	s.state = SlaveState::ONLINE;
+	updateTimeout(s);
+}
+
+void SlaveHealth::onResponse(const int slave_id, const uint32_t rtt_us, const uint64_t now_ms) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (!isValid(slave_id)) return;
+	answered(m_slaves[slave_id], rtt_us, now_ms);
+}
+
+void SlaveHealth::onException(const int slave_id, const uint32_t rtt_us, const uint64_t now_ms) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (!isValid(slave_id)) return;
+	Slave& s = m_slaves[slave_id];
+	answered(s, rtt_us, now_ms);
+	++s.exceptions;
+}
+
+void SlaveHealth::onTimeout(const int slave_id, const uint64_t now_ms) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (!isValid(slave_id)) return;
+	Slave& s = m_slaves[slave_id];
+	++s.requests;
+	++s.timeouts;
+	// Таймаут подряд - ожидание расширяется, чтобы дождаться ответа замедлившегося устройства
+	if (s.state != SlaveState::OFFLINE) s.timeout_ms = clampTimeout(static_cast<uint64_t>(s.timeout_ms) * 2);
+	failed(s, now_ms);
+}
+
+void SlaveHealth::onFailure(const int slave_id, const uint64_t now_ms) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (!isValid(slave_id)) return;
+	Slave& s = m_slaves[slave_id];
+	++s.requests;
+	++s.errors;
+	failed(s, now_ms);
+}
+
+void SlaveHealth::failed(Slave& s, const uint64_t now_ms) {
+	++s.fails;
+	s.probing = false;
+
+	if (s.state == SlaveState::OFFLINE) {
+		// Неудачный пробный запрос - удваиваем задержку
+		s.backoff_ms = std::min<uint64_t>(static_cast<uint64_t>(s.backoff_ms) * 2, m_config.backoff_max_ms);
+	}
+	else if (s.fails >= m_config.fail_threshold) {
+		s.state = SlaveState::OFFLINE;
+		s.backoff_ms = m_config.backoff_base_ms;
+	}
+	else {
+		s.state = SlaveState::SUSPECT;
+		return;
+	}
+	s.next_probe_ms = now_ms + s.backoff_ms;
+}
+
+SlaveState SlaveHealth::getState(const int slave_id) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (!isValid(slave_id)) return SlaveState::OFFLINE;
+	return m_slaves[slave_id].state;
+}
+
+bool SlaveHealth::getStats(const int slave_id, SlaveStats& stats) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (!isValid(slave_id)) return false;
+	const Slave& s = m_slaves[slave_id];
+	stats.state = s.state;
+	stats.timeout_ms = s.timeout_ms;
+	stats.p50_us = s.rtt.percentile(0.5);
+	stats.p99_us = s.rtt.percentile(0.99);
+	stats.requests = s.requests;
+	stats.timeouts = s.timeouts;
+	stats.errors = s.errors;
+	stats.exceptions = s.exceptions;
+	stats.skipped = s.skipped;
+	stats.last_seen_ms = s.last_seen_ms;
+	return true;
+}
+
+void SlaveHealth::reset(const int slave_id) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (!isValid(slave_id)) return;
+	initSlave(m_slaves[slave_id]);
+}
+
+} // modbus
+} // mb
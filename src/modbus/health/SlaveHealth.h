@@ -0,0 +1,136 @@
+#ifndef MB_SLAVE_HEALTH_H
+#define MB_SLAVE_HEALTH_H
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+namespace mb {
+namespace modbus {
+
+#define MAX_SLAVE_ID 247
+
+/** @brief Состояние устройства на линии */
+enum class SlaveState {
+	ONLINE,		// Отвечает
+	SUSPECT,		// Есть подряд идущие неответы, но порог не превышен, опрос продолжается
+	OFFLINE,		// Исключено из опроса, опрашивается пробными запросами с экспоненциальной задержкой
+};
+
+/** @brief Параметры адаптивного опроса */
+struct HealthConfig {
+	uint32_t initial_timeout_ms = 500;	// Таймаут до накопления статистики RTT
+	uint32_t min_timeout_ms = 20;
+	uint32_t max_timeout_ms = 2000;
+	double timeout_factor = 1.5;			// Таймаут = p99 RTT * timeout_factor + timeout_margin_ms
+	uint32_t timeout_margin_ms = 10;
+	uint32_t min_samples = 16;				// Минимум замеров RTT для адаптивного таймаута
+	uint32_t fail_threshold = 3;			// Количество неответов подряд для перевода в OFFLINE
+	uint32_t backoff_base_ms = 1000;		// Первая задержка пробного запроса
+	uint32_t backoff_max_ms = 60000;		// Максимальная задержка пробного запроса
+};
+
+/** @brief Гистограмма RTT в микросекундах с логарифмическими корзинами (HDR-подобная).
+	Каждая степень двойки делится на 8 под-корзин, относительная погрешность перцентиля не более 12.5%.
+	При переполнении окна счетчики делятся пополам, поэтому старые замеры постепенно забываются */
+class RttHistogram {
+public:
+	static constexpr int SUB_BITS = 3;
+	static constexpr int SUB_COUNT = 1 << SUB_BITS;
+	static constexpr int BUCKETS = (32 - SUB_BITS + 1) * SUB_COUNT;
+	static constexpr uint32_t WINDOW = 1024;
+
+	RttHistogram() { reset(); }
+
+	void record(uint32_t us);
+	uint32_t percentile(double p) const; // Верхняя граница корзины, в которую попал перцентиль p (0..1)
+	uint32_t count() const { return m_count; }
+	void reset();
+
+	static int bucketOf(uint32_t us);
+	static uint32_t bucketUpper(int bucket);
+
+private:
+	std::array<uint32_t, BUCKETS> m_buckets;
+	uint32_t m_count;
+};
+
+/** @brief Статистика устройства для вывода */
+struct SlaveStats {
+	SlaveState state;
+	uint32_t timeout_ms;
+	uint32_t p50_us;
+	uint32_t p99_us;
+	uint64_t requests;
+	uint64_t timeouts;
+	uint64_t errors;		// Искаженные ответы и ошибки ввода-вывода (CRC, неверный ответ, обрыв соединения)
+	uint64_t exceptions;
+	uint64_t skipped;		// Пропущенные циклы опроса, пока устройство было OFFLINE
+	uint64_t last_seen_ms;	// Время последнего ответа, 0 - ответов не было
+};
+
+/** @brief Состояние "здоровья" устройств линии.
+	Неотвечающее устройство после fail_threshold неответов исключается из опроса и опрашивается
+	только пробными запросами с экспоненциально растущей задержкой, таймаут каждого устройства
+	подстраивается по p99 RTT, поэтому одно мертвое устройство не съедает время цикла остальных.
+	Ответ исключением (Rx:01 83 01 80 F0) считается ответом - устройство на связи,
+	искаженный ответ или ошибка ввода-вывода считается неответом так же, как таймаут.
+	Каждый таймаут подряд удваивает таймаут устройства (до max_timeout_ms), пробные запросы идут с max_timeout_ms,
+	поэтому замедлившееся устройство не остается OFFLINE из-за таймаута, выученного по прежним ответам */
+class SlaveHealth {
+public:
+	SlaveHealth();
+	SlaveHealth(const HealthConfig& config);
+	~SlaveHealth() {}
+
+	// Нужно ли опрашивать устройство сейчас, для OFFLINE устройства разрешается один пробный запрос по сроку
+	bool shouldPoll(const int slave_id, const uint64_t now_ms);
+	// Текущий таймаут ответа для устройства, для пробного запроса OFFLINE устройства - max_timeout_ms
+	uint32_t timeoutMs(const int slave_id);
+
+	void onResponse(const int slave_id, const uint32_t rtt_us, const uint64_t now_ms);
+	void onException(const int slave_id, const uint32_t rtt_us, const uint64_t now_ms);
+	void onTimeout(const int slave_id, const uint64_t now_ms);
+	// Искаженный ответ (CRC_ERROR, BAD_RESPONSE) или ошибка ввода-вывода
+	void onFailure(const int slave_id, const uint64_t now_ms);
+
+	SlaveState getState(const int slave_id);
+	bool getStats(const int slave_id, SlaveStats& stats);
+	void reset(const int slave_id);
+
+private:
+	struct Slave {
+		SlaveState state = SlaveState::ONLINE;
+		RttHistogram rtt;
+		uint32_t timeout_ms = 0;			// Действующий таймаут, расширяется при таймаутах подряд
+		uint32_t learned_ms = 0;			// Таймаут по статистике RTT
+		uint32_t fails = 0;			// Неответы подряд
+		uint32_t backoff_ms = 0;		// Текущая задержка пробного запроса
+		uint64_t next_probe_ms = 0;
+		uint64_t probe_ms = 0;			// Время выдачи пробного запроса
+		bool probing = false;			// Пробный запрос выдан, ожидается результат
+		uint64_t last_seen_ms = 0;
+		uint64_t requests = 0;
+		uint64_t timeouts = 0;
+		uint64_t errors = 0;
+		uint64_t exceptions = 0;
+		uint64_t skipped = 0;
+	};
+
+	bool isValid(const int slave_id) const { return slave_id >= 0 && slave_id <= MAX_SLAVE_ID; }
+	void answered(Slave& s, const uint32_t rtt_us, const uint64_t now_ms);
+	void failed(Slave& s, const uint64_t now_ms);
+	void updateTimeout(Slave& s);
+	uint32_t clampTimeout(const uint64_t timeout_ms) const;
+	void initSlave(Slave& s) const;
+
+	HealthConfig m_config;
+	std::array<Slave, MAX_SLAVE_ID + 1> m_slaves;
+
+	std::mutex m_mtx;		// Мьютекс для чтения статистики из других потоков
+};
+
+} // modbus
+} // mb
+
+#endif // MB_SLAVE_HEALTH_H
@@ -0,0 +1,99 @@
+#ifndef MB_MODBUS_DEFS_H
+#define MB_MODBUS_DEFS_H
+
+#include <cstdint>
+
+namespace mb {
+namespace modbus {
+
+#define WORD_BIT_SIZE 16
+#define DWORD_BIT_SIZE 32
+
+#define DWORD  uint32_t
+#define WORD   uint16_t
+#define BYTE   uint8_t
+#define BIT    uint8_t
+
+#define MAX_RTU_PACKAGE_SIZE 256
+#define MAX_RTU_BYTE_COUNT 252
+
+#define MAX_TCP_PACKAGE_SIZE 260
+#define MAX_TCP_BYTE_COUNT 260
+
+#define MODBUS_MAX_READ_BITS  2000
+#define MODBUS_MAX_WRITE_BITS 1968
+
+#define MODBUS_MAX_READ_REGISTERS     125
+#define MODBUS_MAX_WRITE_REGISTERS    123
+
+#define MODBUS_MAX_PDU_LENGTH 253
+
+#define MODBUS_MAX_ADU_LENGTH 260
+
+/* Protocol exceptions */
+enum class ModbusExceptionCode {
+    EXCEPTION_ILLEGAL_FUNCTION = 0x01,
+    EXCEPTION_ILLEGAL_DATA_ADDRESS,
+    EXCEPTION_ILLEGAL_DATA_VALUE,
+    EXCEPTION_SLAVE_OR_SERVER_FAILURE,
+    EXCEPTION_ACKNOWLEDGE,
+    EXCEPTION_SLAVE_OR_SERVER_BUSY,
+    EXCEPTION_NEGATIVE_ACKNOWLEDGE,
+    EXCEPTION_MEMORY_PARITY,
+    EXCEPTION_NOT_DEFINED,
+    EXCEPTION_GATEWAY_PATH,
+    EXCEPTION_GATEWAY_TARGET,
+    EXCEPTION_MAX
+};
+
+
+// Задаваемые пользователем (user-defined function codes) - 65...72, 100...110. Эти коды не описаны в спецификации стандарта и могут использоваться в конкретных изделиях для собственных функций.
+// Зарезервированные (reserved). В эту группу входят коды 9, 10, 13, 14, 41, 42, 90, 91, 125, 126 и 127.
+
+/*
+0x01 (1) - чтение значений из нескольких регистров флагов - Read Coil Status.
+0x02 (2) - чтение значений из нескольких дискретных входов - Read Discrete Inputs.
+0x03 (3) - чтение значений из нескольких регистров хранения - Read Holding Registers.
+0x04 (4) - чтение значений из нескольких регистров ввода - Read Input Registers.
+0x05 (5) - запись значения одного флага - Force Single Coil.
+0x06 (6) - запись значения в один регистр хранения - Preset Single Register.
+0x07 (7) - чтение сигналов состояния - Read Exception Status.
+0x08 (8) - диагностика - Diagnostic.
+0x0B (11) - чтение счетчика событий - Get Com Event Counter.
+0x0C (12) - чтение журнала событий - Get Com Event Log.
+0x0F (15) - запись значений в несколько регистров флагов - Force Multiple Coils.
+0x10 (16) - запись значений в несколько регистров хранения - Preset Multiple Registers.
+0x11 (17) - чтение информации об устройстве - Report Slave ID.
+0x14 (20) - чтение из файла - Read File Record.
+0x15 (21) - запись в файл - Write File Record.
+0x16 (22) - запись в один регистр хранения с использованием маски "И" и маски "ИЛИ" - Mask Write Register.
+0x18 (24) - чтение данных из очереди - Read FIFO Queue.
+0x2B (43) - Encapsulated Interface Transport.
+*/
+
+enum class ModbusFunc {
+    F_01 = 1, // Read Coil Status
+    F_02 = 2, // Read Input Status
+    F_03 = 3, // Read Holding Registers
+    F_04 = 4, // Read Input Registers
+    F_05 = 5, // Write Single Coil
+    F_06 = 6, // Write Single Register
+    F_15 = 15, // Write Multiple Coils
+    F_16 = 16, // Write Multiple Registers
+};
+
+enum class ModbusFuncError {
+    F_ERR_01 = 129, // Error Read Coil Status
+    F_ERR_02 = 130, // Error Read Input Status
+    F_ERR_03 = 131, // Error Read Holding Registers
+    F_ERR_04 = 132, // Error Read Input Registers
+    F_ERR_05 = 133, // Error Write Single Coil
+    F_ERR_06 = 134, // Error Write Single Register
+    F_ERR_15 = 143, // Error Write Multiple Coils
+    F_ERR_16 = 144, // Error Write Multiple Registers
+};
+
+} // modbus
+} // mb
+
+#endif // MB_MODBUS_DEFS_H
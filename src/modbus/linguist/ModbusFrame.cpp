@@ -0,0 +1,168 @@
+#include "ModbusFrame.h"
+
+#include <cstring>
+
+namespace mb {
+namespace modbus {
+
+// Таблица CRC16 для полинома 0xA001, строится при компиляции
+struct CrcTable {
+	WORD v[256];
+	constexpr CrcTable() : v() {
+		for (int i = 0; i < 256; i++) {
+			WORD crc = i;
+			for (int j = 0; j < 8; j++) crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+			v[i] = crc;
+		}
+	}
+};
+
+static constexpr CrcTable crc_table;
+
+WORD crc16(const BYTE* buf, size_t len) {
+	WORD crc = 0xFFFF;
+	for (size_t i = 0; i < len; i++) crc = (crc >> 8) ^ crc_table.v[(crc ^ buf[i]) & 0xFF];
+	return crc;
+}
+
+size_t rtuFinish(BYTE* adu, size_t len) {
+	WORD crc = crc16(adu, len);
+	adu[len] = crc & 0xFF;
+	adu[len + 1] = crc >> 8;
+	return len + RTU_CRC_SIZE;
+}
+
+bool rtuCheck(const BYTE* adu, size_t len) {
+	if (len < RTU_HEADER_SIZE + 1 + RTU_CRC_SIZE) return false;
+	WORD crc = crc16(adu, len - RTU_CRC_SIZE);
+	return adu[len - 2] == (crc & 0xFF) && adu[len - 1] == (crc >> 8);
+}
+
+size_t rtuRequestLength(const BYTE* adu, size_t have) {
+	if (have < 2) return 0;
+	switch (adu[1]) {
+		case 1: case 2: case 3: case 4: case 5: case 6:
+			return 8;
+		case 15: case 16:
+			if (have < 7) return 0;
+			return 7 + adu[6] + RTU_CRC_SIZE;
+		default:
+			// Неизвестная функция - ответим исключением, кадр считаем минимальным
+			return 8;
+	}
+}
+
+size_t rtuResponseLength(const BYTE* adu, size_t have) {
+	if (have < 2) return 0;
+	BYTE func = adu[1];
+	if (func & 0x80) return 5;
+	switch (func) {
+		case 1: case 2: case 3: case 4:
+			if (have < 3) return 0;
+			return 3 + adu[2] + RTU_CRC_SIZE;
+		case 5: case 6: case 15: case 16:
+			return 8;
+		default:
+			return 0;
+	}
+}
+
+void mbapEncode(BYTE* adu, WORD transaction_id, BYTE unit_id, size_t pdu_len) {
+	putWordBE(adu, transaction_id);
+	putWordBE(adu + 2, 0);
+	putWordBE(adu + 4, static_cast<WORD>(pdu_len + 1));
+	adu[6] = unit_id;
+}
+
+bool mbapDecode(const BYTE* adu, size_t len, MbapHeader& header) {
+	if (len < TCP_HEADER_SIZE) return false;
+	header.transaction_id = getWordBE(adu);
+	header.protocol_id = getWordBE(adu + 2);
+	header.length = getWordBE(adu + 4);
+	header.unit_id = adu[6];
+	return header.protocol_id == 0 && header.length >= 2 && header.length <= MODBUS_MAX_PDU_LENGTH + 1;
+}
+
+size_t pduReadRequest(BYTE* pdu, BYTE func, WORD start_adr, WORD quantity) {
+	pdu[0] = func;
+	putWordBE(pdu + 1, start_adr);
+	putWordBE(pdu + 3, quantity);
+	return 5;
+}
+
+size_t pduWriteSingle(BYTE* pdu, BYTE func, WORD adr, WORD val) {
+	pdu[0] = func;
+	putWordBE(pdu + 1, adr);
+	if (func == static_cast<BYTE>(ModbusFunc::F_05)) val = val ? 0xFF00 : 0x0000;
+	putWordBE(pdu + 3, val);
+	return 5;
+}
+
+void packBits(const BIT* vals, WORD quantity, BYTE* out) {
+	size_t bytes = (quantity + 7) / 8;
+	memset(out, 0, bytes);
+	for (WORD i = 0; i < quantity; i++) {
+		if (vals[i]) out[i >> 3] |= 1 << (i & 7);
+	}
+}
+
+void unpackBits(const BYTE* in, WORD quantity, BIT* vals) {
+	for (WORD i = 0; i < quantity; i++) vals[i] = (in[i >> 3] >> (i & 7)) & 1;
+}
+
+size_t pduWriteBits(BYTE* pdu, WORD start_adr, WORD quantity, const BIT* vals) {
+	BYTE byte_count = static_cast<BYTE>((quantity + 7) / 8);
+	pdu[0] = static_cast<BYTE>(ModbusFunc::F_15);
+	putWordBE(pdu + 1, start_adr);
+	putWordBE(pdu + 3, quantity);
+	pdu[5] = byte_count;
+	packBits(vals, quantity, pdu + 6);
+	return 6 + byte_count;
+}
+
+size_t pduWriteWords(BYTE* pdu, WORD start_adr, WORD quantity, const WORD* vals) {
+	pdu[0] = static_cast<BYTE>(ModbusFunc::F_16);
+	putWordBE(pdu + 1, start_adr);
+	putWordBE(pdu + 3, quantity);
+	pdu[5] = static_cast<BYTE>(quantity * 2);
+	for (WORD i = 0; i < quantity; i++) putWordBE(pdu + 6 + i * 2, vals[i]);
+	return 6 + quantity * 2;
+}
+
+size_t pduException(BYTE* pdu, BYTE func, ModbusExceptionCode code) {
+	pdu[0] = func | 0x80;
+	pdu[1] = static_cast<BYTE>(code);
+	return 2;
+}
+
+size_t pduReadBitsResponse(BYTE* pdu, BYTE func, WORD quantity, const BIT* vals) {
+	BYTE byte_count = static_cast<BYTE>((quantity + 7) / 8);
+	pdu[0] = func;
+	pdu[1] = byte_count;
+	packBits(vals, quantity, pdu + 2);
+	return 2 + byte_count;
+}
+
+size_t pduReadWordsResponse(BYTE* pdu, BYTE func, WORD quantity, const WORD* vals) {
+	pdu[0] = func;
+	pdu[1] = static_cast<BYTE>(quantity * 2);
+	for (WORD i = 0; i < quantity; i++) putWordBE(pdu + 2 + i * 2, vals[i]);
+	return 2 + quantity * 2;
+}
+
+bool pduParseBits(const BYTE* pdu, size_t len, BYTE func, WORD quantity, BIT* vals) {
+	size_t byte_count = (quantity + 7) / 8;
+	if (len < 2 || pdu[0] != func || pdu[1] != byte_count || len < 2 + byte_count) return false;
+	unpackBits(pdu + 2, quantity, vals);
+	return true;
+}
+
+bool pduParseWords(const BYTE* pdu, size_t len, BYTE func, WORD quantity, WORD* vals) {
+	size_t byte_count = quantity * 2;
+	if (len < 2 || pdu[0] != func || pdu[1] != byte_count || len < 2 + byte_count) return false;
+	for (WORD i = 0; i < quantity; i++) vals[i] = getWordBE(pdu + 2 + i * 2);
+	return true;
+}
+
+} // modbus
+} // mb
@@ -0,0 +1,76 @@
+#ifndef MB_MODBUS_FRAME_H
+#define MB_MODBUS_FRAME_H
+
+#include "ModbusDefs.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mb {
+namespace modbus {
+
+/** @brief Кодирование и разбор кадров Modbus без копирования.
+	Все функции работают с буферами вызывающего кода: PDU собирается сразу на своем месте
+	внутри ADU (после адреса устройства RTU или заголовка MBAP), затем дописывается CRC или заголовок */
+
+// RTU:  [slave][PDU ...][CRC lo][CRC hi]
+// TCP:  [tid hi][tid lo][pid hi][pid lo][len hi][len lo][unit][PDU ...]
+
+#define RTU_HEADER_SIZE 1
+#define RTU_CRC_SIZE 2
+#define TCP_HEADER_SIZE 7
+
+/** @brief Заголовок MBAP Modbus TCP */
+struct MbapHeader {
+	WORD transaction_id;
+	WORD protocol_id;
+	WORD length;			// Количество байт после поля length (unit + PDU)
+	BYTE unit_id;
+};
+
+inline WORD getWordBE(const BYTE* p) { return static_cast<WORD>((p[0] << 8) | p[1]); }
+inline void putWordBE(BYTE* p, WORD v) { p[0] = v >> 8; p[1] = v & 0xFF; }
+
+inline bool isReadFunc(BYTE func) { return func >= 1 && func <= 4; }
+inline bool isBitFunc(BYTE func) { return func == 1 || func == 2 || func == 5 || func == 15; }
+inline bool isExceptionPdu(const BYTE* pdu) { return (pdu[0] & 0x80) != 0; }
+
+// CRC16 Modbus (полином 0xA001, начальное значение 0xFFFF)
+WORD crc16(const BYTE* buf, size_t len);
+
+/* RTU */
+// Дописывает CRC к кадру длиной len, возвращает полную длину кадра
+size_t rtuFinish(BYTE* adu, size_t len);
+// Проверка CRC кадра полной длины
+bool rtuCheck(const BYTE* adu, size_t len);
+// Ожидаемая длина кадра запроса/ответа по уже принятым байтам, 0 - принятых байт недостаточно для определения
+size_t rtuRequestLength(const BYTE* adu, size_t have);
+size_t rtuResponseLength(const BYTE* adu, size_t have);
+
+/* TCP */
+void mbapEncode(BYTE* adu, WORD transaction_id, BYTE unit_id, size_t pdu_len);
+bool mbapDecode(const BYTE* adu, size_t len, MbapHeader& header);
+
+/* PDU запросов */
+size_t pduReadRequest(BYTE* pdu, BYTE func, WORD start_adr, WORD quantity);
+size_t pduWriteSingle(BYTE* pdu, BYTE func, WORD adr, WORD val);	// Для F_05 val > 0 кодируется как 0xFF00
+size_t pduWriteBits(BYTE* pdu, WORD start_adr, WORD quantity, const BIT* vals);
+size_t pduWriteWords(BYTE* pdu, WORD start_adr, WORD quantity, const WORD* vals);
+
+/* PDU ответов */
+size_t pduException(BYTE* pdu, BYTE func, ModbusExceptionCode code);
+size_t pduReadBitsResponse(BYTE* pdu, BYTE func, WORD quantity, const BIT* vals);
+size_t pduReadWordsResponse(BYTE* pdu, BYTE func, WORD quantity, const WORD* vals);
+
+// Разбор ответа на чтение, проверяется функция и количество байт
+bool pduParseBits(const BYTE* pdu, size_t len, BYTE func, WORD quantity, BIT* vals);
+bool pduParseWords(const BYTE* pdu, size_t len, BYTE func, WORD quantity, WORD* vals);
+
+// Упаковка/распаковка битов в байты Modbus (младший бит - первый адрес)
+void packBits(const BIT* vals, WORD quantity, BYTE* out);
+void unpackBits(const BYTE* in, WORD quantity, BIT* vals);
+
+} // modbus
+} // mb
+
+#endif // MB_MODBUS_FRAME_H
@@ -0,0 +1,190 @@
+#include "ModbusMaster.h"
+
+#include <chrono>
+
+namespace mb {
+namespace modbus {
+
+static uint64_t nowUs() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ModbusMaster::ModbusMaster(Transport* transport, SlaveHealth* health) : m_transport(transport),
+																								m_health(health),
+																								m_metrics(nullptr),
+																								m_timeout_ms(500),
+																								m_last_exception(ModbusExceptionCode::EXCEPTION_NOT_DEFINED),
+																								m_transactions(0) {}
+
+void ModbusMaster::setTimeout(uint32_t timeout_ms) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_timeout_ms = timeout_ms;
+}
+
+void ModbusMaster::setMetrics(metrics::Metrics* metrics) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_metrics = metrics;
+}
+
+static metrics::Counter statusCounter(MbStatus status) {
+	switch (status) {
+		case MbStatus::OK: return metrics::Counter::RESPONSES;
+		case MbStatus::EXCEPTION: return metrics::Counter::EXCEPTIONS;
+		case MbStatus::TIMEOUT: return metrics::Counter::TIMEOUTS;
+		case MbStatus::CRC_ERROR: return metrics::Counter::CRC_ERRORS;
+		case MbStatus::BAD_RESPONSE: return metrics::Counter::BAD_RESPONSES;
+		case MbStatus::SKIPPED: return metrics::Counter::SKIPPED;
+		default: return metrics::Counter::IO_ERRORS;
+	}
+}
+
+MbStatus ModbusMaster::execute(const int slave_id, const size_t pdu_len, const BYTE** resp_pdu, size_t* resp_len) {
+	uint64_t start_us = nowUs();
+	uint32_t timeout_ms = m_timeout_ms;
+	const BYTE func = m_transport->txPdu()[0];
+
+	if (m_health) {
+		if (!m_health->shouldPoll(slave_id, start_us / 1000)) {
+			if (m_metrics) m_metrics->add(slave_id, func, metrics::Counter::SKIPPED);
+			return MbStatus::SKIPPED;
+		}
+		timeout_ms = m_health->timeoutMs(slave_id);
+	}
+
+	MbStatus status = m_transport->transact(static_cast<BYTE>(slave_id), pdu_len, resp_pdu, resp_len, timeout_ms);
+	++m_transactions;
+
+	uint64_t end_us = nowUs();
+	uint32_t rtt_us = static_cast<uint32_t>(end_us - start_us);
+
+	if (status == MbStatus::EXCEPTION) m_last_exception = static_cast<ModbusExceptionCode>((*resp_pdu)[1]);
+
+	if (m_metrics) {
+		const bool answered = status == MbStatus::OK || status == MbStatus::EXCEPTION;
+		m_metrics->onTransaction(slave_id, func, statusCounter(status), rtt_us, static_cast<uint32_t>(pdu_len), answered ? static_cast<uint32_t>(*resp_len) : 0);
+		if (status == MbStatus::EXCEPTION) m_metrics->addException(slave_id, func, m_last_exception);
+	}
+
+	if (m_health) {
+		if (status == MbStatus::OK) m_health->onResponse(slave_id, rtt_us, end_us / 1000);
+		else if (status == MbStatus::EXCEPTION) m_health->onException(slave_id, rtt_us, end_us / 1000);
+		else if (status == MbStatus::TIMEOUT) m_health->onTimeout(slave_id, end_us / 1000);
+		else m_health->onFailure(slave_id, end_us / 1000);
+	}
+	return status;
+}
+
+MbStatus ModbusMaster::readBits(const int slave_id, const BYTE func, const WORD start_adr, const WORD quantity, BIT *const vals) {
+	if (vals == nullptr || quantity == 0 || quantity > MODBUS_MAX_READ_BITS || (func != 1 && func != 2)) return MbStatus::BAD_RESPONSE;
+	std::lock_guard<std::mutex> lock(m_mtx);
+
+	const BYTE* resp;
+	size_t resp_len;
+	size_t pdu_len = pduReadRequest(m_transport->txPdu(), func, start_adr, quantity);
+	MbStatus status = execute(slave_id, pdu_len, &resp, &resp_len);
+	if (status != MbStatus::OK) return status;
+	return pduParseBits(resp, resp_len, func, quantity, vals) ? MbStatus::OK : MbStatus::BAD_RESPONSE;
+}
+
+MbStatus ModbusMaster::readWords(const int slave_id, const BYTE func, const WORD start_adr, const WORD quantity, WORD *const vals) {
+	if (vals == nullptr || quantity == 0 || quantity > MODBUS_MAX_READ_REGISTERS || (func != 3 && func != 4)) return MbStatus::BAD_RESPONSE;
+	std::lock_guard<std::mutex> lock(m_mtx);
+
+	const BYTE* resp;
+	size_t resp_len;
+	size_t pdu_len = pduReadRequest(m_transport->txPdu(), func, start_adr, quantity);
+	MbStatus status = execute(slave_id, pdu_len, &resp, &resp_len);
+	if (status != MbStatus::OK) return status;
+	return pduParseWords(resp, resp_len, func, quantity, vals) ? MbStatus::OK : MbStatus::BAD_RESPONSE;
+}
+
+MbStatus ModbusMaster::readToMap(const int slave_id, const BYTE func, const WORD start_adr, const WORD quantity, data::Map& map) {
+	const bool is_bit = func == 1 || func == 2;
+	if (quantity == 0 || quantity > (is_bit ? MODBUS_MAX_READ_BITS : MODBUS_MAX_READ_REGISTERS) || func < 1 || func > 4) return MbStatus::BAD_RESPONSE;
+	std::lock_guard<std::mutex> lock(m_mtx);
+
+	const BYTE* resp;
+	size_t resp_len;
+	size_t pdu_len = pduReadRequest(m_transport->txPdu(), func, start_adr, quantity);
+	MbStatus status = execute(slave_id, pdu_len, &resp, &resp_len);
+
+	// Метаданные карты слов ведутся по адресам слов: биты F_01/F_02 переводятся в слова, как в Map::updateBits
+	WORD meta_adr = start_adr;
+	WORD meta_quantity = quantity;
+	if (is_bit && map.getMapType() == data::MapType::WORD_MAP) {
+		meta_adr = start_adr / WORD_BIT_SIZE;
+		meta_quantity = static_cast<WORD>((static_cast<uint32_t>(start_adr) + quantity - 1) / WORD_BIT_SIZE - meta_adr + 1);
+	}
+
+	// Значения и метаданные диапазонов карты обновляются под блокировкой карты вместе
+	if (status == MbStatus::EXCEPTION) {
+		map.setQuality(meta_adr, meta_quantity, data::MapQuality::EXCEPTION, static_cast<uint8_t>(m_last_exception));
+		return status;
+	}
+	if (status != MbStatus::OK) {
+		map.setQuality(meta_adr, meta_quantity, data::MapQuality::COMM_FAIL);
+		return status;
+	}
+
+	bool result;
+	if (is_bit) result = pduParseBits(resp, resp_len, func, quantity, m_bits) && map.updateBits(start_adr, quantity, m_bits);
+	else result = pduParseWords(resp, resp_len, func, quantity, m_words) && map.updateWords(start_adr, quantity, m_words);
+	if (!result) map.setQuality(meta_adr, meta_quantity, data::MapQuality::COMM_FAIL);
+	return result ? MbStatus::OK : MbStatus::BAD_RESPONSE;
+}
+
+MbStatus ModbusMaster::checkWriteEcho(const BYTE* resp_pdu, const size_t resp_len, const BYTE func, const WORD adr, const WORD val) {
+	if (resp_len < 5 || resp_pdu[0] != func || getWordBE(resp_pdu + 1) != adr || getWordBE(resp_pdu + 3) != val) return MbStatus::BAD_RESPONSE;
+	return MbStatus::OK;
+}
+
+MbStatus ModbusMaster::writeBit(const int slave_id, const WORD adr, const BIT val) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	const BYTE func = static_cast<BYTE>(ModbusFunc::F_05);
+	const BYTE* resp;
+	size_t resp_len;
+	size_t pdu_len = pduWriteSingle(m_transport->txPdu(), func, adr, val);
+	if (slave_id == 0) return m_transport->send(0, pdu_len) ? MbStatus::OK : MbStatus::IO_ERROR; // Широковещательная запись без ответа
+	MbStatus status = execute(slave_id, pdu_len, &resp, &resp_len);
+	if (status != MbStatus::OK) return status;
+	return checkWriteEcho(resp, resp_len, func, adr, val ? 0xFF00 : 0x0000);
+}
+
+MbStatus ModbusMaster::writeWord(const int slave_id, const WORD adr, const WORD val) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	const BYTE func = static_cast<BYTE>(ModbusFunc::F_06);
+	const BYTE* resp;
+	size_t resp_len;
+	size_t pdu_len = pduWriteSingle(m_transport->txPdu(), func, adr, val);
+	if (slave_id == 0) return m_transport->send(0, pdu_len) ? MbStatus::OK : MbStatus::IO_ERROR;
+	MbStatus status = execute(slave_id, pdu_len, &resp, &resp_len);
+	if (status != MbStatus::OK) return status;
+	return checkWriteEcho(resp, resp_len, func, adr, val);
+}
+
+MbStatus ModbusMaster::writeBits(const int slave_id, const WORD start_adr, const WORD quantity, const BIT *const vals) {
+	if (vals == nullptr || quantity == 0 || quantity > MODBUS_MAX_WRITE_BITS) return MbStatus::BAD_RESPONSE;
+	std::lock_guard<std::mutex> lock(m_mtx);
+	const BYTE* resp;
+	size_t resp_len;
+	size_t pdu_len = pduWriteBits(m_transport->txPdu(), start_adr, quantity, vals);
+	if (slave_id == 0) return m_transport->send(0, pdu_len) ? MbStatus::OK : MbStatus::IO_ERROR;
+	MbStatus status = execute(slave_id, pdu_len, &resp, &resp_len);
+	if (status != MbStatus::OK) return status;
+	return checkWriteEcho(resp, resp_len, static_cast<BYTE>(ModbusFunc::F_15), start_adr, quantity);
+}
+
+MbStatus ModbusMaster::writeWords(const int slave_id, const WORD start_adr, const WORD quantity, const WORD *const vals) {
+	if (vals == nullptr || quantity == 0 || quantity > MODBUS_MAX_WRITE_REGISTERS) return MbStatus::BAD_RESPONSE;
+	std::lock_guard<std::mutex> lock(m_mtx);
+	const BYTE* resp;
+	size_t resp_len;
+	size_t pdu_len = pduWriteWords(m_transport->txPdu(), start_adr, quantity, vals);
+	if (slave_id == 0) return m_transport->send(0, pdu_len) ? MbStatus::OK : MbStatus::IO_ERROR;
+	MbStatus status = execute(slave_id, pdu_len, &resp, &resp_len);
+	if (status != MbStatus::OK) return status;
+	return checkWriteEcho(resp, resp_len, static_cast<BYTE>(ModbusFunc::F_16), start_adr, quantity);
+}
+
+} // modbus
+} // mb
@@ -0,0 +1,67 @@
+#ifndef MB_MODBUS_MASTER_H
+#define MB_MODBUS_MASTER_H
+
+#include "Transport.h"
+#include "SlaveHealth.h"
+#include "Map.h"
+#include "Metrics.h"
+
+#include <mutex>
+
+namespace mb {
+namespace modbus {
+
+/** @brief Мастер Modbus поверх транспорта.
+	Собирает PDU прямо в буфере транспорта и разбирает ответ из его приемного буфера.
+	Доступ к линии разделяется мьютексом, поэтому мастером могут пользоваться несколько потоков.
+	Если задан SlaveHealth, таймаут берется адаптивный, а устройства в состоянии OFFLINE пропускаются.
+	Если задан реестр Metrics, каждая транзакция учитывается в серии slave_id/func */
+class ModbusMaster {
+public:
+	ModbusMaster(Transport* transport, SlaveHealth* health = nullptr);
+	~ModbusMaster() {}
+
+	void setTimeout(uint32_t timeout_ms);	// Таймаут ответа, если не задан SlaveHealth
+	void setMetrics(metrics::Metrics* metrics);
+
+	// Чтение катушек/дискретных входов (func 1, 2)
+	MbStatus readBits(const int slave_id, const BYTE func, const WORD start_adr, const WORD quantity, BIT *const vals);
+	// Чтение регистров хранения/входных регистров (func 3, 4)
+	MbStatus readWords(const int slave_id, const BYTE func, const WORD start_adr, const WORD quantity, WORD *const vals);
+	// Чтение с записью результата в карту памяти (адреса карты совпадают с адресами устройства).
+	// Метаданные диапазонов карты получают время и качество ответа: GOOD, EXCEPTION с кодом или COMM_FAIL
+	MbStatus readToMap(const int slave_id, const BYTE func, const WORD start_adr, const WORD quantity, data::Map& map);
+
+	MbStatus writeBit(const int slave_id, const WORD adr, const BIT val);
+	MbStatus writeWord(const int slave_id, const WORD adr, const WORD val);
+	MbStatus writeBits(const int slave_id, const WORD start_adr, const WORD quantity, const BIT *const vals);
+	MbStatus writeWords(const int slave_id, const WORD start_adr, const WORD quantity, const WORD *const vals);
+
+	// Код исключения последнего ответа исключением
+	ModbusExceptionCode getLastException() const { return m_last_exception; }
+	uint64_t getTransactions() const { return m_transactions; }
+
+	Transport* getTransport() { return m_transport; }
+
+private:
+	MbStatus execute(const int slave_id, const size_t pdu_len, const BYTE** resp_pdu, size_t* resp_len);
+	MbStatus checkWriteEcho(const BYTE* resp_pdu, const size_t resp_len, const BYTE func, const WORD adr, const WORD val);
+
+	Transport* m_transport;
+	SlaveHealth* m_health;
+	metrics::Metrics* m_metrics;
+	uint32_t m_timeout_ms;
+
+	ModbusExceptionCode m_last_exception;
+	uint64_t m_transactions;
+
+	BIT m_bits[MODBUS_MAX_READ_BITS];			// Буферы разбора ответа для readToMap
+	WORD m_words[MODBUS_MAX_READ_REGISTERS];
+
+	std::mutex m_mtx;		// Мьютекс линии
+};
+
+} // modbus
+} // mb
+
+#endif // MB_MODBUS_MASTER_H
@@ -0,0 +1,189 @@
+#include "RequestCache.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace mb {
+namespace modbus {
+
+static uint64_t nowMs() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+constexpr size_t INDEX_NODE_SIZE = 64;	// Не меньше узла unordered_map<uint64_t, iterator> (24-32 байта)
+
+RequestCache::RequestCache(ModbusMaster* master, size_t capacity) : m_master(master),
+																						  m_capacity(capacity ? capacity : 1),
+																						  m_frames(m_capacity),
+																						  m_index_nodes(INDEX_NODE_SIZE, m_capacity),
+																						  m_index(0, std::hash<uint64_t>(), std::equal_to<uint64_t>(), IndexAllocator(&m_index_nodes)),
+																						  m_stats() {
+	m_index.reserve(m_capacity * 2);
+	// Записи с буферами создаются один раз и дальше только переходят между m_free и m_lru
+	for (size_t i = 0; i < m_capacity; i++) {
+		m_free.emplace_front();
+		m_free.front().data = m_frames.acquireFrame();
+	}
+}
+
+MbStatus RequestCache::readBits(const int slave_id, const BYTE func, const data::Range& range, BIT *const vals, ModbusExceptionCode* exception) {
+	if (vals == nullptr || range.end < range.start || range.quantity() > MODBUS_MAX_READ_BITS || (func != 1 && func != 2)) return MbStatus::BAD_RESPONSE;
+	return read(slave_id, func, range, vals, sizeof(BIT), exception);
+}
+
+MbStatus RequestCache::readWords(const int slave_id, const BYTE func, const data::Range& range, WORD *const vals, ModbusExceptionCode* exception) {
+	if (vals == nullptr || range.end < range.start || range.quantity() > MODBUS_MAX_READ_REGISTERS || (func != 3 && func != 4)) return MbStatus::BAD_RESPONSE;
+	return read(slave_id, func, range, vals, sizeof(WORD), exception);
+}
+
+RequestCache::Entry* RequestCache::acquire(const uint64_t key) {
+	auto it = m_index.find(key);
+	if (it != m_index.end()) {
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		return &*it->second;
+	}
+	if (m_free.empty() && !evict()) return nullptr;
+	m_lru.splice(m_lru.begin(), m_free, m_free.begin());
+	Entry& e = m_lru.front();
+	e.key = key;
+	e.updated_ms = 0;
+	e.valid = false;
+	e.status = MbStatus::OK;
+	e.exception = ModbusExceptionCode::EXCEPTION_NOT_DEFINED;
+	m_index.emplace(key, m_lru.begin());
+	return &e;
+}
+
+void RequestCache::recycle(LruIterator it) {
+	m_index.erase(it->key);
+	it->valid = false;
+	m_free.splice(m_free.begin(), m_lru, it);
+}
+
+bool RequestCache::evict() {
+	// С конца списка ищем запись без ожидающих вызовов
+	for (auto it = m_lru.end(); it != m_lru.begin();) {
+		--it;
+		if (it->users > 0) continue;
+		recycle(it);
+		++m_stats.evictions;
+		return true;
+	}
+	return false;
+}
+
+MbStatus RequestCache::transact(const int slave_id, const BYTE func, const data::Range& range, void* vals, const size_t val_size, ModbusExceptionCode* code) {
+	MbStatus status;
+	if (val_size == sizeof(BIT)) status = m_master->readBits(slave_id, func, range.start, range.quantity(), static_cast<BIT*>(vals));
+	else status = m_master->readWords(slave_id, func, range.start, range.quantity(), static_cast<WORD*>(vals));
+	if (status == MbStatus::EXCEPTION && code) *code = m_master->getLastException();
+	return status;
+}
+
+MbStatus RequestCache::read(const int slave_id, const BYTE func, const data::Range& range, void* vals, const size_t val_size, ModbusExceptionCode* exception) {
+	const WORD quantity = range.quantity();
+	const bool is_bit = val_size == sizeof(BIT);
+
+	std::unique_lock<std::mutex> lock(m_mtx);
+	++m_stats.requests;
+	Entry* e = acquire(keyOf(slave_id, func, range.start, quantity));
+
+	if (e == nullptr) {
+		// Все записи ждут своих транзакций - запрос выполняется в обход кэша
+		++m_stats.transactions;
+		lock.unlock();
+		return transact(slave_id, func, range, vals, val_size, exception);
+	}
+
+	for (;;) {
+		if (e->inflight) {
+			// Транзакция начата до invalidate - ее данные могут быть старее записи. Ждем только освобождения линии
+			// (мастер все равно выполняет транзакции по одной) и выполняем новую
+			const bool stale = e->read_generation != e->generation;
+			++e->users;
+			e->cv.wait(lock, [e] { return !e->inflight; });
+			--e->users;
+			if (stale) continue;
+			++m_stats.collapsed;
+		}
+		else if (e->valid && range.scan_ms > 0 && nowMs() - e->updated_ms <= range.scan_ms) {
+			++m_stats.hits;
+		}
+		else {
+			e->inflight = true;
+			e->read_generation = e->generation;
+			++e->users;
+			++m_stats.transactions;
+			lock.unlock();
+
+			BIT bits[MODBUS_MAX_READ_BITS];
+			WORD words[MODBUS_MAX_READ_REGISTERS];
+			// Код исключения сохраняется в записи для всех ожидающих вызовов
+			ModbusExceptionCode code = ModbusExceptionCode::EXCEPTION_NOT_DEFINED;
+			MbStatus status = transact(slave_id, func, range, is_bit ? static_cast<void*>(bits) : static_cast<void*>(words), val_size, &code);
+
+			lock.lock();
+			e->status = status;
+			e->exception = code;
+			if (status == MbStatus::OK) {
+				if (is_bit) packBits(bits, quantity, e->data);
+				else memcpy(e->data, words, quantity * sizeof(WORD));
+				e->updated_ms = nowMs();
+			}
+			// Данные отдаются этому вызову и ожидавшим его, но в кэше действительны, только если не было invalidate
+			e->valid = status == MbStatus::OK && e->read_generation == e->generation;
+			e->inflight = false;
+			--e->users;
+			e->cv.notify_all();
+		}
+		break;
+	}
+
+	// Статус последней транзакции, данные при OK остаются от нее даже после invalidate
+	MbStatus status = e->status;
+	if (status == MbStatus::OK) {
+		if (is_bit) unpackBits(e->data, quantity, static_cast<BIT*>(vals));
+		else memcpy(vals, e->data, quantity * sizeof(WORD));
+	}
+	else if (exception) *exception = e->exception;
+	return status;
+}
+
+void RequestCache::invalidate(const int slave_id, const BYTE func, const WORD start_adr, const WORD end_adr) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	for (Entry& e : m_lru) {
+		if (static_cast<int>(e.key >> 40) != (slave_id & 0xFF) || static_cast<BYTE>(e.key >> 32) != func) continue;
+		uint32_t start = static_cast<WORD>(e.key >> 16);
+		uint32_t end = start + static_cast<WORD>(e.key) - 1;
+		if (start <= end_adr && end >= start_adr) {
+			e.valid = false;
+			++e.generation;
+		}
+	}
+}
+
+void RequestCache::clear() {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	for (auto it = m_lru.begin(); it != m_lru.end();) {
+		if (it->users > 0) {
+			it->valid = false;
+			++it->generation;
+			++it;
+			continue;
+		}
+		recycle(it++);
+	}
+}
+
+size_t RequestCache::size() {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_lru.size();
+}
+
+RequestCacheStats RequestCache::getStats() {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_stats;
+}
+
+} // modbus
+} // mb
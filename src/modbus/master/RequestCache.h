@@ -0,0 +1,98 @@
+#ifndef MB_REQUEST_CACHE_H
+#define MB_REQUEST_CACHE_H
+
+#include "ModbusMaster.h"
+#include "Range.h"
+#include "Pool.h"
+
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace mb {
+namespace modbus {
+
+/** @brief Счетчики кэша запросов */
+struct RequestCacheStats {
+	uint64_t requests;		// Вызовы чтения
+	uint64_t hits;				// Ответы из кэша
+	uint64_t collapsed;		// Вызовы, дождавшиеся уже выполняющейся транзакции
+	uint64_t transactions;	// Транзакции, выданные мастеру
+	uint64_t evictions;		// Вытеснения LRU
+};
+
+/** @brief Кэш результатов чтения с совместным выполнением одинаковых запросов (single-flight) перед ModbusMaster.
+	Ключ запроса - (slave_id, func, range.start, range.quantity()).
+	Пока транзакция по ключу выполняется, другие вызовы с тем же ключом ждут ее результата.
+	Результат хранится в кэше LRU на capacity ключей и отдается, пока его возраст не больше range.scan_ms,
+	scan_ms = 0 - только совместное выполнение без кэширования.
+	Ошибка транзакции получают все ожидавшие вызовы, в кэше она не хранится.
+	Транзакция, начатая до invalidate, не делает запись действительной, а вызовы после invalidate
+	не берут ее результат и выполняют новую транзакцию.
+	Записи, буферы значений (FramePool) и узлы индекса (Pool) выделяются при создании кэша,
+	поэтому в установившемся режиме промах и вытеснение не обращаются к системному распределителю.
+	Если все записи заняты ожидающими вызовами, запрос выполняется напрямую без кэша */
+class RequestCache {
+public:
+	RequestCache(ModbusMaster* master, size_t capacity = 256);
+	~RequestCache() {}
+
+	// Чтение катушек/дискретных входов (func 1, 2), exception - код исключения при MbStatus::EXCEPTION
+	MbStatus readBits(const int slave_id, const BYTE func, const data::Range& range, BIT *const vals, ModbusExceptionCode* exception = nullptr);
+	// Чтение регистров (func 3, 4)
+	MbStatus readWords(const int slave_id, const BYTE func, const data::Range& range, WORD *const vals, ModbusExceptionCode* exception = nullptr);
+
+	// Сброс результатов, пересекающихся с [start_adr-end_adr] (после записи)
+	void invalidate(const int slave_id, const BYTE func, const WORD start_adr, const WORD end_adr);
+	void clear();
+
+	size_t size();
+	RequestCacheStats getStats();
+
+private:
+	struct Entry {
+		uint64_t key = 0;
+		BYTE* data = nullptr;				// Буфер кадра из m_frames: WORD как есть, BIT упакованы по 8 в байт
+		uint64_t updated_ms = 0;
+		bool valid = false;
+		bool inflight = false;
+		uint32_t generation = 0;				// Увеличивается при каждом invalidate/clear
+		uint32_t read_generation = 0;		// Поколение на момент начала выполняющейся транзакции
+		int users = 0;							// Ожидающие вызовы, запись с users > 0 не вытесняется
+		MbStatus status = MbStatus::OK;
+		ModbusExceptionCode exception = ModbusExceptionCode::EXCEPTION_NOT_DEFINED;
+		std::condition_variable cv;
+	};
+
+	static uint64_t keyOf(const int slave_id, const BYTE func, const WORD start_adr, const WORD quantity) {
+		return (static_cast<uint64_t>(slave_id & 0xFF) << 40) | (static_cast<uint64_t>(func) << 32) | (static_cast<uint64_t>(start_adr) << 16) | quantity;
+	}
+
+	using LruIterator = std::list<Entry>::iterator;
+	using IndexAllocator = mem::PoolAllocator<std::pair<const uint64_t, LruIterator>>;
+	using Index = std::unordered_map<uint64_t, LruIterator, std::hash<uint64_t>, std::equal_to<uint64_t>, IndexAllocator>;
+
+	MbStatus read(const int slave_id, const BYTE func, const data::Range& range, void* vals, const size_t val_size, ModbusExceptionCode* exception);
+	MbStatus transact(const int slave_id, const BYTE func, const data::Range& range, void* vals, const size_t val_size, ModbusExceptionCode* code);
+	Entry* acquire(const uint64_t key);	// Поиск или занятие свободной записи, вызывается с захваченным m_mtx. nullptr - все записи заняты
+	bool evict();
+	void recycle(LruIterator it);			// Перенос записи из LRU в список свободных
+
+	ModbusMaster* m_master;
+	size_t m_capacity;
+
+	mem::FramePool m_frames;
+	mem::Pool m_index_nodes;
+	std::list<Entry> m_lru;													// Начало списка - последние использованные
+	std::list<Entry> m_free;												// Свободные записи со своими буферами
+	Index m_index;
+	std::mutex m_mtx;
+
+	RequestCacheStats m_stats;
+};
+
+} // modbus
+} // mb
+
+#endif // MB_REQUEST_CACHE_H
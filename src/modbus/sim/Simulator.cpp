@@ -0,0 +1,988 @@
+#include "Simulator.h"
+#include "ModbusFrame.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Формат сценария (loadScript). Пустые строки и текст после ';' или '#' пропускаются.
+	Команды после tcp/rtutcp/udp/pty относятся к объявленной ими группе точек подключения.
+
+	seed 42                            ; зерно генераторов задержек и ошибок
+	tick 100                           ; период обновления шаблонов, мс
+	tcp 127.0.0.1 1502 [n]             ; n серверов TCP на портах 1502, 1503, ... (порт 0 - свободные порты)
+	rtutcp 127.0.0.1 1602 [n]          ; серверы TCP с кадрами RTU
+	udp 127.0.0.1 1702 [n]             ; точки Modbus UDP
+	pty [n]                            ; n псевдотерминалов RTU
+	slaves 1-247 [co=N] [di=N] [hr=N] [ir=N]        ; устройства и размер их таблиц (по умолчанию hr=100 ir=100)
+	latency fixed 5 | uniform 2 8 | normal 5 1.5 | exp 2 3     ; задержка ответа, мс
+	exception 0.01 [busy|failure|address|value|function|ack|nack|parity|path|target|<код>]
+	noresponse 0.001
+	corrupt 0.001
+	pattern 1-247 hr 0-9 sine 0 1000 [период_мс]    ; const|ramp|sine|square|walk|counter от до
+*/
+
+namespace mb {
+namespace modbus {
+
+constexpr size_t CONN_BUFFER = 4096;
+constexpr uint64_t RTU_GAP_NS = 50000000;	// Пауза, после которой принятые байты RTU считаются началом нового кадра
+constexpr int MAX_WAIT_MS = 200;
+constexpr size_t UDP_BATCH = 32;		// Датаграмм на вызов recvmmsg/sendmmsg
+
+static uint64_t monoNs() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+static bool setNonBlocking(int fd) {
+	int flags = fcntl(fd, F_GETFL, 0);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+namespace {
+
+// Ответ, ожидающий своей задержки
+struct Pending {
+	uint64_t due_ns;
+	uint64_t seq;		// Порядок постановки при равном времени
+	int fd;
+	uint64_t gen;		// Поколение соединения: fd мог быть закрыт и выдан новому клиенту
+	sockaddr_in peer;	// UDP: адрес клиента
+	uint16_t len;
+	BYTE adu[MODBUS_MAX_ADU_LENGTH];
+};
+
+struct PendingLater {
+	bool operator()(const Pending& a, const Pending& b) const {
+		return a.due_ns != b.due_ns ? a.due_ns > b.due_ns : a.seq > b.seq;
+	}
+};
+
+struct Conn {
+	uint64_t gen = 0;
+	std::vector<BYTE> in;
+	size_t have = 0;
+	std::vector<BYTE> out;		// Не отправленный остаток (сокет был переполнен)
+	uint64_t last_due_ns = 0;	// Ответы соединения уходят в порядке запросов
+};
+
+} // namespace
+
+enum class Simulator::EndpointKind : uint8_t {
+	TCP,			// MBAP через TCP
+	RTU_TCP,		// Кадры RTU через TCP
+	UDP,			// MBAP в датаграммах
+	PTY,			// Линия RTU на псевдотерминале
+};
+
+struct Simulator::Endpoint {
+	EndpointKind kind = EndpointKind::TCP;
+	std::string name;
+	uint16_t port = 0;
+	int listen_fd = -1;			// Сервер TCP или сокет UDP
+	int pty_fd = -1;
+	int pty_slave_fd = -1;		// Ведомая сторона держится открытой, пока к ней не подключился опрашивающий
+
+	SlaveHandler handler;
+	std::vector<std::unique_ptr<data::Map>> maps;
+	size_t slaves = 0;
+	LatencyModel latency;
+	FaultModel faults;
+	std::mt19937_64 rng;
+
+	int epoll_fd = -1;
+	int wake_fd = -1;
+	std::thread thread;
+
+	std::unordered_map<int, Conn> conns;
+	std::priority_queue<Pending, std::vector<Pending>, PendingLater> pending;
+	uint64_t next_gen = 1;
+	uint64_t next_seq = 0;
+
+	// RTU
+	BYTE rx[MODBUS_MAX_ADU_LENGTH * 2];
+	size_t have = 0;
+	uint64_t last_rx_ns = 0;
+	uint64_t line_free_ns = 0;	// Линия полудуплексная: следующий ответ не раньше предыдущего
+
+	std::atomic<uint64_t> requests{ 0 };
+	std::atomic<uint64_t> responses{ 0 };
+	std::atomic<uint64_t> exceptions{ 0 };
+	std::atomic<uint64_t> dropped{ 0 };
+	std::atomic<uint64_t> corrupted{ 0 };
+	std::atomic<uint64_t> bytes_in{ 0 };
+	std::atomic<uint64_t> bytes_out{ 0 };
+	std::atomic<uint64_t> connections{ 0 };
+
+	~Endpoint() {
+		if (listen_fd >= 0) ::close(listen_fd);
+		if (pty_slave_fd >= 0) ::close(pty_slave_fd);
+		if (pty_fd >= 0) ::close(pty_fd);
+	}
+};
+
+/* Настройка */
+
+Simulator::Simulator() : m_tick_ms(100), m_seed(1), m_running(false), m_start_ms(0) {}
+
+Simulator::~Simulator() {
+	stop();
+}
+
+Simulator::Endpoint* Simulator::endpointAt(const int endpoint) const {
+	if (endpoint < 0 || static_cast<size_t>(endpoint) >= m_endpoints.size()) return nullptr;
+	return m_endpoints[endpoint].get();
+}
+
+int Simulator::addTcp(const std::string& bind_adr, const uint16_t port) {
+	return addSocket(bind_adr, port, EndpointKind::TCP);
+}
+
+int Simulator::addRtuTcp(const std::string& bind_adr, const uint16_t port) {
+	return addSocket(bind_adr, port, EndpointKind::RTU_TCP);
+}
+
+int Simulator::addUdp(const std::string& bind_adr, const uint16_t port) {
+	return addSocket(bind_adr, port, EndpointKind::UDP);
+}
+
+int Simulator::addSocket(const std::string& bind_adr, const uint16_t port, const EndpointKind kind) {
+	if (m_running) return -1;
+	const bool udp = kind == EndpointKind::UDP;
+	int fd = ::socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+	if (fd < 0) return -1;
+	int one = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	sockaddr_in adr = {};
+	adr.sin_family = AF_INET;
+	adr.sin_port = htons(port);
+	socklen_t adr_len = sizeof(adr);
+	if (inet_pton(AF_INET, bind_adr.c_str(), &adr.sin_addr) != 1 || ::bind(fd, reinterpret_cast<sockaddr*>(&adr), sizeof(adr)) != 0 ||
+		 (!udp && ::listen(fd, 1024) != 0) || getsockname(fd, reinterpret_cast<sockaddr*>(&adr), &adr_len) != 0 || !setNonBlocking(fd)) {
+		::close(fd);
+		return -1;
+	}
+
+	std::unique_ptr<Endpoint> ep(new Endpoint());
+	ep->kind = kind;
+	ep->listen_fd = fd;
+	ep->port = ntohs(adr.sin_port);
+	ep->name = bind_adr + ":" + std::to_string(ep->port);
+	m_endpoints.push_back(std::move(ep));
+	return static_cast<int>(m_endpoints.size() - 1);
+}
+
+int Simulator::addPty() {
+	if (m_running) return -1;
+	int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0) return -1;
+	if (grantpt(fd) != 0 || unlockpt(fd) != 0) {
+		::close(fd);
+		return -1;
+	}
+	const char* path = ptsname(fd);
+	int slave_fd = path ? ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK) : -1;
+	termios tio;
+	if (slave_fd < 0 || tcgetattr(slave_fd, &tio) != 0) {
+		if (slave_fd >= 0) ::close(slave_fd);
+		::close(fd);
+		return -1;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(slave_fd, TCSANOW, &tio);
+
+	std::unique_ptr<Endpoint> ep(new Endpoint());
+	ep->kind = EndpointKind::PTY;
+	ep->pty_fd = fd;
+	ep->pty_slave_fd = slave_fd;
+	ep->name = path;
+	m_endpoints.push_back(std::move(ep));
+	return static_cast<int>(m_endpoints.size() - 1);
+}
+
+bool Simulator::addSlaves(const int endpoint, const int first_slave, const int last_slave, const SimLayout& layout) {
+	Endpoint* ep = endpointAt(endpoint);
+	if (ep == nullptr || m_running || first_slave < 1 || last_slave > 247 || first_slave > last_slave) return false;
+
+	const struct { SlaveTable table; WORD size; data::MapType type; } tables[] = {
+		{ SlaveTable::COILS, layout.coils, data::MapType::BIT_MAP },
+		{ SlaveTable::DISCRETE_INPUTS, layout.discrete, data::MapType::BIT_MAP },
+		{ SlaveTable::HOLDING_REGISTERS, layout.holding, data::MapType::WORD_MAP },
+		{ SlaveTable::INPUT_REGISTERS, layout.input, data::MapType::WORD_MAP },
+	};
+	for (int slave = first_slave; slave <= last_slave; slave++) {
+		if (!ep->handler.hasSlave(slave)) ep->slaves++;
+		for (const auto& t : tables) {
+			if (t.size == 0) continue;
+			std::unique_ptr<data::Map> map(new data::Map(0, t.size));
+			if (!map->initNewMemory(t.type)) return false;
+			ep->handler.setMap(slave, t.table, map.get());
+			ep->maps.push_back(std::move(map));
+		}
+	}
+	return true;
+}
+
+bool Simulator::setLatency(const int endpoint, const LatencyModel& latency) {
+	Endpoint* ep = endpointAt(endpoint);
+	if (ep == nullptr || m_running) return false;
+	ep->latency = latency;
+	return true;
+}
+
+bool Simulator::setFaults(const int endpoint, const FaultModel& faults) {
+	Endpoint* ep = endpointAt(endpoint);
+	if (ep == nullptr || m_running) return false;
+	ep->faults = faults;
+	return true;
+}
+
+bool Simulator::addPattern(const PatternSpec& pattern) {
+	if (m_running || (pattern.endpoint >= 0 && endpointAt(pattern.endpoint) == nullptr)) return false;
+	if (pattern.table == SlaveTable::COUNT || pattern.start > pattern.end || pattern.first_slave > pattern.last_slave) return false;
+	m_patterns.push_back(pattern);
+	return true;
+}
+
+std::string Simulator::getEndpointName(const int endpoint) const {
+	Endpoint* ep = endpointAt(endpoint);
+	return ep ? ep->name : std::string();
+}
+
+uint16_t Simulator::getPort(const int endpoint) const {
+	Endpoint* ep = endpointAt(endpoint);
+	return ep ? ep->port : 0;
+}
+
+size_t Simulator::getSlaveCount() const {
+	size_t n = 0;
+	for (const auto& ep : m_endpoints) n += ep->slaves;
+	return n;
+}
+
+data::Map* Simulator::getMap(const int endpoint, const int slave_id, const SlaveTable table) {
+	Endpoint* ep = endpointAt(endpoint);
+	return ep ? ep->handler.getMap(slave_id, table) : nullptr;
+}
+
+SimStats Simulator::getStats() const {
+	SimStats s = {};
+	for (const auto& ep : m_endpoints) {
+		s.requests += ep->requests.load(std::memory_order_relaxed);
+		s.responses += ep->responses.load(std::memory_order_relaxed);
+		s.exceptions += ep->exceptions.load(std::memory_order_relaxed);
+		s.dropped += ep->dropped.load(std::memory_order_relaxed);
+		s.corrupted += ep->corrupted.load(std::memory_order_relaxed);
+		s.bytes_in += ep->bytes_in.load(std::memory_order_relaxed);
+		s.bytes_out += ep->bytes_out.load(std::memory_order_relaxed);
+		s.connections += ep->connections.load(std::memory_order_relaxed);
+	}
+	return s;
+}
+
+/* Сценарий */
+
+static bool parseSpan(const std::string& s, int& first, int& last) {
+	char* end = nullptr;
+	first = static_cast<int>(strtol(s.c_str(), &end, 10));
+	if (end == s.c_str()) return false;
+	if (*end == 0) {
+		last = first;
+		return true;
+	}
+	if (*end != '-') return false;
+	const char* p = end + 1;
+	last = static_cast<int>(strtol(p, &end, 10));
+	return end != p && *end == 0 && first <= last;
+}
+
+static bool parseTable(const std::string& s, SlaveTable& table) {
+	if (s == "co") table = SlaveTable::COILS;
+	else if (s == "di") table = SlaveTable::DISCRETE_INPUTS;
+	else if (s == "hr") table = SlaveTable::HOLDING_REGISTERS;
+	else if (s == "ir") table = SlaveTable::INPUT_REGISTERS;
+	else return false;
+	return true;
+}
+
+static bool parseException(const std::string& s, ModbusExceptionCode& code) {
+	static const struct { const char* name; ModbusExceptionCode code; } names[] = {
+		{ "function", ModbusExceptionCode::EXCEPTION_ILLEGAL_FUNCTION },
+		{ "address", ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_ADDRESS },
+		{ "value", ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE },
+		{ "failure", ModbusExceptionCode::EXCEPTION_SLAVE_OR_SERVER_FAILURE },
+		{ "ack", ModbusExceptionCode::EXCEPTION_ACKNOWLEDGE },
+		{ "busy", ModbusExceptionCode::EXCEPTION_SLAVE_OR_SERVER_BUSY },
+		{ "nack", ModbusExceptionCode::EXCEPTION_NEGATIVE_ACKNOWLEDGE },
+		{ "parity", ModbusExceptionCode::EXCEPTION_MEMORY_PARITY },
+		{ "path", ModbusExceptionCode::EXCEPTION_GATEWAY_PATH },
+		{ "target", ModbusExceptionCode::EXCEPTION_GATEWAY_TARGET },
+	};
+	for (const auto& n : names) {
+		if (s == n.name) {
+			code = n.code;
+			return true;
+		}
+	}
+	int v = atoi(s.c_str());
+	if (v < 1 || v >= static_cast<int>(ModbusExceptionCode::EXCEPTION_MAX)) return false;
+	code = static_cast<ModbusExceptionCode>(v);
+	return true;
+}
+
+static bool parsePattern(const std::string& s, SimPattern& kind) {
+	if (s == "const") kind = SimPattern::CONST;
+	else if (s == "ramp") kind = SimPattern::RAMP;
+	else if (s == "sine") kind = SimPattern::SINE;
+	else if (s == "square") kind = SimPattern::SQUARE;
+	else if (s == "walk") kind = SimPattern::RANDOM_WALK;
+	else if (s == "counter") kind = SimPattern::COUNTER;
+	else return false;
+	return true;
+}
+
+bool Simulator::loadScript(const std::string& text) {
+	std::istringstream in(text);
+	std::string line;
+	int line_no = 0;
+	int group_first = -1, group_last = -1;		// Последняя объявленная группа точек подключения
+
+	auto fail = [&](const std::string& message) {
+		m_error = "line " + std::to_string(line_no) + ": " + message;
+		return false;
+	};
+
+	while (std::getline(in, line)) {
+		line_no++;
+		line = line.substr(0, line.find_first_of(";#"));
+		std::istringstream ls(line);
+		std::vector<std::string> tok;
+		for (std::string t; ls >> t;) tok.push_back(t);
+		if (tok.empty()) continue;
+		const std::string& cmd = tok[0];
+
+		if (cmd == "seed" && tok.size() == 2) {
+			m_seed = strtoull(tok[1].c_str(), nullptr, 10);
+			continue;
+		}
+		if (cmd == "tick" && tok.size() == 2) {
+			setTick(static_cast<uint32_t>(atoi(tok[1].c_str())));
+			continue;
+		}
+		const bool net = cmd == "tcp" || cmd == "rtutcp" || cmd == "udp";
+		if ((net && (tok.size() == 3 || tok.size() == 4)) || (cmd == "pty" && tok.size() <= 2)) {
+			const size_t count_pos = net ? 3 : 1;
+			const int count = tok.size() > count_pos ? atoi(tok[count_pos].c_str()) : 1;
+			if (count < 1) return fail("bad endpoint count");
+			const int port = net ? atoi(tok[2].c_str()) : 0;
+			const EndpointKind kind = cmd == "udp" ? EndpointKind::UDP : (cmd == "rtutcp" ? EndpointKind::RTU_TCP : EndpointKind::TCP);
+			group_first = static_cast<int>(m_endpoints.size());
+			for (int i = 0; i < count; i++) {
+				int ep = net ? addSocket(tok[1], static_cast<uint16_t>(port ? port + i : 0), kind) : addPty();
+				if (ep < 0) return fail("can't open endpoint " + (net ? tok[1] + ":" + std::to_string(port ? port + i : 0) : cmd));
+			}
+			group_last = static_cast<int>(m_endpoints.size()) - 1;
+			continue;
+		}
+
+		if (group_first < 0) return fail("'" + cmd + "' before tcp/rtutcp/udp/pty");
+
+		if (cmd == "slaves" && tok.size() >= 2) {
+			int first, last;
+			if (!parseSpan(tok[1], first, last)) return fail("bad slave range");
+			SimLayout layout;
+			for (size_t i = 2; i < tok.size(); i++) {
+				const std::string& t = tok[i];
+				if (t.size() < 4 || t[2] != '=') return fail("bad table size '" + t + "'");
+				SlaveTable table;
+				if (!parseTable(t.substr(0, 2), table)) return fail("bad table '" + t + "'");
+				const WORD size = static_cast<WORD>(atoi(t.c_str() + 3));
+				if (table == SlaveTable::COILS) layout.coils = size;
+				else if (table == SlaveTable::DISCRETE_INPUTS) layout.discrete = size;
+				else if (table == SlaveTable::HOLDING_REGISTERS) layout.holding = size;
+				else layout.input = size;
+			}
+			for (int ep = group_first; ep <= group_last; ep++) {
+				if (!addSlaves(ep, first, last, layout)) return fail("bad slaves");
+			}
+		}
+		else if (cmd == "latency" && tok.size() >= 2) {
+			LatencyModel latency;
+			const std::string& kind = tok[1];
+			const size_t need = kind == "fixed" ? 3 : 4;
+			if (kind == "none") latency.kind = SimLatency::NONE;
+			else if (tok.size() != need) return fail("bad latency parameters");
+			else if (kind == "fixed") latency.kind = SimLatency::FIXED;
+			else if (kind == "uniform") latency.kind = SimLatency::UNIFORM;
+			else if (kind == "normal") latency.kind = SimLatency::NORMAL;
+			else if (kind == "exp") latency.kind = SimLatency::EXPONENTIAL;
+			else return fail("unknown latency '" + kind + "'");
+			if (tok.size() > 2) latency.a_ms = atof(tok[2].c_str());
+			if (tok.size() > 3) latency.b_ms = atof(tok[3].c_str());
+			for (int ep = group_first; ep <= group_last; ep++) m_endpoints[ep]->latency = latency;
+		}
+		else if ((cmd == "exception" || cmd == "noresponse" || cmd == "corrupt") && tok.size() >= 2) {
+			const double rate = atof(tok[1].c_str());
+			if (rate < 0 || rate > 1) return fail("rate must be 0..1");
+			ModbusExceptionCode code = ModbusExceptionCode::EXCEPTION_SLAVE_OR_SERVER_BUSY;
+			if (cmd == "exception" && tok.size() > 2 && !parseException(tok[2], code)) return fail("bad exception '" + tok[2] + "'");
+			for (int ep = group_first; ep <= group_last; ep++) {
+				FaultModel& f = m_endpoints[ep]->faults;
+				if (cmd == "exception") {
+					f.exception_rate = rate;
+					f.exception = code;
+				}
+				else if (cmd == "noresponse") f.no_response_rate = rate;
+				else f.corrupt_rate = rate;
+			}
+		}
+		else if (cmd == "pattern" && (tok.size() == 7 || tok.size() == 8)) {
+			PatternSpec p;
+			int start, end;
+			if (!parseSpan(tok[1], p.first_slave, p.last_slave)) return fail("bad slave range");
+			if (!parseTable(tok[2], p.table)) return fail("bad table '" + tok[2] + "'");
+			if (!parseSpan(tok[3], start, end) || start < 0 || end > 65535) return fail("bad address range");
+			if (!parsePattern(tok[4], p.kind)) return fail("unknown pattern '" + tok[4] + "'");
+			p.start = static_cast<WORD>(start);
+			p.end = static_cast<WORD>(end);
+			p.min = atof(tok[5].c_str());
+			p.max = atof(tok[6].c_str());
+			if (tok.size() == 8) p.period_ms = static_cast<uint32_t>(std::max(1, atoi(tok[7].c_str())));
+			for (int ep = group_first; ep <= group_last; ep++) {
+				p.endpoint = ep;
+				if (!addPattern(p)) return fail("bad pattern");
+			}
+		}
+		else return fail("unknown command '" + cmd + "'");
+	}
+	return true;
+}
+
+bool Simulator::loadScriptFile(const std::string& path) {
+	std::ifstream in(path);
+	if (!in) {
+		m_error = "can't open " + path;
+		return false;
+	}
+	std::stringstream ss;
+	ss << in.rdbuf();
+	return loadScript(ss.str());
+}
+
+/* Шаблоны значений */
+
+double Simulator::patternValue(const PatternSpec& p, const WORD adr, const uint64_t t_ms) {
+	const double span = p.max - p.min;
+	const uint32_t period = std::max<uint32_t>(1, p.period_ms);
+	const double frac = static_cast<double>(t_ms % period) / period;
+
+	switch (p.kind) {
+		case SimPattern::RAMP: return p.min + span * frac;
+		case SimPattern::SINE: return p.min + span * (0.5 + 0.5 * std::sin(2 * M_PI * (frac + (adr - p.start) / 64.0)));
+		case SimPattern::SQUARE: return frac < 0.5 ? p.min : p.max;
+		case SimPattern::COUNTER: return p.min + static_cast<double>((t_ms / period) % (static_cast<uint64_t>(std::max(0.0, span)) + 1));
+		default: return p.min;
+	}
+}
+
+static WORD toWord(double v) {
+	v = std::max(-32768.0, std::min(65535.0, v));
+	return static_cast<WORD>(static_cast<int32_t>(std::lround(v)));
+}
+
+static uint64_t nextRandom(uint64_t& s) {
+	s ^= s << 13;
+	s ^= s >> 7;
+	s ^= s << 17;
+	return s;
+}
+
+void Simulator::applyPattern(const PatternSpec& p, Endpoint& ep, const uint64_t t_ms, uint64_t& rng_state) {
+	WORD words[MODBUS_MAX_READ_REGISTERS];
+	BIT bits[MODBUS_MAX_READ_BITS];
+	const bool bit_table = p.table == SlaveTable::COILS || p.table == SlaveTable::DISCRETE_INPUTS;
+	const double threshold = (p.min + p.max) / 2;
+	const double step = std::max(1.0, (p.max - p.min) / 100);
+
+	for (int slave = std::max(1, p.first_slave); slave <= std::min(247, p.last_slave); slave++) {
+		data::Map* map = ep.handler.getMap(slave, p.table);
+		if (map == nullptr) continue;
+		const WORD first = std::max(p.start, map->getStartAdr());
+		const WORD last = std::min(p.end, map->getEndAdr());
+		if (first > last) continue;
+
+		for (uint32_t adr = first; adr <= last;) {
+			const WORD n = static_cast<WORD>(std::min<uint32_t>(last - adr + 1, bit_table ? MODBUS_MAX_READ_BITS : MODBUS_MAX_READ_REGISTERS));
+			if (bit_table) {
+				for (WORD i = 0; i < n; i++) {
+					const double v = patternValue(p, static_cast<WORD>(adr + i), t_ms);
+					bits[i] = p.max > p.min ? v > threshold : v != 0;
+				}
+				map->writeBits(static_cast<WORD>(adr), n, bits);
+			}
+			else if (p.kind == SimPattern::RANDOM_WALK) {
+				map->readWords(static_cast<WORD>(adr), n, words);
+				for (WORD i = 0; i < n; i++) {
+					double v = static_cast<int16_t>(words[i]);
+					if (p.min >= 0) v = words[i];
+					if (v < p.min || v > p.max) v = threshold;
+					else v += (nextRandom(rng_state) & 1) ? step : -step;
+					words[i] = toWord(std::max(p.min, std::min(p.max, v)));
+				}
+				map->writeWords(static_cast<WORD>(adr), n, words);
+			}
+			else {
+				for (WORD i = 0; i < n; i++) words[i] = toWord(patternValue(p, static_cast<WORD>(adr + i), t_ms));
+				map->writeWords(static_cast<WORD>(adr), n, words);
+			}
+			adr += n;
+		}
+	}
+}
+
+void Simulator::updateLoop() {
+	uint64_t rng_state = m_seed * 2654435761ull + 1;
+	std::unique_lock<std::mutex> lock(m_update_mtx);
+	while (m_running) {
+		m_update_cv.wait_for(lock, std::chrono::milliseconds(m_tick_ms), [this]() { return !m_running; });
+		if (!m_running) break;	// Карты после stop остаются в последнем опрошенном состоянии
+		const uint64_t t_ms = monoNs() / 1000000 - m_start_ms;
+		for (const PatternSpec& p : m_patterns) {
+			for (size_t i = 0; i < m_endpoints.size(); i++) {
+				if (p.endpoint < 0 || static_cast<size_t>(p.endpoint) == i) applyPattern(p, *m_endpoints[i], t_ms, rng_state);
+			}
+		}
+	}
+}
+
+/* Обработка запросов */
+
+size_t Simulator::process(Endpoint& ep, const BYTE unit_id, const BYTE* req, const size_t req_len, BYTE* resp, const bool tcp, bool& corrupt) {
+	std::uniform_real_distribution<double> u(0.0, 1.0);
+	ep.requests.fetch_add(1, std::memory_order_relaxed);
+	corrupt = false;
+
+	if (ep.faults.no_response_rate > 0 && u(ep.rng) < ep.faults.no_response_rate) {
+		ep.dropped.fetch_add(1, std::memory_order_relaxed);
+		return 0;
+	}
+
+	size_t len;
+	if (ep.faults.exception_rate > 0 && ep.handler.hasSlave(unit_id) && u(ep.rng) < ep.faults.exception_rate) {
+		len = pduException(resp, req[0], ep.faults.exception);
+		ep.exceptions.fetch_add(1, std::memory_order_relaxed);
+	}
+	else {
+		len = ep.handler.handle(unit_id, req, req_len, resp);
+		// Устройства нет: линия RTU молчит, сервер TCP отвечает как шлюз без целевого устройства
+		if (len == 0 && tcp && unit_id != 0) len = pduException(resp, req[0], ModbusExceptionCode::EXCEPTION_GATEWAY_TARGET);
+	}
+
+	if (len && ep.faults.corrupt_rate > 0 && u(ep.rng) < ep.faults.corrupt_rate) {
+		corrupt = true;
+		ep.corrupted.fetch_add(1, std::memory_order_relaxed);
+	}
+	return len;
+}
+
+uint64_t Simulator::sampleDelayNs(Endpoint& ep) {
+	const LatencyModel& l = ep.latency;
+	double ms = 0;
+	switch (l.kind) {
+		case SimLatency::NONE: return 0;
+		case SimLatency::FIXED: ms = l.a_ms; break;
+		case SimLatency::UNIFORM: ms = std::uniform_real_distribution<double>(l.a_ms, std::max(l.a_ms, l.b_ms))(ep.rng); break;
+		case SimLatency::NORMAL: ms = std::normal_distribution<double>(l.a_ms, std::max(0.0, l.b_ms))(ep.rng); break;
+		case SimLatency::EXPONENTIAL: ms = l.a_ms + (l.b_ms > 0 ? std::exponential_distribution<double>(1.0 / l.b_ms)(ep.rng) : 0); break;
+	}
+	return ms > 0 ? static_cast<uint64_t>(ms * 1e6) : 0;
+}
+
+void Simulator::sendResponse(Endpoint& ep, const int fd, const uint64_t gen, const BYTE* adu, const size_t len, const sockaddr_in* peer) {
+	ep.responses.fetch_add(1, std::memory_order_relaxed);
+	ep.bytes_out.fetch_add(len, std::memory_order_relaxed);
+
+	if (ep.kind == EndpointKind::PTY) {
+		if (::write(ep.pty_fd, adu, len) != static_cast<ssize_t>(len)) ep.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	if (ep.kind == EndpointKind::UDP) {
+		if (::sendto(fd, adu, len, 0, reinterpret_cast<const sockaddr*>(peer), sizeof(sockaddr_in)) != static_cast<ssize_t>(len)) ep.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	auto it = ep.conns.find(fd);
+	if (it == ep.conns.end() || it->second.gen != gen) return;
+	Conn& c = it->second;
+	size_t sent = 0;
+	if (c.out.empty()) {
+		ssize_t n = ::send(fd, adu, len, MSG_NOSIGNAL);
+		if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			closeConn(ep, fd);
+			return;
+		}
+		sent = n > 0 ? static_cast<size_t>(n) : 0;
+		if (sent == len) return;
+		epoll_event ev = {};
+		ev.events = EPOLLIN | EPOLLOUT;
+		ev.data.fd = fd;
+		epoll_ctl(ep.epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+	}
+	c.out.insert(c.out.end(), adu + sent, adu + len);
+}
+
+void Simulator::flushOut(Endpoint& ep, const int fd) {
+	auto it = ep.conns.find(fd);
+	if (it == ep.conns.end()) return;
+	Conn& c = it->second;
+	while (!c.out.empty()) {
+		ssize_t n = ::send(fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+			closeConn(ep, fd);
+			return;
+		}
+		c.out.erase(c.out.begin(), c.out.begin() + n);
+	}
+	epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	epoll_ctl(ep.epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void Simulator::flushDue(Endpoint& ep, const uint64_t now_ns) {
+	while (!ep.pending.empty() && ep.pending.top().due_ns <= now_ns) {
+		const Pending& p = ep.pending.top();
+		sendResponse(ep, p.fd, p.gen, p.adu, p.len, &p.peer);
+		ep.pending.pop();
+	}
+}
+
+void Simulator::queueResponse(Endpoint& ep, const int fd, const BYTE* adu, const size_t len, const uint64_t due_ns, const uint64_t now_ns, const sockaddr_in* peer) {
+	uint64_t gen = 0;
+	if (ep.kind == EndpointKind::TCP || ep.kind == EndpointKind::RTU_TCP) {
+		auto it = ep.conns.find(fd);
+		if (it == ep.conns.end()) return;
+		gen = it->second.gen;
+	}
+	if (due_ns <= now_ns) {
+		flushDue(ep, now_ns);	// Ранее отложенные ответы, время которых наступило, уходят первыми
+		sendResponse(ep, fd, gen, adu, len, peer);
+		return;
+	}
+	Pending p;
+	p.due_ns = due_ns;
+	p.seq = ep.next_seq++;
+	p.fd = fd;
+	p.gen = gen;
+	if (peer) p.peer = *peer;
+	p.len = static_cast<uint16_t>(len);
+	memcpy(p.adu, adu, len);
+	ep.pending.push(p);
+}
+
+void Simulator::closeConn(Endpoint& ep, const int fd) {
+	epoll_ctl(ep.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+	::close(fd);
+	ep.conns.erase(fd);
+}
+
+void Simulator::readConn(Endpoint& ep, const int fd) {
+	auto it = ep.conns.find(fd);
+	if (it == ep.conns.end()) return;
+	Conn& c = it->second;
+	BYTE resp[MODBUS_MAX_ADU_LENGTH];
+
+	for (;;) {
+		ssize_t n = ::recv(fd, c.in.data() + c.have, c.in.size() - c.have, 0);
+		if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+			closeConn(ep, fd);
+			return;
+		}
+		if (n < 0) return;
+		c.have += n;
+		ep.bytes_in.fetch_add(n, std::memory_order_relaxed);
+
+		// Запросы могут идти подряд без ожидания ответов
+		const uint64_t now = monoNs();
+		size_t pos = 0;
+		while (c.have > pos) {
+			const BYTE* req = c.in.data() + pos;
+			const size_t avail = c.have - pos;
+			bool corrupt;
+			size_t len = 0;
+			if (ep.kind == EndpointKind::RTU_TCP) {
+				// Кадры RTU в потоке: границы определяются по функции, как на линии
+				const size_t need = rtuRequestLength(req, avail);
+				if (need == 0 || avail < need) break;
+				if (need > MODBUS_MAX_ADU_LENGTH || !rtuCheck(req, need)) {
+					pos = c.have;		// Помеха - принятые байты отбрасываются, клиент повторит запрос
+					break;
+				}
+				const size_t pdu_len = process(ep, req[0], req + RTU_HEADER_SIZE, need - RTU_HEADER_SIZE - RTU_CRC_SIZE, resp + RTU_HEADER_SIZE, false, corrupt);
+				pos += need;
+				if (pdu_len == 0) continue;
+				resp[0] = req[0];
+				len = rtuFinish(resp, RTU_HEADER_SIZE + pdu_len);
+				if (corrupt) resp[len - 1] ^= 0xFF;
+			}
+			else {
+				if (avail < TCP_HEADER_SIZE) break;
+				MbapHeader h;
+				if (!mbapDecode(req, TCP_HEADER_SIZE, h)) {
+					closeConn(ep, fd);
+					return;
+				}
+				const size_t total = TCP_HEADER_SIZE - 1 + h.length;
+				if (avail < total) break;
+
+				const size_t pdu_len = process(ep, h.unit_id, req + TCP_HEADER_SIZE, h.length - 1, resp + TCP_HEADER_SIZE, true, corrupt);
+				pos += total;
+				if (pdu_len == 0) continue;
+				mbapEncode(resp, corrupt ? static_cast<WORD>(h.transaction_id ^ 0x5A5A) : h.transaction_id, h.unit_id, pdu_len);
+				len = TCP_HEADER_SIZE + pdu_len;
+			}
+
+			const uint64_t due = std::max(now + sampleDelayNs(ep), c.last_due_ns);
+			c.last_due_ns = due;
+			queueResponse(ep, fd, resp, len, due, now);
+			// Отправка могла закрыть соединение
+			it = ep.conns.find(fd);
+			if (it == ep.conns.end()) return;
+		}
+		if (pos) {
+			memmove(c.in.data(), c.in.data() + pos, c.have - pos);
+			c.have -= pos;
+		}
+	}
+}
+
+void Simulator::readPty(Endpoint& ep) {
+	BYTE resp[MODBUS_MAX_ADU_LENGTH];
+	for (;;) {
+		const uint64_t now = monoNs();
+		if (ep.have && now - ep.last_rx_ns > RTU_GAP_NS) ep.have = 0;
+		ssize_t n = ::read(ep.pty_fd, ep.rx + ep.have, sizeof(ep.rx) - ep.have);
+		if (n <= 0) return;
+		ep.have += n;
+		ep.last_rx_ns = now;
+		ep.bytes_in.fetch_add(n, std::memory_order_relaxed);
+
+		while (ep.have >= 2) {
+			const size_t need = rtuRequestLength(ep.rx, ep.have);
+			if (need == 0 || ep.have < need) break;
+			if (need > MODBUS_MAX_ADU_LENGTH || !rtuCheck(ep.rx, need)) {
+				ep.have = 0;		// Помеха на линии - ждем паузы и следующего кадра
+				break;
+			}
+
+			bool corrupt;
+			const size_t pdu_len = process(ep, ep.rx[0], ep.rx + RTU_HEADER_SIZE, need - RTU_HEADER_SIZE - RTU_CRC_SIZE, resp + RTU_HEADER_SIZE, false, corrupt);
+			if (pdu_len) {
+				resp[0] = ep.rx[0];
+				const size_t len = rtuFinish(resp, RTU_HEADER_SIZE + pdu_len);
+				if (corrupt) resp[len - 1] ^= 0xFF;
+				const uint64_t due = std::max(now + sampleDelayNs(ep), ep.line_free_ns);
+				ep.line_free_ns = due;
+				queueResponse(ep, ep.pty_fd, resp, len, due, now);
+			}
+			memmove(ep.rx, ep.rx + need, ep.have - need);
+			ep.have -= need;
+		}
+	}
+}
+
+// Датаграммы принимаются и ответы без задержки отправляются пачками: один recvmmsg и один sendmmsg на пачку
+void Simulator::readUdp(Endpoint& ep) {
+	BYTE in[UDP_BATCH][MODBUS_MAX_ADU_LENGTH];
+	BYTE out[UDP_BATCH][MODBUS_MAX_ADU_LENGTH];
+	sockaddr_in from[UDP_BATCH];
+	iovec in_iov[UDP_BATCH], out_iov[UDP_BATCH];
+	mmsghdr in_msgs[UDP_BATCH], out_msgs[UDP_BATCH];
+
+	for (;;) {
+		for (size_t i = 0; i < UDP_BATCH; i++) {
+			in_iov[i] = { in[i], MODBUS_MAX_ADU_LENGTH };
+			in_msgs[i].msg_hdr = msghdr();
+			in_msgs[i].msg_hdr.msg_name = &from[i];
+			in_msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			in_msgs[i].msg_hdr.msg_iov = &in_iov[i];
+			in_msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		const int n = ::recvmmsg(ep.listen_fd, in_msgs, UDP_BATCH, MSG_DONTWAIT, nullptr);
+		if (n <= 0) return;
+
+		const uint64_t now = monoNs();
+		unsigned ready = 0;
+		for (int i = 0; i < n; i++) {
+			const size_t len = in_msgs[i].msg_len;
+			ep.bytes_in.fetch_add(len, std::memory_order_relaxed);
+			MbapHeader h;
+			if (!mbapDecode(in[i], len, h) || static_cast<size_t>(TCP_HEADER_SIZE - 1 + h.length) != len) continue;	// Не кадр MBAP
+
+			bool corrupt;
+			const size_t pdu_len = process(ep, h.unit_id, in[i] + TCP_HEADER_SIZE, h.length - 1, out[ready] + TCP_HEADER_SIZE, true, corrupt);
+			if (pdu_len == 0) continue;
+			mbapEncode(out[ready], corrupt ? static_cast<WORD>(h.transaction_id ^ 0x5A5A) : h.transaction_id, h.unit_id, pdu_len);
+			const size_t out_len = TCP_HEADER_SIZE + pdu_len;
+
+			// Порядок ответов в UDP не важен: отложенные ответы уходят из очереди по времени
+			const uint64_t due = now + sampleDelayNs(ep);
+			if (due > now) {
+				queueResponse(ep, ep.listen_fd, out[ready], out_len, due, now, &from[i]);
+				continue;
+			}
+			out_iov[ready] = { out[ready], out_len };
+			out_msgs[ready].msg_hdr = msghdr();
+			out_msgs[ready].msg_hdr.msg_name = &from[i];
+			out_msgs[ready].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			out_msgs[ready].msg_hdr.msg_iov = &out_iov[ready];
+			out_msgs[ready].msg_hdr.msg_iovlen = 1;
+			ep.responses.fetch_add(1, std::memory_order_relaxed);
+			ep.bytes_out.fetch_add(out_len, std::memory_order_relaxed);
+			ready++;
+		}
+		for (unsigned sent = 0; sent < ready;) {
+			const int r = ::sendmmsg(ep.listen_fd, out_msgs + sent, ready - sent, 0);
+			if (r > 0) {
+				sent += r;
+				continue;
+			}
+			if (r < 0 && errno == EINTR) continue;
+			ep.dropped.fetch_add(1, std::memory_order_relaxed);	// Датаграмма не отправлена - клиент увидит таймаут
+			sent++;
+		}
+		if (n < static_cast<int>(UDP_BATCH)) return;
+	}
+}
+
+void Simulator::loop(Endpoint& ep) {
+	epoll_event events[64];
+	while (m_running) {
+		const uint64_t now = monoNs();
+		flushDue(ep, now);
+		int wait_ms = MAX_WAIT_MS;
+		if (!ep.pending.empty()) wait_ms = static_cast<int>(std::min<uint64_t>(MAX_WAIT_MS, (ep.pending.top().due_ns - now + 999999) / 1000000));
+
+		const int n = epoll_wait(ep.epoll_fd, events, 64, wait_ms);
+		for (int i = 0; i < n; i++) {
+			const int fd = events[i].data.fd;
+			if (fd == ep.wake_fd) {
+				uint64_t v;
+				if (::read(ep.wake_fd, &v, sizeof(v)) < 0) {}
+			}
+			else if (fd == ep.listen_fd) {
+				if (ep.kind == EndpointKind::UDP) readUdp(ep);
+				else acceptConns(ep);
+			}
+			else if (fd == ep.pty_fd) readPty(ep);
+			else {
+				if (events[i].events & EPOLLOUT) flushOut(ep, fd);
+				if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) readConn(ep, fd);
+			}
+		}
+	}
+}
+
+// Прием всех ожидающих подключений
+void Simulator::acceptConns(Endpoint& ep) {
+	for (;;) {
+		int fd = ::accept4(ep.listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+		if (fd < 0) return;
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		epoll_event ev = {};
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		if (epoll_ctl(ep.epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+			::close(fd);
+			continue;
+		}
+		Conn& c = ep.conns[fd];
+		c = Conn();
+		c.gen = ep.next_gen++;
+		c.in.resize(CONN_BUFFER);
+		ep.connections.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+/* Запуск */
+
+bool Simulator::start() {
+	if (m_running || m_endpoints.empty()) return false;
+
+	for (size_t i = 0; i < m_endpoints.size(); i++) {
+		Endpoint& ep = *m_endpoints[i];
+		ep.rng.seed(m_seed + i);
+		ep.epoll_fd = epoll_create1(0);
+		ep.wake_fd = eventfd(0, EFD_NONBLOCK);
+		if (ep.epoll_fd < 0 || ep.wake_fd < 0) return false;
+		const int fds[] = { ep.wake_fd, ep.kind == EndpointKind::PTY ? ep.pty_fd : ep.listen_fd };
+		for (int fd : fds) {
+			epoll_event ev = {};
+			ev.events = EPOLLIN;
+			ev.data.fd = fd;
+			epoll_ctl(ep.epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+		}
+	}
+
+	// Начальные значения шаблонов записываются до первого запроса
+	m_start_ms = monoNs() / 1000000;
+	uint64_t rng_state = m_seed * 2654435761ull + 1;
+	for (const PatternSpec& p : m_patterns) {
+		for (size_t i = 0; i < m_endpoints.size(); i++) {
+			if (p.endpoint < 0 || static_cast<size_t>(p.endpoint) == i) applyPattern(p, *m_endpoints[i], 0, rng_state);
+		}
+	}
+
+	m_running = true;
+	for (auto& ep : m_endpoints) ep->thread = std::thread(&Simulator::loop, this, std::ref(*ep));
+	if (!m_patterns.empty()) m_update_thread = std::thread(&Simulator::updateLoop, this);
+	return true;
+}
+
+void Simulator::stop() {
+	if (!m_running.exchange(false)) return;
+	{
+		std::lock_guard<std::mutex> lock(m_update_mtx);
+		m_update_cv.notify_all();
+	}
+	if (m_update_thread.joinable()) m_update_thread.join();
+
+	for (auto& ep : m_endpoints) {
+		uint64_t one = 1;
+		if (::write(ep->wake_fd, &one, sizeof(one)) < 0) {}
+		if (ep->thread.joinable()) ep->thread.join();
+		for (auto& c : ep->conns) ::close(c.first);
+		ep->conns.clear();
+		ep->pending = decltype(ep->pending)();
+		::close(ep->epoll_fd);
+		::close(ep->wake_fd);
+		ep->epoll_fd = ep->wake_fd = -1;
+	}
+}
+
+} // modbus
+} // mb
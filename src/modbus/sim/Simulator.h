@@ -0,0 +1,183 @@
+#ifndef MB_SIMULATOR_H
+#define MB_SIMULATOR_H
+
+#include "ModbusDefs.h"
+#include "SlaveHandler.h"
+#include "Map.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct sockaddr_in;
+
+namespace mb {
+namespace modbus {
+
+/** @brief Распределение задержки ответа */
+enum class SimLatency {
+	NONE,
+	FIXED,			// a_ms
+	UNIFORM,			// [a_ms, b_ms]
+	NORMAL,			// Среднее a_ms, СКО b_ms (отрицательные значения - 0)
+	EXPONENTIAL,	// a_ms + экспонента со средним b_ms (длинный хвост)
+};
+
+/** @brief Задержка ответа точки подключения */
+struct LatencyModel {
+	SimLatency kind = SimLatency::NONE;
+	double a_ms = 0;
+	double b_ms = 0;
+};
+
+/** @brief Внесение ошибок: доли запросов от 0 до 1 */
+struct FaultModel {
+	double exception_rate = 0;		// Ответ исключением exception вместо данных
+	ModbusExceptionCode exception = ModbusExceptionCode::EXCEPTION_SLAVE_OR_SERVER_BUSY;
+	double no_response_rate = 0;	// Запрос остается без ответа (таймаут у опрашивающего)
+	double corrupt_rate = 0;		// RTU - неверная CRC, TCP - чужой номер транзакции
+};
+
+/** @brief Размер таблиц виртуального устройства, 0 - таблицы нет */
+struct SimLayout {
+	WORD coils = 0;
+	WORD discrete = 0;
+	WORD holding = 100;
+	WORD input = 100;
+};
+
+/** @brief Закон изменения значений регистров во времени */
+enum class SimPattern {
+	CONST,			// min
+	RAMP,				// Пила от min до max за period_ms
+	SINE,				// Синусоида между min и max с периодом period_ms, фаза сдвигается по адресу
+	SQUARE,			// Первую половину периода min, вторую max
+	RANDOM_WALK,	// Случайное блуждание с шагом 1% диапазона в пределах [min, max]
+	COUNTER,			// min + номер периода, по модулю (max - min + 1)
+};
+
+/** @brief Шаблон значений для адресов [start-end] таблицы устройств [first_slave-last_slave] точки endpoint */
+struct PatternSpec {
+	int endpoint = -1;	// -1 - все точки подключения
+	int first_slave = 1;
+	int last_slave = 247;
+	SlaveTable table = SlaveTable::HOLDING_REGISTERS;
+	WORD start = 0;
+	WORD end = 0;
+	SimPattern kind = SimPattern::CONST;
+	double min = 0;
+	double max = 0;
+	uint32_t period_ms = 1000;
+};
+
+/** @brief Счетчики симулятора */
+struct SimStats {
+	uint64_t requests;
+	uint64_t responses;
+	uint64_t exceptions;	// Внесенные исключения (исключения SlaveHandler считаются ответами)
+	uint64_t dropped;		// Запросы без ответа
+	uint64_t corrupted;
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint64_t connections;
+};
+
+/** @brief Симулятор ведомых устройств Modbus для нагрузочных испытаний.
+	Точки подключения - сервер Modbus TCP, RTU поверх TCP или Modbus UDP на loopback либо псевдотерминал RTU, на каждой до 247 виртуальных устройств
+	со своими картами Map, поэтому тысячи устройств - это несколько десятков точек.
+	Каждая точка обслуживается одним потоком epoll без блокировок на запрос: задержка ответа не занимает поток,
+	ответ ставится в очередь по времени готовности. Порядок ответов в соединении TCP и на линии RTU сохраняется.
+	Шаблоны значений применяет отдельный поток раз в tick_ms, запись идет через Map, поэтому опрос и обновление
+	не мешают друг другу дольше одной операции с картой.
+	Настройка - методами add.../set... или сценарием loadScript (формат в Simulator.cpp) до start */
+class Simulator {
+public:
+	Simulator();
+	~Simulator();
+
+	Simulator(const Simulator&) = delete;
+	Simulator& operator=(const Simulator&) = delete;
+
+	// Точка подключения, возвращает ее номер или -1. port = 0 - свободный порт (см. getPort)
+	int addTcp(const std::string& bind_adr, const uint16_t port);
+	// Сервер TCP с кадрами RTU (шлюз последовательной линии, для RtuTcpTransport)
+	int addRtuTcp(const std::string& bind_adr, const uint16_t port);
+	// Modbus UDP: кадры MBAP в датаграммах (для UdpTransport)
+	int addUdp(const std::string& bind_adr, const uint16_t port);
+	// Псевдотерминал, путь ведомой стороны для RtuTransport - getEndpointName
+	int addPty();
+
+	bool addSlaves(const int endpoint, const int first_slave, const int last_slave, const SimLayout& layout);
+	bool setLatency(const int endpoint, const LatencyModel& latency);
+	bool setFaults(const int endpoint, const FaultModel& faults);
+	bool addPattern(const PatternSpec& pattern);
+	void setTick(const uint32_t tick_ms) { m_tick_ms = tick_ms ? tick_ms : 1; }
+	void setSeed(const uint64_t seed) { m_seed = seed; }
+
+	// Настройка текстом сценария, при ошибке - false и getError с номером строки
+	bool loadScript(const std::string& text);
+	bool loadScriptFile(const std::string& path);
+	const std::string& getError() const { return m_error; }
+
+	bool start();
+	void stop();
+	bool isRunning() const { return m_running; }
+
+	size_t getEndpointCount() const { return m_endpoints.size(); }
+	std::string getEndpointName(const int endpoint) const;
+	uint16_t getPort(const int endpoint) const;
+	size_t getSlaveCount() const;
+	data::Map* getMap(const int endpoint, const int slave_id, const SlaveTable table);
+
+	SimStats getStats() const;
+
+	// Значение шаблона (кроме RANDOM_WALK) для адреса adr через t_ms после start
+	static double patternValue(const PatternSpec& pattern, const WORD adr, const uint64_t t_ms);
+
+private:
+	enum class EndpointKind : uint8_t;
+	struct Endpoint;
+
+	int addSocket(const std::string& bind_adr, const uint16_t port, const EndpointKind kind);
+	Endpoint* endpointAt(const int endpoint) const;
+	void loop(Endpoint& ep);
+	void updateLoop();
+	void applyPattern(const PatternSpec& pattern, Endpoint& ep, const uint64_t t_ms, uint64_t& rng_state);
+
+	// Обработка PDU запроса с внесением ошибок, возвращает длину PDU ответа (0 - без ответа)
+	static size_t process(Endpoint& ep, const BYTE unit_id, const BYTE* req_pdu, const size_t req_len, BYTE* resp_pdu, const bool tcp, bool& corrupt);
+	static uint64_t sampleDelayNs(Endpoint& ep);
+	// Отправка ответов, время которых наступило
+	static void flushDue(Endpoint& ep, const uint64_t now_ns);
+	// peer - адрес клиента UDP
+	static void queueResponse(Endpoint& ep, const int fd, const BYTE* adu, const size_t len, const uint64_t due_ns, const uint64_t now_ns, const sockaddr_in* peer = nullptr);
+	static void sendResponse(Endpoint& ep, const int fd, const uint64_t gen, const BYTE* adu, const size_t len, const sockaddr_in* peer = nullptr);
+	static void flushOut(Endpoint& ep, const int fd);
+	static void closeConn(Endpoint& ep, const int fd);
+	static void readConn(Endpoint& ep, const int fd);
+	static void readPty(Endpoint& ep);
+	static void readUdp(Endpoint& ep);
+	static void acceptConns(Endpoint& ep);
+
+	std::vector<std::unique_ptr<Endpoint>> m_endpoints;
+	std::vector<PatternSpec> m_patterns;
+	uint32_t m_tick_ms;
+	uint64_t m_seed;
+	std::string m_error;
+
+	std::atomic<bool> m_running;
+	uint64_t m_start_ms;
+	std::thread m_update_thread;
+	std::mutex m_update_mtx;
+	std::condition_variable m_update_cv;
+};
+
+} // modbus
+} // mb
+
+#endif // MB_SIMULATOR_H
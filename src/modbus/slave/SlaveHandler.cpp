@@ -0,0 +1,96 @@
+#include "SlaveHandler.h"
+#include "ModbusFrame.h"
+
+namespace mb {
+namespace modbus {
+
+SlaveHandler::SlaveHandler() {
+	for (auto& tables : m_maps) tables.fill(nullptr);
+}
+
+bool SlaveHandler::setMap(const int slave_id, const SlaveTable table, data::Map* map) {
+	if (slave_id < 0 || slave_id > 255 || table == SlaveTable::COUNT) return false;
+	m_maps[slave_id][static_cast<size_t>(table)] = map;
+	return true;
+}
+
+data::Map* SlaveHandler::getMap(const int slave_id, const SlaveTable table) {
+	if (slave_id < 0 || slave_id > 255 || table == SlaveTable::COUNT) return nullptr;
+	return m_maps[slave_id][static_cast<size_t>(table)];
+}
+
+bool SlaveHandler::hasSlave(const int slave_id) const {
+	if (slave_id < 0 || slave_id > 255) return false;
+	for (data::Map* map : m_maps[slave_id]) if (map) return true;
+	return false;
+}
+
+SlaveTable SlaveHandler::tableOf(const BYTE func) {
+	switch (func) {
+		case 1: case 5: case 15: return SlaveTable::COILS;
+		case 2: return SlaveTable::DISCRETE_INPUTS;
+		case 3: case 6: case 16: return SlaveTable::HOLDING_REGISTERS;
+		case 4: return SlaveTable::INPUT_REGISTERS;
+		default: return SlaveTable::COUNT;
+	}
+}
+
+size_t SlaveHandler::handle(const BYTE slave_id, const BYTE* req, const size_t req_len, BYTE* resp) {
+	if (req_len < 1 || !hasSlave(slave_id)) return 0;
+
+	const BYTE func = req[0];
+	SlaveTable table = tableOf(func);
+	if (table == SlaveTable::COUNT) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_FUNCTION);
+	if (req_len < 5) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE);
+
+	data::Map* map = m_maps[slave_id][static_cast<size_t>(table)];
+	if (map == nullptr) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_ADDRESS);
+
+	const WORD adr = getWordBE(req + 1);
+	const WORD val = getWordBE(req + 3); // Количество для групповых функций
+	bool ok = false;
+
+	switch (func) {
+		case 1: case 2:
+			if (val == 0 || val > MODBUS_MAX_READ_BITS) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE);
+			if (!map->readBits(adr, val, m_bits)) break;
+			return pduReadBitsResponse(resp, func, val, m_bits);
+
+		case 3: case 4:
+			if (val == 0 || val > MODBUS_MAX_READ_REGISTERS) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE);
+			if (!map->readWords(adr, val, m_words)) break;
+			return pduReadWordsResponse(resp, func, val, m_words);
+
+		case 5:
+			if (val != 0xFF00 && val != 0x0000) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE);
+			ok = map->writeBit(adr, val ? 1 : 0);
+			break;
+
+		case 6:
+			ok = map->writeWord(adr, val);
+			break;
+
+		case 15:
+			if (val == 0 || val > MODBUS_MAX_WRITE_BITS || req_len < 6 + static_cast<size_t>((val + 7) / 8)) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE);
+			unpackBits(req + 6, val, m_bits);
+			ok = map->writeBits(adr, val, m_bits);
+			break;
+
+		case 16:
+			if (val == 0 || val > MODBUS_MAX_WRITE_REGISTERS || req_len < 6 + static_cast<size_t>(val * 2)) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_VALUE);
+			for (WORD i = 0; i < val; i++) m_words[i] = getWordBE(req + 6 + i * 2);
+			ok = map->writeWords(adr, val, m_words);
+			break;
+	}
+
+	if (!ok) return pduException(resp, func, ModbusExceptionCode::EXCEPTION_ILLEGAL_DATA_ADDRESS);
+
+	// Ответ на запись - эхо адреса и значения/количества
+	resp[0] = func;
+	putWordBE(resp + 1, adr);
+	putWordBE(resp + 3, val);
+	return 5;
+}
+
+} // modbus
+} // mb
@@ -0,0 +1,50 @@
+#ifndef MB_SLAVE_HANDLER_H
+#define MB_SLAVE_HANDLER_H
+
+#include "ModbusDefs.h"
+#include "Map.h"
+
+#include <array>
+
+namespace mb {
+namespace modbus {
+
+/** @brief Тип карты памяти устройства (таблица Modbus) */
+enum class SlaveTable {
+	COILS,					// func 1, 5, 15
+	DISCRETE_INPUTS,		// func 2
+	HOLDING_REGISTERS,	// func 3, 6, 16
+	INPUT_REGISTERS,		// func 4
+	COUNT
+};
+
+/** @brief Обработчик запросов ведомого устройства поверх карт памяти Map.
+	Маршрутизация (slave_id, таблица) -> Map выполняется прямой таблицей без поиска.
+	Адреса карт совпадают с адресами Modbus. Обращение вне карты - исключение ILLEGAL_DATA_ADDRESS */
+class SlaveHandler {
+public:
+	SlaveHandler();
+	~SlaveHandler() {}
+
+	// Привязка карты к устройству, карта должна жить дольше обработчика
+	bool setMap(const int slave_id, const SlaveTable table, data::Map* map);
+	data::Map* getMap(const int slave_id, const SlaveTable table);
+	// Есть ли у устройства хотя бы одна карта (иначе устройство не отвечает)
+	bool hasSlave(const int slave_id) const;
+
+	// Обработка PDU запроса, возвращает длину PDU ответа, 0 - ответа нет
+	size_t handle(const BYTE slave_id, const BYTE* req_pdu, const size_t req_len, BYTE* resp_pdu);
+
+	static SlaveTable tableOf(const BYTE func);
+
+private:
+	std::array<std::array<data::Map*, static_cast<size_t>(SlaveTable::COUNT)>, 256> m_maps;
+
+	BIT m_bits[MODBUS_MAX_READ_BITS];
+	WORD m_words[MODBUS_MAX_READ_REGISTERS];
+};
+
+} // modbus
+} // mb
+
+#endif // MB_SLAVE_HANDLER_H
@@ -0,0 +1,210 @@
+#include "FrameTrace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace mb {
+namespace modbus {
+
+constexpr size_t MIN_TRACE_CAPACITY = 4096;
+constexpr unsigned TRACE_SPIN_LIMIT = 64;	// Попыток захвата с паузой процессора до уступки кванта планировщику
+
+// Ожидание освобождения блокировки записи: владелец держит ее на время копирования одного кадра,
+// но если он вытеснен, крутиться бессмысленно - после TRACE_SPIN_LIMIT попыток поток уступает процессор
+static void spinWait(unsigned& spins) {
+	if (spins++ < TRACE_SPIN_LIMIT) {
+#if defined(__x86_64__) || defined(__i386__)
+		_mm_pause();
+#endif
+	}
+	else sched_yield();
+}
+
+static uint64_t clockNs(clockid_t clock) {
+	timespec ts;
+	clock_gettime(clock, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+/* FrameTrace */
+
+FrameTrace::FrameTrace() : m_header(nullptr), m_ring(nullptr), m_map_size(0) {}
+
+FrameTrace::~FrameTrace() { close(); }
+
+uint64_t FrameTrace::monoNs() {
+	return clockNs(CLOCK_MONOTONIC);
+}
+
+bool FrameTrace::open(const std::string& path, size_t capacity) {
+	close();
+	capacity = std::max(capacity, MIN_TRACE_CAPACITY) & ~size_t(TRACE_ALIGN - 1);
+	size_t map_size = sizeof(TraceFileHeader) + capacity;
+
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return false;
+	if (ftruncate(fd, static_cast<off_t>(map_size)) != 0) {
+		::close(fd);
+		return false;
+	}
+	void* p = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED) return false;
+
+	m_header = new (p) TraceFileHeader();
+	memcpy(m_header->magic, TRACE_MAGIC, 4);
+	m_header->version = TRACE_VERSION;
+	m_header->capacity = capacity;
+	m_header->start_mono_ns = clockNs(CLOCK_MONOTONIC);
+	m_header->start_real_ns = clockNs(CLOCK_REALTIME);
+	m_header->head.store(0);
+	m_header->tail.store(0);
+	m_header->frames.store(0);
+	m_header->reserved = 0;
+	m_ring = static_cast<BYTE*>(p) + sizeof(TraceFileHeader);
+	m_map_size = map_size;
+	return true;
+}
+
+void FrameTrace::close() {
+	if (m_header == nullptr) return;
+	munmap(m_header, m_map_size);
+	m_header = nullptr;
+	m_ring = nullptr;
+	m_map_size = 0;
+}
+
+void FrameTrace::write(const uint16_t line_id, const TraceDir dir, const TraceKind kind, const BYTE* frame, const size_t len, const uint8_t status) {
+	if (m_header == nullptr) return;
+	const size_t n = std::min<size_t>(len, MODBUS_MAX_ADU_LENGTH);
+	const uint64_t cap = m_header->capacity;
+	const uint64_t size = recordSize(n);
+	const uint64_t ts = monoNs();
+
+	unsigned spins = 0;
+	while (m_lock.test_and_set(std::memory_order_acquire)) spinWait(spins);
+
+	uint64_t head = m_header->head.load(std::memory_order_relaxed);
+	uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+	uint64_t pos = head % cap;
+	const uint64_t pad = pos + size > cap ? cap - pos : 0;	// Запись не разрывается концом кольца
+
+	// Освобождение места: самые старые записи отбрасываются
+	while (head + pad + size - tail > cap) {
+		const TraceRecord* old = reinterpret_cast<const TraceRecord*>(m_ring + tail % cap);
+		tail += recordSize(old->len);
+	}
+	m_header->tail.store(tail, std::memory_order_release);
+
+	if (pad) {
+		TraceRecord* r = reinterpret_cast<TraceRecord*>(m_ring + pos);
+		*r = TraceRecord{ 0, 0, static_cast<uint16_t>(pad - sizeof(TraceRecord)), TraceDir::PAD, kind, 0, 0 };
+		head += pad;
+		pos = 0;
+	}
+
+	TraceRecord* r = reinterpret_cast<TraceRecord*>(m_ring + pos);
+	*r = TraceRecord{ ts, line_id, static_cast<uint16_t>(n), dir, kind, status, 0 };
+	memcpy(r + 1, frame, n);
+
+	m_header->head.store(head + size, std::memory_order_release);
+	m_header->frames.store(m_header->frames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	m_lock.clear(std::memory_order_release);
+}
+
+/* FrameTraceReader */
+
+FrameTraceReader::FrameTraceReader() : m_header(nullptr), m_ring(nullptr), m_map_size(0), m_pos(0), m_end(0) {}
+
+FrameTraceReader::~FrameTraceReader() { close(); }
+
+bool FrameTraceReader::open(const std::string& path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		m_error = "can't open file";
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(TraceFileHeader)) {
+		::close(fd);
+		m_error = "file too small";
+		return false;
+	}
+	void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED) {
+		m_error = "mmap failed";
+		return false;
+	}
+	m_header = static_cast<const TraceFileHeader*>(p);
+	m_map_size = st.st_size;
+
+	if (memcmp(m_header->magic, TRACE_MAGIC, 4) != 0 || m_header->version != TRACE_VERSION) {
+		m_error = "not a frame trace";
+		close();
+		return false;
+	}
+	if (m_header->capacity == 0 || m_header->capacity % TRACE_ALIGN || sizeof(TraceFileHeader) + m_header->capacity > m_map_size) {
+		m_error = "bad ring size";
+		close();
+		return false;
+	}
+	m_ring = static_cast<const BYTE*>(p) + sizeof(TraceFileHeader);
+	rewind();
+	return true;
+}
+
+void FrameTraceReader::close() {
+	if (m_header) munmap(const_cast<TraceFileHeader*>(m_header), m_map_size);
+	m_header = nullptr;
+	m_ring = nullptr;
+	m_map_size = 0;
+	m_pos = m_end = 0;
+}
+
+void FrameTraceReader::rewind() {
+	if (m_header == nullptr) return;
+	m_end = m_header->head.load(std::memory_order_acquire);
+	m_pos = m_header->tail.load(std::memory_order_acquire);
+	if (m_end < m_pos || m_end - m_pos > m_header->capacity) m_pos = m_end;
+}
+
+bool FrameTraceReader::next(TraceFrame& frame) {
+	const uint64_t cap = m_header ? m_header->capacity : 0;
+	while (m_pos < m_end) {
+		const TraceRecord* r = reinterpret_cast<const TraceRecord*>(m_ring + m_pos % cap);
+		const uint64_t size = FrameTrace::recordSize(r->len);
+		if (m_pos % cap + size > cap || (r->dir != TraceDir::PAD && r->len > MODBUS_MAX_ADU_LENGTH)) {
+			m_error = "corrupted record";
+			m_pos = m_end;
+			return false;
+		}
+		m_pos += size;
+		if (r->dir == TraceDir::PAD) continue;
+
+		frame.ts_ns = r->ts_ns - m_header->start_mono_ns;
+		frame.line_id = r->line_id;
+		frame.dir = r->dir;
+		frame.kind = r->kind;
+		frame.status = r->status;
+		frame.data = reinterpret_cast<const BYTE*>(r + 1);
+		frame.len = r->len;
+		return true;
+	}
+	return false;
+}
+
+} // modbus
+} // mb
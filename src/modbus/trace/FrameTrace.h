@@ -0,0 +1,132 @@
+#ifndef MB_FRAME_TRACE_H
+#define MB_FRAME_TRACE_H
+
+#include "ModbusDefs.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace mb {
+namespace modbus {
+
+/** @brief Направление кадра */
+enum class TraceDir : uint8_t {
+	TX = 1,
+	RX = 2,
+	PAD = 0xFF,		// Заполнитель до конца кольца, кадра нет
+};
+
+/** @brief Вид кадра (где в кадре начинается PDU) */
+enum class TraceKind : uint8_t {
+	RTU = 1,
+	TCP = 2,
+};
+
+#define TRACE_MAGIC "MBTR"
+#define TRACE_VERSION 1
+#define TRACE_ALIGN 16
+
+/** @brief Заголовок файла трассировки. Файл: заголовок, затем кольцо записей размером capacity байт.
+	head и tail - сквозные (не по модулю) смещения в кольце: записи лежат в [tail, head), позиция в кольце - смещение % capacity */
+struct TraceFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t capacity;
+	uint64_t start_mono_ns;					// CLOCK_MONOTONIC на момент создания файла
+	uint64_t start_real_ns;					// CLOCK_REALTIME на тот же момент, для перевода меток во время суток
+	std::atomic<uint64_t> head;
+	std::atomic<uint64_t> tail;			// Самая старая запись, сдвигается при перезаписи кольца
+	std::atomic<uint64_t> frames;			// Всего записано кадров (включая перезаписанные)
+	uint64_t reserved;
+};
+
+static_assert(sizeof(TraceFileHeader) == 64, "TraceFileHeader layout");
+
+/** @brief Запись кадра, за ней байты кадра, выровненные до TRACE_ALIGN */
+struct TraceRecord {
+	uint64_t ts_ns;			// CLOCK_MONOTONIC
+	uint16_t line_id;			// Линия или соединение
+	uint16_t len;				// Байт кадра
+	TraceDir dir;
+	TraceKind kind;
+	uint8_t status;			// Для RX - MbStatus транзакции
+	uint8_t reserved;
+};
+
+static_assert(sizeof(TraceRecord) == TRACE_ALIGN, "TraceRecord layout");
+
+/** @brief Двоичная трассировка кадров в кольцо в отображенном в память файле (mmap).
+	Запись кадра - метка времени, копирование байтов кадра и сдвиг head: без форматирования, выделения памяти
+	и системных вызовов, поэтому трассировку можно не выключать в работе. Файл сбрасывается на диск ядром.
+	Одной трассировкой могут пользоваться несколько линий: запись сериализуется спин-блокировкой на время копирования.
+	Когда кольцо заполнено, самые старые записи перезаписываются */
+class FrameTrace {
+public:
+	FrameTrace();
+	~FrameTrace();
+
+	FrameTrace(const FrameTrace&) = delete;
+	FrameTrace& operator=(const FrameTrace&) = delete;
+
+	// Создание (перезапись) файла с кольцом capacity байт (округляется до TRACE_ALIGN)
+	bool open(const std::string& path, size_t capacity);
+	void close();
+	bool isOpen() const { return m_header != nullptr; }
+
+	void write(const uint16_t line_id, const TraceDir dir, const TraceKind kind, const BYTE* frame, const size_t len, const uint8_t status = 0);
+
+	uint64_t getFrames() const { return m_header ? m_header->frames.load(std::memory_order_relaxed) : 0; }
+
+	static uint64_t monoNs();
+	static size_t recordSize(size_t len) { return sizeof(TraceRecord) + ((len + TRACE_ALIGN - 1) & ~size_t(TRACE_ALIGN - 1)); }
+
+private:
+	TraceFileHeader* m_header;
+	BYTE* m_ring;
+	size_t m_map_size;
+	std::atomic_flag m_lock = ATOMIC_FLAG_INIT;
+};
+
+/** @brief Кадр, прочитанный из файла трассировки */
+struct TraceFrame {
+	uint64_t ts_ns;				// От создания файла
+	uint16_t line_id;
+	TraceDir dir;
+	TraceKind kind;
+	uint8_t status;
+	const BYTE* data;			// Внутри отображения файла
+	uint16_t len;
+};
+
+/** @brief Чтение файла трассировки (read-only mmap), кадры от старых к новым.
+	Файл, в который идет запись, лучше предварительно скопировать: самые старые записи могут быть перезаписаны во время чтения */
+class FrameTraceReader {
+public:
+	FrameTraceReader();
+	~FrameTraceReader();
+
+	bool open(const std::string& path);
+	void close();
+
+	// Перемотка к самой старой записи
+	void rewind();
+	bool next(TraceFrame& frame);
+
+	const TraceFileHeader* getHeader() const { return m_header; }
+	const std::string& getError() const { return m_error; }
+
+private:
+	const TraceFileHeader* m_header;
+	const BYTE* m_ring;
+	size_t m_map_size;
+	uint64_t m_pos;
+	uint64_t m_end;
+	std::string m_error;
+};
+
+} // modbus
+} // mb
+
+#endif // MB_FRAME_TRACE_H
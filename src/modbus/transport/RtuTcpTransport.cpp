@@ -0,0 +1,60 @@
+#include "RtuTcpTransport.h"
+
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace mb {
+namespace modbus {
+
+RtuTcpTransport::RtuTcpTransport(const std::string& host, uint16_t port) : m_host(host),
+																								  m_port(port),
+																								  m_fd(-1) {
+	m_name = host + ":" + std::to_string(port);
+}
+
+RtuTcpTransport::~RtuTcpTransport() { close(); }
+
+bool RtuTcpTransport::open() {
+	if (m_fd >= 0) return true;
+	m_fd = connectTcp(m_host, m_port);
+	return m_fd >= 0;
+}
+
+void RtuTcpTransport::close() {
+	if (m_fd >= 0) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+}
+
+bool RtuTcpTransport::discardInput() {
+	for (;;) {
+		ssize_t n = ::recv(m_fd, m_rx, sizeof(m_rx), MSG_DONTWAIT);
+		if (n > 0) continue;
+		if (n == 0) return false;
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	}
+}
+
+bool RtuTcpTransport::send(const BYTE slave_id, const size_t pdu_len) {
+	if (!open()) return false;
+	if (!writeAll(m_fd, m_tx, rtuFrame(slave_id, pdu_len))) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+MbStatus RtuTcpTransport::transact(const BYTE slave_id, const size_t pdu_len, const BYTE** resp_pdu, size_t* resp_len, const uint32_t timeout_ms) {
+	// Соединение, закрытое шлюзом между запросами, открывается заново
+	if (isOpen() && !discardInput()) close();
+	if (!send(slave_id, pdu_len)) return MbStatus::IO_ERROR;
+
+	const MbStatus status = rtuReceive(m_fd, slave_id, nowMs() + timeout_ms, resp_pdu, resp_len);
+	if (status == MbStatus::IO_ERROR) close();
+	return status;
+}
+
+} // modbus
+} // mb
@@ -0,0 +1,39 @@
+#ifndef MB_RTU_TCP_TRANSPORT_H
+#define MB_RTU_TCP_TRANSPORT_H
+
+#include "Transport.h"
+
+namespace mb {
+namespace modbus {
+
+/** @brief Кадры Modbus RTU (адрес устройства и CRC) через соединение TCP - прозрачные шлюзы и преобразователи
+	последовательных линий. Разбор кадров общий с RtuTransport, соединение - как у TcpTransport.
+	Номера транзакции нет, поэтому перед запросом отбрасываются опоздавшие байты ответа на прошлый запрос */
+class RtuTcpTransport : public Transport {
+public:
+	RtuTcpTransport(const std::string& host, uint16_t port);
+	~RtuTcpTransport();
+
+	bool open() override;
+	void close() override;
+	bool isOpen() const override { return m_fd >= 0; }
+
+	MbStatus transact(const BYTE slave_id, const size_t pdu_len, const BYTE** resp_pdu, size_t* resp_len, const uint32_t timeout_ms) override;
+	bool send(const BYTE slave_id, const size_t pdu_len) override;
+
+protected:
+	size_t headerSize() const override { return RTU_HEADER_SIZE; }
+
+private:
+	// false - соединение закрыто другой стороной
+	bool discardInput();
+
+	std::string m_host;
+	uint16_t m_port;
+	int m_fd;
+};
+
+} // modbus
+} // mb
+
+#endif // MB_RTU_TCP_TRANSPORT_H
@@ -0,0 +1,84 @@
+#include "RtuTransport.h"
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace mb {
+namespace modbus {
+
+static speed_t toSpeed(int baud) {
+	switch (baud) {
+		case 1200: return B1200;
+		case 2400: return B2400;
+		case 4800: return B4800;
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		default: return B19200;
+	}
+}
+
+RtuTransport::RtuTransport(const std::string& path, int baud, char parity, int stop_bits) : m_path(path),
+																															 m_baud(baud),
+																															 m_parity(parity),
+																															 m_stop_bits(stop_bits),
+																															 m_fd(-1) {
+	m_name = path;
+}
+
+RtuTransport::~RtuTransport() { close(); }
+
+bool RtuTransport::open() {
+	if (m_fd >= 0) return true;
+
+	m_fd = ::open(m_path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (m_fd < 0) return false;
+
+	termios tio;
+	if (tcgetattr(m_fd, &tio) != 0) {
+		close();
+		return false;
+	}
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, toSpeed(m_baud));
+	cfsetospeed(&tio, toSpeed(m_baud));
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cflag &= ~(PARENB | PARODD | CSTOPB);
+	if (m_parity == 'E') tio.c_cflag |= PARENB;
+	if (m_parity == 'O') tio.c_cflag |= PARENB | PARODD;
+	if (m_stop_bits == 2) tio.c_cflag |= CSTOPB;
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+
+	if (tcsetattr(m_fd, TCSANOW, &tio) != 0) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void RtuTransport::close() {
+	if (m_fd >= 0) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+}
+
+bool RtuTransport::send(const BYTE slave_id, const size_t pdu_len) {
+	if (!open()) return false;
+	return writeAll(m_fd, m_tx, rtuFrame(slave_id, pdu_len));
+}
+
+MbStatus RtuTransport::transact(const BYTE slave_id, const size_t pdu_len, const BYTE** resp_pdu, size_t* resp_len, const uint32_t timeout_ms) {
+	if (!open()) return MbStatus::IO_ERROR;
+
+	tcflush(m_fd, TCIFLUSH); // Отбрасываем опоздавшие ответы на предыдущие запросы
+	if (!send(slave_id, pdu_len)) return MbStatus::IO_ERROR;
+	return rtuReceive(m_fd, slave_id, nowMs() + timeout_ms, resp_pdu, resp_len);
+}
+
+} // modbus
+} // mb
@@ -0,0 +1,36 @@
+#ifndef MB_RTU_TRANSPORT_H
+#define MB_RTU_TRANSPORT_H
+
+#include "Transport.h"
+
+namespace mb {
+namespace modbus {
+
+/** @brief Линия Modbus RTU через последовательный порт (или псевдотерминал pty) */
+class RtuTransport : public Transport {
+public:
+	RtuTransport(const std::string& path, int baud = 19200, char parity = 'N', int stop_bits = 1);
+	~RtuTransport();
+
+	bool open() override;
+	void close() override;
+	bool isOpen() const override { return m_fd >= 0; }
+
+	MbStatus transact(const BYTE slave_id, const size_t pdu_len, const BYTE** resp_pdu, size_t* resp_len, const uint32_t timeout_ms) override;
+	bool send(const BYTE slave_id, const size_t pdu_len) override;
+
+protected:
+	size_t headerSize() const override { return RTU_HEADER_SIZE; }
+
+private:
+	std::string m_path;
+	int m_baud;
+	char m_parity;		// 'N', 'E', 'O'
+	int m_stop_bits;
+	int m_fd;
+};
+
+} // modbus
+} // mb
+
+#endif // MB_RTU_TRANSPORT_H
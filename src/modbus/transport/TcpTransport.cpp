@@ -0,0 +1,67 @@
+#include "TcpTransport.h"
+
+#include <unistd.h>
+
+namespace mb {
+namespace modbus {
+
+TcpTransport::TcpTransport(const std::string& host, uint16_t port) : m_host(host),
+																						  m_port(port),
+																						  m_fd(-1),
+																						  m_transaction_id(0) {
+	m_name = host + ":" + std::to_string(port);
+}
+
+TcpTransport::~TcpTransport() { close(); }
+
+bool TcpTransport::open() {
+	if (m_fd >= 0) return true;
+	m_fd = connectTcp(m_host, m_port);
+	return m_fd >= 0;
+}
+
+void TcpTransport::close() {
+	if (m_fd >= 0) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+}
+
+bool TcpTransport::send(const BYTE slave_id, const size_t pdu_len) {
+	if (!open()) return false;
+	if (!writeAll(m_fd, m_tx, mbapFrame(++m_transaction_id, slave_id, pdu_len))) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+MbStatus TcpTransport::transact(const BYTE slave_id, const size_t pdu_len, const BYTE** resp_pdu, size_t* resp_len, const uint32_t timeout_ms) {
+	if (!send(slave_id, pdu_len)) return MbStatus::IO_ERROR;
+
+	uint64_t deadline = nowMs() + timeout_ms;
+	MbapHeader header;
+
+	// Ответы с чужим transaction_id (опоздавшие ответы на запросы с истекшим таймаутом) пропускаются
+	for (;;) {
+		size_t got = 0;
+		MbStatus status = readExact(m_fd, m_rx, TCP_HEADER_SIZE, deadline, &got);
+		if (status == MbStatus::OK && !mbapDecode(m_rx, TCP_HEADER_SIZE, header)) status = MbStatus::BAD_RESPONSE;
+		if (status == MbStatus::OK) status = readExact(m_fd, m_rx + TCP_HEADER_SIZE, header.length - 1, deadline);
+		if (status != MbStatus::OK) {
+			// Соединение сохраняется только при таймауте на границе кадра: остаток частично прочитанного кадра
+			// был бы принят за начало следующего ответа
+			if (status != MbStatus::TIMEOUT || got != 0) close();
+			return status;
+		}
+		if (header.transaction_id == m_transaction_id) break;
+		trace(TraceDir::RX, TraceKind::TCP, m_rx, TCP_HEADER_SIZE + header.length - 1, MbStatus::BAD_RESPONSE);
+	}
+
+	const MbStatus status = mbapResponse(m_rx, header, slave_id, m_tx[TCP_HEADER_SIZE], resp_pdu, resp_len);
+	trace(TraceDir::RX, TraceKind::TCP, m_rx, TCP_HEADER_SIZE + header.length - 1, status);
+	return status;
+}
+
+} // modbus
+} // mb
@@ -0,0 +1,35 @@
+#ifndef MB_TCP_TRANSPORT_H
+#define MB_TCP_TRANSPORT_H
+
+#include "Transport.h"
+
+namespace mb {
+namespace modbus {
+
+/** @brief Соединение Modbus TCP (заголовок MBAP) */
+class TcpTransport : public Transport {
+public:
+	TcpTransport(const std::string& host, uint16_t port);
+	~TcpTransport();
+
+	bool open() override;
+	void close() override;
+	bool isOpen() const override { return m_fd >= 0; }
+
+	MbStatus transact(const BYTE slave_id, const size_t pdu_len, const BYTE** resp_pdu, size_t* resp_len, const uint32_t timeout_ms) override;
+	bool send(const BYTE slave_id, const size_t pdu_len) override;
+
+protected:
+	size_t headerSize() const override { return TCP_HEADER_SIZE; }
+
+private:
+	std::string m_host;
+	uint16_t m_port;
+	int m_fd;
+	WORD m_transaction_id;
+};
+
+} // modbus
+} // mb
+
+#endif // MB_TCP_TRANSPORT_H
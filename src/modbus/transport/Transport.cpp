@@ -0,0 +1,151 @@
+#include "Transport.h"
+
+#include <chrono>
+#include <cerrno>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace mb {
+namespace modbus {
+
+const char* mbStatusToString(MbStatus status) {
+	switch (status) {
+		case MbStatus::OK: return "OK";
+		case MbStatus::EXCEPTION: return "EXCEPTION";
+		case MbStatus::TIMEOUT: return "TIMEOUT";
+		case MbStatus::CRC_ERROR: return "CRC_ERROR";
+		case MbStatus::BAD_RESPONSE: return "BAD_RESPONSE";
+		case MbStatus::IO_ERROR: return "IO_ERROR";
+		case MbStatus::SKIPPED: return "SKIPPED";
+	}
+	return "UNKNOWN";
+}
+
+uint64_t Transport::nowMs() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t Transport::rtuFrame(const BYTE slave_id, const size_t pdu_len) {
+	m_tx[0] = slave_id;
+	const size_t len = rtuFinish(m_tx, RTU_HEADER_SIZE + pdu_len);
+	trace(TraceDir::TX, TraceKind::RTU, m_tx, len);
+	return len;
+}
+
+size_t Transport::mbapFrame(const WORD transaction_id, const BYTE slave_id, const size_t pdu_len) {
+	mbapEncode(m_tx, transaction_id, slave_id, pdu_len);
+	trace(TraceDir::TX, TraceKind::TCP, m_tx, TCP_HEADER_SIZE + pdu_len);
+	return TCP_HEADER_SIZE + pdu_len;
+}
+
+MbStatus Transport::rtuReceive(const int fd, const BYTE slave_id, const uint64_t deadline_ms, const BYTE** resp_pdu, size_t* resp_len) {
+	size_t have = 0;
+	size_t expected = 0;
+
+	auto done = [&](MbStatus status) {
+		trace(TraceDir::RX, TraceKind::RTU, m_rx, have, status);
+		return status;
+	};
+
+	while (expected == 0 || have < expected) {
+		size_t want = expected ? expected - have : (have < 3 ? 3 - have : 1);
+		int n = readSome(fd, m_rx + have, want, deadline_ms);
+		if (n == 0) return done(MbStatus::TIMEOUT);
+		if (n < 0) return done(MbStatus::IO_ERROR);
+		have += n;
+		if (expected == 0) {
+			expected = rtuResponseLength(m_rx, have);
+			if (expected == 0 && have >= 3) return done(MbStatus::BAD_RESPONSE);
+			if (expected > MODBUS_MAX_ADU_LENGTH) return done(MbStatus::BAD_RESPONSE);
+		}
+	}
+
+	if (!rtuCheck(m_rx, expected)) return done(MbStatus::CRC_ERROR);
+	if (m_rx[0] != slave_id || (m_rx[1] & 0x7F) != m_tx[1]) return done(MbStatus::BAD_RESPONSE);
+
+	*resp_pdu = m_rx + RTU_HEADER_SIZE;
+	*resp_len = expected - RTU_HEADER_SIZE - RTU_CRC_SIZE;
+	return done(isExceptionPdu(*resp_pdu) ? MbStatus::EXCEPTION : MbStatus::OK);
+}
+
+MbStatus Transport::mbapResponse(const BYTE* adu, const MbapHeader& header, const BYTE slave_id, const BYTE func, const BYTE** resp_pdu, size_t* resp_len) {
+	if (header.unit_id != slave_id || (adu[TCP_HEADER_SIZE] & 0x7F) != func) return MbStatus::BAD_RESPONSE;
+	*resp_pdu = adu + TCP_HEADER_SIZE;
+	*resp_len = header.length - 1;
+	return isExceptionPdu(*resp_pdu) ? MbStatus::EXCEPTION : MbStatus::OK;
+}
+
+int Transport::connectTcp(const std::string& host, const uint16_t port) {
+	sockaddr_in adr = {};
+	adr.sin_family = AF_INET;
+	adr.sin_port = htons(port);
+	if (inet_pton(AF_INET, host.c_str(), &adr.sin_addr) != 1) return -1;
+
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) return -1;
+	if (::connect(fd, reinterpret_cast<sockaddr*>(&adr), sizeof(adr)) != 0) {
+		::close(fd);
+		return -1;
+	}
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return fd;
+}
+
+bool Transport::writeAll(int fd, const BYTE* buf, size_t len) {
+	while (len > 0) {
+		ssize_t n = ::write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN) continue;
+			return false;
+		}
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+int Transport::readSome(int fd, BYTE* buf, size_t len, uint64_t deadline_ms) {
+	for (;;) {
+		uint64_t now = nowMs();
+		if (now >= deadline_ms) return 0;
+
+		pollfd pfd = { fd, POLLIN, 0 };
+		int rc = ::poll(&pfd, 1, static_cast<int>(deadline_ms - now));
+		if (rc < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		if (rc == 0) return 0;
+
+		ssize_t n = ::read(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN) continue;
+			return -1;
+		}
+		if (n == 0) return -1; // Соединение закрыто
+		return static_cast<int>(n);
+	}
+}
+
+MbStatus Transport::readExact(int fd, BYTE* buf, size_t len, uint64_t deadline_ms, size_t* got) {
+	size_t have = 0;
+	MbStatus status = MbStatus::OK;
+	while (have < len) {
+		int n = readSome(fd, buf + have, len - have, deadline_ms);
+		if (n <= 0) {
+			status = n == 0 ? MbStatus::TIMEOUT : MbStatus::IO_ERROR;
+			break;
+		}
+		have += n;
+	}
+	if (got) *got = have;
+	return status;
+}
+
+} // modbus
+} // mb
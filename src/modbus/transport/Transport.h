@@ -0,0 +1,93 @@
+#ifndef MB_TRANSPORT_H
+#define MB_TRANSPORT_H
+
+#include "ModbusDefs.h"
+#include "ModbusFrame.h"
+#include "FrameTrace.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace mb {
+namespace modbus {
+
+/** @brief Результат транзакции */
+enum class MbStatus {
+	OK,
+	EXCEPTION,		// Устройство ответило исключением
+	TIMEOUT,
+	CRC_ERROR,
+	BAD_RESPONSE,	// Ответ не соответствует запросу
+	IO_ERROR,
+	SKIPPED,			// Запрос не выдан (устройство исключено из опроса)
+};
+
+const char* mbStatusToString(MbStatus status);
+
+/** @brief Транспорт Modbus (линия RTU, соединение TCP, RTU поверх TCP, UDP).
+	Буферы кадров принадлежат транспорту: PDU запроса записывается прямо в txPdu(),
+	а после транзакции resp_pdu указывает на PDU ответа внутри приемного буфера. Копирования нет.
+	Транспорт не потокобезопасен, разделение доступа к линии выполняет ModbusMaster.
+	Если задана трассировка, каждый отправленный и принятый кадр (ADU целиком) пишется в нее с номером линии line_id */
+class Transport {
+public:
+	Transport() : m_trace(nullptr), m_line_id(0) {}
+	virtual ~Transport() {}
+
+	virtual bool open() = 0;
+	virtual void close() = 0;
+	virtual bool isOpen() const = 0;
+
+	// Место для PDU запроса
+	BYTE* txPdu() { return m_tx + headerSize(); }
+
+	// Отправка pdu_len байт из txPdu() устройству slave_id и ожидание ответа
+	virtual MbStatus transact(const BYTE slave_id, const size_t pdu_len, const BYTE** resp_pdu, size_t* resp_len, const uint32_t timeout_ms) = 0;
+
+	// Отправка без ожидания ответа (широковещательный запрос RTU)
+	virtual bool send(const BYTE slave_id, const size_t pdu_len) = 0;
+
+	const std::string& getName() const { return m_name; }
+
+	void setTrace(FrameTrace* trace, uint16_t line_id) { m_trace = trace; m_line_id = line_id; }
+
+protected:
+	virtual size_t headerSize() const = 0;
+
+	// Общая часть кадров для всех транспортов: RTU (линия, RTU поверх TCP) и MBAP (TCP, UDP).
+	// Кадр запроса с PDU, уже записанным в txPdu(), дописывается на месте и пишется в трассировку, возвращается длина ADU
+	size_t rtuFrame(const BYTE slave_id, const size_t pdu_len);
+	size_t mbapFrame(const WORD transaction_id, const BYTE slave_id, const size_t pdu_len);
+	// Прием ответа RTU в m_rx до deadline_ms. Принятые байты (в том числе неполный кадр) пишутся в трассировку с результатом
+	MbStatus rtuReceive(const int fd, const BYTE slave_id, const uint64_t deadline_ms, const BYTE** resp_pdu, size_t* resp_len);
+	// Проверка ответа MBAP длиной len (заголовок уже разобран в header) на запрос с функцией func
+	static MbStatus mbapResponse(const BYTE* adu, const MbapHeader& header, const BYTE slave_id, const BYTE func, const BYTE** resp_pdu, size_t* resp_len);
+
+	// Соединение TCP с адресом IPv4 host:port (TCP_NODELAY), -1 - ошибка
+	static int connectTcp(const std::string& host, const uint16_t port);
+	// Запись всего буфера в дескриптор
+	static bool writeAll(int fd, const BYTE* buf, size_t len);
+	// Чтение не более len байт с ожиданием до deadline_ms, возвращает количество байт, 0 - таймаут, -1 - ошибка
+	static int readSome(int fd, BYTE* buf, size_t len, uint64_t deadline_ms);
+	// Чтение ровно len байт до deadline_ms, в got (если задан) - количество прочитанных байт, в т.ч. при таймауте
+	static MbStatus readExact(int fd, BYTE* buf, size_t len, uint64_t deadline_ms, size_t* got = nullptr);
+	static uint64_t nowMs();
+
+	void trace(const TraceDir dir, const TraceKind kind, const BYTE* adu, const size_t len, const MbStatus status = MbStatus::OK) {
+		if (m_trace) m_trace->write(m_line_id, dir, kind, adu, len, static_cast<uint8_t>(status));
+	}
+
+	std::string m_name;	// Наименование для журналов (путь порта, адрес:порт)
+
+	BYTE m_tx[MODBUS_MAX_ADU_LENGTH];
+	BYTE m_rx[MODBUS_MAX_ADU_LENGTH];
+
+	FrameTrace* m_trace;
+	uint16_t m_line_id;
+};
+
+} // modbus
+} // mb
+
+#endif // MB_TRANSPORT_H
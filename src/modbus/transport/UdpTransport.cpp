@@ -0,0 +1,212 @@
+#include "UdpTransport.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace mb {
+namespace modbus {
+
+static bool samePeer(const sockaddr_in& a, const sockaddr_in& b) {
+	return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+UdpTransport::UdpTransport(const std::string& host, uint16_t port, const size_t batch) : m_host(host),
+																												 m_port(port),
+																												 m_peer(),
+																												 m_fd(-1),
+																												 m_transaction_id(0),
+																												 m_syscalls(0),
+																												 m_batch(std::max<size_t>(1, batch)),
+																												 m_batch_tx(new BYTE[m_batch * MODBUS_MAX_ADU_LENGTH]),
+																												 m_batch_rx(new BYTE[m_batch * MODBUS_MAX_ADU_LENGTH]),
+																												 m_msgs(m_batch),
+																												 m_iov(m_batch),
+																												 m_from(m_batch) {
+	m_name = host + ":" + std::to_string(port);
+	m_free.reserve(m_batch);
+	m_slots.reserve(m_batch);
+}
+
+UdpTransport::~UdpTransport() { close(); }
+
+bool UdpTransport::resolve(const std::string& host, const uint16_t port, sockaddr_in& out) {
+	out = sockaddr_in();
+	out.sin_family = AF_INET;
+	out.sin_port = htons(port);
+	return inet_pton(AF_INET, host.c_str(), &out.sin_addr) == 1;
+}
+
+bool UdpTransport::open() {
+	if (m_fd >= 0) return true;
+	if (!resolve(m_host, m_port, m_peer)) return false;
+
+	m_fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+	if (m_fd < 0) return false;
+	// Ответы пакета не должны теряться в буфере сокета, пока поток разбирает предыдущую пачку
+	int size = static_cast<int>(m_batch * MODBUS_MAX_ADU_LENGTH * 4);
+	setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	return true;
+}
+
+void UdpTransport::close() {
+	if (m_fd >= 0) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+}
+
+int UdpTransport::waitInput(const uint64_t deadline_ms) {
+	for (;;) {
+		uint64_t now = nowMs();
+		if (now >= deadline_ms) return 0;
+		pollfd pfd = { m_fd, POLLIN, 0 };
+		int rc = ::poll(&pfd, 1, static_cast<int>(deadline_ms - now));
+		if (rc < 0 && errno == EINTR) continue;
+		return rc < 0 ? -1 : (rc > 0 ? 1 : 0);
+	}
+}
+
+bool UdpTransport::send(const BYTE slave_id, const size_t pdu_len) {
+	if (!open()) return false;
+	const size_t len = mbapFrame(++m_transaction_id, slave_id, pdu_len);
+	m_syscalls++;
+	return ::sendto(m_fd, m_tx, len, 0, reinterpret_cast<const sockaddr*>(&m_peer), sizeof(m_peer)) == static_cast<ssize_t>(len);
+}
+
+MbStatus UdpTransport::transact(const BYTE slave_id, const size_t pdu_len, const BYTE** resp_pdu, size_t* resp_len, const uint32_t timeout_ms) {
+	if (!send(slave_id, pdu_len)) return MbStatus::IO_ERROR;
+
+	const uint64_t deadline = nowMs() + timeout_ms;
+	// Датаграммы других адресов, искаженные датаграммы и ответы с чужим transaction_id (опоздавшие) пропускаются,
+	// ожидание продолжается до срока, как в transactBatch
+	for (;;) {
+		sockaddr_in from;
+		socklen_t from_len = sizeof(from);
+		ssize_t n = ::recvfrom(m_fd, m_rx, sizeof(m_rx), MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&from), &from_len);
+		m_syscalls++;
+		if (n < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return MbStatus::IO_ERROR;
+			const int w = waitInput(deadline);
+			if (w == 0) return MbStatus::TIMEOUT;
+			if (w < 0) return MbStatus::IO_ERROR;
+			continue;
+		}
+		bool skip = !samePeer(from, m_peer);
+		MbapHeader header;
+		if (!skip && (!mbapDecode(m_rx, n, header) || static_cast<size_t>(TCP_HEADER_SIZE - 1 + header.length) != static_cast<size_t>(n) ||
+						  header.transaction_id != m_transaction_id)) {
+			trace(TraceDir::RX, TraceKind::TCP, m_rx, n, MbStatus::BAD_RESPONSE);
+			skip = true;
+		}
+		if (skip) {
+			if (nowMs() >= deadline) return MbStatus::TIMEOUT; // Поток посторонних датаграмм не продлевает ожидание
+			continue;
+		}
+		const MbStatus status = mbapResponse(m_rx, header, slave_id, m_tx[TCP_HEADER_SIZE], resp_pdu, resp_len);
+		trace(TraceDir::RX, TraceKind::TCP, m_rx, n, status);
+		return status;
+	}
+}
+
+size_t UdpTransport::transactBatch(UdpRequest* reqs, const size_t count, const uint32_t timeout_ms) {
+	const size_t n = std::min(count, m_batch);
+	for (size_t i = 0; i < count; i++) {
+		reqs[i].status = i < n ? MbStatus::TIMEOUT : MbStatus::SKIPPED;	// Сверх размера пакета запросы не выдаются
+		reqs[i].resp_pdu = nullptr;
+		reqs[i].resp_len = 0;
+	}
+	if (n == 0) return 0;
+	if (!open()) {
+		for (size_t i = 0; i < n; i++) reqs[i].status = MbStatus::IO_ERROR;
+		return 0;
+	}
+
+	// Номера транзакций пакета идут подряд: номер ответа - сразу индекс запроса
+	const WORD base = static_cast<WORD>(m_transaction_id + 1);
+	m_transaction_id = static_cast<WORD>(m_transaction_id + n);
+	for (size_t i = 0; i < n; i++) {
+		BYTE* adu = &m_batch_tx[i * MODBUS_MAX_ADU_LENGTH];
+		mbapEncode(adu, static_cast<WORD>(base + i), reqs[i].slave_id, reqs[i].pdu_len);
+		trace(TraceDir::TX, TraceKind::TCP, adu, TCP_HEADER_SIZE + reqs[i].pdu_len);
+		m_iov[i] = { adu, TCP_HEADER_SIZE + reqs[i].pdu_len };
+		m_msgs[i].msg_hdr = msghdr();
+		m_msgs[i].msg_hdr.msg_name = &reqs[i].peer;
+		m_msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+		m_msgs[i].msg_hdr.msg_iov = &m_iov[i];
+		m_msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	size_t pending = n;
+	for (size_t sent = 0; sent < n;) {
+		int r = ::sendmmsg(m_fd, &m_msgs[sent], static_cast<unsigned>(n - sent), 0);
+		m_syscalls++;
+		if (r > 0) {
+			sent += r;
+			continue;
+		}
+		if (r < 0 && errno == EINTR) continue;
+		// Первое сообщение не отправлено (например, адрес недоступен) - остальные пробуются дальше
+		reqs[sent++].status = MbStatus::IO_ERROR;
+		pending--;
+	}
+
+	// Приемные буферы: занятые ответами остаются за запросами, остальные снова отдаются recvmmsg
+	m_free.clear();
+	for (size_t k = m_batch; k > 0; k--) m_free.push_back(static_cast<uint32_t>(k - 1));
+	size_t answered = 0;
+	const uint64_t deadline = nowMs() + timeout_ms;
+	while (pending > 0) {
+		const size_t want = std::min(pending, m_free.size());
+		m_slots.assign(m_free.end() - want, m_free.end());
+		m_free.resize(m_free.size() - want);
+		for (size_t k = 0; k < want; k++) {
+			m_iov[k] = { &m_batch_rx[m_slots[k] * MODBUS_MAX_ADU_LENGTH], MODBUS_MAX_ADU_LENGTH };
+			m_msgs[k].msg_hdr = msghdr();
+			m_msgs[k].msg_hdr.msg_name = &m_from[k];
+			m_msgs[k].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			m_msgs[k].msg_hdr.msg_iov = &m_iov[k];
+			m_msgs[k].msg_hdr.msg_iovlen = 1;
+		}
+
+		int r = ::recvmmsg(m_fd, m_msgs.data(), static_cast<unsigned>(want), MSG_DONTWAIT, nullptr);
+		m_syscalls++;
+		if (r < 0) {
+			m_free.insert(m_free.end(), m_slots.begin(), m_slots.end());
+			if (errno == EINTR) continue;
+			int w = -1;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) w = waitInput(deadline);
+			if (w > 0) continue;
+			if (w < 0) {
+				for (size_t i = 0; i < n; i++) {
+					if (reqs[i].status == MbStatus::TIMEOUT) reqs[i].status = MbStatus::IO_ERROR;
+				}
+			}
+			break;
+		}
+
+		for (size_t k = 0; k < want; k++) {
+			const BYTE* adu = &m_batch_rx[m_slots[k] * MODBUS_MAX_ADU_LENGTH];
+			const size_t len = static_cast<int>(k) < r ? m_msgs[k].msg_len : 0;
+			MbapHeader header;
+			size_t i = n;
+			if (len && mbapDecode(adu, len, header) && static_cast<size_t>(TCP_HEADER_SIZE - 1 + header.length) == len) i = static_cast<WORD>(header.transaction_id - base);
+			if (i >= n || reqs[i].status != MbStatus::TIMEOUT || !samePeer(m_from[k], reqs[i].peer)) {
+				if (len) trace(TraceDir::RX, TraceKind::TCP, adu, len, MbStatus::BAD_RESPONSE);
+				m_free.push_back(m_slots[k]);
+				continue;
+			}
+			UdpRequest& req = reqs[i];
+			req.status = mbapResponse(adu, header, req.slave_id, m_batch_tx[i * MODBUS_MAX_ADU_LENGTH + TCP_HEADER_SIZE], &req.resp_pdu, &req.resp_len);
+			trace(TraceDir::RX, TraceKind::TCP, adu, len, req.status);
+			pending--;
+			if (req.status == MbStatus::OK || req.status == MbStatus::EXCEPTION) answered++;
+			else m_free.push_back(m_slots[k]);
+		}
+	}
+	return answered;
+}
+
+} // modbus
+} // mb
@@ -0,0 +1,86 @@
+#ifndef MB_UDP_TRANSPORT_H
+#define MB_UDP_TRANSPORT_H
+
+#include "Transport.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <memory>
+#include <vector>
+
+namespace mb {
+namespace modbus {
+
+/** @brief Запрос пакетного опроса UdpTransport::transactBatch */
+struct UdpRequest {
+	sockaddr_in peer;			// Адрес устройства (шлюза), см. UdpTransport::resolve
+	BYTE slave_id;
+	size_t pdu_len;			// Длина PDU, записанного в batchPdu(i)
+
+	// Результат: OK/EXCEPTION - resp_pdu указывает в приемный буфер транспорта до следующего пакета
+	MbStatus status;
+	const BYTE* resp_pdu;
+	size_t resp_len;
+};
+
+/** @brief Modbus UDP: кадры MBAP (как Modbus TCP) в датаграммах, одна датаграмма - один кадр.
+	transact работает с одним устройством host:port, как остальные транспорты.
+	transactBatch опрашивает много устройств (например, шлюзов одной подсети) одним сокетом: все запросы
+	уходят одним sendmmsg, ответы принимаются пачками recvmmsg прямо в буферы транспорта и сопоставляются
+	с запросами по номеру транзакции и адресу отправителя. Ответы приходят в любом порядке, опоздавшие ответы
+	прошлых пакетов отбрасываются по номеру транзакции */
+class UdpTransport : public Transport {
+public:
+	// batch - наибольшее количество запросов в transactBatch
+	UdpTransport(const std::string& host, uint16_t port, const size_t batch = 64);
+	~UdpTransport();
+
+	bool open() override;
+	void close() override;
+	bool isOpen() const override { return m_fd >= 0; }
+
+	MbStatus transact(const BYTE slave_id, const size_t pdu_len, const BYTE** resp_pdu, size_t* resp_len, const uint32_t timeout_ms) override;
+	bool send(const BYTE slave_id, const size_t pdu_len) override;
+
+	// Место для PDU запроса i пакета, i < getBatchSize()
+	BYTE* batchPdu(const size_t i) { return &m_batch_tx[i * MODBUS_MAX_ADU_LENGTH + TCP_HEADER_SIZE]; }
+	size_t getBatchSize() const { return m_batch; }
+	// Отправка count запросов и прием ответов до timeout_ms. Запросы без ответа - TIMEOUT.
+	// Возвращает количество запросов с ответом (OK или EXCEPTION)
+	size_t transactBatch(UdpRequest* reqs, const size_t count, const uint32_t timeout_ms);
+
+	// Системных вызовов отправки и приема (send*, recv*)
+	uint64_t getSyscalls() const { return m_syscalls; }
+
+	static bool resolve(const std::string& host, const uint16_t port, sockaddr_in& out);
+
+protected:
+	size_t headerSize() const override { return TCP_HEADER_SIZE; }
+
+private:
+	// Ожидание датаграмм до deadline_ms: 1 - есть, 0 - таймаут, -1 - ошибка
+	int waitInput(const uint64_t deadline_ms);
+
+	std::string m_host;
+	uint16_t m_port;
+	sockaddr_in m_peer;
+	int m_fd;
+	WORD m_transaction_id;
+	uint64_t m_syscalls;
+
+	// Пакет: буферы кадров запросов и ответов по MODBUS_MAX_ADU_LENGTH, заголовки sendmmsg/recvmmsg
+	size_t m_batch;
+	std::unique_ptr<BYTE[]> m_batch_tx;
+	std::unique_ptr<BYTE[]> m_batch_rx;
+	std::vector<mmsghdr> m_msgs;
+	std::vector<iovec> m_iov;
+	std::vector<sockaddr_in> m_from;
+	std::vector<uint32_t> m_free;			// Свободные приемные буферы
+	std::vector<uint32_t> m_slots;		// Номера приемных буферов текущего вызова recvmmsg
+};
+
+} // modbus
+} // mb
+
+#endif // MB_UDP_TRANSPORT_H
@@ -0,0 +1,115 @@
+#include "WriteQueue.h"
+
+#include <algorithm>
+
+namespace mb {
+namespace modbus {
+
+void WriteQueue::put(const uint64_t key, const WORD val, const uint64_t now_ms) {
+	if (m_pending.empty()) m_oldest_ms = now_ms;
+	m_pending[key] = val; // Последняя запись по адресу побеждает
+	++m_writes;
+}
+
+void WriteQueue::writeWord(const int slave_id, const WORD adr, const WORD val, const uint64_t now_ms) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	put(makeKey(slave_id, true, adr), val, now_ms);
+}
+
+bool WriteQueue::writeWords(const int slave_id, const WORD adr, const WORD quantity, const WORD *const val, const uint64_t now_ms) {
+	if (val == nullptr || quantity == 0 || static_cast<uint32_t>(adr) + quantity - 1 > 0xFFFF) return false;
+	std::lock_guard<std::mutex> lock(m_mtx);
+	for (WORD i = 0; i < quantity; i++) {
+		put(makeKey(slave_id, true, static_cast<WORD>(adr + i)), *(val + i), now_ms);
+	}
+	return true;
+}
+
+void WriteQueue::writeBit(const int slave_id, const WORD adr, const BIT val, const uint64_t now_ms) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	put(makeKey(slave_id, false, adr), val > 0 ? 1 : 0, now_ms);
+}
+
+void WriteQueue::setFlushLatency(uint32_t flush_latency_ms) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_flush_latency_ms = flush_latency_ms;
+}
+
+uint32_t WriteQueue::getFlushLatency() {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_flush_latency_ms;
+}
+
+bool WriteQueue::isDue(const uint64_t now_ms) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return !m_pending.empty() && now_ms >= m_oldest_ms + m_flush_latency_ms;
+}
+
+size_t WriteQueue::pending() {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_pending.size();
+}
+
+uint64_t WriteQueue::writes() {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_writes;
+}
+
+void WriteQueue::emit(WriteBatch& batch, int slave_id, bool is_word, WORD start_adr, const WORD* vals, size_t quantity) {
+	const WORD max_q = is_word ? MODBUS_MAX_WRITE_REGISTERS : MODBUS_MAX_WRITE_BITS;
+
+	// Последовательность длиннее протокольного лимита делится на несколько запросов
+	for (size_t done = 0; done < quantity;) {
+		WORD q = static_cast<WORD>(std::min<size_t>(quantity - done, max_q));
+
+		WriteRequest req;
+		req.slave_id = slave_id;
+		req.start_adr = start_adr + done;
+		req.quantity = q;
+		req.values_offset = batch.values.size();
+		if (q == 1) req.func = is_word ? ModbusFunc::F_06 : ModbusFunc::F_05;
+		else req.func = is_word ? ModbusFunc::F_16 : ModbusFunc::F_15;
+
+		batch.values.insert(batch.values.end(), vals + done, vals + done + q);
+		batch.requests.push_back(req);
+		done += q;
+	}
+}
+
+size_t WriteQueue::flush(const uint64_t now_ms, WriteBatch& batch, bool force) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	batch.clear();
+
+	if (m_pending.empty()) return 0;
+	if (!force && now_ms < m_oldest_ms + m_flush_latency_ms) return 0;
+
+	int run_slave = -1;
+	bool run_word = false;
+	WORD run_start = 0;
+	uint32_t run_next = 0; // Адрес, который продолжит текущую последовательность
+	m_run.clear();
+
+	for (const auto& pair : m_pending) {
+		int slave_id = static_cast<int>(pair.first >> 17);
+		bool is_word = (pair.first >> 16) & 1;
+		WORD adr = pair.first & 0xFFFF;
+
+		bool cont = !m_run.empty() && slave_id == run_slave && is_word == run_word && adr == run_next;
+		if (!cont) {
+			if (!m_run.empty()) emit(batch, run_slave, run_word, run_start, m_run.data(), m_run.size());
+			m_run.clear();
+			run_slave = slave_id;
+			run_word = is_word;
+			run_start = adr;
+		}
+		m_run.push_back(pair.second);
+		run_next = static_cast<uint32_t>(adr) + 1;
+	}
+	if (!m_run.empty()) emit(batch, run_slave, run_word, run_start, m_run.data(), m_run.size());
+
+	m_pending.clear();
+	return batch.requests.size();
+}
+
+} // modbus
+} // mb
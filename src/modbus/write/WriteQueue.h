@@ -0,0 +1,89 @@
+#ifndef MB_WRITE_QUEUE_H
+#define MB_WRITE_QUEUE_H
+
+#include "ModbusDefs.h"
+
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+
+namespace mb {
+namespace modbus {
+
+/** @brief Запрос записи, сформированный очередью.
+	Значения лежат в общем буфере WriteBatch::values начиная с values_offset, для катушек 0 или 1 */
+struct WriteRequest {
+	int slave_id;
+	ModbusFunc func;			// F_05, F_06, F_15 или F_16
+	WORD start_adr;
+	WORD quantity;
+	size_t values_offset;
+};
+
+/** @brief Набор запросов одного сброса очереди, буферы переиспользуются между сбросами */
+struct WriteBatch {
+	std::vector<WriteRequest> requests;
+	std::vector<WORD> values;
+
+	void clear() { requests.clear(); values.clear(); }
+	const WORD* valuesOf(const WriteRequest& req) const { return values.data() + req.values_offset; }
+};
+
+/** @brief Очередь исходящих записей с объединением.
+	Записи одиночных уставок (writeWord, writeBit) накапливаются, по одному адресу остается последнее значение.
+	При сбросе соседние адреса одного устройства объединяются в запросы F_15/F_16 до
+	MODBUS_MAX_WRITE_BITS/MODBUS_MAX_WRITE_REGISTERS, одиночные адреса уходят F_05/F_06.
+	Сброс выполняется не раньше чем через flush_latency_ms от самой старой записи в очереди */
+
+// Пример. Очередь: (1, 200) = 5, (1, 201) = 7, (1, 200) = 9, (1, 205) = 1, катушка (1, 10) = 1
+// Сброс -> F_16 slave 1 [200-201] = {9, 7}
+//          F_06 slave 1 205 = 1
+//          F_05 slave 1 10 = 1
+
+class WriteQueue {
+public:
+	WriteQueue(uint32_t flush_latency_ms = 20) : m_flush_latency_ms(flush_latency_ms), m_oldest_ms(0), m_writes(0) {}
+	~WriteQueue() {}
+
+	// Запись регистра хранения
+	void writeWord(const int slave_id, const WORD adr, const WORD val, const uint64_t now_ms);
+	// Запись массива регистров хранения, массив, выходящий за адрес 0xFFFF, отклоняется
+	bool writeWords(const int slave_id, const WORD adr, const WORD quantity, const WORD *const val, const uint64_t now_ms);
+	// Запись катушки
+	void writeBit(const int slave_id, const WORD adr, const BIT val, const uint64_t now_ms);
+
+	void setFlushLatency(uint32_t flush_latency_ms);
+	uint32_t getFlushLatency();
+
+	// Наступил ли срок сброса очереди
+	bool isDue(const uint64_t now_ms);
+	// Сброс очереди в batch (batch предварительно очищается). Если срок не наступил и force == false - ничего не делает
+	size_t flush(const uint64_t now_ms, WriteBatch& batch, bool force = false);
+
+	size_t pending();		// Количество адресов, ожидающих записи
+	uint64_t writes();		// Количество принятых записей за все время
+
+private:
+	// Ключ упорядочен по (slave_id, тип, адрес), поэтому соседние адреса идут в очереди подряд
+	static uint64_t makeKey(const int slave_id, const bool is_word, const WORD adr) {
+		return (static_cast<uint64_t>(slave_id) << 17) | (static_cast<uint64_t>(is_word) << 16) | adr;
+	}
+
+	void put(const uint64_t key, const WORD val, const uint64_t now_ms);
+	void emit(WriteBatch& batch, int slave_id, bool is_word, WORD start_adr, const WORD* vals, size_t quantity);
+
+	uint32_t m_flush_latency_ms;
+	uint64_t m_oldest_ms;		// Время самой старой записи в очереди
+	uint64_t m_writes;
+
+	std::map<uint64_t, WORD> m_pending;
+	std::vector<WORD> m_run;	// Буфер значений текущей последовательности адресов
+
+	std::mutex m_mtx;
+};
+
+} // modbus
+} // mb
+
+#endif // MB_WRITE_QUEUE_H
@@ -0,0 +1,115 @@
+#include "WorkPool.h"
+
+#include <algorithm>
+
+namespace mb {
+namespace work {
+
+static inline uint64_t packRange(const uint64_t begin, const uint64_t end) {
+	return begin << 32 | end;
+}
+
+WorkPool::WorkPool(size_t threads)
+	: m_lane_count(0), m_fn(nullptr), m_ctx(nullptr), m_pending(0), m_steals(0), m_running(false), m_generation(0), m_stop(false) {
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	m_lane_count = threads;
+	m_lanes.reset(new Lane[threads]);
+	for (size_t i = 0; i < threads; i++) m_lanes[i].range.store(0, std::memory_order_relaxed);
+	for (size_t i = 1; i < threads; i++) m_threads.emplace_back(&WorkPool::loop, this, i);
+}
+
+WorkPool::~WorkPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_stop = true;
+	}
+	m_start_cv.notify_all();
+	for (std::thread& t : m_threads) t.join();
+}
+
+void WorkPool::run(const size_t count, TaskFn fn, void* ctx) {
+	if (count == 0) return;
+	if (m_threads.empty() || count == 1 || count > UINT32_MAX || m_running.exchange(true, std::memory_order_acquire)) {
+		for (size_t i = 0; i < count; i++) fn(ctx, i);
+		return;
+	}
+
+	// Индексы поровну по полосам, потоки пула будятся новым номером цикла
+	for (size_t k = 0; k < m_lane_count; k++) m_lanes[k].range.store(packRange(count * k / m_lane_count, count * (k + 1) / m_lane_count), std::memory_order_relaxed);
+	m_fn = fn;
+	m_ctx = ctx;
+	m_pending.store(m_threads.size(), std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		++m_generation;
+	}
+	m_start_cv.notify_all();
+
+	work(0);
+	{
+		std::unique_lock<std::mutex> lock(m_mtx);
+		m_done_cv.wait(lock, [this]() { return m_pending.load(std::memory_order_acquire) == 0; });
+	}
+	m_running.store(false, std::memory_order_release);
+}
+
+void WorkPool::loop(const size_t id) {
+	uint64_t seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(m_mtx);
+			m_start_cv.wait(lock, [&]() { return m_stop || m_generation != seen; });
+			if (m_stop) return;
+			seen = m_generation;
+		}
+		work(id);
+		if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_done_cv.notify_one();
+		}
+	}
+}
+
+void WorkPool::work(const size_t id) {
+	size_t index;
+	do {
+		while (take(m_lanes[id], index)) m_fn(m_ctx, index);
+	} while (steal(id));
+}
+
+// Индекс с начала своей полосы
+bool WorkPool::take(Lane& lane, size_t& index) {
+	uint64_t r = lane.range.load(std::memory_order_acquire);
+	for (;;) {
+		const uint64_t begin = r >> 32, end = r & 0xFFFFFFFFu;
+		if (begin >= end) return false;
+		if (lane.range.compare_exchange_weak(r, packRange(begin + 1, end), std::memory_order_acq_rel, std::memory_order_acquire)) {
+			index = static_cast<size_t>(begin);
+			return true;
+		}
+	}
+}
+
+// Верхняя половина остатка чужой полосы переносится в свою (она пуста, поэтому ее никто не меняет).
+// false - работы не осталось ни в одной полосе
+bool WorkPool::steal(const size_t id) {
+	for (;;) {
+		bool found = false;
+		for (size_t k = 1; k < m_lane_count; k++) {
+			Lane& victim = m_lanes[(id + k) % m_lane_count];
+			uint64_t r = victim.range.load(std::memory_order_acquire);
+			const uint64_t begin = r >> 32, end = r & 0xFFFFFFFFu;
+			if (begin >= end) continue;
+			found = true;
+			const uint64_t mid = begin + (end - begin) / 2;
+			if (!victim.range.compare_exchange_strong(r, packRange(begin, mid), std::memory_order_acq_rel, std::memory_order_acquire)) continue;
+			m_lanes[id].range.store(packRange(mid, end), std::memory_order_release);
+			m_steals.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+		if (!found) return false;
+	}
+}
+
+} // work
+} // mb
@@ -0,0 +1,76 @@
+#ifndef MB_WORK_POOL_H
+#define MB_WORK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace mb {
+namespace work {
+
+/** @brief Пул потоков для параллельных циклов с перехватом работы (work stealing).
+	parallelFor делит индексы поровну между потоками; поток берет индексы своей полосы с начала, а закончив ее,
+	забирает верхнюю половину оставшихся индексов у другого потока. Поэтому неравные по цене задачи
+	(например, группы диапазонов разного размера) не оставляют потоки без работы. Полоса - одно атомарное
+	слово [начало, конец), взятие и перехват - CAS без блокировок.
+	Вызывающий поток участвует в работе. parallelFor, вызванный во время другого цикла (в том числе из задачи),
+	выполняется последовательно в вызывающем потоке */
+class WorkPool {
+public:
+	// threads - всего потоков вместе с вызывающим, 0 - по числу процессоров
+	explicit WorkPool(size_t threads = 0);
+	~WorkPool();
+
+	WorkPool(const WorkPool&) = delete;
+	WorkPool& operator=(const WorkPool&) = delete;
+
+	// fn(i) для каждого i из [0, count), возврат после выполнения всех
+	template <typename Fn>
+	void parallelFor(const size_t count, Fn&& fn) {
+		run(count, [](void* ctx, size_t i) { (*static_cast<typename std::remove_reference<Fn>::type*>(ctx))(i); }, &fn);
+	}
+
+	size_t getThreadCount() const { return m_lane_count; }
+	// Сколько раз потоки забирали работу у других
+	uint64_t getSteals() const { return m_steals.load(std::memory_order_relaxed); }
+
+private:
+	using TaskFn = void (*)(void* ctx, size_t i);
+
+	struct alignas(64) Lane {
+		std::atomic<uint64_t> range;	// начало << 32 | конец
+	};
+
+	void run(const size_t count, TaskFn fn, void* ctx);
+	void loop(const size_t id);
+	void work(const size_t id);
+	bool take(Lane& lane, size_t& index);
+	bool steal(const size_t id);
+
+	std::unique_ptr<Lane[]> m_lanes;		// [0] - вызывающий поток, [1..] - потоки пула
+	size_t m_lane_count;
+	std::vector<std::thread> m_threads;
+
+	TaskFn m_fn;
+	void* m_ctx;
+	std::atomic<size_t> m_pending;		// Потоков пула, еще не закончивших текущий цикл
+	std::atomic<uint64_t> m_steals;
+	std::atomic<bool> m_running;			// Идет цикл
+
+	std::mutex m_mtx;
+	std::condition_variable m_start_cv;
+	std::condition_variable m_done_cv;
+	uint64_t m_generation;					// Номер цикла, под m_mtx
+	bool m_stop;
+};
+
+} // work
+} // mb
+
+#endif // MB_WORK_POOL_H
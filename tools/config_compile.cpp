@@ -0,0 +1,43 @@
+#include <iostream>
+#include <cstdlib>
+
+#include "ConfigParser.h"
+#include "ConfigImage.h"
+
+// Компиляция текстовой конфигурации тегов и диапазонов в двоичный образ
+// Запуск: mb_config_compile <конфигурация> <образ> [период опроса по умолчанию, мс]
+
+using namespace mb::data;
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cerr << "Usage: " << argv[0] << " <config> <image> [default_scan_ms]" << std::endl;
+		return 2;
+	}
+	uint32_t default_scan_ms = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 1000;
+
+	ConfigFile file;
+	if (!file.open(argv[1])) {
+		std::cerr << argv[1] << ": can't open" << std::endl;
+		return 1;
+	}
+	ConfigParser parser;
+	if (!parser.parse(file.text())) {
+		const ConfigError& e = parser.getError();
+		std::cerr << argv[1] << ":" << e.line << ":" << e.column << ": " << e.message << std::endl;
+		return 1;
+	}
+	if (!ConfigImage::compile(parser, file.text(), default_scan_ms, argv[2])) {
+		std::cerr << argv[2] << ": can't write image" << std::endl;
+		return 1;
+	}
+
+	ConfigImage image;
+	if (!image.open(argv[2])) {
+		std::cerr << argv[2] << ": " << image.getError() << std::endl;
+		return 1;
+	}
+	std::cout << argv[2] << ": " << image.getTagCount() << " tags, " << image.getRangeCount() << " ranges, "
+			  << image.getPlanCount() << " poll requests, " << image.getHeader().total_size << " bytes" << std::endl;
+	return 0;
+}
@@ -0,0 +1,67 @@
+#include <iostream>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "Simulator.h"
+
+// Симулятор ведомых устройств Modbus TCP/RTU по сценарию (формат - в Simulator.cpp, пример - example/sim_plant.conf)
+// Запуск: mb_sim <сценарий> [длительность, с]   - без длительности работает до Ctrl+C, счетчики выводятся раз в 5 с
+
+using namespace mb::modbus;
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void onSignal(int) { g_stop = 1; }
+
+static void printStats(const SimStats& s, const SimStats& prev, double sec) {
+	std::cout << "requests " << s.requests << " (" << static_cast<uint64_t>((s.requests - prev.requests) / sec) << "/s)"
+				 << ", responses " << s.responses << ", exceptions " << s.exceptions << ", dropped " << s.dropped
+				 << ", corrupted " << s.corrupted << ", connections " << s.connections << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " <script> [seconds]" << std::endl;
+		return 2;
+	}
+	const int seconds = argc > 2 ? std::atoi(argv[2]) : 0;
+
+	Simulator sim;
+	if (!sim.loadScriptFile(argv[1])) {
+		std::cerr << argv[1] << ": " << sim.getError() << std::endl;
+		return 1;
+	}
+	if (!sim.start()) {
+		std::cerr << "Can't start simulator" << std::endl;
+		return 1;
+	}
+	for (size_t i = 0; i < sim.getEndpointCount(); i++) std::cout << "Endpoint " << i << ": " << sim.getEndpointName(static_cast<int>(i)) << std::endl;
+	std::cout << "Slaves: " << sim.getSlaveCount() << std::endl;
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	auto start = std::chrono::steady_clock::now();
+	auto last = start;
+	SimStats prev = sim.getStats();
+	while (!g_stop) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		auto now = std::chrono::steady_clock::now();
+		if (seconds > 0 && now - start >= std::chrono::seconds(seconds)) break;
+		double sec = std::chrono::duration<double>(now - last).count();
+		if (sec >= 5) {
+			SimStats s = sim.getStats();
+			printStats(s, prev, sec);
+			prev = s;
+			last = now;
+		}
+	}
+
+	sim.stop();
+	SimStats s = sim.getStats();
+	printStats(s, SimStats{}, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	return 0;
+}
@@ -0,0 +1,198 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <ctime>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+
+#include "FrameTrace.h"
+#include "Transport.h"
+
+// Просмотр и воспроизведение двоичной трассировки кадров
+// Запуск: mb_trace print <трассировка> [-t] [-l]    - вывод в формате Readme (Tx:000056-01 05 00 01 FF 00 DD FA),
+//                                                     -t - время суток кадра, -l - номер линии
+//         mb_trace replay <трассировка> [повторы]    - разбор принятых кадров декодером, замер времени.
+//                                                     Ответ TCP сопоставляется запросу по transaction_id, RTU - первому
+//                                                     ответу после запроса; таймауты и опоздавшие ответы не разбираются
+
+using namespace mb::modbus;
+
+static void printFrames(FrameTraceReader& reader, bool with_time, bool with_line) {
+	const TraceFileHeader* h = reader.getHeader();
+	TraceFrame f;
+	uint32_t seq = 0;
+	char line[MODBUS_MAX_ADU_LENGTH * 3 + 128];
+
+	while (reader.next(f)) {
+		char* p = line;
+		if (with_time) {
+			uint64_t real_ns = h->start_real_ns + f.ts_ns;
+			time_t sec = static_cast<time_t>(real_ns / 1000000000ull);
+			tm t;
+			localtime_r(&sec, &t);
+			p += sprintf(p, "%02d:%02d:%02d.%06u ", t.tm_hour, t.tm_min, t.tm_sec, static_cast<unsigned>(real_ns % 1000000000ull / 1000));
+		}
+		if (with_line) p += sprintf(p, "[%u] ", f.line_id);
+		p += sprintf(p, "%s:%06u-", f.dir == TraceDir::TX ? "Tx" : "Rx", seq++ % 1000000);
+		for (uint16_t i = 0; i < f.len; i++) p += sprintf(p, i ? " %02X" : "%02X", f.data[i]);
+
+		if (f.dir == TraceDir::RX) {
+			MbStatus status = static_cast<MbStatus>(f.status);
+			if (status == MbStatus::EXCEPTION) p += sprintf(p, "\t\t\tОшибка");
+			else if (status != MbStatus::OK) p += sprintf(p, "\t\t\t%s", mbStatusToString(status));
+		}
+		puts(line);
+	}
+}
+
+// Пара запрос/ответ одной линии
+struct Exchange {
+	const BYTE* tx;
+	uint16_t tx_len;
+	const BYTE* rx;
+	uint16_t rx_len;
+	TraceKind kind;
+};
+
+// PDU внутри кадра, nullptr - кадр не прошел проверку CRC/MBAP
+static const BYTE* pduOf(const BYTE* adu, size_t len, TraceKind kind, size_t& pdu_len) {
+	if (kind == TraceKind::RTU) {
+		if (len < RTU_HEADER_SIZE + RTU_CRC_SIZE + 1 || !rtuCheck(adu, len)) return nullptr;
+		pdu_len = len - RTU_HEADER_SIZE - RTU_CRC_SIZE;
+		return adu + RTU_HEADER_SIZE;
+	}
+	MbapHeader header;
+	if (!mbapDecode(adu, len, header) || len < TCP_HEADER_SIZE + 1) return nullptr;
+	pdu_len = len - TCP_HEADER_SIZE;
+	return adu + TCP_HEADER_SIZE;
+}
+
+// Разбор ответа так же, как его разбирает ModbusMaster
+static bool decode(const Exchange& e) {
+	size_t req_len = 0, resp_len = 0;
+	const BYTE* req = pduOf(e.tx, e.tx_len, e.kind, req_len);
+	const BYTE* resp = pduOf(e.rx, e.rx_len, e.kind, resp_len);
+	if (req == nullptr || resp == nullptr || req_len < 5) return false;
+	if (isExceptionPdu(resp)) return (resp[0] & 0x7F) == req[0];
+
+	static BIT bits[MODBUS_MAX_READ_BITS];
+	static WORD words[MODBUS_MAX_READ_REGISTERS];
+	const BYTE func = req[0];
+	const WORD quantity = getWordBE(req + 3);
+	if (func == 1 || func == 2) return pduParseBits(resp, resp_len, func, quantity, bits);
+	if (func == 3 || func == 4) return pduParseWords(resp, resp_len, func, quantity, words);
+	return resp_len >= 5 && memcmp(req, resp, 5) == 0;
+}
+
+// Ключ ожидающего запроса TCP: линия и transaction_id MBAP
+static uint32_t tcpKey(const TraceFrame& f) {
+	return (static_cast<uint32_t>(f.line_id) << 16) | getWordBE(f.data);
+}
+
+static int replay(FrameTraceReader& reader, int iterations) {
+	std::vector<Exchange> exchanges;
+	// RTU: один запрос на линии, ответ снимает его. TCP: запросы ждут ответа со своим transaction_id
+	std::vector<TraceFrame> rtu_tx(65536);
+	std::vector<bool> rtu_pending(65536, false);
+	std::unordered_map<uint32_t, TraceFrame> tcp_tx;
+	size_t skipped = 0;
+	TraceFrame f;
+	while (reader.next(f)) {
+		if (f.kind == TraceKind::TCP && f.len < TCP_HEADER_SIZE + 1) {
+			++skipped;
+			continue;
+		}
+		if (f.dir == TraceDir::TX) {
+			if (f.kind == TraceKind::RTU) {
+				rtu_tx[f.line_id] = f;
+				rtu_pending[f.line_id] = true;
+			}
+			else tcp_tx[tcpKey(f)] = f;
+			continue;
+		}
+
+		// Таймаут и ошибка ввода-вывода - кадра нет или он неполный, запрос RTU на этом закончен
+		const MbStatus status = static_cast<MbStatus>(f.status);
+		const bool no_frame = status == MbStatus::TIMEOUT || status == MbStatus::IO_ERROR;
+		if (f.kind == TraceKind::RTU) {
+			if (!no_frame && rtu_pending[f.line_id]) {
+				const TraceFrame& tx = rtu_tx[f.line_id];
+				exchanges.push_back(Exchange{ tx.data, tx.len, f.data, f.len, f.kind });
+			}
+			else ++skipped;
+			rtu_pending[f.line_id] = false;
+			continue;
+		}
+
+		auto it = tcp_tx.find(tcpKey(f));
+		if (it == tcp_tx.end() || no_frame) {
+			++skipped;
+			continue;
+		}
+		const TraceFrame tx = it->second;
+		tcp_tx.erase(it);
+		// BAD_RESPONSE с совпадающими устройством и функцией - опоздавший ответ, пропущенный мастером
+		if (status == MbStatus::BAD_RESPONSE && f.data[TCP_HEADER_SIZE - 1] == tx.data[TCP_HEADER_SIZE - 1] && (f.data[TCP_HEADER_SIZE] & 0x7F) == tx.data[TCP_HEADER_SIZE]) {
+			++skipped;
+			continue;
+		}
+		exchanges.push_back(Exchange{ tx.data, tx.len, f.data, f.len, f.kind });
+	}
+	if (exchanges.empty()) {
+		std::cerr << "no request/response pairs in trace" << std::endl;
+		return 1;
+	}
+
+	size_t decoded = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int it = 0; it < iterations; it++) {
+		for (const Exchange& e : exchanges) decoded += decode(e);
+	}
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const size_t total = exchanges.size() * iterations;
+	printf("%zu responses x %d: %zu decoded, %zu rejected, %zu unpaired skipped, %.1f ns/frame, %.2f Mframes/s\n", exchanges.size(), iterations,
+			 decoded / iterations, (total - decoded) / iterations, skipped, sec * 1e9 / total, total / sec / 1e6);
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cerr << "Usage: " << argv[0] << " print <trace> [-t] [-l]" << std::endl;
+		std::cerr << "       " << argv[0] << " replay <trace> [iterations]" << std::endl;
+		return 2;
+	}
+
+	FrameTraceReader reader;
+	if (!reader.open(argv[2])) {
+		std::cerr << argv[2] << ": " << reader.getError() << std::endl;
+		return 1;
+	}
+
+	if (strcmp(argv[1], "print") == 0) {
+		bool with_time = false, with_line = false;
+		for (int i = 3; i < argc; i++) {
+			if (strcmp(argv[i], "-t") == 0) with_time = true;
+			else if (strcmp(argv[i], "-l") == 0) with_line = true;
+		}
+		printFrames(reader, with_time, with_line);
+	}
+	else if (strcmp(argv[1], "replay") == 0) {
+		int iterations = argc > 3 ? std::max(1, atoi(argv[3])) : 100;
+		if (replay(reader, iterations) != 0) return 1;
+	}
+	else {
+		std::cerr << argv[1] << ": unknown command" << std::endl;
+		return 2;
+	}
+
+	if (!reader.getError().empty()) {
+		std::cerr << argv[2] << ": " << reader.getError() << std::endl;
+		return 1;
+	}
+	return 0;
+}